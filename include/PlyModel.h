@@ -218,6 +218,9 @@ typedef struct PlyModel
     int           vamode;
 } PlyModel;
 
+void read_plyfile(char *filename, PlyModel *model);
+void DeleteModel(PlyModel *model);
+
 void MakePatches(PlyModel *model);
 void SetupNormalMap(PlyModel *model);
 void SetupTexture(PlyModel *model,char* filename);
@@ -17,6 +17,8 @@
 #ifndef GLODAPI_H
 #define GLODAPI_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -66,6 +68,9 @@ extern "C" {
 #define GLOD_PATCH_NAMES           0x03
 #define GLOD_PATCH_SIZES           0x04
 #define GLOD_XFORM_MATRIX          0x05
+#define GLOD_CUT_SNAPSHOT_SIZE     0x06
+#define GLOD_CURRENT_OBJECT_SPACE_ERROR 0x07
+#define GLOD_CURRENT_SCREEN_SPACE_ERROR 0x08
 
 #define GLOD_BUILD_OPERATOR        0x20
 #define GLOD_BUILD_QUEUE_MODE      0x21
@@ -78,10 +83,27 @@ extern "C" {
 #define GLOD_BUILD_ERROR_SPECS     0x28
 #define GLOD_BUILD_PERMISSION_GRID_PRECISION 0x29
 #define GLOD_QUADRIC_MULTIPLIER	   0x2a
+#define GLOD_BUILD_STATUS          0x2b
+#define GLOD_BUILD_PROGRESS        0x2c
+#define GLOD_BORROW_ARRAYS         0x2d
+#define GLOD_PROGRESSIVE_RECORDS   0x2e
+#define GLOD_PROGRESSIVE_RECORDS_LEFT 0x2f
     
 #define GLOD_XFORM                 0x41
 #define GLOD_APPLY_OBJECT_XFORM    0x42
 #define GLOD_IMPORTANCE            0x50
+#define GLOD_OCCLUDER              0x51
+
+#define GLOD_TRI_COMPACTION        0x60
+#define GLOD_TRI_REORDERING        0x61
+#define GLOD_VERTEX_CACHE_SIZE     0x62
+#define GLOD_PATCH_ACMR            0x63
+
+/* Memory Param Names (also queryable per group and per object)
+ ***************************************************************************/
+#define GLOD_MEMORY_BUDGET         0x70
+#define GLOD_MEMORY_ALLOCATED      0x71
+#define GLOD_MEMORY_USAGE          0x72
 
 /* Object::Possible Param Values
  ***************************************************************************/
@@ -107,6 +129,10 @@ extern "C" {
 #define GLOD_SNAPSHOT_TRI_SPEC           0x02
 #define GLOD_SNAPSHOT_ERROR_SPEC         0x03
 
+#define GLOD_BUILD_NOT_STARTED           0x01
+#define GLOD_BUILD_IN_PROGRESS           0x02
+#define GLOD_BUILD_COMPLETE              0x03
+
 /* GLOD Group Params
  ***************************************************************************/
 #define GLOD_ADAPT_MODE                   0x01
@@ -114,6 +140,14 @@ extern "C" {
 #define GLOD_OBJECT_SPACE_ERROR_THRESHOLD 0x03
 #define GLOD_SCREEN_SPACE_ERROR_THRESHOLD 0x04
 #define GLOD_MAX_TRIANGLES                0x05
+#define GLOD_SUBTREE_CULLING              0x06
+#define GLOD_OCCLUSION_CULLING            0x07
+#define GLOD_OCCLUSION_RESOLUTION         0x08
+#define GLOD_ADAPT_THREADS                0x09
+#define GLOD_BUDGET_STEPS                 0x0a
+#define GLOD_BUDGET_HYSTERESIS            0x0b
+#define GLOD_COMPACT_INSTANCES            0x0c
+#define GLOD_INSTANCE_TIERS               0x0d
 
 /* Group::Possible Param Values
  ***************************************************************************/
@@ -122,17 +156,94 @@ extern "C" {
 #define GLOD_OBJECT_SPACE_ERROR 0x03
 #define GLOD_SCREEN_SPACE_ERROR 0x04
 
+/* Group statistics, returned by glodGetGroupStats. Counts cover the group's
+ * continuous objects and accumulate until the stats are reset. Times are
+ * in milliseconds and are only gathered when VDSlib is built with the
+ * TIMING_LEVEL_n noted beside them (see src/vds/settings.h); otherwise 0.
+ ***************************************************************************/
+typedef struct GLODgroupstats
+{
+    GLuint  adaptCount;             /* glodAdaptGroup calls */
+    GLuint  folds;
+    GLuint  unfolds;
+    GLuint  trisIntroduced;
+    GLuint  trisRemoved;
+    GLuint  foldQueueSize;          /* as of the last error update */
+    GLuint  unfoldQueueSize;
+    GLuint  parkedNodes;            /* culled outside the view frustum */
+    GLuint  occludedNodes;          /* behind occluders at the last error update */
+    GLuint  occluderTris;           /* rasterized into the occlusion buffer */
+
+    GLfloat adaptTime;              /* level 1 */
+    GLfloat updateErrorsTime;       /* level 1 */
+    GLfloat simplifyTime;           /* level 1 */
+    GLfloat renderCopyTime;         /* level 1: copies to fast memory */
+    GLfloat occlusionTime;          /* level 1: rasterizing occluders */
+    GLfloat foldErrorCalcTime;      /* level 2 */
+    GLfloat unfoldErrorCalcTime;    /* level 2 */
+    GLfloat foldHeapifyTime;        /* level 2 */
+    GLfloat unfoldHeapifyTime;      /* level 2 */
+    GLfloat cullTime;               /* level 2: subtree culling */
+    GLfloat foldTime;               /* level 3 */
+    GLfloat unfoldTime;             /* level 3 */
+    GLfloat foldCheckTime;          /* level 4 */
+    GLfloat foldRemoveChildrenTime; /* level 4 */
+    GLfloat foldRemoveTrisTime;     /* level 4 */
+    GLfloat foldQueueTime;          /* level 4 */
+    GLfloat unfoldAddChildrenTime;  /* level 4 */
+    GLfloat unfoldMoveTrisTime;     /* level 4 */
+    GLfloat unfoldAddTrisTime;      /* level 4 */
+    GLfloat unfoldQueueTime;        /* level 4 */
+    GLfloat addVertexDataTime;      /* level 5 */
+    GLfloat addTriDataTime;         /* level 5 */
+} GLODgroupstats;
+
+/* All GLOD state lives in a context. Each thread has its own current
+ * context; glodInit makes one if the thread has none.
+ ***************************************************************************/
+typedef struct GLODcontext GLODcontext;
+
+/* Object streams: glodWriteObject and glodReadObject, and their
+ * progressive versions, pass consecutive pieces of the stream through
+ * these. They return the number of bytes written or read; anything short
+ * of size fails the call.
+ ***************************************************************************/
+typedef size_t (*GLODwriteproc)( const GLvoid *data, size_t size, GLvoid *user_data );
+typedef size_t (*GLODreadproc)( GLvoid *data, size_t size, GLvoid *user_data );
+
 GLOD_APIENTRY GLuint glodInit( );
 GLOD_APIENTRY void glodShutdown( );
 
+GLOD_APIENTRY GLODcontext *glodCreateContext( void );
+GLOD_APIENTRY void glodDestroyContext( GLODcontext *context );
+GLOD_APIENTRY void glodMakeCurrent( GLODcontext *context );
+GLOD_APIENTRY GLODcontext *glodGetCurrentContext( void );
+
 GLOD_APIENTRY GLuint glodGetError( void );
 
 GLOD_APIENTRY void glodLoadObject( GLuint name, GLuint groupname, 
                                    const GLvoid *data );
 GLOD_APIENTRY void glodReadbackObject( GLuint name, GLvoid *data );
+GLOD_APIENTRY void glodWriteObject( GLuint name, GLODwriteproc write,
+                                    GLvoid *user_data );
+GLOD_APIENTRY void glodReadObject( GLuint name, GLuint groupname,
+                                   GLODreadproc read, GLvoid *user_data );
+GLOD_APIENTRY void glodMapObject( GLuint name, GLuint groupname,
+                                  GLvoid *data, size_t size );
+GLOD_APIENTRY void glodWriteProgressiveObject( GLuint name, GLODwriteproc write,
+                                               GLvoid *user_data );
+GLOD_APIENTRY void glodReadProgressiveObject( GLuint name, GLuint groupname,
+                                              GLODreadproc read, GLvoid *user_data );
+GLOD_APIENTRY GLboolean glodContinueProgressiveObject( GLuint name,
+                                                       GLuint max_records );
+GLOD_APIENTRY void glodLoadCut( GLuint name, const GLvoid *data );
+GLOD_APIENTRY void glodReadbackCut( GLuint name, GLvoid *data );
 GLOD_APIENTRY void glodFillArrays( GLuint object_name, GLuint patch_name );
 GLOD_APIENTRY void glodFillElements( GLuint object_name, GLuint patch_name, 
                                      GLenum type, GLvoid* out_elements );
+GLOD_APIENTRY void glodFillObjectElements( GLuint object_name, GLenum type,
+                                           GLvoid* out_elements,
+                                           GLint* patch_ranges );
 
 
 GLOD_APIENTRY void glodInsertArrays( GLuint name, GLuint patchname, 
@@ -148,16 +259,25 @@ GLOD_APIENTRY void glodInstanceObject( GLuint name, GLuint instancename,
 GLOD_APIENTRY void glodNewObject( GLuint name, GLuint groupname,
                                   GLenum format );
 GLOD_APIENTRY void glodBuildObject( GLuint name );
+GLOD_APIENTRY void glodBuildObjectAsync( GLuint name );
+GLOD_APIENTRY GLboolean glodTestBuild( GLuint name );
+GLOD_APIENTRY void glodFinishBuild( GLuint name );
 GLOD_APIENTRY void glodDeleteObject( GLuint name );
 
 GLOD_APIENTRY void glodDrawPatch( GLuint name, GLuint patchname );
 
 GLOD_APIENTRY void glodSetLayout(int rows, int cols);
 
+GLOD_APIENTRY void glodMemoryParameteri( GLenum pname, GLint param );
+GLOD_APIENTRY void glodGetMemoryParameteriv( GLenum pname, GLint *param );
+
 GLOD_APIENTRY void glodNewGroup( GLuint groupname );
 GLOD_APIENTRY void glodAdaptGroup( GLuint groupname );
 GLOD_APIENTRY void glodObjectXform( GLuint object_name, float m1[16],
                                     float m2[16], float m3[16] );
+GLOD_APIENTRY void glodObjectXforms( GLsizei count, const GLuint *object_names,
+                                     const float camera[16],
+                                     const float *models );
 GLOD_APIENTRY void glodBindObjectXform( GLuint object_name, GLenum which );
 GLOD_APIENTRY void glodDeleteGroup( GLuint groupname );
 
@@ -189,6 +309,8 @@ GLOD_APIENTRY void glodGroupParameterf( GLuint groupname, GLenum pname,
                                         GLfloat param );
 GLOD_APIENTRY void glodGroupParameteri( GLuint groupname, GLenum pname,
                                         GLint param );
+GLOD_APIENTRY void glodGetGroupStats( GLuint groupname, GLODgroupstats *stats,
+                                      GLboolean reset );
 
 GLOD_APIENTRY void glodDebugDrawObject( GLuint name ); /* debugging only */
 
@@ -0,0 +1,726 @@
+/******************************************************************************
+ * Copyright 2003 Jonathan Cohen, Nat Duca, David Luebke, Brenden Schubert    *
+ *                Johns Hopkins University and University of Virginia         *
+ ******************************************************************************
+ * This file is distributed as part of the GLOD library, and as such, falls   *
+ * under the terms of the GLOD public license. GLOD is distributed without    *
+ * any warranty, implied or otherwise. See the GLOD license for more details. *
+ *                                                                            *
+ * You should have recieved a copy of the GLOD Open-Source License with this  *
+ * copy of GLOD; if not, please visit the GLOD web page,                      *
+ * http://www.cs.jhu.edu/~graphics/GLOD/license for more information          *
+ ******************************************************************************/
+/* Headless adaptation benchmark.
+ *
+ * Loads one or more PLY files into a single GLOD group, then replays a camera
+ * path through glodObjectXform() and glodAdaptGroup(), reading the adapted
+ * geometry back with glodFillElements() instead of drawing it. One CSV line
+ * is printed per frame, followed by a summary; both are meant to be diffed
+ * between builds to catch adaptation performance regressions.
+ *
+ * With -instances, each file is instanced into a grid of many objects, so
+ * that adaptation of large groups (10k-100k objects) can be measured; with
+ * -movers as well, the camera holds still and only a few objects move each
+ * frame, as in a mostly static scene. -compact makes the instances compact
+ * ones (GLOD_COMPACT_INSTANCES), which share their source's cuts, and
+ * -tiers sets how many cuts they share, or switches between two counts
+ * every frame.
+ *
+ * On Linux the GL context GLOD needs for its vertex array calls is created
+ * through EGL's surfaceless platform, so no window, X server or GPU is
+ * required (Mesa's software rasterizer is enough). Elsewhere a GLUT window
+ * is created and hidden.
+ ***************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(__linux__)
+#define BENCH_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#elif defined(__APPLE__)
+#include <OpenGL/gl.h>
+#include <GLUT/glut.h>
+#else
+#include <GL/gl.h>
+#include <GL/glut.h>
+#endif
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+# include <values.h>
+#else
+# include <float.h>
+#endif
+
+#include "glod.h"
+#include "nat_timer.h"
+#include "PlyModel.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_MODEL "../data/bunny17k.ply"
+#define OBJECT_SPACING 1.5f  // distance between neighbouring objects; each is scaled to a unit diagonal
+
+struct CameraFrame {
+    float eye[3];
+    float center[3];
+    float up[3];
+    float fovy;
+};
+
+struct BenchObject {
+    PlyModel model;
+    int format;
+    float scale;
+    GLint npatches;
+    GLint *patchNames;
+    GLint *patchSizes;
+};
+
+// a GLOD object: one of the loaded files, or an instance of one
+struct BenchInstance {
+    GLuint name;
+    BenchObject* object;
+    float offset[3];
+};
+
+int s_Width = 640, s_Height = 480;
+int s_BudgetMode = 0;
+int s_ScreenSpace = 1;
+int s_Triangles = 10000;
+float s_Threshold = -1;
+int s_Readback = 1;
+int s_Cull = 0;
+int s_Occlude = 0;
+int s_Warmup = 1;
+int s_NumInstances = 1;
+int s_Movers = 0;
+int s_BudgetSteps = 0;
+int s_Compact = 0;
+int s_Batch = 0;
+int s_Tiers[2] = { 0, 0 };    // GLOD_INSTANCE_TIERS, alternating if both set
+std::vector<BenchObject*> s_Objects;
+std::vector<BenchInstance> s_Instances;
+unsigned int s_GridSize = 1;  // objects along the longer side of the layout
+
+// for readback
+std::vector<float> s_Vertices;
+std::vector<GLuint> s_Indices;
+
+// for -batch
+std::vector<GLuint> s_XformNames;
+std::vector<float> s_XformModels;
+
+void Usage();
+
+/***************************************************************************
+ * GL context
+ ***************************************************************************/
+#ifdef BENCH_USE_EGL
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+int CreateHeadlessContext(int* argc, char** argv) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    if(getPlatformDisplay != NULL)
+        dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if(dpy == EGL_NO_DISPLAY)
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if(dpy == EGL_NO_DISPLAY || ! eglInitialize(dpy, &major, &minor)) {
+        fprintf(stderr, "Could not initialize EGL.\n");
+        return 0;
+    }
+    if(! eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "EGL does not support desktop OpenGL.\n");
+        return 0;
+    }
+
+    static const EGLint config_attribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                             EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                             EGL_NONE };
+    EGLConfig config;
+    EGLint nconfigs = 0;
+    if(! eglChooseConfig(dpy, config_attribs, &config, 1, &nconfigs) || nconfigs < 1) {
+        fprintf(stderr, "No EGL config supports OpenGL.\n");
+        return 0;
+    }
+
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+    if(ctx == EGL_NO_CONTEXT ||
+       ! eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        fprintf(stderr, "Could not make a surfaceless OpenGL context current.\n");
+        return 0;
+    }
+    (void)argc; (void)argv;
+    return 1;
+}
+#else
+int CreateHeadlessContext(int* argc, char** argv) {
+    glutInit(argc, argv);
+    glutInitDisplayMode(GLUT_RGBA);
+    glutInitWindowSize(64, 64);
+    glutCreateWindow("GLOD benchmark");
+    glutHideWindow();
+    return 1;
+}
+#endif
+
+/***************************************************************************
+ * Matrices (column major, as GL and glodObjectXform expect)
+ ***************************************************************************/
+static void Normalize(float v[3]) {
+    float l = (float) sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    if(l > 0) { v[0] /= l; v[1] /= l; v[2] /= l; }
+}
+
+static void Cross(float d[3], const float a[3], const float b[3]) {
+    d[0] = a[1]*b[2] - a[2]*b[1];
+    d[1] = a[2]*b[0] - a[0]*b[2];
+    d[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+static float Dot(const float a[3], const float b[3]) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+void Perspective(float m[16], float fovy, float aspect, float znear, float zfar) {
+    float f = 1.0f / (float) tan(fovy * M_PI / 360.0);
+    memset(m, 0, sizeof(float) * 16);
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zfar + znear) / (znear - zfar);
+    m[11] = -1;
+    m[14] = 2 * zfar * znear / (znear - zfar);
+}
+
+void LookAt(float m[16], const CameraFrame& cam) {
+    float f[3], s[3], u[3];
+    for(int i = 0; i < 3; i++)
+        f[i] = cam.center[i] - cam.eye[i];
+    Normalize(f);
+    Cross(s, f, cam.up); Normalize(s);
+    Cross(u, s, f);
+
+    m[0] = s[0]; m[4] = s[1]; m[8]  = s[2]; m[12] = -Dot(s, cam.eye);
+    m[1] = u[0]; m[5] = u[1]; m[9]  = u[2]; m[13] = -Dot(u, cam.eye);
+    m[2] =-f[0]; m[6] =-f[1]; m[10] =-f[2]; m[14] =  Dot(f, cam.eye);
+    m[3] = 0;    m[7] = 0;    m[11] = 0;    m[15] = 1;
+}
+
+// d = view * translate(offset) * scale(s)
+void ObjectModelview(float d[16], const float view[16], const BenchInstance& inst,
+                     const float offset[3]) {
+    for(int c = 0; c < 3; c++)
+        for(int r = 0; r < 4; r++)
+            d[c*4+r] = view[c*4+r] * inst.object->scale;
+    for(int r = 0; r < 4; r++)
+        d[12+r] = view[r]*offset[0] + view[4+r]*offset[1] +
+                  view[8+r]*offset[2] + view[12+r];
+}
+
+/***************************************************************************
+ * Camera paths
+ *
+ * A path file holds one frame per line:
+ *   eye_x eye_y eye_z  center_x center_y center_z  up_x up_y up_z  fovy
+ * Blank lines and lines starting with '#' are ignored. Positions are in
+ * benchmark units: every object is scaled to a unit bounding box diagonal
+ * and the objects are lined up along x, OBJECT_SPACING apart, centered on
+ * the origin. With -instances they fill a square grid in the xz plane
+ * instead, also OBJECT_SPACING apart and centered on the origin.
+ ***************************************************************************/
+int ReadCameraPath(const char* file, std::vector<CameraFrame>& path) {
+    FILE* f = fopen(file, "r");
+    if(f == NULL) {
+        fprintf(stderr, "Could not open camera path %s\n", file);
+        return 0;
+    }
+    char line[1024];
+    int lineno = 0;
+    while(fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        char* p = line;
+        while(*p == ' ' || *p == '\t') p++;
+        if(*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+            continue;
+        CameraFrame c;
+        if(sscanf(p, "%f %f %f %f %f %f %f %f %f %f",
+                  &c.eye[0], &c.eye[1], &c.eye[2],
+                  &c.center[0], &c.center[1], &c.center[2],
+                  &c.up[0], &c.up[1], &c.up[2], &c.fovy) != 10) {
+            fprintf(stderr, "%s:%i: expected 10 numbers\n", file, lineno);
+            fclose(f);
+            return 0;
+        }
+        path.push_back(c);
+    }
+    fclose(f);
+    return 1;
+}
+
+int WriteCameraPath(const char* file, const std::vector<CameraFrame>& path) {
+    FILE* f = fopen(file, "w");
+    if(f == NULL) {
+        fprintf(stderr, "Could not write camera path %s\n", file);
+        return 0;
+    }
+    fprintf(f, "# GLOD benchmark camera path: %i frames\n", (int) path.size());
+    fprintf(f, "# eye_x eye_y eye_z center_x center_y center_z up_x up_y up_z fovy\n");
+    for(unsigned int i = 0; i < path.size(); i++) {
+        const CameraFrame& c = path[i];
+        fprintf(f, "%g %g %g %g %g %g %g %g %g %g\n",
+                c.eye[0], c.eye[1], c.eye[2], c.center[0], c.center[1], c.center[2],
+                c.up[0], c.up[1], c.up[2], c.fovy);
+    }
+    fclose(f);
+    return 1;
+}
+
+// One orbit around the objects that also zooms in close and back out twice,
+// so that both refinement and coarsening are exercised.
+void MakeOrbitPath(int nframes, std::vector<CameraFrame>& path) {
+    float extent = OBJECT_SPACING * (s_GridSize - 1) + 1.0f;
+    for(int i = 0; i < nframes; i++) {
+        float a = (float) (2 * M_PI * i / nframes);
+        float d = extent * (0.6f + 0.7f * (1 + (float) cos(2 * a)));
+        CameraFrame c;
+        c.eye[0] = d * (float) sin(a);
+        c.eye[1] = 0.3f * d;
+        c.eye[2] = d * (float) cos(a);
+        c.center[0] = c.center[1] = c.center[2] = 0;
+        c.up[0] = 0; c.up[1] = 1; c.up[2] = 0;
+        c.fovy = 45;
+        path.push_back(c);
+    }
+}
+
+/***************************************************************************
+ * Objects
+ ***************************************************************************/
+BenchObject* LoadObject(char* file, int format, int build_op, int metric) {
+    BenchObject* obj = new BenchObject;
+    memset(&obj->model, 0, sizeof(PlyModel));
+    obj->format = format;
+
+    read_plyfile(file, &obj->model);
+    float diag = CenterOnOrigin(&obj->model);
+    obj->scale = (diag > 0) ? 1.0f / diag : 1.0f;
+    if(! obj->model.has_vertex_normals)
+        ComputeVertexNormals(&obj->model, 0);
+    SetupVertexArray(&obj->model, VERTEX_ARRAY_ELEMENTS);
+
+    GLuint name = (GLuint) s_Objects.size();
+    glodNewObject(name, 0, format);
+    for(int pnum = 0; pnum < obj->model.npatches; pnum++) {
+        BindVertexArray(&obj->model, pnum);
+        glodInsertElements(name, pnum, GL_TRIANGLES,
+                           obj->model.plist[pnum].nindices, GL_UNSIGNED_INT,
+                           obj->model.plist[pnum].indices, 0, 0.0);
+    }
+    glodObjectParameteri(name, GLOD_BUILD_OPERATOR, build_op);
+    glodObjectParameteri(name, GLOD_BUILD_ERROR_METRIC, metric);
+
+    TIMER_DATA t;
+    Timer_Start(&t);
+    glodBuildObject(name);
+    double build = Timer_Elapsed(&t);
+
+    GLuint err = glodGetError();
+    if(err != GLOD_NO_ERROR) {
+        fprintf(stderr, "Building %s failed with GLOD error 0x%x\n", file, err);
+        exit(1);
+    }
+
+    glodGetObjectParameteriv(name, GLOD_NUM_PATCHES, &obj->npatches);
+    obj->patchNames = new GLint[obj->npatches];
+    obj->patchSizes = new GLint[2 * obj->npatches];
+    glodGetObjectParameteriv(name, GLOD_PATCH_NAMES, obj->patchNames);
+
+    printf("# object %u: %s, %s, %i faces, %i patches, built in %.3f s\n",
+           name, file, (format == GLOD_CONTINUOUS) ? "continuous" : "discrete",
+           obj->model.nfaces, (int) obj->npatches, build);
+    return obj;
+}
+
+// Instances every object s_NumInstances-1 times and lays them all out
+void MakeInstances() {
+    unsigned int count = (unsigned int) s_Objects.size() * s_NumInstances;
+    unsigned int cols = count, rows = 1;
+    if(s_NumInstances > 1) {
+        cols = (unsigned int) ceil(sqrt((double) count));
+        rows = (count + cols - 1) / cols;
+    }
+    s_GridSize = std::max(cols, rows);
+
+    GLuint next_name = (GLuint) s_Objects.size();
+    for(unsigned int i = 0; i < count; i++) {
+        BenchInstance inst;
+        inst.object = s_Objects[i % s_Objects.size()];
+        inst.name = (i < s_Objects.size()) ? i : next_name++;
+        if(inst.name != i % s_Objects.size())
+            glodInstanceObject(i % s_Objects.size(), inst.name, 0);
+        inst.offset[0] = OBJECT_SPACING * ((i % cols) - 0.5f * (cols - 1));
+        inst.offset[1] = 0;
+        inst.offset[2] = OBJECT_SPACING * ((i / cols) - 0.5f * (rows - 1));
+        s_Instances.push_back(inst);
+    }
+    GLuint err = glodGetError();
+    if(err != GLOD_NO_ERROR) {
+        fprintf(stderr, "Instancing failed with GLOD error 0x%x\n", err);
+        exit(1);
+    }
+    if(count > s_Objects.size())
+        printf("# %u objects in a %ux%u grid\n", count, cols, rows);
+}
+
+// Binds the view to an instance; movers bob up and down over time.
+// With -batch the binding is queued for FlushXforms() instead.
+void XformInstance(unsigned int i, unsigned int frame,
+                   const float proj[16], const float view[16]) {
+    float modelview[16], offset[3];
+    const BenchInstance& inst = s_Instances[i];
+    offset[0] = inst.offset[0];
+    offset[1] = inst.offset[1];
+    offset[2] = inst.offset[2];
+    if(s_Movers > 0)
+        offset[1] += 0.5f * OBJECT_SPACING * (float) sin(0.05 * frame + i);
+    ObjectModelview(modelview, view, inst, offset);
+    if(s_Batch) {
+        s_XformNames.push_back(inst.name);
+        s_XformModels.insert(s_XformModels.end(), modelview, modelview + 16);
+    } else {
+        glodObjectXform(inst.name, (float*) proj, modelview, NULL);
+    }
+}
+
+// Binds everything XformInstance() queued in one call
+void FlushXforms(const float proj[16]) {
+    if(s_XformNames.empty())
+        return;
+    glodObjectXforms((GLsizei) s_XformNames.size(), &s_XformNames[0],
+                     proj, &s_XformModels[0]);
+    s_XformNames.clear();
+    s_XformModels.clear();
+}
+
+// Reads back every patch of every object; returns the number of triangles
+int ReadbackObjects() {
+    int tris = 0;
+    for(unsigned int i = 0; i < s_Instances.size(); i++) {
+        GLuint name = s_Instances[i].name;
+        BenchObject* obj = s_Instances[i].object;
+        glodGetObjectParameteriv(name, GLOD_PATCH_SIZES, obj->patchSizes);
+        for(int p = 0; p < obj->npatches; p++) {
+            GLint nindices = obj->patchSizes[2*p];
+            GLint nverts = obj->patchSizes[2*p+1];
+            tris += nindices / 3;
+            if(! s_Readback)
+                continue;
+
+            if((int) s_Indices.size() < nindices) s_Indices.resize(nindices);
+            if((int) s_Vertices.size() < 3*nverts) s_Vertices.resize(3*nverts);
+            glVertexPointer(3, GL_FLOAT, 0, &s_Vertices[0]);
+            glodFillElements(name, obj->patchNames[p], GL_UNSIGNED_INT, &s_Indices[0]);
+        }
+    }
+    return tris;
+}
+
+// The largest current error of any object, in the group's error mode
+float CurrentError() {
+    float max_err = 0, err;
+    GLenum pname = s_ScreenSpace ? GLOD_CURRENT_SCREEN_SPACE_ERROR :
+                                   GLOD_CURRENT_OBJECT_SPACE_ERROR;
+    for(unsigned int i = 0; i < s_Instances.size(); i++) {
+        glodGetObjectParameterfv(s_Instances[i].name, pname, &err);
+        if(err > max_err) max_err = err;
+    }
+    return max_err;
+}
+
+double Percentile(std::vector<double> v, double pct) {
+    if(v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    unsigned int k = (unsigned int) (pct * (v.size() - 1) + 0.5);
+    return v[k];
+}
+
+/***************************************************************************
+ * main
+ ***************************************************************************/
+int main(int argc, char ** argv) {
+    int format = GLOD_CONTINUOUS;
+    int build_op = GLOD_OPERATOR_HALF_EDGE_COLLAPSE;
+    int metric = GLOD_METRIC_SPHERES;
+    int nframes = 360;
+    char* path_file = NULL;
+    char* record_file = NULL;
+    std::vector<char*> files;
+    std::vector<int> formats;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--help") == 0) {
+            Usage();
+            return 0;
+        } else if(strcmp(argv[i], "-c") == 0) {
+            format = GLOD_CONTINUOUS;
+        } else if(strcmp(argv[i], "-d") == 0) {
+            format = GLOD_DISCRETE;
+        } else if(strcmp(argv[i], "-q") == 0) {
+            metric = GLOD_METRIC_QUADRICS;
+        } else if(strcmp(argv[i], "-e") == 0) {
+            build_op = GLOD_OPERATOR_EDGE_COLLAPSE;
+        } else if(strcmp(argv[i], "-object") == 0) {
+            s_ScreenSpace = 0;
+        } else if(strcmp(argv[i], "-noreadback") == 0) {
+            s_Readback = 0;
+        } else if(strcmp(argv[i], "-cull") == 0) {
+            s_Cull = 1;
+        } else if(strcmp(argv[i], "-occlude") == 0) {
+            s_Occlude = 1;
+        } else if(strcmp(argv[i], "-budget") == 0 && i+1 < argc) {
+            s_BudgetMode = 1;
+            s_Triangles = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-threshold") == 0 && i+1 < argc) {
+            s_Threshold = (float) atof(argv[++i]);
+        } else if(strcmp(argv[i], "-frames") == 0 && i+1 < argc) {
+            nframes = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-warmup") == 0 && i+1 < argc) {
+            s_Warmup = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-instances") == 0 && i+1 < argc) {
+            s_NumInstances = std::max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "-movers") == 0 && i+1 < argc) {
+            s_Movers = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-compact") == 0) {
+            s_Compact = 1;
+        } else if(strcmp(argv[i], "-batch") == 0) {
+            s_Batch = 1;
+        } else if(strcmp(argv[i], "-tiers") == 0 && i+1 < argc) {
+            if(sscanf(argv[++i], "%i,%i", &s_Tiers[0], &s_Tiers[1]) < 1) {
+                Usage();
+                return 1;
+            }
+        } else if(strcmp(argv[i], "-steps") == 0 && i+1 < argc) {
+            s_BudgetSteps = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-size") == 0 && i+1 < argc) {
+            if(sscanf(argv[++i], "%ix%i", &s_Width, &s_Height) != 2) {
+                Usage();
+                return 1;
+            }
+        } else if(strcmp(argv[i], "-path") == 0 && i+1 < argc) {
+            path_file = argv[++i];
+        } else if(strcmp(argv[i], "-record") == 0 && i+1 < argc) {
+            record_file = argv[++i];
+        } else if(argv[i][0] == '-') {
+            fprintf(stderr, "Unknown option %s\n\n", argv[i]);
+            Usage();
+            return 1;
+        } else {
+            files.push_back(argv[i]);
+            formats.push_back(format);
+        }
+    }
+    if(files.empty()) {
+        files.push_back((char*) DEFAULT_MODEL);
+        formats.push_back(format);
+    }
+    if(s_Threshold < 0)
+        s_Threshold = s_ScreenSpace ? 0.002f : 0.001f;
+
+    if(! CreateHeadlessContext(&argc, argv))
+        return 1;
+    if(glodInit() == 0) {
+        fprintf(stderr, "Could not load GLOD!\n");
+        return 1;
+    }
+
+    // build the objects
+    glodNewGroup(0);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    for(unsigned int i = 0; i < files.size(); i++) {
+        BenchObject* obj = LoadObject(files[i], formats[i], build_op, metric);
+        s_Objects.push_back(obj);
+    }
+    if(s_Compact)
+        glodGroupParameteri(0, GLOD_COMPACT_INSTANCES, GL_TRUE);
+    if(s_Tiers[0] > 0)
+        glodGroupParameteri(0, GLOD_INSTANCE_TIERS, s_Tiers[0]);
+    MakeInstances();
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    // set up the group
+    glodGroupParameteri(0, GLOD_ERROR_MODE,
+                        s_ScreenSpace ? GLOD_SCREEN_SPACE_ERROR : GLOD_OBJECT_SPACE_ERROR);
+    if(s_BudgetMode) {
+        glodGroupParameteri(0, GLOD_ADAPT_MODE, GLOD_TRIANGLE_BUDGET);
+        glodGroupParameteri(0, GLOD_MAX_TRIANGLES, s_Triangles);
+        if(s_BudgetSteps > 0)
+            glodGroupParameteri(0, GLOD_BUDGET_STEPS, s_BudgetSteps);
+    } else {
+        glodGroupParameteri(0, GLOD_ADAPT_MODE, GLOD_ERROR_THRESHOLD);
+        glodGroupParameterf(0, s_ScreenSpace ? GLOD_SCREEN_SPACE_ERROR_THRESHOLD :
+                            GLOD_OBJECT_SPACE_ERROR_THRESHOLD, s_Threshold);
+    }
+    glodGroupParameteri(0, GLOD_SUBTREE_CULLING, s_Cull ? GL_TRUE : GL_FALSE);
+    if(s_Occlude) {
+        glodObjectParameteri(0, GLOD_OCCLUDER, GL_TRUE);
+        glodGroupParameteri(0, GLOD_OCCLUSION_CULLING, GL_TRUE);
+    }
+
+    // get the camera path
+    std::vector<CameraFrame> path;
+    if(path_file != NULL) {
+        if(! ReadCameraPath(path_file, path))
+            return 1;
+    } else {
+        MakeOrbitPath(nframes, path);
+    }
+    if(record_file != NULL && ! WriteCameraPath(record_file, path))
+        return 1;
+    if(path.empty()) {
+        fprintf(stderr, "The camera path has no frames.\n");
+        return 1;
+    }
+
+    printf("# %s, %s %g, %i frames, %ix%i\n",
+           s_ScreenSpace ? "screen space" : "object space",
+           s_BudgetMode ? "triangle budget" : "error threshold",
+           s_BudgetMode ? (double) s_Triangles : (double) s_Threshold,
+           (int) path.size(), s_Width, s_Height);
+    printf("frame,adapt_ms,readback_ms,folds,unfolds,tris_introduced,tris_removed,tris,error,parked,occluded\n");
+
+    // replay it
+    std::vector<double> adapt_times;
+    double adapt_total = 0, readback_total = 0, xform_total = 0;
+    unsigned int folds_total = 0, unfolds_total = 0;
+    float proj[16], view[16];
+    unsigned int next_mover = 0;
+    GLODgroupstats stats;
+    glodGetGroupStats(0, NULL, GL_TRUE);
+
+    for(unsigned int frame = 0; frame < path.size(); frame++) {
+        // movers hold the camera at the path's first frame
+        const CameraFrame& cam = path[(s_Movers > 0) ? 0 : frame];
+        float dist = (float) sqrt(Dot(cam.eye, cam.eye));
+        float extent = OBJECT_SPACING * s_GridSize;
+        float zfar = dist + extent;
+        float znear = std::max(0.01f, dist - extent);
+        Perspective(proj, cam.fovy, (float) s_Width / (float) s_Height, znear, zfar);
+        LookAt(view, cam);
+
+        TIMER_DATA t;
+        Timer_Start(&t);
+        if(s_Movers > 0 && frame > 0) {
+            for(int m = 0; m < s_Movers; m++) {
+                XformInstance(next_mover, frame, proj, view);
+                next_mover = (next_mover + 1) % s_Instances.size();
+            }
+        } else {
+            for(unsigned int i = 0; i < s_Instances.size(); i++)
+                XformInstance(i, frame, proj, view);
+        }
+        FlushXforms(proj);
+        if(s_Tiers[1] > 0)
+            glodGroupParameteri(0, GLOD_INSTANCE_TIERS, s_Tiers[frame % 2]);
+        double xform = Timer_Reset(&t) * 1000.0;
+
+        glodAdaptGroup(0);
+        double adapt = Timer_Reset(&t) * 1000.0;
+        int tris = ReadbackObjects();
+        double readback = Timer_Elapsed(&t) * 1000.0;
+
+        glodGetGroupStats(0, &stats, GL_TRUE);
+        printf("%u,%.3f,%.3f,%u,%u,%u,%u,%i,%g,%u,%u\n", frame, adapt, readback,
+               stats.folds, stats.unfolds, stats.trisIntroduced, stats.trisRemoved,
+               tris, CurrentError(), stats.parkedNodes, stats.occludedNodes);
+
+        if((int) frame >= s_Warmup) {
+            adapt_times.push_back(adapt);
+            adapt_total += adapt;
+            readback_total += readback;
+            xform_total += xform;
+            folds_total += stats.folds;
+            unfolds_total += stats.unfolds;
+        }
+    }
+
+    GLuint err = glodGetError();
+    if(err != GLOD_NO_ERROR)
+        fprintf(stderr, "GLOD error 0x%x during the run\n", err);
+
+    unsigned int n = (unsigned int) adapt_times.size();
+    if(n > 0) {
+        printf("# frames %u (after %i warmup)\n", n, s_Warmup);
+        printf("# adapt ms: total %.3f mean %.3f p50 %.3f p95 %.3f max %.3f\n",
+               adapt_total, adapt_total / n, Percentile(adapt_times, 0.5),
+               Percentile(adapt_times, 0.95), Percentile(adapt_times, 1.0));
+        printf("# readback ms: total %.3f mean %.3f\n", readback_total, readback_total / n);
+        printf("# xform ms: total %.3f mean %.3f\n", xform_total, xform_total / n);
+        printf("# folds %u unfolds %u\n", folds_total, unfolds_total);
+    }
+
+    glodShutdown();
+    for(unsigned int i = 0; i < s_Objects.size(); i++) {
+        DeleteModel(&s_Objects[i]->model);
+        delete [] s_Objects[i]->patchNames;
+        delete [] s_Objects[i]->patchSizes;
+        delete s_Objects[i];
+    }
+    return (err == GLOD_NO_ERROR) ? 0 : 1;
+}
+
+void Usage() {
+    printf("Usage:\n");
+    printf("   bench [flags] [-c|-d] file.ply [[-c|-d] file2.ply ...]\n");
+    printf("       Replays a camera path through glodAdaptGroup without a window\n");
+    printf("       and prints per-frame adaptation statistics as CSV.\n");
+    printf("       Defaults to %s.\n", DEFAULT_MODEL);
+    printf("Flags:\n");
+    printf("      -c    Builds the following files as continuous objects (default)\n");
+    printf("      -d    Builds the following files as discrete objects\n");
+    printf("      -q    Uses quadric error instead of error spheres\n");
+    printf("      -e    Uses full edge collapse instead of half edge\n");
+    printf("      -object            Adapts to object-space instead of screen-space error\n");
+    printf("      -threshold <t>     Error threshold, as a fraction of the viewport width in\n");
+    printf("                         screen space (default 0.002, or 0.001 in object space)\n");
+    printf("      -budget <tris>     Adapts to a triangle budget instead of a threshold\n");
+    printf("      -noreadback        Skips reading back the adapted geometry\n");
+    printf("      -cull              Culls hierarchy subtrees outside the view frustum\n");
+    printf("      -occlude           Coarsens what the first object hides from the others\n");
+    printf("      -size <w>x<h>      Viewport aspect for the projection (default 640x480)\n");
+    printf("      -steps <n>         Most budget adaptation steps per frame (default no limit)\n");
+    printf("Large groups:\n");
+    printf("      -instances <n>     Instances each file n times, in a square grid\n");
+    printf("      -movers <n>        Holds the camera still and moves n objects a frame\n");
+    printf("      -compact           Makes the instances compact, sharing their cuts\n");
+    printf("      -batch             Binds each frame's transforms with one glodObjectXforms\n");
+    printf("      -tiers <n>[,<m>]   Cuts compact instances share; with m, switches between\n");
+    printf("                         n and m every frame\n");
+    printf("Camera path:\n");
+    printf("      -path <file>       Replays a recorded path instead of the built-in orbit\n");
+    printf("      -frames <n>        Number of frames in the built-in orbit (default 360)\n");
+    printf("      -record <file>     Writes the path being replayed to a file\n");
+    printf("      -warmup <n>        Frames left out of the summary (default 1)\n");
+    printf("\n");
+    return;
+}
@@ -26,6 +26,7 @@
 #include "glod_core.h"
 
 #include <xbs.h>
+#include "Continuous.h"
 
 /***************************************************************************/
 void glodGroupParameteri(GLuint name, GLenum pname, GLint param)
@@ -76,7 +77,43 @@ void glodGroupParameteri(GLuint name, GLenum pname, GLint param)
     case GLOD_SCREEN_SPACE_ERROR_THRESHOLD:
 	group->setScreenSpaceErrorThreshold((float)param);
 	break;
-
+    case GLOD_SUBTREE_CULLING:
+	group->mpSimplifier->SetCullSubtrees(param != GL_FALSE);
+	break;
+    case GLOD_OCCLUSION_CULLING:
+	group->setOcclusionCulling(param != GL_FALSE);
+	break;
+    case GLOD_OCCLUSION_RESOLUTION:
+	if ((param < 1) || (param > 4096)) {
+	    GLOD_SetError(GLOD_INVALID_PARAM, "Occlusion resolution out of range", param);
+	    return;
+	}
+	group->setOcclusionResolution(param);
+	break;
+    case GLOD_ADAPT_THREADS:
+	if (param < 0) {
+	    GLOD_SetError(GLOD_INVALID_PARAM, "Adapt thread count must be nonnegative", param);
+	    return;
+	}
+	group->adaptThreads = param;
+	break;
+    case GLOD_BUDGET_STEPS:
+	if (param < 0) {
+	    GLOD_SetError(GLOD_INVALID_PARAM, "Budget step count must be nonnegative", param);
+	    return;
+	}
+	group->setBudgetSteps(param);
+	break;
+    case GLOD_COMPACT_INSTANCES:
+	group->compactInstances = (param != GL_FALSE);
+	break;
+    case GLOD_INSTANCE_TIERS:
+	if ((param < 1) || (param > GLOD_MAX_INSTANCE_TIERS)) {
+	    GLOD_SetError(GLOD_INVALID_PARAM, "Instance tier count out of range", param);
+	    return;
+	}
+	group->instanceTiers = param;
+	break;
 
     default:
       GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
@@ -105,6 +142,13 @@ void glodGroupParameterf (GLuint name, GLenum pname, GLfloat param)
     case GLOD_SCREEN_SPACE_ERROR_THRESHOLD:
 	group->setScreenSpaceErrorThreshold(param);
 	break;
+    case GLOD_BUDGET_HYSTERESIS:
+	if (param < 0) {
+	    GLOD_SetError(GLOD_INVALID_PARAM, "Budget hysteresis must be nonnegative");
+	    return;
+	}
+	group->setBudgetHysteresis(param);
+	break;
     default:
       GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
       return;
@@ -124,21 +168,143 @@ void glodGetGroupParameteriv (GLuint name, GLenum pname, GLint *param) {
 	GLOD_SetError(GLOD_INVALID_NAME, "Group does not exist");
 	return;
     }
-//    switch(pname) {
-//    default:
+    switch(pname) {
+    case GLOD_MEMORY_ALLOCATED:
+    {
+	// all of the group's continuous objects share its simplifier
+	*param = 0;
+	for (int i = 0; i < group->getNumObjects(); i++)
+	{
+	    GLOD_Object *obj = group->getObject(i);
+	    if ((obj->format == GLOD_CONTINUOUS) && (obj->cut != NULL))
+		*param += ((VDSCut*)obj->cut)->mpRenderer->GetMemoryAllocated();
+	}
+	return;
+    }
+    case GLOD_MEMORY_USAGE:
+	*param = group->mpSimplifier->GetMemoryUsage();
+	return;
+    case GLOD_SUBTREE_CULLING:
+	*param = group->mpSimplifier->mCullSubtrees ? GL_TRUE : GL_FALSE;
+	return;
+    case GLOD_OCCLUSION_CULLING:
+	*param = (group->occlusionBuffer != NULL) ? GL_TRUE : GL_FALSE;
+	return;
+    case GLOD_OCCLUSION_RESOLUTION:
+	*param = group->occlusionResolution;
+	return;
+    case GLOD_ADAPT_THREADS:
+	*param = group->adaptThreads;
+	return;
+    case GLOD_BUDGET_STEPS:
+	*param = group->budgetSteps;
+	return;
+    case GLOD_COMPACT_INSTANCES:
+	*param = group->compactInstances ? GL_TRUE : GL_FALSE;
+	return;
+    case GLOD_INSTANCE_TIERS:
+	*param = group->instanceTiers;
+	return;
+    default:
       GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
-//      return;
-//    }
+      return;
+    }
 }
 
 /* glodGroupParameterfv
  ***************************************************************************/
 void glodGetGroupParameterfv (GLuint name, GLenum pname, GLfloat *param) {
-/*    switch(pname) {
+    GLOD_Group *group =
+	(GLOD_Group *)HashtableSearch(s_APIState.group_hash, name);
+    if(group == NULL) {
+	GLOD_SetError(GLOD_INVALID_NAME, "Group does not exist", name);
+	return;
+    }
+    switch(pname) {
+    case GLOD_BUDGET_HYSTERESIS:
+	*param = group->budgetHysteresis;
+	return;
     default:
       GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
       return;
-    }*/
+    }
+}
+
+/* glodGetGroupStats
+ ***************************************************************************/
+static GLfloat TicksToMilliseconds(VDS::TimerTicks Ticks) {
+    return (GLfloat) (VDS::TimerTicksToSeconds(Ticks) * 1000.0);
+}
+
+void glodGetGroupStats (GLuint name, GLODgroupstats *stats, GLboolean reset) {
+    GLOD_Group *group =
+	(GLOD_Group *)HashtableSearch(s_APIState.group_hash, name);
+    if(group == NULL) {
+	GLOD_SetError(GLOD_INVALID_NAME, "Group does not exist", name);
+	return;
+    }
+
+    // all of the group's continuous objects share its simplifier
+    VDS::SimplifierStats &s = group->mpSimplifier->mStats;
+    VDS::TimerTicks copyTicks = 0;
+    int i;
+    for (i = 0; i < group->getNumObjects(); i++)
+    {
+	GLOD_Object *obj = group->getObject(i);
+	if ((obj->format == GLOD_CONTINUOUS) && (obj->cut != NULL))
+	{
+	    VDS::Renderer *renderer = ((VDSCut*)obj->cut)->mpRenderer;
+	    copyTicks += renderer->mCopyTicks;
+	    if (reset)
+		renderer->mCopyTicks = 0;
+	}
+    }
+
+    if (stats != NULL)
+    {
+	stats->adaptCount = group->adaptCount;
+	stats->folds = s.NumFolds;
+	stats->unfolds = s.NumUnfolds;
+	stats->trisIntroduced = s.TrisIntroduced;
+	stats->trisRemoved = s.TrisRemoved;
+	stats->foldQueueSize = s.FoldQueueSize;
+	stats->unfoldQueueSize = s.UnfoldQueueSize;
+	stats->parkedNodes = s.NumParked;
+	stats->occludedNodes = s.NumOccluded;
+	stats->occluderTris = group->occluderTris;
+
+	stats->adaptTime = TicksToMilliseconds(group->adaptTicks);
+	stats->updateErrorsTime = TicksToMilliseconds(s.UpdateNodeErrorsTicks);
+	stats->simplifyTime = TicksToMilliseconds(s.SimplifyTicks);
+	stats->renderCopyTime = TicksToMilliseconds(copyTicks);
+	stats->occlusionTime = TicksToMilliseconds(group->occlusionTicks);
+	stats->foldErrorCalcTime = TicksToMilliseconds(s.FoldErrorCalcTicks);
+	stats->unfoldErrorCalcTime = TicksToMilliseconds(s.UnfoldErrorCalcTicks);
+	stats->foldHeapifyTime = TicksToMilliseconds(s.FoldHeapifyTicks);
+	stats->unfoldHeapifyTime = TicksToMilliseconds(s.UnfoldHeapifyTicks);
+	stats->cullTime = TicksToMilliseconds(s.CullSubtreesTicks);
+	stats->foldTime = TicksToMilliseconds(s.FoldTicks);
+	stats->unfoldTime = TicksToMilliseconds(s.UnfoldTicks);
+	stats->foldCheckTime = TicksToMilliseconds(s.FoldCheckTicks);
+	stats->foldRemoveChildrenTime = TicksToMilliseconds(s.FoldRemoveChildrenTicks);
+	stats->foldRemoveTrisTime = TicksToMilliseconds(s.FoldRemoveSubTrisTicks);
+	stats->foldQueueTime = TicksToMilliseconds(s.FoldQueueManipTicks);
+	stats->unfoldAddChildrenTime = TicksToMilliseconds(s.UnfoldActivateChildrenTicks);
+	stats->unfoldMoveTrisTime = TicksToMilliseconds(s.UnfoldMoveLiveTrisTicks);
+	stats->unfoldAddTrisTime = TicksToMilliseconds(s.UnfoldActivateSubTrisTicks);
+	stats->unfoldQueueTime = TicksToMilliseconds(s.UnfoldQueueManipTicks);
+	stats->addVertexDataTime = TicksToMilliseconds(s.AddVertexRenderDatumTicks);
+	stats->addTriDataTime = TicksToMilliseconds(s.AddTriRenderDatumTicks);
+    }
+
+    if (reset)
+    {
+	group->mpSimplifier->ResetStats();
+	group->adaptCount = 0;
+	group->adaptTicks = 0;
+	group->occluderTris = 0;
+	group->occlusionTicks = 0;
+    }
 }
 
 /***************************************************************************
@@ -17,6 +17,7 @@
  ******************************************************************************/
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
 #if !defined(_WIN32) && !defined(__APPLE__)
 #include <values.h>
 #endif
@@ -25,13 +26,21 @@
 #include "glod_core.h"
 
 #include <xbs.h>
+#include "Continuous.h"
 
 /***************************************************************************/
 
 void glodObjectParameteri (GLuint name, GLenum pname, GLint param) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if(obj == NULL) {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist.", name);
+        if(HashtableSearch(s_APIState.instance_hash, name) != NULL)
+            GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Not supported by compact instances", pname);
+        else
+            GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist.", name);
+        return;
+    }
+    if(obj->buildJob != NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object is being built: ", name);
         return;
     }
 
@@ -140,6 +149,65 @@ void glodObjectParameteri (GLuint name, GLenum pname, GLint param) {
             }
             obj->shareTolerance = (GLfloat) param;
             break;
+
+        case GLOD_TRI_COMPACTION:
+            if (obj->format != GLOD_CONTINUOUS)
+            {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Tri compaction is only supported for continuous objects");
+                return;
+            }
+            if (obj->cut == NULL)
+            {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            if (param < 0)
+            {
+                GLOD_SetError(GLOD_INVALID_PARAM, "Tri compaction move count out of range");
+                return;
+            }
+            ((VDSCut*)obj->cut)->mpRenderer->SetTriCompaction((unsigned int) param);
+            break;
+
+        case GLOD_TRI_REORDERING:
+        case GLOD_VERTEX_CACHE_SIZE:
+            if (obj->format != GLOD_CONTINUOUS)
+            {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Vertex cache reordering is only supported for continuous objects");
+                return;
+            }
+            if (obj->cut == NULL)
+            {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            if (param < 0)
+            {
+                GLOD_SetError(GLOD_INVALID_PARAM, "Vertex cache parameter out of range");
+                return;
+            }
+            if (pname == GLOD_TRI_REORDERING)
+                ((VDSCut*)obj->cut)->mpRenderer->SetTriReordering((unsigned int) param);
+            else
+                ((VDSCut*)obj->cut)->mpRenderer->SetVertexCacheSize((unsigned int) param);
+            break;
+
+        case GLOD_OCCLUDER:
+            obj->occluder = (param != GL_FALSE);
+            break;
+
+        case GLOD_BORROW_ARRAYS:
+            obj->borrowArrays = (param != GL_FALSE);
+            break;
+
+        case GLOD_PROGRESSIVE_RECORDS:
+            if (param < 0)
+            {
+                GLOD_SetError(GLOD_INVALID_PARAM, "Progressive record count out of range");
+                return;
+            }
+            obj->progressiveRecords = param;
+            break;
   
         default:
             GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
@@ -153,7 +221,14 @@ void glodObjectParameteri (GLuint name, GLenum pname, GLint param) {
 void glodObjectParameteriv (GLuint name, GLenum pname, GLint count, GLint *param) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if(obj == NULL) {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist.", name);
+        if(HashtableSearch(s_APIState.instance_hash, name) != NULL)
+            GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Not supported by compact instances", pname);
+        else
+            GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist.", name);
+        return;
+    }
+    if(obj->buildJob != NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object is being built: ", name);
         return;
     }
 
@@ -230,7 +305,15 @@ void glodObjectParameterfv(GLuint name, GLenum pname,
         (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if (obj == NULL) 
     {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist.", name);
+        if (HashtableSearch(s_APIState.instance_hash, name) != NULL)
+            GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Not supported by compact instances", pname);
+        else
+            GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist.", name);
+        return;
+    }
+    if(obj->buildJob != NULL)
+    {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object is being built: ", name);
         return;
     }
 
@@ -312,7 +395,20 @@ void glodObjectParameterfv(GLuint name, GLenum pname,
 void glodObjectParameterf (GLuint name, GLenum pname, GLfloat param) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if(obj == NULL) {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
+        int index;
+        GLOD_InstanceSet *set = GLOD_FindInstance(name, &index);
+        if(set == NULL)
+            GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
+        else if(pname != GLOD_IMPORTANCE)
+            GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Not supported by compact instances", pname);
+        else if(param < 0.0)
+            GLOD_SetError(GLOD_INVALID_PARAM, "Importance out of range");
+        else
+            set->setImportance(index, param);
+        return;
+    }
+    if(obj->buildJob != NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object is being built: ", name);
         return;
     }
 
@@ -350,6 +446,17 @@ void glodObjectParameterf (GLuint name, GLenum pname, GLfloat param) {
             obj->quadricMultiplier = param;
             obj->hierarchy->changeQuadricMultiplier(param);
             break;
+        case GLOD_IMPORTANCE:
+            if (param < 0.0)
+            {
+                GLOD_SetError(GLOD_INVALID_PARAM, "Importance out of range");
+                return;
+            }
+            obj->importance = param;
+            // less important continuous objects give up render memory first
+            if ((obj->format == GLOD_CONTINUOUS) && (obj->cut != NULL))
+                s_VDSMemoryManager.SetRendererImportance(((VDSCut*)obj->cut)->mpRenderer, param);
+            break;
         default:
             GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
             return;
@@ -363,7 +470,12 @@ void glodObjectParameterf (GLuint name, GLenum pname, GLfloat param) {
 void glodGetObjectParameteriv (GLuint name, GLenum pname, GLint *param) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if(obj == NULL) {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
+        int index;
+        GLOD_InstanceSet *set = GLOD_FindInstance(name, &index);
+        if(set != NULL)
+            GLOD_GetInstanceParameteriv(set, index, pname, param);
+        else
+            GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
         return;
     }
     switch(pname) {
@@ -382,8 +494,28 @@ void glodGetObjectParameteriv (GLuint name, GLenum pname, GLint *param) {
         break;
         case GLOD_READBACK_SIZE:
         {
-            int more = 4 + 8 + 8 * HashtableNumElements(obj->patch_id_map);
-            *param = obj->hierarchy->getReadbackSize() + more;
+            // a writer without a write function only counts
+            GLOD_StreamWriter counter(NULL, NULL);
+            if(!GLOD_WriteObjectStream(obj, &counter))
+                return;
+            if(counter.getSize() > INT_MAX) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object is too large for a readback buffer; use glodWriteObject: ", name);
+                return;
+            }
+            *param = (GLint) counter.getSize();
+        }
+        return;
+        case GLOD_CUT_SNAPSHOT_SIZE:
+        {
+            if(obj->cut == NULL) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            if(obj->cut->getSnapshotSize() == 0) {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Cut snapshots are only supported for continuous objects");
+                return;
+            }
+            *param = obj->cut->getSnapshotSize();
         }
         return;
         case GLOD_PATCH_SIZES:
@@ -404,6 +536,82 @@ void glodGetObjectParameteriv (GLuint name, GLenum pname, GLint *param) {
             HASHTABLE_WALK_END(obj->patch_id_map);
             return;
         }
+        case GLOD_TRI_COMPACTION:
+        {
+            if (obj->format != GLOD_CONTINUOUS)
+            {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Tri compaction is only supported for continuous objects");
+                return;
+            }
+            if(obj->cut == NULL) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            *param = ((VDSCut*)obj->cut)->mpRenderer->mMaxTriCompactionMoves;
+            return;
+        }
+        case GLOD_TRI_REORDERING:
+        case GLOD_VERTEX_CACHE_SIZE:
+        {
+            if (obj->format != GLOD_CONTINUOUS)
+            {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Vertex cache reordering is only supported for continuous objects");
+                return;
+            }
+            if(obj->cut == NULL) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            if (pname == GLOD_TRI_REORDERING)
+                *param = ((VDSCut*)obj->cut)->mpRenderer->mMaxTriReorderTris;
+            else
+                *param = ((VDSCut*)obj->cut)->mpRenderer->mVertexCacheSize;
+            return;
+        }
+        case GLOD_PATCH_ACMR:
+            GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "GLOD_PATCH_ACMR only supports float outputs.");
+            return;
+        case GLOD_MEMORY_ALLOCATED:
+        case GLOD_MEMORY_USAGE:
+        {
+            if (obj->format != GLOD_CONTINUOUS)
+            {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Memory statistics are only kept for continuous objects");
+                return;
+            }
+            if(obj->cut == NULL) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            if (pname == GLOD_MEMORY_ALLOCATED)
+                *param = ((VDSCut*)obj->cut)->mpRenderer->GetMemoryAllocated();
+            else
+                *param = ((VDSCut*)obj->cut)->mpCut->mBytesUsed;
+            return;
+        }
+        case GLOD_OCCLUDER:
+            *param = obj->occluder ? GL_TRUE : GL_FALSE;
+            return;
+        case GLOD_BORROW_ARRAYS:
+            *param = obj->borrowArrays ? GL_TRUE : GL_FALSE;
+            return;
+        case GLOD_PROGRESSIVE_RECORDS:
+            *param = obj->progressiveRecords;
+            return;
+        case GLOD_PROGRESSIVE_RECORDS_LEFT:
+            *param = (obj->hierarchy != NULL) ? (GLint) obj->hierarchy->getProgressiveRecordsLeft() : 0;
+            return;
+        case GLOD_BUILD_STATUS:
+            if(obj->buildJob != NULL)
+                *param = GLOD_BUILD_IN_PROGRESS;
+            else if(obj->hierarchy != NULL)
+                *param = GLOD_BUILD_COMPLETE;
+            else
+                *param = GLOD_BUILD_NOT_STARTED;
+            return;
+        case GLOD_BUILD_PROGRESS:
+            GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "GLOD_BUILD_PROGRESS only supports float outputs.");
+            return;
         default:
             GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
             return;
@@ -416,7 +624,12 @@ void glodGetObjectParameteriv (GLuint name, GLenum pname, GLint *param) {
 void glodGetObjectParameterfv (GLuint name, GLenum pname, GLfloat *param) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if(obj == NULL) {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist.", name);
+        int index;
+        GLOD_InstanceSet *set = GLOD_FindInstance(name, &index);
+        if(set != NULL)
+            GLOD_GetInstanceParameterfv(set, index, pname, param);
+        else
+            GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist.", name);
         return;
     }
 
@@ -443,6 +656,49 @@ void glodGetObjectParameterfv (GLuint name, GLenum pname, GLfloat *param) {
         case GLOD_QUADRIC_MULTIPLIER:
             *param = obj->quadricMultiplier;
             break;
+        case GLOD_IMPORTANCE:
+            *param = obj->importance;
+            break;
+        case GLOD_BUILD_PROGRESS:
+            // finished builds read 1 until they are attached
+            if(obj->buildJob != NULL)
+                *param = obj->buildJob->progress;
+            else
+                *param = (obj->hierarchy != NULL) ? 1.0f : 0.0f;
+            break;
+        case GLOD_CURRENT_OBJECT_SPACE_ERROR:
+        case GLOD_CURRENT_SCREEN_SPACE_ERROR:
+        {
+            if(obj->cut == NULL) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+            if(pname == GLOD_CURRENT_OBJECT_SPACE_ERROR)
+                *param = obj->cut->currentErrorObjectSpace();
+            else
+                *param = obj->cut->currentErrorScreenSpace();
+            break;
+        }
+        case GLOD_PATCH_ACMR:
+        {
+            if (obj->format != GLOD_CONTINUOUS)
+            {
+                GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "GLOD_PATCH_ACMR is only supported for continuous objects");
+                return;
+            }
+            if(obj->cut == NULL) {
+                GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", name);
+                return;
+            }
+
+            ptrdiff_t d;
+            VDS::Renderer *renderer = ((VDSCut*)obj->cut)->mpRenderer;
+            HASHTABLE_WALK(obj->patch_id_map, node); //hashtable  --> patch name to 0-based-patch-index
+            d = (ptrdiff_t) node->data - 1;
+            param[d] = renderer->GetPatchACMR(d);
+            HASHTABLE_WALK_END(obj->patch_id_map);
+            break;
+        }
         default:
             GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
             return;
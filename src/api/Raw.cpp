@@ -32,7 +32,13 @@
 void HandlePatch(GLOD_Object* obj, GLOD_RawPatch* patch, int level, float geometric_error);
 GLOD_RawPatch* ProducePatch(GLenum mode, 
 			GLenum first, GLenum count, 
-			void* indices, GLenum indices_type); // in RawConvert.c
+			void* indices, GLenum indices_type, int borrow); // in RawConvert.c
+
+// the manual discrete loader keeps every vertex it is given, so it only
+// gets copies
+static int BorrowArrays(GLOD_Object* obj) {
+  return obj->borrowArrays && (obj->format != GLOD_DISCRETE_MANUAL);
+}
 
 
 /***************************************************************************/
@@ -47,13 +53,13 @@ void glodInsertArrays (GLuint name, GLuint patchname,
     return;
   }
   
-  if(obj->hierarchy != NULL) {
+  if((obj->hierarchy != NULL) || (obj->buildJob != NULL)) {
     GLOD_SetError(GLOD_INVALID_STATE, "This object has already been built! You cannot add more data to it!", name);
     return;
   }
   
   // get the patch from the vertex array
-  GLOD_RawPatch* p = ProducePatch(mode, first, count, NULL, 0);
+  GLOD_RawPatch* p = ProducePatch(mode, first, count, NULL, 0, BorrowArrays(obj));
   if(p == NULL) {
     return; // ProducePatch has already set the error flag
   }
@@ -85,13 +91,13 @@ void glodInsertElements (GLuint name, GLuint patchname,
     return;
   }
 
-  if(obj->hierarchy != NULL) {
+  if((obj->hierarchy != NULL) || (obj->buildJob != NULL)) {
     GLOD_SetError(GLOD_INVALID_STATE, "This object has already been built! You cannot add more data to it!", name);
     return;
   }
 
   // make the patch
-  GLOD_RawPatch* p = ProducePatch(mode, 0, count, indices, type);
+  GLOD_RawPatch* p = ProducePatch(mode, 0, count, indices, type, BorrowArrays(obj));
   if(p == NULL) {
     return; // ProducePatch has already set the error flag
   }
@@ -118,32 +124,63 @@ void glodInsertElements (GLuint name, GLuint patchname,
  ***************************************************************************/
 extern int ProduceVA(GLOD_Cut* c, int patchNum,
                      void* indices, GLenum indices_type);
+extern int ProduceObjectVA(GLOD_Cut* c, int num_patches, void* indices,
+                           GLenum indices_type, GLint* ranges);
 
-GLOD_APIENTRY void glodFillArrays( GLuint name, GLuint patch_name ) {
+// finds the cut to read back for name, which may be a compact instance,
+// and its patch table; false if it doesn't exist. The cut is NULL for a
+// hidden compact instance, which has nothing to read back.
+static bool FindObjectCut(GLuint name, GLOD_Cut **cut, HashTable **patch_id_map) {
   GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
-  int patch_id;
   
   if(obj == NULL) {
-    GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
-    return;
+    int index;
+    GLOD_InstanceSet* set = GLOD_FindInstance(name, &index);
+    if(set == NULL) {
+      GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
+      return false;
+    }
+    *cut = set->getCut(index);
+    *patch_id_map = set->patch_id_map;
+  } else {
+    if(obj->hierarchy == NULL) {
+      GLOD_SetError(GLOD_INVALID_STATE, "This object has not been built!", name);
+      return false;
+    }
+    *cut = obj->cut;
+    *patch_id_map = obj->patch_id_map;
   }
+  return true;
+}
+
+// as FindObjectCut, and finds the packed id of one of its patches
+static bool FindReadbackCut(GLuint name, GLuint patch_name,
+                            GLOD_Cut **cut, int *patch_id) {
+  HashTable* patch_id_map;
   
-  if(obj->hierarchy == NULL) {
-    GLOD_SetError(GLOD_INVALID_STATE, "This object has not been built!", name);
-    return;
-  }
+  if(!FindObjectCut(name, cut, &patch_id_map))
+    return false;
   
   // look up the real patch name
-  patch_id = HashtableSearchInt(obj->patch_id_map, patch_name+1); // lameness
-  if(patch_id == 0) {
+  *patch_id = HashtableSearchInt(patch_id_map, patch_name+1); // lameness
+  if(*patch_id == 0) {
     // this patch isn't there
     GLOD_SetError(GLOD_INVALID_PATCH, "Patch of the specified doesn't exist.", patch_name);
-    return;
+    return false;
   }
-  patch_id --;// now, correct for the lameness of the hashtable, which stores everything +1
+  (*patch_id) --;// now, correct for the lameness of the hashtable, which stores everything +1
+  return true;
+}
+
+GLOD_APIENTRY void glodFillArrays( GLuint name, GLuint patch_name ) {
+  GLOD_Cut* cut;
+  int patch_id;
+  
+  if(!FindReadbackCut(name, patch_name, &cut, &patch_id) || cut == NULL)
+    return;
   
   // we're good to go... read the object
-  if(ProduceVA(obj->cut, patch_id, NULL, 0) == 0) {
+  if(ProduceVA(cut, patch_id, NULL, 0) == 0) {
     return;
   }
 }
@@ -151,40 +188,40 @@ GLOD_APIENTRY void glodFillArrays( GLuint name, GLuint patch_name ) {
 GLOD_APIENTRY void glodFillElements( GLuint name, GLuint patch_name, 
                                      GLenum type, GLvoid* out_elements ) {
   // now read the cut
-  GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+  GLOD_Cut* cut;
   int patch_id;
   
-  if(obj == NULL) {
-    GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
-    return;
-  }
-  
-  if(obj->hierarchy == NULL) {
-    GLOD_SetError(GLOD_INVALID_STATE, "This object has not been built!", name);
+  if(!FindReadbackCut(name, patch_name, &cut, &patch_id) || cut == NULL)
     return;
-  }
-
-  // look up the real patch name
-  patch_id = HashtableSearchInt(obj->patch_id_map, patch_name+1); // lameness
-  if(patch_id == 0) {
-    // this patch isn't there
-    GLOD_SetError(GLOD_INVALID_PATCH, "Patch of the specified doesn't exist.", patch_name);
-    return;
-  }
-  patch_id --;// now, correct for the lameness of the hashtable, which stores everything +1
 
   // OK. we're good to go... readback this cut
-  if(ProduceVA(obj->cut, patch_id, out_elements, type) == 0) {
+  if(ProduceVA(cut, patch_id, out_elements, type) == 0) {
     return;
   }
 
 }
 
+GLOD_APIENTRY void glodFillObjectElements( GLuint name, GLenum type,
+                                           GLvoid* out_elements,
+                                           GLint* patch_ranges ) {
+  GLOD_Cut* cut;
+  HashTable* patch_id_map;
+  
+  if(!FindObjectCut(name, &cut, &patch_id_map))
+    return;
+  
+  // patches go out in packed id order, as GLOD_PATCH_NAMES lists them
+  ProduceObjectVA(cut, HashtableNumElements(patch_id_map), out_elements, type,
+                  patch_ranges);
+}
+
 /***************************************************************************
  ***************************************************************************/
 GLOD_RawPatch::~GLOD_RawPatch() {
-  if(triangles)
+  if(triangles && !(borrowed & GLOD_BORROWED_TRIANGLES))
     free(triangles);
+  if(borrowed & GLOD_BORROWED_VERTICES)
+    return;
   if(vertices)
     free(vertices);
   if(vertex_texture_coords)
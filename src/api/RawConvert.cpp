@@ -72,10 +72,15 @@ int GetStrideSize(int numElements, int type);
 
 int PredictSizes(VaState* va, GLuint mode, int count, GLvoid* indices, int *num_triangles, int *num_vertices, int *num_elems);
 
+static int FastLayout(VaState* vas, GLenum mode);
+static int ProduceFastPatch(VaState* vas, GLOD_RawPatch* p, int num_triangles, int borrow);
+
 /***** PRODUCE PATCH ---> goes from current VA state to a GLOD_RawPatch ******/
+/* If borrow is set, the patch may point into the caller's arrays instead of
+ * copying them (see ProduceFastPatch); they must then outlive the patch. */
 GLOD_RawPatch* ProducePatch(GLenum mode, 
 			GLenum first, GLenum count, 
-			void* indices, GLenum indices_type) {
+			void* indices, GLenum indices_type, int borrow) {
   GLOD_RawPatch* p = new GLOD_RawPatch();
 
   VaState vas;
@@ -120,22 +125,28 @@ GLOD_RawPatch* ProducePatch(GLenum mode,
   if(PredictSizes(&vas, mode, count, indices, &num_triangles, &num_vertices, &num_elems) == 0)
     return NULL;
 
-  // alloc & set flags
+  // set flags
+  if(vas.na != NULL)
+    p->data_flags |= GLOD_HAS_VERTEX_NORMALS;
+  if(vas.ta != NULL)
+    p->data_flags |= GLOD_HAS_TEXTURE_COORDS_2;
+  if(vas.ca != NULL)
+    p->data_flags |= GLOD_HAS_VERTEX_COLORS_3;
+
+  // float arrays with int or short indices skip the per-scalar conversion
+  if(FastLayout(&vas, mode) && ProduceFastPatch(&vas, p, num_triangles, borrow))
+    return p;
+
+  // alloc
   {
-    if(vas.na != NULL) {
-      p->data_flags |= GLOD_HAS_VERTEX_NORMALS;
+    if(vas.na != NULL)
       p->vertex_normals = (GLfloat*) malloc(sizeof(GLfloat) * num_vertices * 3);
-    }
     
-    if(vas.ta != NULL) {
-      p->data_flags |= GLOD_HAS_TEXTURE_COORDS_2;
+    if(vas.ta != NULL)
       p->vertex_texture_coords = (GLfloat*) malloc(sizeof(GLfloat) * num_vertices * vas.ta_size);
-    }
     
-    if(vas.ca != NULL) {
+    if(vas.ca != NULL)
       p->vertex_colors = (GLfloat*) malloc(sizeof(GLfloat) * num_vertices * vas.ca_size);
-      p->data_flags |= GLOD_HAS_VERTEX_COLORS_3;
-    }
   }
 
   // alloc tri & vertices
@@ -204,41 +215,264 @@ GLOD_RawPatch* ProducePatch(GLenum mode,
   return p;
 }
 
-/***** PRODUCE VA ---> goes from a GLOD_Cut to GLOD_RawPatch to the current VA state ******/
-/**** WE ONLY PRODUCE GL_TRIANGLE ARRAYS */
-int ProduceVA(GLOD_Cut* c, int patch, 
-              void* indices, GLenum indices_type) {
-  VaState vas;
+/***** FAST PATCH ---> float arrays and GL_UNSIGNED_INT/SHORT indices ******/
 
-  GetVAState(&vas);
-  vas.ia = indices;
-  vas.ia_type = indices_type;
-  vas.first = 0;
+// true if ProduceFastPatch can take this vertex array state
+static int FastLayout(VaState* vas, GLenum mode) {
+  if(mode != GL_TRIANGLES || vas->va_type != GL_FLOAT)
+    return 0;
+  if((vas->na && vas->na_type != GL_FLOAT) ||
+     (vas->ta && vas->ta_type != GL_FLOAT) ||
+     (vas->ca && vas->ca_type != GL_FLOAT))
+    return 0;
+  if(vas->ia && vas->ia_type != GL_UNSIGNED_INT && vas->ia_type != GL_UNSIGNED_SHORT)
+    return 0;
+  return 1;
+}
+
+// true if every array is tightly packed, as GLOD_RawPatch keeps its own
+static int PackedLayout(VaState* vas) {
+  return (vas->va_stride == 3 * sizeof(GLfloat)) &&
+    (!vas->na || vas->na_stride == 3 * sizeof(GLfloat)) &&
+    (!vas->ta || vas->ta_stride == 2 * sizeof(GLfloat)) &&
+    (!vas->ca || vas->ca_stride == 3 * sizeof(GLfloat));
+}
+
+template <int N>
+static void CopyFloats(GLfloat* dst, void* src, GLsizei stride, int first, int n) {
+  char* base = (char*) src + (ptrdiff_t) first * stride;
+  if(stride == N * sizeof(GLfloat)) {
+    memcpy(dst, base, sizeof(GLfloat) * N * n);
+    return;
+  }
+  for(int i = 0; i < n; i++)
+    memcpy(dst + N*i, base + (ptrdiff_t) i * stride, sizeof(GLfloat) * N);
+}
+
+template <int N>
+static void GatherFloats(GLfloat* dst, void* src, GLsizei stride, const GLint* order, int n) {
+  char* base = (char*) src;
+  for(int i = 0; i < n; i++)
+    memcpy(dst + N*i, base + (ptrdiff_t) order[i] * stride, sizeof(GLfloat) * N);
+}
+
+template <class Index>
+static void IndexRange(const Index* ia, int count, GLuint* lo, GLuint* hi) {
+  GLuint l = ia[0], h = ia[0];
+  for(int k = 1; k < count; k++) {
+    GLuint v = ia[k];
+    if(v < l) l = v;
+    if(v > h) h = v;
+  }
+  *lo = l; *hi = h;
+}
+
+// numbers vertices in the order the triangles first use them, as the
+// hashtable in ProducePatch does; order[] gets each one's array index
+template <class Index>
+static int RemapIndices(const Index* ia, int count, GLuint lo,
+                        GLint* remap, GLint* order, GLint* tris) {
+  int n = 0;
+  for(int k = 0; k < count; k++) {
+    GLuint v = ia[k] - lo;
+    if(remap[v] < 0) {
+      remap[v] = n;
+      order[n++] = (GLint) (v + lo);
+    }
+    tris[k] = remap[v];
+  }
+  return n;
+}
+
+template <class Index>
+static int CountUsed(const Index* ia, int count, GLuint lo, GLuint range) {
+  unsigned char* seen = (unsigned char*) calloc(range, 1);
+  int used = 0;
+  for(int k = 0; k < count; k++) {
+    GLuint v = ia[k] - lo;
+    used += 1 - seen[v];
+    seen[v] = 1;
+  }
+  free(seen);
+  return used;
+}
+
+// points p's vertex data at n packed vertices of the caller's arrays
+static void BorrowVertices(VaState* vas, GLOD_RawPatch* p, int first, int n) {
+  p->vertices = (GLfloat*) vas->va + 3*first;
+  if(vas->na) p->vertex_normals = (GLfloat*) vas->na + 3*first;
+  if(vas->ta) p->vertex_texture_coords = (GLfloat*) vas->ta + 2*first;
+  if(vas->ca) p->vertex_colors = (GLfloat*) vas->ca + 3*first;
+  p->borrowed |= GLOD_BORROWED_VERTICES;
+  p->num_vertices = n;
+}
+
+static void AllocVertices(VaState* vas, GLOD_RawPatch* p, int n) {
+  p->vertices = (GLfloat*) malloc(sizeof(GLfloat) * n * 3);
+  if(vas->na) p->vertex_normals = (GLfloat*) malloc(sizeof(GLfloat) * n * 3);
+  if(vas->ta) p->vertex_texture_coords = (GLfloat*) malloc(sizeof(GLfloat) * n * 2);
+  if(vas->ca) p->vertex_colors = (GLfloat*) malloc(sizeof(GLfloat) * n * 3);
+  p->num_vertices = n;
+}
+
+template <class Index>
+static int ProduceFastElements(VaState* vas, GLOD_RawPatch* p, const Index* ia,
+                               int count, int borrow) {
+  GLuint lo, hi;
+  int k;
+  
+  ia += vas->first;
+  IndexRange(ia, count, &lo, &hi);
+  GLuint range = hi - lo + 1;
+  if(range > 2 * (GLuint) count + 1024)
+    return 0; // too sparse for a remap table; the hashtable copes
+  
+  // the indices used span [lo, hi] of the caller's arrays. Borrow that span
+  // if at least half of it is used; XBS drops the unused vertices.
+  if(borrow && PackedLayout(vas) && 2 * (GLuint) CountUsed(ia, count, lo, range) >= range) {
+    BorrowVertices(vas, p, vas->first + lo, range);
+    if(sizeof(Index) == sizeof(GLint) && lo == 0) {
+      p->triangles = (GLint*) ia;
+      p->borrowed |= GLOD_BORROWED_TRIANGLES;
+    } else {
+      p->triangles = (GLint*) malloc(sizeof(GLint) * count);
+      for(k = 0; k < count; k++)
+        p->triangles[k] = (GLint) (ia[k] - lo);
+    }
+    return 1;
+  }
+  
+  GLint* remap = (GLint*) malloc(sizeof(GLint) * range);
+  GLint* order = (GLint*) malloc(sizeof(GLint) * ((range < (GLuint) count) ? range : count));
+  memset(remap, 0xff, sizeof(GLint) * range);
+  p->triangles = (GLint*) malloc(sizeof(GLint) * count);
+  int n = RemapIndices(ia, count, lo, remap, order, p->triangles);
+  free(remap);
   
-  // verify the state of these vertex arrays...
+  for(k = 0; k < n; k++)
+    order[k] += vas->first;
+  AllocVertices(vas, p, n);
+  GatherFloats<3>(p->vertices, vas->va, vas->va_stride, order, n);
+  if(vas->na) GatherFloats<3>(p->vertex_normals, vas->na, vas->na_stride, order, n);
+  if(vas->ta) GatherFloats<2>(p->vertex_texture_coords, vas->ta, vas->ta_stride, order, n);
+  if(vas->ca) GatherFloats<3>(p->vertex_colors, vas->ca, vas->ca_stride, order, n);
+  free(order);
+  return 1;
+}
+
+/* ProduceFastPatch: fills p from float vertex arrays (FastLayout) without a
+ * hashtable or per-scalar type switches. Produces the same patch as the
+ * general path, unless borrow is set and the arrays are tightly packed: then
+ * p points into the caller's arrays (and index array, for GL_UNSIGNED_INT
+ * indices starting at 0) rather than copying them, and may hold vertices no
+ * triangle uses. Returns 0, having allocated nothing, if it can't help.
+ */
+static int ProduceFastPatch(VaState* vas, GLOD_RawPatch* p, int num_triangles, int borrow) {
+  int count = 3 * num_triangles;
+  
+  if(vas->ia == NULL) {
+    // every vertex is used once, in order
+    if(borrow && PackedLayout(vas)) {
+      BorrowVertices(vas, p, vas->first, count);
+    } else {
+      AllocVertices(vas, p, count);
+      CopyFloats<3>(p->vertices, vas->va, vas->va_stride, vas->first, count);
+      if(vas->na) CopyFloats<3>(p->vertex_normals, vas->na, vas->na_stride, vas->first, count);
+      if(vas->ta) CopyFloats<2>(p->vertex_texture_coords, vas->ta, vas->ta_stride, vas->first, count);
+      if(vas->ca) CopyFloats<3>(p->vertex_colors, vas->ca, vas->ca_stride, vas->first, count);
+    }
+    p->triangles = (GLint*) malloc(sizeof(GLint) * count);
+    for(int k = 0; k < count; k++)
+      p->triangles[k] = k;
+  } else if(vas->ia_type == GL_UNSIGNED_INT) {
+    if(!ProduceFastElements(vas, p, (GLuint*) vas->ia, count, borrow))
+      return 0;
+  } else {
+    if(!ProduceFastElements(vas, p, (GLushort*) vas->ia, count, borrow))
+      return 0;
+  }
+  p->num_triangles = num_triangles;
+  return 1;
+}
+
+/***** PRODUCE VA ---> goes from a GLOD_Cut to the current VA state ******/
+/**** WE ONLY PRODUCE GL_TRIANGLE ARRAYS */
+
+// checks that the current vertex arrays are ones we can write to
+static int CheckFillState(VaState* vas) {
   // we can only read at the moment:
   //    tri-color
   //    2d texture coords
   //    normals
   //    vertices
-  if(vas.va == NULL) {
+  if(vas->va == NULL) {
     GLOD_SetError(GLOD_INVALID_DATA_FORMAT, "glGetPointerv(vp) == NULL. Cannot continue!");
     return 0;
   }
-  if(vas.va_size != 3) {
+  if(vas->va_size != 3) {
     GLOD_SetError(GLOD_INVALID_DATA_FORMAT, "Not a 3-coord vertex array!");
     return 0;
   }
   
-  if(vas.ca && vas.ca_size == 4) {
+  if(vas->ca && vas->ca_size == 4) {
     GLOD_SetError(GLOD_INVALID_DATA_FORMAT, "Only tri-color RGB is supported.");
     return 0;
   }
 
-  if(vas.ta && vas.ta_size != 2) {
+  if(vas->ta && vas->ta_size != 2) {
     GLOD_SetError(GLOD_INVALID_DATA_FORMAT, "Only 2-D texcoords are supported.");
     return 0;
   }
+  return 1;
+}
+
+// describes vas as a GLOD_FillTarget, if it's a layout GLOD_Cut::fill writes
+static int FillLayout(VaState* vas, GLOD_FillTarget* t) {
+  if(vas->va_type != GL_FLOAT ||
+     (vas->na && vas->na_type != GL_FLOAT) ||
+     (vas->ta && vas->ta_type != GL_FLOAT) ||
+     (vas->ca && vas->ca_type != GL_FLOAT && vas->ca_type != GL_UNSIGNED_BYTE))
+    return 0;
+  if(vas->ia && vas->ia_type != GL_UNSIGNED_INT && vas->ia_type != GL_UNSIGNED_SHORT)
+    return 0;
+  
+  t->vertices = (char*) vas->va;        t->vertex_stride = vas->va_stride;
+  t->normals = (char*) vas->na;         t->normal_stride = vas->na_stride;
+  t->texture_coords = (char*) vas->ta;  t->texture_coord_stride = vas->ta_stride;
+  t->colors = (char*) vas->ca;          t->color_stride = vas->ca_stride;
+  t->color_type = vas->ca_type;
+  t->indices = vas->ia;                 t->index_type = vas->ia_type;
+  t->index_base = 0;
+  if(s_pCurrentContext->fillScratch == NULL)
+    s_pCurrentContext->fillScratch = new GLOD_FillScratch;
+  t->scratch = s_pCurrentContext->fillScratch;
+  t->num_vertices = t->num_indices = 0;
+  return 1;
+}
+
+/* FillPatch: writes patch of c into the arrays in vas, starting at vertex
+ * base and (for indexed output) index offset; index values are offset by
+ * base too. Returns the vertices and indices written. Float arrays with
+ * int or short indices go straight from the cut through GLOD_Cut::fill();
+ * anything else goes through a GLOD_RawPatch and the Set* conversions.
+ */
+static int FillPatch(GLOD_Cut* c, int patch, VaState vas, GLuint base, GLuint offset,
+                     GLuint* nverts, GLuint* nindices) {
+  vas.va = (char*) vas.va + (ptrdiff_t) base * vas.va_stride;
+  if(vas.na) vas.na = (char*) vas.na + (ptrdiff_t) base * vas.na_stride;
+  if(vas.ta) vas.ta = (char*) vas.ta + (ptrdiff_t) base * vas.ta_stride;
+  if(vas.ca) vas.ca = (char*) vas.ca + (ptrdiff_t) base * vas.ca_stride;
+  if(vas.ia) vas.ia = (char*) vas.ia + (ptrdiff_t) offset * TypeSize(vas.ia_type);
+  
+  GLOD_FillTarget target;
+  if(FillLayout(&vas, &target)) {
+    target.index_base = base;
+    if(c->fill(patch, &target)) {
+      *nverts = target.num_vertices;
+      *nindices = target.num_indices;
+      return 1;
+    }
+  }
   
   // what are the maximum sizes for the readback?
   GLuint cut_nindices, cut_nverts;
@@ -267,11 +501,15 @@ int ProduceVA(GLOD_Cut* c, int patch,
   c->readback(patch, p);
   
   // convert the RawObject into the user's specified vertex array format...
-  int i;
+  GLuint i;
   
-  if(indices) {
-    // vertices first
-    for(i = 0; i < cut_nverts; i++) {
+  if(vas.ia) {
+    // vertices first; the cut numbers the ones it uses from 0
+    GLuint used = 0;
+    for(i = 0; i < cut_nindices; i++)
+      if((GLuint) p->triangles[i] >= used)
+        used = p->triangles[i] + 1;
+    for(i = 0; i < used; i++) {
       SetV(&vas, GL_TRIANGLES, p->vertices + 3*i, i);
       if(vas.na)
         SetN(&vas, GL_TRIANGLES, p->vertex_normals + 3*i, i);    
@@ -281,9 +519,13 @@ int ProduceVA(GLOD_Cut* c, int patch,
         SetT(&vas, GL_TRIANGLES, p->vertex_texture_coords + 2 * i, i);
     }
     
-    // now the index array if present 
+    // now the index array
+    for(i = 0; i < cut_nindices; i++)
+      p->triangles[i] += base;
     for(i = 0; i < cut_nindices / 3; i++)
         SetTriangle(&vas, GL_TRIANGLES, i, (int*)(p->triangles + 3*i));
+    *nverts = used;
+    *nindices = cut_nindices;
   } else {
     int real_index;
     for(i = 0; i < cut_nindices; i++) {
@@ -297,21 +539,61 @@ int ProduceVA(GLOD_Cut* c, int patch,
       if(vas.ta)
         SetT(&vas, GL_TRIANGLES, p->vertex_texture_coords + 2 * real_index, i);
     }
+    *nverts = cut_nindices;
+    *nindices = 0;
   }
 
-  // free the raw object
-//  free(p->vertices);
-//  if(vas.ca)
-//    free(p->vertex_colors);
-//  if(vas.na)
-//    free(p->vertex_normals);
-//  if(vas.ta)
-//    free(p->vertex_texture_coords);
-//  free(p->triangles);
   delete(p);
   return 1;
 }
 
+int ProduceVA(GLOD_Cut* c, int patch, 
+              void* indices, GLenum indices_type) {
+  VaState vas;
+  GLuint nverts, nindices;
+
+  GetVAState(&vas);
+  vas.ia = indices;
+  vas.ia_type = indices_type;
+  vas.first = 0;
+  if(!CheckFillState(&vas))
+    return 0;
+  
+  return FillPatch(c, patch, vas, 0, 0, &nverts, &nindices);
+}
+
+/* ProduceObjectVA: fills patches 0..num_patches-1 of c one after another
+ * into the current vertex arrays and indices. If ranges isn't NULL it gets
+ * each patch's first index, index count, first vertex and vertex count.
+ */
+int ProduceObjectVA(GLOD_Cut* c, int num_patches, void* indices,
+                    GLenum indices_type, GLint* ranges) {
+  VaState vas;
+  GLuint base = 0, offset = 0;
+
+  GetVAState(&vas);
+  vas.ia = indices;
+  vas.ia_type = indices_type;
+  vas.first = 0;
+  if(!CheckFillState(&vas))
+    return 0;
+  
+  for(int patch = 0; patch < num_patches; patch++) {
+    GLuint nverts = 0, nindices = 0;
+    if(c != NULL && !FillPatch(c, patch, vas, base, offset, &nverts, &nindices))
+      return 0;
+    if(ranges != NULL) {
+      ranges[4*patch] = offset;
+      ranges[4*patch+1] = nindices;
+      ranges[4*patch+2] = base;
+      ranges[4*patch+3] = nverts;
+    }
+    base += nverts;
+    offset += nindices;
+  }
+  return 1;
+}
+
 
 // to get a tri in a array format, verts should be
 //  {tri*3, tri*3+1, tri*3+2}
@@ -367,9 +649,10 @@ void GetTriangle(VaState* vas, int mode, int tri, int* dst) {
       dst[1] = GetIntAtOffset((char*)vas->ia, vas->first+tri*3+1, vas->ia_type);
       dst[2] = GetIntAtOffset((char*)vas->ia, vas->first+tri*3+2, vas->ia_type);
     } else {
-      dst[0] = vas->first + tri*3;
-      dst[1] = vas->first + tri*3+1;
-      dst[2] = vas->first + tri*3+2;
+      // GetV() and friends add first
+      dst[0] = tri*3;
+      dst[1] = tri*3+1;
+      dst[2] = tri*3+2;
     }
     return;
 	
@@ -684,10 +967,11 @@ static int TypeSize(int type) {
   case GL_UNSIGNED_SHORT:
     return sizeof(GLushort);
   case GL_UNSIGNED_INT:
-    return sizeof(GLushort);
+    return sizeof(GLuint);
   default:
     assert(false);
   }
+  return 0;
 }
 
 /***************************************************************************
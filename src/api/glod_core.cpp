@@ -24,32 +24,119 @@
 
 #include "manager.h"
 
-GLOD_APIState s_APIState;
-int GLOD_NUM_TILES;
-int GLOD_TILE_ROWS;
-int GLOD_TILE_COLS;
-GLOD_Tile *tiles;
-VDS::Manager s_VDSMemoryManager;
+GLOD_THREAD_LOCAL GLODcontext *s_pCurrentContext = NULL;
+GLOD_THREAD_LOCAL int GLOD_NUM_TILES;
+GLOD_THREAD_LOCAL int GLOD_TILE_ROWS;
+GLOD_THREAD_LOCAL int GLOD_TILE_COLS;
+GLOD_THREAD_LOCAL GLOD_Tile *tiles;
 
 /*****************************************************************************/
 
+/* BindContext: makes context current on this thread. The tile globals are
+ * per-thread copies of the current context's layout, so they are saved
+ * back to the old context and loaded from the new one.
+ ***************************************************************************/
+static void BindContext(GLODcontext *context) {
+  GLODcontext *old = s_pCurrentContext;
+  if (old != NULL) {
+    old->tileRows = GLOD_TILE_ROWS;
+    old->tileCols = GLOD_TILE_COLS;
+    old->numTiles = GLOD_NUM_TILES;
+    old->tiles = tiles;
+  }
+  s_pCurrentContext = context;
+  if (context != NULL) {
+    GLOD_TILE_ROWS = context->tileRows;
+    GLOD_TILE_COLS = context->tileCols;
+    GLOD_NUM_TILES = context->numTiles;
+    tiles = context->tiles;
+  } else {
+    GLOD_TILE_ROWS = GLOD_TILE_COLS = GLOD_NUM_TILES = 0;
+    tiles = NULL;
+  }
+}
+
+/* glodCreateContext
+ ***************************************************************************/
+GLOD_APIENTRY GLODcontext *glodCreateContext() {
+  GLODcontext *context = new GLODcontext;
+  context->state.last_error = GLOD_NO_ERROR;
+  context->state.object_hash = AllocHashtable();
+  context->state.group_hash = AllocHashtable();
+  context->state.instance_hash = AllocHashtable();
+  context->tileRows = context->tileCols = context->numTiles = 1;
+  context->tiles = new GLOD_Tile[1];
+  context->tiles[0].min_x=-1;
+  context->tiles[0].max_x=1;
+  context->tiles[0].min_y=-1;
+  context->tiles[0].max_y=1;
+  context->createdByInit = false;
+  context->buildPool = NULL;
+  context->fillScratch = NULL;
+  return context;
+}
+
+/* glodDestroyContext
+ ***************************************************************************/
+GLOD_APIENTRY void glodDestroyContext(GLODcontext *context) {
+  if (context == NULL)
+    return;
+
+  // tear down through the normal API entries, with the context current
+  GLODcontext *previous = s_pCurrentContext;
+  BindContext(context);
+
+  // drop builds that haven't been attached, along with their objects
+  GLOD_ShutdownBuilds(context);
+
+  // cleanup all groups using glodDeleteGroups... this will kill the
+  // objects as well. Collect the names first, since deleting from the
+  // table while walking it isn't safe.
+  unsigned int num_groups = HashtableNumElements(s_APIState.group_hash), i = 0;
+  GLuint *group_names = new GLuint[num_groups];
+  HASHTABLE_WALK(s_APIState.group_hash, node);
+  group_names[i++] = node->key;
+  HASHTABLE_WALK_END(s_APIState.group_hash);
+  for (i = 0; i < num_groups; i++)
+	glodDeleteGroup(group_names[i]);
+  delete [] group_names;
+  
+  assert(HashtableNumElements(s_APIState.group_hash) == 0);
+  assert(HashtableNumElements(s_APIState.object_hash) == 0);
+  assert(HashtableNumElements(s_APIState.instance_hash) == 0);
+
+  FreeHashtable(s_APIState.group_hash);
+  FreeHashtable(s_APIState.object_hash);
+  FreeHashtableCautious(s_APIState.instance_hash); // the groups own the sets
+
+  delete [] tiles;
+  delete context->fillScratch;
+  s_pCurrentContext = NULL; // nothing to save back
+  delete context;
+  BindContext((previous == context) ? NULL : previous);
+}
+
+/* glodMakeCurrent
+ ***************************************************************************/
+GLOD_APIENTRY void glodMakeCurrent(GLODcontext *context) {
+  BindContext(context);
+}
+
+/* glodGetCurrentContext
+ ***************************************************************************/
+GLOD_APIENTRY GLODcontext *glodGetCurrentContext() {
+  return s_pCurrentContext;
+}
+
 /* glodInit
  ***************************************************************************/
 GLOD_APIENTRY GLuint glodInit() {
-  // init routine
-  memset(&s_APIState, 0, sizeof(s_APIState));
-  s_APIState.last_error = GLOD_NO_ERROR;
-  s_APIState.object_hash = AllocHashtable();
-  s_APIState.group_hash = AllocHashtable();
-  GLOD_TILE_ROWS=1;
-  GLOD_TILE_COLS=1;
-  GLOD_NUM_TILES=GLOD_TILE_ROWS*GLOD_TILE_COLS;
-
-  tiles=new GLOD_Tile();
-  tiles[0].min_x=-1;
-  tiles[0].max_x=1;
-  tiles[0].min_y=-1;
-  tiles[0].max_y=1;
+  // give the thread a context if it hasn't been given one
+  if (s_pCurrentContext == NULL) {
+    GLODcontext *context = glodCreateContext();
+    context->createdByInit = true;
+    BindContext(context);
+  }
 
   // init opengl extensions
   GLOD_InitGL();
@@ -64,21 +151,9 @@ GLOD_APIENTRY void glodShutdown() {
   // shutdown OpenGL
   GLOD_CleanupGL();
 
-  // cleanup all groups using glodDeleteGroups... this will kill the
-  // objects as well
-  while(HashtableNumElements(s_APIState.group_hash) > 0) {
-	HASHTABLE_FIRST_NODE(s_APIState.group_hash, node);
-	glodDeleteGroup(node->key);
-  }
-  
-  assert(HashtableNumElements(s_APIState.group_hash) == 0);
-  assert(HashtableNumElements(s_APIState.object_hash) == 0);
-
-  FreeHashtable(s_APIState.group_hash);
-  FreeHashtable(s_APIState.object_hash);
-
-
-  delete [] tiles;
+  // contexts from glodCreateContext belong to the application
+  if ((s_pCurrentContext != NULL) && s_pCurrentContext->createdByInit)
+    glodDestroyContext(s_pCurrentContext);
 }
 
 /* glodGetError
@@ -89,6 +164,47 @@ GLOD_APIENTRY GLenum glodGetError ( void ) {
     return error;
 }
 
+/* glodMemoryParameteri
+ ***************************************************************************/
+GLOD_APIENTRY void glodMemoryParameteri ( GLenum pname, GLint param ) {
+    switch(pname) {
+    case GLOD_MEMORY_BUDGET:
+        if (param < 0) {
+            GLOD_SetError(GLOD_INVALID_PARAM, "Memory budget must be nonnegative");
+            return;
+        }
+        // the budget is enforced as groups adapt
+        s_VDSMemoryManager.SetMemoryBudget((unsigned int) param);
+        return;
+    case GLOD_MEMORY_ALLOCATED:
+    case GLOD_MEMORY_USAGE:
+        GLOD_SetError(GLOD_INVALID_STATE, "Memory statistics are read-only", pname);
+        return;
+    default:
+        GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
+        return;
+    }
+}
+
+/* glodGetMemoryParameteriv
+ ***************************************************************************/
+GLOD_APIENTRY void glodGetMemoryParameteriv ( GLenum pname, GLint *param ) {
+    switch(pname) {
+    case GLOD_MEMORY_BUDGET:
+        *param = (GLint) s_VDSMemoryManager.GetMemoryBudget();
+        return;
+    case GLOD_MEMORY_ALLOCATED:
+        *param = (GLint) s_VDSMemoryManager.GetMemoryAllocated();
+        return;
+    case GLOD_MEMORY_USAGE:
+        *param = (GLint) s_VDSMemoryManager.GetMemoryUsage();
+        return;
+    default:
+        GLOD_SetError(GLOD_UNKNOWN_PROPERTY, "Unknown property", pname);
+        return;
+    }
+}
+
 
 /***************************************************************************
  * $Log: glod_core.cpp,v $
@@ -46,7 +46,7 @@ bool s_glodHasVBO = false;
 void GLOD_InitGL() {
   // query available extensions for VBO
   char *exts=(char *)glGetString(GL_EXTENSIONS);
-  if (strstr(exts, "GL_ARB_vertex_buffer_object")!=NULL){
+  if (exts!=NULL && strstr(exts, "GL_ARB_vertex_buffer_object")!=NULL){
     s_glodHasVBO=true;
   }
   else {
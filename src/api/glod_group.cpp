@@ -33,14 +33,34 @@
 #include "glod_core.h"
 #include "hash.h"
 #include "Continuous.h"
+#include "threads.h"
 /*----------------------------- Local Constants -----------------------------*/
 
 //#define GLOD_USE_TILES
+
+// error threshold adaptation gives a thread no fewer objects than this...
+#define GLOD_ADAPT_THREAD_MIN_OBJECTS 256
+// ...and hands them out this many at a time
+#define GLOD_ADAPT_THREAD_CHUNK 64
+// when the worst object can't be refined, triangle budget adaptation
+// looks this many objects further down for ones that still fit
+#define GLOD_BUDGET_FILL_TRIES 16
 /*------------------------------ Local Macros -------------------------------*/
 
 
 /*------------------------------- Local Types -------------------------------*/
 
+// a group's objects being adapted to an error threshold by several threads
+struct ThresholdAdaptJob
+{
+    GLOD_Object **objects;
+    int numObjects;
+    ErrorMode errorMode;
+    float threshold;
+    ThreadLock lock; // guards nextObject
+    int nextObject;
+    int *numTris;    // each thread's share of the group's triangles
+};
 
 /*------------------------------ Local Globals ------------------------------*/
 
@@ -138,7 +158,6 @@ void glodNewGroup(GLuint name)
 
 void glodDeleteGroup(GLuint name)
 {
-    int i;
     GLOD_Object* obj;
     
     GLOD_Group *group =
@@ -150,10 +169,11 @@ void glodDeleteGroup(GLuint name)
 	return;
     }
 
-    // iterate through group objects... delete each object
-    for(i = 0; i < group->getNumObjects(); i++)
+    // delete each object; removeObject() moves the last object into
+    // the freed slot, so always take the first one
+    while(group->getNumObjects() > 0)
     {
-	obj = group->getObject(i);
+	obj = group->getObject(0);
         
         glodDeleteObject(obj->name);
     }
@@ -169,6 +189,15 @@ void glodDeleteGroup(GLuint name)
 
 
 void glodAdaptGroup(GLuint name) {
+    // adapting is a safe point to add objects whose async builds are done
+    GLOD_AttachFinishedBuilds(name);
+
+    // and, as only this thread searches them, to free the arrays the name
+    // tables have grown out of
+    HashtableReclaim(s_APIState.object_hash);
+    HashtableReclaim(s_APIState.group_hash);
+    HashtableReclaim(s_APIState.instance_hash);
+
     GLOD_Group *group =
 	(GLOD_Group *)HashtableSearch(s_APIState.group_hash, name);
     
@@ -176,6 +205,9 @@ void glodAdaptGroup(GLuint name) {
 	GLOD_SetError(GLOD_INVALID_NAME, "Group does not exist", name);
 	return;
     }
+    // progressively loading objects read some more of their streams
+    GLOD_ContinueProgressiveLoads(group);
+
     if ((group->numTiles!=GLOD_NUM_TILES))
 	group->changeLayout();
     group->adapt();
@@ -254,10 +286,19 @@ void GLOD_Group::addObject(GLOD_Object *obj)
 //	fprintf(stderr, "mpSimplifier->AddCut()\n");
 	mpSimplifier->AddCut(   ((VDSCut*)obj->cut)->mpCut );
 //	fprintf(stderr, "mpSimplifier->CutAdded\n");
+
+	s_VDSMemoryManager.SetRendererImportance(((VDSCut*)obj->cut)->mpRenderer, obj->importance);
     }	
     
 #ifndef GLOD_USE_TILES
     currentNumTris += obj->cut->currentNumTris;
+    obj->budgetTris = obj->cut->currentNumTris;
+    // a VDS object changes the VDS objects' shared queue entry, so the
+    // budget queues are rebuilt; others are simply added at the next adapt
+    if (obj->format == GLOD_VDS)
+	firstBudgetAdapt = 1;
+    else
+	objectChanged(obj);
 #else
     for (int i=0; i<GLOD_NUM_TILES; i++)
 	if (obj->cut->currentErrorScreenSpace() > 0.f)
@@ -285,7 +326,9 @@ GLOD_Group::removeObject(int index)
 	return;
     }
 #ifndef GLOD_USE_TILES
-    if (objects[index]->cut->currentErrorScreenSpace() > 0.f)
+    if (objects[index]->budgetCoarsenHeapData.inHeap() || objects[index]->budgetDirty)
+	currentNumTris -= objects[index]->budgetTris;
+    else if (objects[index]->cut->currentErrorScreenSpace() > 0.f)
 	currentNumTris -= objects[index]->cut->currentNumTris;
 #else
     for (int i=0; i<GLOD_NUM_TILES; i++)
@@ -300,6 +343,25 @@ GLOD_Group::removeObject(int index)
     if(objects[index]->budgetRefineHeapData.inHeap())
         refineQueue->remove(&objects[index]->budgetRefineHeapData);
 
+    // and from the objects waiting to be re-keyed
+    if (objects[index]->budgetDirty)
+    {
+	for (unsigned int i=0; i<budgetDirtyObjects.size(); i++)
+	    if (budgetDirtyObjects[i] == objects[index])
+	    {
+		budgetDirtyObjects[i] = budgetDirtyObjects.back();
+		budgetDirtyObjects.pop_back();
+		break;
+	    }
+	objects[index]->budgetDirty = 0;
+    }
+    if (objects[index]->format == GLOD_VDS)
+    {
+	if (objects[index] == budgetVDSObject)
+	    budgetVDSObject = NULL;
+	firstBudgetAdapt = 1;
+    }
+
 
     objects[index]->groupIndex = -1;
     objects[index]->group = NULL;
@@ -330,6 +392,16 @@ GLOD_Group::adaptErrorThreshold()
     // Each object can adapt itself independently
 #ifndef GLOD_USE_TILES
     currentNumTris=0;
+
+    // so large groups are split among threads
+    int numThreads = (adaptThreads > 0) ? adaptThreads : GetNumSystemProcessors();
+    if (numThreads > numObjects / GLOD_ADAPT_THREAD_MIN_OBJECTS)
+	numThreads = numObjects / GLOD_ADAPT_THREAD_MIN_OBJECTS;
+    if ((numThreads > 1) && ((errorMode == ScreenSpace) || (errorMode == ObjectSpace)))
+    {
+	adaptErrorThresholdParallel(numThreads);
+	return;
+    }
 #else
     for (int i=0; i<GLOD_NUM_TILES; i++)
 	currentNumTris[i] = 0;
@@ -379,601 +451,473 @@ GLOD_Group::adaptErrorThreshold()
 
 } /* End of GLOD_Group::adaptErrorThreshold() **/
 
-bool GLOD_Group::isEndlessLoop()
+#ifndef GLOD_USE_TILES
+
+/*****************************************************************************\
+ @ AdaptThresholdThread
+ -----------------------------------------------------------------------------
+ description : adapts chunks of a ThresholdAdaptJob's objects until none are
+               left, adding up the triangles they contribute
+ input       : 
+ output      : 
+ notes       : discrete cuts only touch themselves, and VDS cuts have already
+               been adapted, so chunks can go to any thread
+\*****************************************************************************/
+static void AdaptThresholdThread(int iThread, int NumThreads, void *pParams)
 {
-	if(RefinedStatusList[0].size() != RefinedStatusList[1].size() || CoarsenedStatusList[0].size() != CoarsenedStatusList[1].size())
-	{
-		return false ;
-	}
+    ThresholdAdaptJob *job = (ThresholdAdaptJob *) pParams;
+    int numTris = 0;
 
-	for(unsigned int i = 0 ; i < RefinedStatusList[0].size(); i++)
+    for (;;)
+    {
+	job->lock.Lock();
+	int first = job->nextObject;
+	job->nextObject += GLOD_ADAPT_THREAD_CHUNK;
+	job->lock.Unlock();
+	if (first >= job->numObjects)
+	    break;
+
+	int last = first + GLOD_ADAPT_THREAD_CHUNK;
+	if (last > job->numObjects)
+	    last = job->numObjects;
+	for (int i=first; i<last; i++)
 	{
-		if(RefinedStatusList[0][i] != RefinedStatusList[1][i])
-		{
-			return false ;
-		}
+	    GLOD_Object *obj = job->objects[i];
+	    if (job->errorMode == ScreenSpace)
+		obj->adaptScreenSpaceErrorThreshold(job->threshold);
+	    else
+		obj->adaptObjectSpaceErrorThreshold(job->threshold);
+	    if (obj->cut->currentErrorScreenSpace() > 0.f)
+		numTris += obj->cut->currentNumTris;
 	}
+    }
+    job->numTris[iThread] = numTris;
+} /* End of AdaptThresholdThread() **/
 
-	for(unsigned int i = 0 ; i < CoarsenedStatusList[0].size(); i++)
+/*****************************************************************************\
+ @ GLOD_Group::adaptErrorThresholdParallel
+ -----------------------------------------------------------------------------
+ description : adaptErrorThreshold for large groups, spread over numThreads
+ input       : 
+ output      : 
+ notes       : The VDS cuts all share mpSimplifier, so it is adapted here
+               first, once; their own adapt calls are then no-ops.
+\*****************************************************************************/
+void
+GLOD_Group::adaptErrorThresholdParallel(int numThreads)
+{
+    float threshold = (errorMode == ScreenSpace) ?
+	screenSpaceErrorThreshold : objectSpaceErrorThreshold;
+
+    for (int i=0; i<numObjects; i++)
+    {
+	if (objects[i]->format == GLOD_VDS)
 	{
-		if(CoarsenedStatusList[0][i] != CoarsenedStatusList[1][i])
-		{
-			return false ;
-		}
+	    if (errorMode == ScreenSpace)
+		objects[i]->adaptScreenSpaceErrorThreshold(threshold);
+	    else
+		objects[i]->adaptObjectSpaceErrorThreshold(threshold);
+	    break;
 	}
-	
-	return true ;
-}
+    }
 
-#ifndef GLOD_USE_TILES
+    ThresholdAdaptJob job;
+    job.objects = objects;
+    job.numObjects = numObjects;
+    job.errorMode = errorMode;
+    job.threshold = threshold;
+    job.nextObject = 0;
+    job.numTris = new int[numThreads];
+    ForkAndJoinThreads(numThreads, AdaptThresholdThread, &job);
+
+    currentNumTris = 0;
+    for (int i=0; i<numThreads; i++)
+	currentNumTris += job.numTris[i];
+    delete [] job.numTris;
+} /* End of GLOD_Group::adaptErrorThresholdParallel() **/
+
+#endif
 
 /*****************************************************************************\
- @ GLOD_Group::adaptTriangleBudget
+ @ GLOD_Group::objectChanged
  -----------------------------------------------------------------------------
- description : 
+ description : notes that an object's view or cut changed between adapts
  input       : 
  output      : 
- notes       : 
+ notes       : The triangle budget queues are kept from one adapt to the
+               next, so objects changed in between have to be re-keyed.
+               Each is listed once. Nothing is listed in other modes, as
+               switching to triangle budget mode rebuilds the queues.
 \*****************************************************************************/
 void
-GLOD_Group::adaptTriangleBudget()
+GLOD_Group::objectChanged(GLOD_Object *obj)
 {
-	int TrisAfterRefine;
-	float NewError;
+    if ((adaptMode != TriangleBudget) || obj->budgetDirty)
+	return;
+    obj->budgetDirty = 1;
+    budgetDirtyObjects.push_back(obj);
+} /* End of GLOD_Group::objectChanged() **/
 
-	GLOD_Object_Status LastRefinedStatus ;
-	GLOD_Object_Status LastCoarsenedStatus ;
-	LastRefinedStatus.name = UINT_MAX - 1;
-	LastCoarsenedStatus.name = UINT_MAX - 1;
-	
-    if (!firstBudgetAdapt && !objectsChanged &&	!budgetChanged &&
-		(errorMode == ObjectSpace))
-	{
-		return;
-	}
+/*****************************************************************************\
+ @ GLOD_Group::objectLoaded
+ -----------------------------------------------------------------------------
+ description : notes that a progressive load brought in more of an object
+ input       : 
+ output      : 
+ notes       : VDS nodes whose children had yet to arrive were deferred,
+               which leaves them a stand-in error until the simplifier
+               recomputes every node's error; the VDS budget queue keys
+               need the real ones.
+\*****************************************************************************/
+void
+GLOD_Group::objectLoaded(GLOD_Object *obj)
+{
+    if ((obj->format == GLOD_VDS) && (adaptMode == TriangleBudget) &&
+	(budgetVDSObject != NULL))
+    {
+	mpSimplifier->UpdateNodeErrors();
+	budgetVDSObject->cut->updateStats();
+    }
+    objectChanged(obj);
+} /* End of GLOD_Group::objectLoaded() **/
 
-	//printf("Beginning adaptTriangleBudget()\n");
+#ifndef GLOD_USE_TILES
 
-	// update currentNumTris
-	bool VDScutCounted = false;
-	currentNumTris = 0;
-    for (int i=0; i<numObjects; i++)
+/*****************************************************************************\
+ @ GLOD_Group::rekeyBudgetObject
+ -----------------------------------------------------------------------------
+ description : brings an object's budget queue keys, and its share of
+               currentNumTris, up to date with its cut
+ input       : 
+ output      : 
+ notes       : The keys of elements that are out of their queue are only
+               set; insertBudgetObject() puts them back.
+\*****************************************************************************/
+void
+GLOD_Group::rekeyBudgetObject(GLOD_Object *obj)
+{
+    currentNumTris += obj->cut->currentNumTris - obj->budgetTris;
+    obj->budgetTris = obj->cut->currentNumTris;
+
+    float coarsenError, currentError;
+    if (errorMode == ObjectSpace)
     {
-		if (objects[i]->format == GLOD_VDS)
-		{
-			if (VDScutCounted == true)
-				continue;
-			else
-				VDScutCounted = true;
-			currentNumTris += objects[i]->cut->currentNumTris;
-		}
-		else
-		{
-			currentNumTris += objects[i]->cut->currentNumTris;
-		}
+	coarsenError = obj->cut->coarsenErrorObjectSpace();
+	currentError = obj->cut->currentErrorObjectSpace();
+    }
+    else
+    {
+	coarsenError = obj->cut->coarsenErrorScreenSpace();
+	currentError = obj->cut->currentErrorScreenSpace();
     }
 
-    // initialize (or re-inintialize) the budget algorithm
+    if (obj->budgetCoarsenHeapData.inHeap())
+	coarsenQueue->changeKey(&obj->budgetCoarsenHeapData, coarsenError);
+    else
+	obj->budgetCoarsenHeapData.setKey(coarsenError);
+    if (obj->budgetRefineHeapData.inHeap())
+	refineQueue->changeKey(&obj->budgetRefineHeapData, -currentError);
+    else
+	obj->budgetRefineHeapData.setKey(-currentError);
+} /* End of GLOD_Group::rekeyBudgetObject() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::insertBudgetObject
+ -----------------------------------------------------------------------------
+ description : re-keys an object and puts it in whichever budget queues it
+               is missing from
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_Group::insertBudgetObject(GLOD_Object *obj)
+{
+    rekeyBudgetObject(obj);
+    if (!obj->budgetCoarsenHeapData.inHeap())
+	coarsenQueue->insert(&obj->budgetCoarsenHeapData);
+    if (!obj->budgetRefineHeapData.inHeap())
+	refineQueue->insert(&obj->budgetRefineHeapData);
+} /* End of GLOD_Group::insertBudgetObject() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::clearQueues
+ -----------------------------------------------------------------------------
+ description : empties the triangle budget queues and the list of objects
+               waiting to be re-keyed
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_Group::clearQueues()
+{
     refineQueue->clear();
     coarsenQueue->clear();
+    for (unsigned int i=0; i<budgetDirtyObjects.size(); i++)
+	budgetDirtyObjects[i]->budgetDirty = 0;
+    budgetDirtyObjects.clear();
+    budgetVDSObject = NULL;
+} /* End of GLOD_Group::clearQueues() **/
 
-	bool VDScutAdded = false;
+/*****************************************************************************\
+ @ GLOD_Group::initQueues
+ -----------------------------------------------------------------------------
+ description : (re)builds the triangle budget queues from every object
+ input       : 
+ output      : 
+ notes       : Only needed on the first adapt in triangle budget mode, after
+               the error mode changes, or when VDS objects come or go;
+               otherwise updateQueues() keeps the queues current.
+\*****************************************************************************/
+void
+GLOD_Group::initQueues()
+{
+    clearQueues();
+
+    // all VDS objects in a group share the same VDS::Simplifier, and
+    // adapting this simplifier adapts all of the VDS objects at once
+    // therefore, we only need a single entry in the queues for all 
+    // VDS objects in the group; VDS will take care of distributing the
+    // triangles to each object according to its current error. Its
+    // cut's currentNumTris already counts all of their triangles.
+    currentNumTris = 0;
     for (int i=0; i<numObjects; i++)
     {
-		GLOD_Object *obj = objects[i];
-	
-		if (obj->format!=GLOD_VDS)
-		{
-			obj->budgetCoarsenHeapData=HeapElement(obj);
-			obj->budgetRefineHeapData=HeapElement(obj);
-		}
-		// all VDS objects in a group share the same VDS::Simplifier, and
-		// adapting this simplifier adapts all of the VDS objects at once
-		// therefore, we only need a single entry in the queues for all 
-		// VDS objects in the group; VDS will take care of distributing the
-		// triangles to each object according to its current error.
-		if (obj->format == GLOD_VDS)
-		{
-			if (VDScutAdded == true)
-				continue;
-			else
-				VDScutAdded = true;
-		}
-
-		if (errorMode == ObjectSpace)
-		{
-			obj->budgetCoarsenHeapData.setKey(
-				obj->cut->coarsenErrorObjectSpace());
-			coarsenQueue->insert(&(objects[i]->budgetCoarsenHeapData));
-		
-			obj->budgetRefineHeapData.setKey(
-				-obj->cut->currentErrorObjectSpace());
-			refineQueue->insert(&(objects[i]->budgetRefineHeapData));
-		}
-		else
-		{
-			obj->budgetCoarsenHeapData.setKey(
-				obj->cut->coarsenErrorScreenSpace());
-			coarsenQueue->insert(&(objects[i]->budgetCoarsenHeapData));
-	
-			obj->budgetRefineHeapData.setKey(
-				-obj->cut->currentErrorScreenSpace());
-			refineQueue->insert(&(objects[i]->budgetRefineHeapData));
-		}
-    }
-
-    firstBudgetAdapt = 0;
-	objectsChanged = 0;
-    
-    // adapt all the objects to distribute the budgeted triangles while
-    // minimizing the error
-    GLOD_Object *coarsenTop, *refineTop;
-    char roomToRefine, overBudget, queuesBalanced;
-
-    coarsenTop = (GLOD_Object *)coarsenQueue->min()->userData();
-    refineTop = (GLOD_Object *)refineQueue->min()->userData();
-
-	if (refineTop->cut->refineTris == MAXINT)
+	GLOD_Object *obj = objects[i];
+	if (obj->format == GLOD_VDS)
 	{
-		roomToRefine = 0;
+	    if (budgetVDSObject != NULL)
+		continue;
+	    budgetVDSObject = obj;
 	}
-	else
-	{
-		TrisAfterRefine = currentNumTris - refineTop->cut->currentNumTris
-			+ refineTop->cut->refineTris;
+	obj->budgetTris = 0;
+	insertBudgetObject(obj);
+    }
 
-		roomToRefine = (TrisAfterRefine <= triBudget);
-	}
+    firstBudgetAdapt = 0;
+    objectsChanged = 0;
+    budgetSettled = 0;
+} /* End of GLOD_Group::initQueues() **/
 
-    overBudget = ((currentNumTris > triBudget) &&
-		  (coarsenTop->cut->coarsenErrorObjectSpace() != MAXFLOAT));
+/*****************************************************************************\
+ @ GLOD_Group::updateQueues
+ -----------------------------------------------------------------------------
+ description : re-keys the objects listed by objectChanged(), adding those
+               that are new to the group to the queues
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_Group::updateQueues()
+{
+    if (budgetDirtyObjects.empty())
+	return;
 
-	if (errorMode == ObjectSpace)
-	{
-	    queuesBalanced = (coarsenTop->cut->coarsenErrorObjectSpace()
-			>= refineTop->cut->currentErrorObjectSpace());
-	}
+    bool VDSChanged = false;
+    for (unsigned int i=0; i<budgetDirtyObjects.size(); i++)
+    {
+	GLOD_Object *obj = budgetDirtyObjects[i];
+	obj->budgetDirty = 0;
+	if (obj->format == GLOD_VDS)
+	    VDSChanged = true;
 	else
-	{
-		queuesBalanced = (coarsenTop->cut->coarsenErrorScreenSpace() 
-			>= refineTop->cut->currentErrorScreenSpace());
-	}
-	
-	if (errorMode == ScreenSpace)
-	{
-	  roomToRefine=1;
-	  overBudget=1;
-	}
-#ifdef DEBUG_TRIADAPT
-    printf("\n\nbeginning of adapt\n\n");
-#endif
-
-	unsigned int IterationCounter = 0 ;	
-	int CurList = -1 ;
-	
-	RefinedStatusList[0].clear() ;
-	CoarsenedStatusList[0].clear() ;
-	RefinedStatusList[1].clear() ;
-	CoarsenedStatusList[1].clear() ;
-    while (roomToRefine || overBudget || !queuesBalanced)
-    {		
-		IterationCounter++ ;
-		if(IterationCounter > 100) //check if there is endless loop
-		{
-			if(isEndlessLoop()) //break
-			{
-				refineQueue->clear();
-				coarsenQueue->clear();
-				return ;
-			}
-
-			if(CurList < 0)
-			{
-				CurList = 0 ;
-			}
-			else
-			{
-				CurList = !CurList ;
-			}
-			RefinedStatusList[CurList].clear() ;
-			CoarsenedStatusList[CurList].clear() ;
-		}
-
-#ifdef DEBUG_TRIADAPT
-        printf("\tCurrent Num Tris: %i, TrisAfterRefine: %i, Budget: %i\n",
-               currentNumTris, TrisAfterRefine, triBudget);
-        printf("\tCoarsen Queue Top Error: %.25f, Refine Queue Top Error: %.25f\n",
-               (errorMode == ObjectSpace) ? coarsenTop->cut->coarsenErrorObjectSpace() :
-               coarsenTop->cut->coarsenErrorScreenSpace(), (errorMode == ObjectSpace) ? 
-               refineTop->cut->currentErrorObjectSpace() : 
-               refineTop->cut->currentErrorScreenSpace());
-        
-        if (roomToRefine)
-            printf("\troomToRefine: 1, ");
-        else
-            printf("\troomToRefine: 0, ");
-        if (overBudget)
-            printf("overBudget: 1, ");
-        else
-            printf("overBudget: 0, ");
-        if (queuesBalanced)
-            printf("queuesBalanced: 1\n");
-        else
-            printf("queuesBalanced: 0\n");
-#endif
-		// Refine first, then coarsen, so that coarsening is last (and thus
-		// we end up within the budget)
-
-		// refine
-		while (roomToRefine)
-		{
-#ifdef DEBUG_TRIADAPT
-			printf("Beginning refine pass\n");
-#endif
-			GLOD_Object *refineObj =
-				(GLOD_Object *)refineQueue->extractMin()->userData();
-
-			GLOD_Object *nextRefine = (refineQueue->size() > 0) ?
-				(GLOD_Object *)refineQueue->min()->userData() : NULL;
-
-			// apply refinement
-			int beforeTris = refineObj->cut->currentNumTris;
-			int triTermination = triBudget - (currentNumTris - beforeTris);
-
-			if (triTermination < 0)
-			{
-	    		triTermination = refineObj->cut->refineTris;
-			}
-
-			float errorTermination = (nextRefine != NULL) ? 
-				nextRefine->cut->currentErrorObjectSpace() : -MAXFLOAT;
-
-			if ((errorMode == ScreenSpace) && (errorTermination != -MAXFLOAT))
-			{
-				float nextRefineError = nextRefine->cut->currentErrorScreenSpace();			
-				errorTermination =  nextRefineError;
-			}
-#ifdef DEBUG_TRIADAPT
-            printf("refining %u\n", refineObj->name);
-            printf("tri term %i errorTerm %f\n", triTermination, errorTermination);
-#endif
-            refineObj->cut->refine(errorMode, triTermination, errorTermination);
-
-			int afterTris = refineObj->cut->currentNumTris;
-			currentNumTris = currentNumTris - beforeTris + afterTris;
+	    insertBudgetObject(obj);
+    }
+    if (VDSChanged && (budgetVDSObject != NULL))
+	insertBudgetObject(budgetVDSObject);
 
-			if ((refineObj->name == LastRefinedStatus.name) &&
-				(triTermination == LastRefinedStatus.triTermination) &&
-				(errorTermination == LastRefinedStatus.errorTermination))
-			{
-			//	printf("Duplicate refine call - euthanizing budget loop.\n");
+    budgetDirtyObjects.clear();
+    budgetSettled = 0;
+} /* End of GLOD_Group::updateQueues() **/
 
-				if (coarsenQueue->size() == 1)
-					return;
+/*****************************************************************************\
+ @ GLOD_Group::stepBudgetObject
+ -----------------------------------------------------------------------------
+ description : refines or coarsens an object just taken off the top of the
+               refine or coarsen queue, re-keys it, and puts it back
+ input       : triTermination and errorTermination go to the cut
+ output      : false if the cut did not change; the object is then left
+               out of the queue it was taken from
+ notes       : 
+\*****************************************************************************/
+bool
+GLOD_Group::stepBudgetObject(GLOD_Object *obj, bool refine,
+			     int triTermination, float errorTermination)
+{
+    int beforeTris = obj->cut->currentNumTris;
+    if (refine)
+	obj->cut->refine(errorMode, triTermination, errorTermination);
+    else
+	obj->cut->coarsen(errorMode, triTermination, errorTermination);
+    rekeyBudgetObject(obj);
+
+    if (obj->cut->currentNumTris == beforeTris)
+	return false;
+    if (refine)
+	refineQueue->insert(&obj->budgetRefineHeapData);
+    else
+	coarsenQueue->insert(&obj->budgetCoarsenHeapData);
+    return true;
+} /* End of GLOD_Group::stepBudgetObject() **/
 
-				coarsenQueue->remove(&(refineObj->budgetCoarsenHeapData));
-				refineTop= (GLOD_Object *)refineQueue->min()->userData();
-			}
-			else
-			{
-				LastRefinedStatus.name = refineObj->name;
-				LastRefinedStatus.triTermination = triTermination;
-				LastRefinedStatus.errorTermination = errorTermination;
-
-				if(CurList >= 0)
-				{
-					RefinedStatusList[CurList].push_back(LastRefinedStatus) ;
-				}
-				// possible reasons that the refine terminated:
-				//
-				// a) error < errorTermination
-				//    -- put back on refine queue (it won't be on top anymore)
-				//
-				// b) tris > triTermination
-				//    -- put on coarsen queue (we will need to coarsen either
-				//       this or something else to get within budget)
-				//
-				// c) no more refinements possible
-				//    -- put on coarsen queue
-			
-				if (errorMode == ObjectSpace)
-				{
-					refineObj->budgetRefineHeapData.setKey(
-					  -refineObj->cut->currentErrorObjectSpace());
-				}
-				else
-				{
-					refineObj->budgetRefineHeapData.setKey(
-						-refineObj->cut->currentErrorScreenSpace());
-				}
-
-				if (errorMode == ObjectSpace)
-				{
-					NewError = refineObj->cut->coarsenErrorObjectSpace();
-				}
-				else
-				{
-					NewError = refineObj->cut->coarsenErrorScreenSpace();
-				}	
-
-				refineQueue->insert(&(refineObj->budgetRefineHeapData));
-				coarsenQueue->changeKey(&(refineObj->budgetCoarsenHeapData), NewError);
-			}
+/*****************************************************************************\
+ @ GLOD_Group::adaptTriangleBudget
+ -----------------------------------------------------------------------------
+ description : spreads triBudget triangles over the group's objects so that
+               the largest error is as small as it can be made
+ input       : 
+ output      : 
+ notes       : The refine queue is keyed on each object's current error,
+               the coarsen queue on its error once coarsened. Both are
+               kept between adapts, and only the objects listed by
+               objectChanged() are re-keyed, so an adapt after k changes
+               costs O(k log n) rather than O(n log n).
+
+               Each pass first coarsens until the group is within the
+               budget. It then refines the worst object while that fits,
+               or else coarsens the cheapest one to make room, but only
+               when that is better by more than budgetHysteresis. An
+               object coarsened in a pass is not refined again in it, nor
+               the other way around, so every pass ends. budgetSteps can
+               cut a pass shorter; the next adapt picks up from there.
+\*****************************************************************************/
+void
+GLOD_Group::adaptTriangleBudget()
+{
+    if (firstBudgetAdapt)
+	initQueues();
+    else
+	updateQueues();
 
-			coarsenTop = (GLOD_Object *)coarsenQueue->min()->userData();
-			refineTop = (GLOD_Object *)refineQueue->min()->userData();
+    if ((budgetSettled && !budgetChanged) || (triBudget < 0) ||
+	(coarsenQueue->size() == 0))
+	return;
+    budgetChanged = 0;
+    budgetSettled = 1;
+    budgetPass++;
 
-			TrisAfterRefine = (currentNumTris - refineTop->cut->currentNumTris +
-				refineTop->cut->refineTris);
+    // objects that can't be adapted any further this pass are set aside
+    std::vector<GLOD_Object*> parked;
+    int fillTries = GLOD_BUDGET_FILL_TRIES;
+    int steps = 0;
 
-			roomToRefine = (refineTop->cut->refineTris == MAXINT) ? 0 :
-				(TrisAfterRefine < triBudget);
+    for (;;)
+    {
+	// getting back within the budget is never put off
+	if (currentNumTris > triBudget)
+	{
+	    HeapElement *cheapest = coarsenQueue->min();
+	    if ((cheapest == NULL) || (cheapest->key() == MAXFLOAT))
+		break; // nothing left to coarsen
 
-			overBudget = ((currentNumTris > triBudget) &&
-				  (coarsenTop->cut->coarsenErrorObjectSpace() != MAXFLOAT));
+	    GLOD_Object *coarsenObj =
+		(GLOD_Object *)coarsenQueue->extractMin()->userData();
+	    float errorTermination = (coarsenQueue->size() > 0) ?
+		coarsenQueue->min()->key() : MAXFLOAT;
+	    coarsenObj->budgetCoarsenPass = budgetPass;
+	    if (!stepBudgetObject(coarsenObj, false,
+				  triBudget - (currentNumTris - coarsenObj->budgetTris),
+				  errorTermination))
+		parked.push_back(coarsenObj);
+	    continue;
+	}
 
-			//printf("over (refine)? %i %i\n", currentNumTris, triBudget);
-	   
-			if (errorMode == ObjectSpace)
-			{
-				queuesBalanced = (coarsenTop->cut->coarsenErrorObjectSpace()
-					  >= refineTop->cut->currentErrorObjectSpace());
-			}
-			else
-			{
-				float coarsenTopError = coarsenTop->cut->coarsenErrorScreenSpace();
-				float refineTopError = refineTop->cut->currentErrorScreenSpace();
-				queuesBalanced = (coarsenTopError >= refineTopError);
-			}
-	    
-	 		if ((errorMode == ScreenSpace) && (!overBudget) && (queuesBalanced) && (refineTop->cut->currentErrorScreenSpace() < 0.0000000001))
-				return;
-
-#ifdef DEBUG_TRIADAPT
-			printf("\tCurrent Num Tris: %i, TrisAfterRefine: %i, Budget: %i\n",
-				currentNumTris, TrisAfterRefine, triBudget);
-			printf("before %i after %i rque: %i cque: %i\n", beforeTris, afterTris, refineQueue->size(), coarsenQueue->size());
-
-			printf("\tCoarsen Queue Top Error: %f, Refine Queue Top Error: %f\n",
-				(errorMode == ObjectSpace) ? coarsenTop->cut->coarsenErrorObjectSpace() :
-				coarsenTop->cut->coarsenErrorScreenSpace(), (errorMode == ObjectSpace) ? 
-				refineTop->cut->currentErrorObjectSpace() : 
-				refineTop->cut->currentErrorScreenSpace());
-#endif
-#if 1
-	    
-			if (queuesBalanced)
-			{
-				while ((!overBudget) && (!roomToRefine) && (refineQueue->size() > 1))
-				{
+	if ((budgetSteps > 0) && (steps >= budgetSteps))
+	{
+	    budgetSettled = 0; // the next adapt carries on
+	    break;
+	}
 
-				//		    printf("Queues Balanced; removing tops of refine and coarsen queues(refine)\n");
+	// a VDS cut that has yet to be adapted can report a stale, negative
+	// error, so only an error of exactly zero means there is nothing left
+	HeapElement *worst = refineQueue->min();
+	if ((worst == NULL) || (worst->key() == 0))
+	    break; // no error left to refine away
+	GLOD_Object *refineObj = (GLOD_Object *)worst->userData();
+	float refineError = -worst->key();
+	int refineTris = refineObj->cut->refineTris;
+
+	if ((refineTris != MAXINT) &&
+	    (refineObj->budgetCoarsenPass != budgetPass))
+	{
+	    int needed = currentNumTris - refineObj->budgetTris + refineTris -
+		triBudget;
 
-					refineQueue->remove( &(refineTop->budgetRefineHeapData) );
-					coarsenQueue->remove( &(refineTop->budgetCoarsenHeapData) );
-					refineTop = (GLOD_Object *)refineQueue->min()->userData();
-		    
-					TrisAfterRefine = (currentNumTris - 
-						refineTop->cut->currentNumTris + refineTop->cut->refineTris);
-		    
-					roomToRefine = (refineTop->cut->refineTris == MAXINT) ? 0 :
-						(TrisAfterRefine < triBudget);
-				}
-			}
-#endif      
+	    // refine the worst object if that fits in the budget...
+	    if (needed <= 0)
+	    {
+		refineQueue->extractMin();
+		float errorTermination = (refineQueue->size() > 0) ?
+		    -refineQueue->min()->key() : -MAXFLOAT;
+		refineObj->budgetRefinePass = budgetPass;
+		steps++;
+		if (!stepBudgetObject(refineObj, true,
+				      triBudget - (currentNumTris - refineObj->budgetTris),
+				      errorTermination))
+		    parked.push_back(refineObj);
+		continue;
+	    }
 
-		} // end of refinement
-#ifdef DEBUG_TRIADAPT
-        printf("after refinement\n");
-        if (roomToRefine)
-            printf("\troomToRefine: 1, ");
-        else
-            printf("\troomToRefine: 0, ");
-        if (overBudget)
-            printf("overBudget: 1, ");
-        else
-            printf("overBudget: 0, ");
-        if (queuesBalanced)
-            printf("queuesBalanced: 1\n");
-        else
-            printf("queuesBalanced: 0\n");
-#endif
-        
-		while (overBudget || !queuesBalanced)
+	    // ...or else make room by coarsening whatever costs the least
+	    // error, if that is clearly better than leaving it be
+	    HeapElement *cheapest = coarsenQueue->min();
+	    float tradeError = refineError / (1.0f + budgetHysteresis);
+
+	    // the VDS objects share one entry, so they make room among
+	    // themselves: held to their share of the budget, the simplifier
+	    // folds nodes cheaper than tradeError (occluded ones, say) to
+	    // unfold the worst. Once a pass, as the trade may not pay off.
+	    if ((refineObj->format == GLOD_VDS) &&
+		(refineObj->budgetRefinePass != budgetPass) &&
+		(refineObj->budgetCoarsenHeapData.key() < tradeError))
+	    {
+		refineQueue->extractMin();
+		refineObj->budgetRefinePass = budgetPass;
+		steps++;
+		if (!stepBudgetObject(refineObj, true,
+				      triBudget - (currentNumTris - refineObj->budgetTris),
+				      tradeError))
+		    parked.push_back(refineObj);
+		continue;
+	    }
+	    if ((cheapest != NULL) && (cheapest->userData() != refineObj) &&
+		(cheapest->key() < tradeError))
+	    {
+		GLOD_Object *coarsenObj =
+		    (GLOD_Object *)coarsenQueue->extractMin()->userData();
+		if (coarsenObj->budgetRefinePass == budgetPass)
 		{
-#ifdef DEBUG_TRIADAPT
-			printf("Beginning coarsen pass\n");
-#endif
-			GLOD_Object *coarsenObj =
-				(GLOD_Object *)coarsenQueue->extractMin()->userData();
-	  
-			GLOD_Object *nextCoarsen = (coarsenQueue->size() > 0) ?
-				(GLOD_Object *)coarsenQueue->min()->userData() : NULL;
-		
-			// apply coarsening
-	    
-			int beforeTris = coarsenObj->cut->currentNumTris;
-			/*
-			if (beforeTris==0&&(refineQueue->size()>1)){
-			  refineQueue->remove( &(coarsenTop->budgetRefineHeapData) );
-			  coarsenQueue->remove( &(coarsenTop->budgetCoarsenHeapData) );
-			  refineTop = (GLOD_Object *)refineQueue->min()->userData();
-			  coarsenTop = (GLOD_Object *)coarsenQueue->min()->userData();
-			  continue;
-	      
-			}
-			else if (beforeTris==0&&(refineQueue->size()==1)){
-			  */
-	      
-			int triTermination = triBudget - (currentNumTris - beforeTris);
-	    
-			float errorTermination = (nextCoarsen != NULL) ?
-				nextCoarsen->cut->coarsenErrorObjectSpace() : MAXFLOAT;
-			//printf("tri term %i errorTerm(os) %f\n", triTermination, errorTermination);
-			if ((errorMode == ScreenSpace) && (errorTermination != MAXFLOAT))
-			{
-				errorTermination = nextCoarsen->cut->coarsenErrorScreenSpace();
-			}
-	#ifdef DEBUG_TRIADAPT
-			printf("coarsening %u\n", coarsenObj->name);
-			printf("tri term %i errorTerm %f\n", triTermination, errorTermination);
-	#endif
-
-			if (triTermination >= beforeTris)
-				triTermination = 0;
-
-			coarsenObj->cut->coarsen(errorMode, triTermination, errorTermination);
-		
-			int afterTris = coarsenObj->cut->currentNumTris;
-			currentNumTris = currentNumTris - beforeTris + afterTris;
-
-
-			if ((coarsenObj->name == LastCoarsenedStatus.name) &&
-				(triTermination == LastCoarsenedStatus.triTermination) &&
-				(errorTermination == LastCoarsenedStatus.errorTermination))
-			{
-				//printf("Duplicate coarsen call - euthanizing budget loop.\n");
-
-				if (refineQueue->size() == 1)
-					return;
-
-				refineQueue->remove(&(coarsenObj->budgetRefineHeapData));
-				refineTop= (GLOD_Object *)refineQueue->min()->userData();
-			}			
-			else
-			{				
-				LastCoarsenedStatus.name = coarsenObj->name;
-				LastCoarsenedStatus.triTermination = triTermination;
-				LastCoarsenedStatus.errorTermination = errorTermination;
-
-				if(CurList >= 0)
-				{
-					CoarsenedStatusList[CurList].push_back(LastCoarsenedStatus) ;
-				}
-
-				// possible reasons that the coarsen terminated:
-				//
-				// a) error > errorTermination
-				//    -- put back on coarsen queue (it won't be on top anymore)
-				//
-				// b) tris <= triTermination
-				//    -- put on refinement queue
-				//
- 				// c) no more coarsening possible
-				//    -- put on refinement queue
-
-				if (errorMode == ObjectSpace)
-				{
-					coarsenObj->budgetCoarsenHeapData.setKey(
-						coarsenObj->cut->coarsenErrorObjectSpace());
-				}
-				else
-				{
-					coarsenObj->budgetCoarsenHeapData.setKey(
-						coarsenObj->cut->coarsenErrorScreenSpace());
-				}
-				coarsenQueue->insert(&(coarsenObj->budgetCoarsenHeapData));
-
-				if (errorMode == ObjectSpace)
-				{
-					NewError = -coarsenObj->cut->currentErrorObjectSpace();
-				}
-				else
-				{
-					NewError = -coarsenObj->cut->currentErrorScreenSpace();
-				}
-
-				refineQueue->changeKey(&(coarsenObj->budgetRefineHeapData), NewError);
-			}
-	    
-			coarsenTop = (GLOD_Object *)coarsenQueue->min()->userData();
-			refineTop = (GLOD_Object *)refineQueue->min()->userData();
-	    
-			TrisAfterRefine = (currentNumTris - refineTop->cut->currentNumTris +
-				  refineTop->cut->refineTris);
-			roomToRefine = (refineTop->cut->refineTris == MAXINT) ? 0 :
-				(TrisAfterRefine < triBudget);
-
-			overBudget = ((currentNumTris > triBudget) && 
-				(coarsenTop->cut->coarsenErrorObjectSpace() != MAXFLOAT));
-
-			if (triBudget<0)
-			  overBudget=0;
-
-			if (errorMode == ObjectSpace)
-			  {		
-					queuesBalanced = (coarsenTop->cut->coarsenErrorObjectSpace() 
-					  >= refineTop->cut->currentErrorObjectSpace());
-			  }
-			else
-			  {
-					queuesBalanced = (coarsenTop->cut->coarsenErrorScreenSpace()
-						>= refineTop->cut->currentErrorScreenSpace());
-			  }
-#ifdef DEBUG_TRIADAPT    
-				printf("\tCurrent Num Tris: %i, TrisAfterRefine: %i, Budget: %i, ref %i, %i\n",
-					   currentNumTris, TrisAfterRefine, triBudget, refineTop->cut->refineTris, MAXINT);
-				printf("before %i after %i rque: %i cque: %i\n", beforeTris, afterTris, refineQueue->size(), coarsenQueue->size());
-				printf("\tCoarsen Queue Top Error: %.50f, Refine Queue Top Error: %.50f\n",
-					   (errorMode == ObjectSpace) ? coarsenTop->cut->coarsenErrorObjectSpace() :
-					   coarsenTop->cut->coarsenErrorScreenSpace(), (errorMode == ObjectSpace) ? 
-					   refineTop->cut->currentErrorObjectSpace() : 
-					   refineTop->cut->currentErrorScreenSpace());
-#endif
-			if (coarsenQueue->size()==1)
-			  queuesBalanced=1;
-	    
-		   /* 
-			if (refineTop->cut->currentErrorScreenSpace()==0){
-			printf("arrrrr %i %f\n", coarsenTop->cut->currentNumTris, coarsenTop->cut->coarsenErrorObjectSpace());
-			printf("cq %i rq %i\n", coarsenQueue->size(), refineQueue->size());
-			printf("%i %i %i\n", overBudget, roomToRefine, queuesBalanced);
-			printf("%i %i\n", currentNumTris, triBudget);
-			}
-			*/
-	    
-		    if ((errorMode==ScreenSpace) && (!overBudget) && (queuesBalanced) && (refineTop->cut->currentErrorScreenSpace() < 0.0000000001))
-				return;
-	    
-#if 1
-			if (queuesBalanced)
-			{
-				while (!overBudget&&!roomToRefine&&(refineQueue->size()>1))
-				{
-
-				  //	  printf("Queues Balanced; removing tops of refine and coarsen queues(coarsen)\n");
-
-					refineQueue->remove(&(refineTop->budgetRefineHeapData));
-					coarsenQueue->remove(&(refineTop->budgetCoarsenHeapData));
-					refineTop= (GLOD_Object *)refineQueue->min()->userData();
+		    parked.push_back(coarsenObj);
+		    continue;
+		}
 
-					TrisAfterRefine = (currentNumTris 
-						- refineTop->cut->currentNumTris 
-						+ refineTop->cut->refineTris);
+		// a discrete cut stops on the first level past the error
+		// termination, so it gives up a level at a time to stay
+		// short of tradeError; VDS gets asked for all of it at once,
+		// as each of its steps updates every node's error
+		int triTermination = (coarsenObj->format == GLOD_VDS) ?
+		    coarsenObj->budgetTris - needed :
+		    coarsenObj->budgetTris - 1;
+		coarsenObj->budgetCoarsenPass = budgetPass;
+		steps++;
+		if (!stepBudgetObject(coarsenObj, false, triTermination, tradeError))
+		    parked.push_back(coarsenObj);
+		continue;
+	    }
+	}
 
-					roomToRefine = (refineTop->cut->refineTris == MAXINT) ? 0 :
-						(TrisAfterRefine < triBudget);
-				}
-			}
-#endif    
-		} // end of coarsening
-	
-//	if (!queuesBalanced&&!roomToRefine&&!overBudget){
-//	  roomToRefine=1;
-//
-//	}
-	
+	// the worst object can't be refined; a few of the next worst may
+	// still fit what is left of the budget
+	if (fillTries-- <= 0)
+	    break;
+	refineQueue->extractMin();
+	parked.push_back(refineObj);
     }
- 
-    budgetChanged = 0;
 
-#if 0
-    fprintf(stderr, "adaptTriangleBudget(): ");
-    fprintf(stderr, "budget: %d, tris: %d\n",
-    triBudget, currentNumTris);
-#endif
-    
-    return;
+    for (unsigned int i=0; i<parked.size(); i++)
+	insertBudgetObject(parked[i]);
 } /* End of GLOD_Group::adaptTriangleBudget() **/
 
 #else
@@ -2035,6 +1979,87 @@ else
 } /* End of GLOD_Group::adaptTriangleBudget() **/
 #endif
 #endif
+/*****************************************************************************\
+ @ GLOD_Group::rasterizeOccluders
+ -----------------------------------------------------------------------------
+ description : Draws the current cuts of the group's occluder objects into
+               the occlusion buffer and rebuilds its depth pyramid.
+ input       : 
+ output      : 
+ notes       : The cuts are last frame's, seen through this frame's view.
+               Occluders should therefore be solid, closed objects; holes
+               that open up during adaptation only make the test less
+               conservative by one frame.
+\*****************************************************************************/
+void
+GLOD_Group::rasterizeOccluders()
+{
+#ifdef TIMING_LEVEL_1
+  VDS::ScopedTimer OcclusionTimer(occlusionTicks);
+#endif
+
+  occlusionBuffer->Clear();
+  for (int i=0; i<numObjects; i++)
+    {
+      GLOD_Object *obj = objects[i];
+      if (!obj->occluder || (obj->cut == NULL))
+	continue;
+      if (obj->format == GLOD_CONTINUOUS)
+	{
+	  occlusionBuffer->RasterizeCut(((VDSCut*)obj->cut)->mpCut);
+	  continue;
+	}
+
+      // discrete levels are filled a patch at a time, positions only,
+      // into the group's scratch arrays
+      for (int p=0; p<obj->hierarchy->GetPatchCount(); p++)
+	{
+	  GLuint nindices, nverts;
+	  obj->cut->getReadbackSizes(p, &nindices, &nverts);
+	  if (nindices == 0)
+	    continue;
+	  if (occluderIndices.size() < nindices)
+	    occluderIndices.resize(nindices);
+	  if (occluderVertices.size() < 3 * nverts)
+	    occluderVertices.resize(3 * nverts);
+
+	  if (s_pCurrentContext->fillScratch == NULL)
+	    s_pCurrentContext->fillScratch = new GLOD_FillScratch;
+	  GLOD_FillTarget target;
+	  target.vertices = (char*) &occluderVertices[0];
+	  target.vertex_stride = 3 * sizeof(GLfloat);
+	  target.normals = target.texture_coords = target.colors = NULL;
+	  target.normal_stride = target.texture_coord_stride = target.color_stride = 0;
+	  target.color_type = GL_FLOAT;
+	  target.indices = &occluderIndices[0];
+	  target.index_type = GL_UNSIGNED_INT;
+	  target.index_base = 0;
+	  target.scratch = s_pCurrentContext->fillScratch;
+	  target.num_vertices = target.num_indices = 0;
+
+	  if (!obj->cut->fill(p, &target))
+	    {
+	      // no fill() for this cut; read it back into the same arrays
+	      GLOD_RawPatch raw;
+	      raw.data_flags = 0;
+	      raw.borrowed = GLOD_BORROWED_TRIANGLES | GLOD_BORROWED_VERTICES;
+	      raw.num_triangles = nindices / 3;
+	      raw.num_vertices = nverts;
+	      raw.triangles = (GLint*) &occluderIndices[0];
+	      raw.vertices = &occluderVertices[0];
+	      obj->cut->readback(p, &raw);
+	      target.num_indices = nindices;
+	    }
+	  occlusionBuffer->RasterizeTriangles(obj->cut->view.matrix,
+					      (const VDS::Point3*) &occluderVertices[0], 3 * sizeof(GLfloat),
+					      (const VDS::ProxyIndex*) &occluderIndices[0],
+					      target.num_indices / 3);
+	}
+    }
+  occlusionBuffer->BuildPyramid();
+  occluderTris += occlusionBuffer->mNumOccluderTris;
+} /* End of GLOD_Group::rasterizeOccluders() **/
+
 /*****************************************************************************\
  @ GLOD_Group::adapt
  -----------------------------------------------------------------------------
@@ -2046,6 +2071,11 @@ else
 void
 GLOD_Group::adapt()
 {
+#ifdef TIMING_LEVEL_1
+  VDS::ScopedTimer AdaptTimer(adaptTicks);
+#endif
+  adaptCount++;
+
   if (mpSimplifier != NULL)
     {
       switch (errorMode)
@@ -2070,6 +2100,19 @@ GLOD_Group::adapt()
 		GLOD_Object *obj = objects[i];
 		obj->cut->updateStats();
     }
+    if (occlusionBuffer != NULL)
+    {
+      rasterizeOccluders();
+
+      // the VDS nodes' errors, and so the VDS budget queue keys, depend on
+      // what is occluded; bring them up to date with the new occluders
+      if ((adaptMode == TriangleBudget) && (budgetVDSObject != NULL))
+      {
+	mpSimplifier->UpdateNodeErrors();
+	budgetVDSObject->cut->updateStats();
+	objectChanged(budgetVDSObject);
+      }
+    }
     switch(adaptMode)
     {
       case TriangleBudget:
@@ -2079,6 +2122,10 @@ GLOD_Group::adapt()
 	adaptErrorThreshold();
 	break;
     }
+    adaptInstances();
+
+    // keep all groups' VDS render data within the global memory budget
+    s_VDSMemoryManager.EnforceBudget();
     return;
 } /* End of GLOD_Group::adapt() **/
 
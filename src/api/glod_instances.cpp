@@ -0,0 +1,1024 @@
+/* GLOD: Compact instances
+ ***************************************************************************/
+/******************************************************************************
+ * Copyright 2003 Jonathan Cohen, Nat Duca, David Luebke, Brenden Schubert    *
+ *                Johns Hopkins University and University of Virginia         *
+ ******************************************************************************
+ * This file is distributed as part of the GLOD library, and as such, falls   *
+ * under the terms of the GLOD public license. GLOD is distributed without    *
+ * any warranty, implied or otherwise. See the GLOD license for more details. *
+ *                                                                            *
+ * You should have recieved a copy of the GLOD Open-Source License with this  *
+ * copy of GLOD; if not, please visit the GLOD web page,                      *
+ * http://www.cs.jhu.edu/~graphics/GLOD/license for more information          *
+ ******************************************************************************/
+
+/*----------------------------- Local Includes -----------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if defined(_WIN32) || defined(__APPLE__)
+#include <float.h>
+#else
+#include <values.h>
+#endif
+
+#include "xbs.h"
+#include "glod_core.h"
+#include "hash.h"
+#include "Discrete.h"
+#include "Continuous.h"
+
+/*----------------------------- Local Constants -----------------------------*/
+
+// bisection steps taken to fit instances into a triangle budget
+#define GLOD_INSTANCE_BUDGET_STEPS 16
+
+/*---------------------------------Functions-------------------------------- */
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::canInstance
+ -----------------------------------------------------------------------------
+ description : whether source can have compact instances
+ input       : 
+ output      : 
+ notes       : Discrete patch hierarchies pick a level per patch, which
+               tiers can't share, so they are always instanced in full.
+\*****************************************************************************/
+bool
+GLOD_InstanceSet::canInstance(GLOD_Object *source)
+{
+    if (source->hierarchy == NULL)
+        return false;
+    OutputType type = source->hierarchy->getHierarchyType();
+    return (type == Discrete_Hierarchy) || (type == VDS_Hierarchy);
+} /* End of GLOD_InstanceSet::canInstance() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::GLOD_InstanceSet
+ -----------------------------------------------------------------------------
+ description : makes an empty set of source's instances, with its tiers
+ input       : numTiers is only used by continuous objects
+ output      : 
+ notes       : 
+\*****************************************************************************/
+GLOD_InstanceSet::GLOD_InstanceSet(GLOD_Group *group, GLOD_Object *source,
+                                   int numTiers)
+{
+    this->group = group;
+    hierarchy = source->hierarchy;
+    hierarchy->LockInstance();
+    continuous = (hierarchy->getHierarchyType() == VDS_Hierarchy);
+
+    patch_id_map = AllocHashtableBySize(PATCH_HASH_BUCKET_SIZE);
+    HASHTABLE_WALK(source->patch_id_map, node);
+    HashtableAdd(patch_id_map, node->key, node->data);
+    HASHTABLE_WALK_END(source->patch_id_map);
+    index_hash = AllocHashtable();
+
+    tierCuts = NULL;
+    tierErrors = NULL;
+    tierInstances = NULL;
+    tierObjects = NULL;
+    tierGroups = NULL;
+    this->numTiers = 0;
+    makeTiers(numTiers);
+
+    numTris = 0;
+    numUnmeasured = 0;
+    assignedThreshold = -1;
+    assignedMode = ObjectSpace;
+    remeasured = false;
+} /* End of GLOD_InstanceSet::GLOD_InstanceSet() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::~GLOD_InstanceSet
+ -----------------------------------------------------------------------------
+ description : frees the set, taking its instances' names out of the
+               context's namespace
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+GLOD_InstanceSet::~GLOD_InstanceSet()
+{
+    for (unsigned int i=0; i<names.size(); i++)
+        HashtableDeleteCautious(s_APIState.instance_hash, names[i]);
+    freeTiers();
+    FreeHashtableCautious(index_hash);
+    FreeHashtableCautious(patch_id_map);
+    hierarchy->ReleaseInstance();
+} /* End of GLOD_InstanceSet::~GLOD_InstanceSet() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::makeTiers
+ -----------------------------------------------------------------------------
+ description : makes the cuts the instances share
+ input       : count is the number of continuous tiers
+ output      : 
+ notes       : A discrete tier is a cut left on one level. A continuous
+               tier is a cut in a group of its own, in object space error
+               threshold mode; it is adapted when placeTiers() gives it a
+               new error. The instances are left hidden, on no tier, until
+               the next adapt() assigns them.
+\*****************************************************************************/
+void
+GLOD_InstanceSet::makeTiers(int count)
+{
+    for (unsigned int i=0; i<tiers.size(); i++)
+        tiers[i] = GLOD_INSTANCE_HIDDEN;
+    numTris = 0;
+    assignedThreshold = -1;
+
+    if (!continuous)
+    {
+        DiscreteHierarchy *discrete = (DiscreteHierarchy *) hierarchy;
+        count = discrete->numLODs;
+        if (count > GLOD_INSTANCE_HIDDEN)
+            count = GLOD_INSTANCE_HIDDEN;
+    }
+
+    numTiers = count;
+    tierCuts = new GLOD_Cut *[count];
+    tierErrors = new float[count];
+    tierInstances = new int[count];
+    tierBase = INT_MIN;
+
+    if (!continuous)
+    {
+        DiscreteHierarchy *discrete = (DiscreteHierarchy *) hierarchy;
+        for (int t=0; t<count; t++)
+        {
+            tierCuts[t] = new DiscreteCut(discrete, t);
+            tierErrors[t] = discrete->errors[t];
+            tierInstances[t] = 0;
+        }
+        for (int i=0; i<3; i++)
+        {
+            boxCenter[i] = discrete->LODs[0]->errorCenter.data[i];
+            boxOffsets[i] = discrete->LODs[0]->errorOffsets.data[i];
+        }
+        return;
+    }
+
+    tierObjects = new GLOD_Object *[count];
+    tierGroups = new GLOD_Group *[count];
+    for (int t=0; t<count; t++)
+    {
+        GLOD_Group *tierGroup = new GLOD_Group();
+        tierGroup->setViewFrustumSimp(false); // the cut has no view
+        tierGroup->setErrorMode(ObjectSpace);
+        // a tier is only adapted when its error changes, so all the way
+        tierGroup->mpSimplifier->mSimplificationBreakCount = 0;
+
+        GLOD_Object *obj = new GLOD_Object();
+        obj->format = GLOD_CONTINUOUS;
+        obj->hierarchy = hierarchy;
+        hierarchy->LockInstance();
+        obj->cut = hierarchy->makeCut();
+        tierGroup->addObject(obj);
+
+        tierGroups[t] = tierGroup;
+        tierObjects[t] = obj;
+        tierCuts[t] = obj->cut;
+        tierErrors[t] = 0;
+        tierInstances[t] = 0;
+    }
+
+    float minx, maxx, miny, maxy, minz, maxz;
+    ((VDSHierarchy *) hierarchy)->mpForest->GetBoundingBox(minx, maxx, miny, maxy,
+                                                          minz, maxz);
+    boxCenter[0] = (minx+maxx)*0.5f;
+    boxCenter[1] = (miny+maxy)*0.5f;
+    boxCenter[2] = (minz+maxz)*0.5f;
+    boxOffsets[0] = (maxx-minx)*0.5f;
+    boxOffsets[1] = (maxy-miny)*0.5f;
+    boxOffsets[2] = (maxz-minz)*0.5f;
+} /* End of GLOD_InstanceSet::makeTiers() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::freeTiers
+ -----------------------------------------------------------------------------
+ description : 
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_InstanceSet::freeTiers()
+{
+    for (int t=0; t<numTiers; t++)
+    {
+        if (continuous)
+        {
+            delete tierObjects[t]; // leaves its group, and frees the cut
+            delete tierGroups[t];
+        }
+        else
+            delete tierCuts[t];
+    }
+    delete [] tierCuts;
+    delete [] tierErrors;
+    delete [] tierInstances;
+    if (tierObjects != NULL)
+        delete [] tierObjects;
+    if (tierGroups != NULL)
+        delete [] tierGroups;
+    tierCuts = NULL;
+    tierErrors = NULL;
+    tierInstances = NULL;
+    tierObjects = NULL;
+    tierGroups = NULL;
+    numTiers = 0;
+} /* End of GLOD_InstanceSet::freeTiers() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::placeTiers
+ -----------------------------------------------------------------------------
+ description : moves the continuous tiers so that the finest is at most
+               finest, and adapts those whose error changed
+ input       : finest is the smallest error an instance on screen needs;
+               StepTiers moves them one octave at most
+ output      : true if any tier was adapted
+ notes       : The tiers sit on powers of two, so they only move when the
+               closest instance crosses into another octave, and a tier
+               whose error is still wanted keeps its cut; moving one octave
+               adapts only one cut. Stepping only moves coarser once the
+               two finest tiers are unused, so the tiers don't go back and
+               forth, and doesn't move past the ends of the hierarchy,
+               where neighbouring tiers have the same triangles.
+\*****************************************************************************/
+bool
+GLOD_InstanceSet::placeTiers(float finest, TierMotion motion)
+{
+    if (!continuous || (motion == HoldTiers))
+        return false;
+
+    int base;
+    if (!(finest > FLT_MIN))
+        finest = FLT_MIN;
+    if (finest > FLT_MAX)
+        finest = FLT_MAX;
+    frexp(finest, &base);
+    base--; // 2^base <= finest
+    if ((motion == StepTiers) && (tierBase != INT_MIN))
+    {
+        int last = numTiers-1;
+        if ((base < tierBase) && (numTiers > 1) &&
+            (tierCuts[0]->currentNumTris != tierCuts[1]->currentNumTris))
+            base = tierBase - 1;
+        else if ((base > tierBase + 1) && (numTiers > 1) &&
+                 (tierCuts[last]->currentNumTris != tierCuts[last-1]->currentNumTris))
+            base = tierBase + 1;
+        else
+            base = tierBase;
+    }
+    if (base == tierBase)
+        return false;
+
+    // hand each cut to the tier that wants its error, if any
+    GLOD_Object **objects = new GLOD_Object *[numTiers];
+    GLOD_Group **groups = new GLOD_Group *[numTiers];
+    bool *adapted = new bool[numTiers];
+    bool *taken = new bool[numTiers];
+    for (int t=0; t<numTiers; t++)
+    {
+        objects[t] = NULL;
+        taken[t] = false;
+    }
+    if (tierBase != INT_MIN)
+    {
+        for (int t=0; t<numTiers; t++)
+        {
+            int old = t + base - tierBase;
+            if ((old >= 0) && (old < numTiers))
+            {
+                objects[t] = tierObjects[old];
+                groups[t] = tierGroups[old];
+                adapted[t] = false;
+                taken[old] = true;
+            }
+        }
+    }
+    int spare = 0;
+    for (int t=0; t<numTiers; t++)
+    {
+        if (objects[t] != NULL)
+            continue;
+        while (taken[spare])
+            spare++;
+        objects[t] = tierObjects[spare];
+        groups[t] = tierGroups[spare];
+        adapted[t] = true;
+        taken[spare] = true;
+    }
+
+    tierBase = base;
+    for (int t=0; t<numTiers; t++)
+    {
+        tierObjects[t] = objects[t];
+        tierGroups[t] = groups[t];
+        tierCuts[t] = objects[t]->cut;
+        tierErrors[t] = (float) ldexp(1.0, base + t);
+        if (adapted[t])
+        {
+            tierGroups[t]->setObjectSpaceErrorThreshold(tierErrors[t]);
+            tierGroups[t]->adapt();
+        }
+    }
+
+    delete [] objects;
+    delete [] groups;
+    delete [] adapted;
+    delete [] taken;
+    return true;
+} /* End of GLOD_InstanceSet::placeTiers() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::guessTiers
+ -----------------------------------------------------------------------------
+ description : makes sure the continuous tiers are in place, guessing where
+               if they have never been placed
+ input       : tierCount is the number of tiers wanted
+ output      : 
+ notes       : A triangle budget is fitted with the triangles of the tiers
+               as they are, so they must be somewhere first. The coarsest
+               goes at the size of the object's bounding box, an error at
+               which any cut will do.
+\*****************************************************************************/
+void
+GLOD_InstanceSet::guessTiers(int tierCount)
+{
+    if (!continuous)
+        return;
+    if (tierCount != numTiers)
+    {
+        freeTiers();
+        makeTiers(tierCount);
+    }
+    if (tierBase != INT_MIN)
+        return;
+
+    float diagonal = 2.0f * sqrtf(boxOffsets[0]*boxOffsets[0] +
+                                  boxOffsets[1]*boxOffsets[1] +
+                                  boxOffsets[2]*boxOffsets[2]);
+    placeTiers((float) ldexp(diagonal, 1-numTiers), JumpTiers);
+} /* End of GLOD_InstanceSet::guessTiers() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::add
+ -----------------------------------------------------------------------------
+ description : adds an instance, with the transform a new object has
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_InstanceSet::add(GLuint name, float importance)
+{
+    GLOD_View view;
+    names.push_back(name);
+    xforms.insert(xforms.end(), &view.matrix.cells[0][0], &view.matrix.cells[0][0] + 16);
+    this->importance.push_back(importance);
+    scales.push_back(-1);
+    tiers.push_back(GLOD_INSTANCE_HIDDEN);
+    numUnmeasured++;
+
+    HashtableAdd(index_hash, name, (void *) (ptrdiff_t) names.size());
+    HashtableAdd(s_APIState.instance_hash, name, this);
+} /* End of GLOD_InstanceSet::add() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::remove
+ -----------------------------------------------------------------------------
+ description : removes an instance; the last one takes its place
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_InstanceSet::remove(int index)
+{
+    HashtableDeleteCautious(index_hash, names[index]);
+    HashtableDeleteCautious(s_APIState.instance_hash, names[index]);
+    if (tiers[index] != GLOD_INSTANCE_HIDDEN)
+    {
+        tierInstances[tiers[index]]--;
+        numTris -= tierCuts[tiers[index]]->currentNumTris;
+    }
+    if (scales[index] < 0)
+        numUnmeasured--;
+
+    int last = (int) names.size() - 1;
+    if (index != last)
+    {
+        names[index] = names[last];
+        memcpy(&xforms[16*index], &xforms[16*last], 16*sizeof(float));
+        importance[index] = importance[last];
+        scales[index] = scales[last];
+        tiers[index] = tiers[last];
+        HashtableReplace(index_hash, names[index], (void *) (ptrdiff_t) (index+1), 0);
+    }
+    names.pop_back();
+    xforms.resize(16*last);
+    importance.pop_back();
+    scales.pop_back();
+    tiers.pop_back();
+} /* End of GLOD_InstanceSet::remove() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::setXform
+ -----------------------------------------------------------------------------
+ description : sets an instance's transform, as glodObjectXform() does
+ input       : m2 and m3 may be NULL
+ output      : 
+ notes       : An instance that didn't move isn't measured again.
+\*****************************************************************************/
+void
+GLOD_InstanceSet::setXform(int index, float m1[16], float m2[16], float m3[16])
+{
+    Mat4 M(m1);
+    if (m2 != NULL)
+        M = M * Mat4(m2);
+    if (m3 != NULL)
+        M = M * Mat4(m3);
+
+    setMatrix(index, &M.cells[0][0]);
+} /* End of GLOD_InstanceSet::setXform() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::setMatrix
+ -----------------------------------------------------------------------------
+ description : sets an instance's transform from a finished product
+ input       : rows is laid out as Mat4::cells
+ output      : 
+ notes       : An instance that didn't move isn't measured again.
+\*****************************************************************************/
+void
+GLOD_InstanceSet::setMatrix(int index, const float rows[16])
+{
+    float *xform = &xforms[16*index];
+    if (memcmp(xform, rows, 16*sizeof(float)) == 0)
+        return;
+    memcpy(xform, rows, 16*sizeof(float));
+    if (scales[index] >= 0)
+    {
+        scales[index] = -1;
+        numUnmeasured++;
+    }
+} /* End of GLOD_InstanceSet::setMatrix() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::setImportance
+ -----------------------------------------------------------------------------
+ description : 
+ input       : 
+ output      : 
+ notes       : the instance is measured again so its tier is picked again
+\*****************************************************************************/
+void
+GLOD_InstanceSet::setImportance(int index, float value)
+{
+    if (importance[index] == value)
+        return;
+    importance[index] = value;
+    if (scales[index] >= 0)
+    {
+        scales[index] = -1;
+        numUnmeasured++;
+    }
+} /* End of GLOD_InstanceSet::setImportance() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::currentError
+ -----------------------------------------------------------------------------
+ description : an instance's error on its tier, as of the last adapt
+ input       : 
+ output      : 0 if it is hidden
+ notes       : 
+\*****************************************************************************/
+float
+GLOD_InstanceSet::currentError(int index, ErrorMode mode)
+{
+    int tier = tiers[index];
+    if (tier == GLOD_INSTANCE_HIDDEN)
+        return 0;
+    if (mode == ObjectSpace)
+        return tierErrors[tier];
+    return (scales[index] > 0) ? tierErrors[tier] * scales[index] : 0;
+} /* End of GLOD_InstanceSet::currentError() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::measureScale
+ -----------------------------------------------------------------------------
+ description : the screen space error of a unit of object space error spread
+               over the object's bounding box, under an instance's transform
+ input       : 
+ output      : 0 if the box is off screen
+ notes       : Instances are taken to be small enough on screen that this
+               holds for every part of them.
+\*****************************************************************************/
+float
+GLOD_InstanceSet::measureScale(int index)
+{
+    GLOD_View view;
+    memcpy(view.matrix.cells, &xforms[16*index], 16*sizeof(float));
+    xbsVec3 center(boxCenter[0], boxCenter[1], boxCenter[2]);
+    xbsVec3 offsets(boxOffsets[0], boxOffsets[1], boxOffsets[2]);
+    return view.computePixelsOfError(center, offsets, 1.0f);
+} /* End of GLOD_InstanceSet::measureScale() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::measure
+ -----------------------------------------------------------------------------
+ description : works out the scale of every instance that has moved
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_InstanceSet::measure()
+{
+    if (numUnmeasured == 0)
+        return;
+
+    int n = (int) names.size();
+    for (int i=0; i<n; i++)
+        if (scales[i] < 0)
+            scales[i] = measureScale(i);
+    numUnmeasured = 0;
+    remeasured = true;
+} /* End of GLOD_InstanceSet::measure() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::requiredError
+ -----------------------------------------------------------------------------
+ description : the object space error an instance can have under threshold
+ input       : 
+ output      : MAXFLOAT if any error will do
+ notes       : importance scales the error the instance is held to
+\*****************************************************************************/
+float
+GLOD_InstanceSet::requiredError(int index, ErrorMode mode, float threshold)
+{
+    float weight = importance[index];
+    if (mode == ScreenSpace)
+        weight *= scales[index];
+    return (weight > 0) ? threshold / weight : MAXFLOAT;
+} /* End of GLOD_InstanceSet::requiredError() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::pickTier
+ -----------------------------------------------------------------------------
+ description : the coarsest tier whose error is within required
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+int
+GLOD_InstanceSet::pickTier(float required)
+{
+    int tier = 0;
+    while ((tier+1 < numTiers) && (tierErrors[tier+1] <= required))
+        tier++;
+    return tier;
+} /* End of GLOD_InstanceSet::pickTier() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::trisAt
+ -----------------------------------------------------------------------------
+ description : the triangles the instances on screen would have under
+               threshold, with the tiers as they are
+ input       : 
+ output      : 
+ notes       : call measure() first
+\*****************************************************************************/
+int
+GLOD_InstanceSet::trisAt(ErrorMode mode, float threshold)
+{
+    int tris = 0;
+    int n = (int) names.size();
+    for (int i=0; i<n; i++)
+        if (scales[i] > 0)
+            tris += tierCuts[pickTier(requiredError(i, mode, threshold))]->currentNumTris;
+    return tris;
+} /* End of GLOD_InstanceSet::trisAt() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::maxThreshold
+ -----------------------------------------------------------------------------
+ description : the threshold at which every instance on screen is on the
+               coarsest tier
+ input       : 
+ output      : 
+ notes       : call measure() first
+\*****************************************************************************/
+float
+GLOD_InstanceSet::maxThreshold(ErrorMode mode)
+{
+    float maxWeight = 0;
+    int n = (int) names.size();
+    for (int i=0; i<n; i++)
+    {
+        if (scales[i] <= 0)
+            continue;
+        float weight = importance[i];
+        if (mode == ScreenSpace)
+            weight *= scales[i];
+        if (weight > maxWeight)
+            maxWeight = weight;
+    }
+    return maxWeight * tierErrors[numTiers-1];
+} /* End of GLOD_InstanceSet::maxThreshold() **/
+
+/*****************************************************************************\
+ @ GLOD_InstanceSet::adapt
+ -----------------------------------------------------------------------------
+ description : puts every instance on the coarsest tier within threshold
+ input       : tierCount is the number of continuous tiers wanted;
+               motion is how far they may move to fit the closest instance
+ output      : true if the tiers themselves changed
+ notes       : When neither the threshold nor the tiers changed, only the
+               instances that moved since the last adapt are looked at.
+\*****************************************************************************/
+bool
+GLOD_InstanceSet::adapt(ErrorMode mode, float threshold, int tierCount,
+                        TierMotion motion)
+{
+    HashtableReclaim(index_hash); // adapting is a safe point; see hash.h
+
+    bool changed = false;
+    if (continuous && (tierCount != numTiers))
+    {
+        freeTiers();
+        makeTiers(tierCount);
+        changed = true;
+    }
+
+    int n = (int) names.size();
+    bool all = changed || remeasured || (threshold != assignedThreshold) ||
+        (mode != assignedMode) || (tierBase == INT_MIN && continuous) ||
+        (2*numUnmeasured > n);
+
+    if (!all)
+    {
+        if (numUnmeasured == 0)
+            return false;
+
+        for (int i=0; i<n; i++)
+        {
+            if (scales[i] >= 0)
+                continue;
+            scales[i] = measureScale(i);
+
+            int tier = GLOD_INSTANCE_HIDDEN;
+            if (scales[i] > 0)
+            {
+                float required = requiredError(i, mode, threshold);
+                if (continuous && (motion != HoldTiers) &&
+                    (required < tierErrors[0]))
+                    all = true; // closer than the finest tier; move them
+                tier = pickTier(required);
+            }
+            if (tiers[i] != GLOD_INSTANCE_HIDDEN)
+            {
+                tierInstances[tiers[i]]--;
+                numTris -= tierCuts[tiers[i]]->currentNumTris;
+            }
+            if (tier != GLOD_INSTANCE_HIDDEN)
+            {
+                tierInstances[tier]++;
+                numTris += tierCuts[tier]->currentNumTris;
+            }
+            tiers[i] = (unsigned char) tier;
+        }
+        numUnmeasured = 0;
+        if (!all)
+            return false;
+    }
+
+    measure();
+
+    if (continuous && (motion != HoldTiers))
+    {
+        float finest = MAXFLOAT;
+        for (int i=0; i<n; i++)
+        {
+            if (scales[i] <= 0)
+                continue;
+            float required = requiredError(i, mode, threshold);
+            if (required < finest)
+                finest = required;
+        }
+        if (finest < MAXFLOAT)
+            changed |= placeTiers(finest, motion);
+    }
+
+    for (int t=0; t<numTiers; t++)
+        tierInstances[t] = 0;
+    for (int i=0; i<n; i++)
+    {
+        if (scales[i] > 0)
+        {
+            int tier = pickTier(requiredError(i, mode, threshold));
+            tiers[i] = (unsigned char) tier;
+            tierInstances[tier]++;
+        }
+        else
+            tiers[i] = GLOD_INSTANCE_HIDDEN;
+    }
+    numTris = 0;
+    for (int t=0; t<numTiers; t++)
+        numTris += tierInstances[t] * tierCuts[t]->currentNumTris;
+
+    assignedThreshold = threshold;
+    assignedMode = mode;
+    remeasured = false;
+    return changed;
+} /* End of GLOD_InstanceSet::adapt() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::addInstance
+ -----------------------------------------------------------------------------
+ description : makes a compact instance of source called name
+ input       : 
+ output      : 
+ notes       : Instances of the same hierarchy share a set.
+\*****************************************************************************/
+void
+GLOD_Group::addInstance(GLOD_Object *source, GLuint name)
+{
+    GLOD_InstanceSet *set = NULL;
+    for (unsigned int i=0; i<instanceSets.size(); i++)
+        if (instanceSets[i]->hierarchy == source->hierarchy)
+        {
+            set = instanceSets[i];
+            break;
+        }
+    if (set == NULL)
+    {
+        set = new GLOD_InstanceSet(this, source, instanceTiers);
+        instanceSets.push_back(set);
+    }
+    set->add(name, source->importance);
+} /* End of GLOD_Group::addInstance() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::removeInstance
+ -----------------------------------------------------------------------------
+ description : deletes one of the group's compact instances
+ input       : 
+ output      : 
+ notes       : the set goes with its last instance
+\*****************************************************************************/
+void
+GLOD_Group::removeInstance(GLOD_InstanceSet *set, int index)
+{
+    instanceTris -= set->numTris;
+    set->remove(index);
+    instanceTris += set->numTris;
+    if (set->getNumInstances() > 0)
+        return;
+
+    for (unsigned int i=0; i<instanceSets.size(); i++)
+        if (instanceSets[i] == set)
+        {
+            instanceSets.erase(instanceSets.begin() + i);
+            break;
+        }
+    delete set;
+} /* End of GLOD_Group::removeInstance() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::instanceTrisAt
+ -----------------------------------------------------------------------------
+ description : 
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+int
+GLOD_Group::instanceTrisAt(float threshold)
+{
+    int tris = 0;
+    for (unsigned int i=0; i<instanceSets.size(); i++)
+        tris += instanceSets[i]->trisAt(errorMode, threshold);
+    return tris;
+} /* End of GLOD_Group::instanceTrisAt() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::fitInstanceBudget
+ -----------------------------------------------------------------------------
+ description : finds the smallest threshold at which the compact instances
+               fit in budget triangles
+ input       : 
+ output      : 
+ notes       : Instances only get coarser as the threshold goes up, so it
+               is bisected, on a log scale as errors span many octaves.
+\*****************************************************************************/
+float
+GLOD_Group::fitInstanceBudget(int budget)
+{
+    for (unsigned int i=0; i<instanceSets.size(); i++)
+        instanceSets[i]->measure();
+
+    float high = 0;
+    for (unsigned int i=0; i<instanceSets.size(); i++)
+    {
+        float threshold = instanceSets[i]->maxThreshold(errorMode);
+        if (threshold > high)
+            high = threshold;
+    }
+    if ((high <= 0) || (instanceTrisAt(high) > budget))
+        return high; // as coarse as they get
+    if (instanceTrisAt(0) <= budget)
+        return 0;
+
+    // step down until over the budget, then close in
+    float low = high;
+    do
+    {
+        high = low;
+        low *= 1.0f/16.0f;
+    } while ((low > FLT_MIN) && (instanceTrisAt(low) <= budget));
+
+    for (int step=0; step<GLOD_INSTANCE_BUDGET_STEPS; step++)
+    {
+        float middle = sqrtf(low * high);
+        if (instanceTrisAt(middle) <= budget)
+            high = middle;
+        else
+            low = middle;
+    }
+    return high;
+} /* End of GLOD_Group::fitInstanceBudget() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::adaptInstanceBudget
+ -----------------------------------------------------------------------------
+ description : puts the compact instances on the tiers that fit budget
+ input       : 
+ output      : 
+ notes       : The fit counts the triangles of the tiers as they are.
+               Continuous tiers then take a step toward the threshold it
+               picked; if any moved, the fit is made again with them held,
+               which keeps the instances within the budget. The tiers
+               settle over a few adapts, an octave at a time.
+\*****************************************************************************/
+void
+GLOD_Group::adaptInstanceBudget(int budget)
+{
+    unsigned int i;
+    for (i=0; i<instanceSets.size(); i++)
+        instanceSets[i]->guessTiers(instanceTiers);
+
+    float threshold = fitInstanceBudget(budget);
+    bool moved = false;
+    for (i=0; i<instanceSets.size(); i++)
+        moved |= instanceSets[i]->adapt(errorMode, threshold, instanceTiers,
+                                        GLOD_InstanceSet::StepTiers);
+    if (!moved)
+        return;
+
+    threshold = fitInstanceBudget(budget);
+    for (i=0; i<instanceSets.size(); i++)
+        instanceSets[i]->adapt(errorMode, threshold, instanceTiers,
+                               GLOD_InstanceSet::HoldTiers);
+} /* End of GLOD_Group::adaptInstanceBudget() **/
+
+/*****************************************************************************\
+ @ GLOD_Group::adaptInstances
+ -----------------------------------------------------------------------------
+ description : puts the group's compact instances on their tiers
+ input       : 
+ output      : 
+ notes       : In triangle budget mode the instances get whatever the
+               group's objects leave of the budget; tiled builds only
+               support error threshold mode for them.
+\*****************************************************************************/
+void
+GLOD_Group::adaptInstances()
+{
+    if (instanceSets.empty())
+        return;
+
+#ifndef GLOD_USE_TILES
+    if (adaptMode == TriangleBudget)
+        adaptInstanceBudget(triBudget - currentNumTris);
+    else
+#endif
+    {
+        float threshold = (errorMode == ScreenSpace) ?
+            screenSpaceErrorThreshold : objectSpaceErrorThreshold;
+        for (unsigned int i=0; i<instanceSets.size(); i++)
+            instanceSets[i]->adapt(errorMode, threshold, instanceTiers,
+                                   GLOD_InstanceSet::JumpTiers);
+    }
+
+    instanceTris = 0;
+    for (unsigned int i=0; i<instanceSets.size(); i++)
+        instanceTris += instanceSets[i]->numTris;
+} /* End of GLOD_Group::adaptInstances() **/
+
+/*****************************************************************************\
+ @ GLOD_FindInstance
+ -----------------------------------------------------------------------------
+ description : looks up a compact instance by name
+ input       : 
+ output      : its set, or NULL; *index is its index in the set
+ notes       : 
+\*****************************************************************************/
+GLOD_InstanceSet *
+GLOD_FindInstance(GLuint name, int *index)
+{
+    GLOD_InstanceSet *set =
+        (GLOD_InstanceSet *) HashtableSearch(s_APIState.instance_hash, name);
+    if (set != NULL)
+        *index = set->find(name);
+    return set;
+} /* End of GLOD_FindInstance() **/
+
+/*****************************************************************************\
+ @ GLOD_GetInstanceParameteriv
+ -----------------------------------------------------------------------------
+ description : glodGetObjectParameteriv() for compact instances
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_GetInstanceParameteriv(GLOD_InstanceSet *set, int index,
+                            GLenum pname, GLint *param)
+{
+    switch (pname)
+    {
+    case GLOD_NUM_PATCHES:
+        *param = set->hierarchy->GetPatchCount();
+        break;
+    case GLOD_PATCH_NAMES:
+    {
+        HASHTABLE_WALK(set->patch_id_map, node);
+        param[(ptrdiff_t) node->data - 1] = node->key - 1;
+        HASHTABLE_WALK_END(set->patch_id_map);
+        break;
+    }
+    case GLOD_PATCH_SIZES:
+    {
+        GLOD_Cut *cut = set->getCut(index);
+        GLuint nI = 0, nV = 0;
+        HASHTABLE_WALK(set->patch_id_map, node);
+        ptrdiff_t d = (ptrdiff_t) node->data - 1;
+        if (cut != NULL)
+            cut->getReadbackSizes(d, &nI, &nV);
+        param[2*d] = nI;
+        param[2*d+1] = nV;
+        HASHTABLE_WALK_END(set->patch_id_map);
+        break;
+    }
+    case GLOD_OCCLUDER:
+        *param = GL_FALSE;
+        break;
+    case GLOD_BUILD_STATUS:
+        *param = GLOD_BUILD_COMPLETE;
+        break;
+    default:
+        GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Not supported by compact instances", pname);
+        break;
+    }
+} /* End of GLOD_GetInstanceParameteriv() **/
+
+/*****************************************************************************\
+ @ GLOD_GetInstanceParameterfv
+ -----------------------------------------------------------------------------
+ description : glodGetObjectParameterfv() for compact instances
+ input       : 
+ output      : 
+ notes       : 
+\*****************************************************************************/
+void
+GLOD_GetInstanceParameterfv(GLOD_InstanceSet *set, int index,
+                            GLenum pname, GLfloat *param)
+{
+    switch (pname)
+    {
+    case GLOD_XFORM_MATRIX:
+        memcpy(param, &set->xforms[16*index], 16*sizeof(float));
+        break;
+    case GLOD_IMPORTANCE:
+        *param = set->importance[index];
+        break;
+    case GLOD_BUILD_PROGRESS:
+        *param = 1.0f;
+        break;
+    case GLOD_CURRENT_OBJECT_SPACE_ERROR:
+        *param = set->currentError(index, ObjectSpace);
+        break;
+    case GLOD_CURRENT_SCREEN_SPACE_ERROR:
+        *param = set->currentError(index, ScreenSpace);
+        break;
+    default:
+        GLOD_SetError(GLOD_UNSUPPORTED_PROPERTY, "Not supported by compact instances", pname);
+        break;
+    }
+} /* End of GLOD_GetInstanceParameterfv() **/
@@ -18,6 +18,7 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #if !defined(_WIN32) && !defined(__APPLE__)
@@ -36,6 +37,12 @@
 #include "Discrete.h"
 #include "DiscretePatch.h"
 #include "Continuous.h"
+#include "threads.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define GLOD_XFORM_SSE
+#include <xmmintrin.h>
+#endif
 //
 //
 //     API ENTRIES
@@ -46,7 +53,7 @@
 void glodNewObject(GLuint name, GLuint groupname, GLenum format) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     
-    if(obj != NULL) {
+    if(obj != NULL || HashtableSearch(s_APIState.instance_hash, name) != NULL) {
         GLOD_SetError(GLOD_INVALID_NAME, "Name already in use:", name);
         return;
     }
@@ -88,7 +95,8 @@ void glodInstanceObject(GLuint name, GLuint instancename, GLuint groupname)
         GLOD_SetError(GLOD_INVALID_NAME, "Source object doesn't exist:", name);
         return;
     }
-    if( HashtableSearch(s_APIState.object_hash, instancename) != NULL) {
+    if( HashtableSearch(s_APIState.object_hash, instancename) != NULL ||
+        HashtableSearch(s_APIState.instance_hash, instancename) != NULL) {
         GLOD_SetError(GLOD_INVALID_NAME, "An object already exists named ",  name);
         return;
     } 
@@ -97,6 +105,18 @@ void glodInstanceObject(GLuint name, GLuint instancename, GLuint groupname)
         return;
     }
     
+    GLOD_Group* group = (GLOD_Group*) HashtableSearch(s_APIState.group_hash, groupname);
+    if(group == NULL) {
+        group = new GLOD_Group();
+        HashtableAdd(s_APIState.group_hash, groupname, group);
+    }
+    
+    // a compact instance is only a record in the group's instance set
+    if(group->compactInstances && GLOD_InstanceSet::canInstance(obj)) {
+        group->addInstance(obj, instancename);
+        return;
+    }
+    
     // make the object
     dst = new GLOD_Object(*obj);
     
@@ -107,6 +127,9 @@ void glodInstanceObject(GLuint name, GLuint instancename, GLuint groupname)
     dst->hierarchy->LockInstance();
     dst->budgetCoarsenHeapData=HeapElement(dst);
     dst->budgetRefineHeapData=HeapElement(dst);
+    dst->budgetDirty = 0;
+    dst->budgetTris = 0;
+    dst->budgetRefinePass = dst->budgetCoarsenPass = 0;
     dst->inArea=new int[GLOD_NUM_TILES];
     
     HashtableAdd(s_APIState.object_hash, instancename, dst);
@@ -123,35 +146,22 @@ void glodInstanceObject(GLuint name, GLuint instancename, GLuint groupname)
     //fprintf(stderr, "After dst->cut = obj->hierarchy->makeCut(),\nGLOD_Object(dst)=%x -> cut: %x -> mpCut: %x\n GLOD_Object(obj)=%x -> cut: %x -> mpCut: %x\n", dst, dst->cut, dst->cut->mpCut, obj, obj->cut, obj->cut->mpCut);
     
     // add it to the group...  
-    GLOD_Group* group = (GLOD_Group*) HashtableSearch(s_APIState.group_hash, groupname);
-    if(group == NULL) {
-        group = new GLOD_Group();
-        HashtableAdd(s_APIState.group_hash, groupname, group);
-    }
     group->addObject(dst);
     
     
 } /* End of glodInstanceObject() */
 
 
-void glodBuildObject (GLuint name) { 
-    
-    GLOD_Object* obj; GLOD_Group* group;
-    
-    obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
-    if(obj == NULL ) {
-        GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist: ", name);
-        return;
-    }
+/* BuildHierarchy: runs an object's inserted geometry through XBS (or the
+ * manual discrete loader) and returns the hierarchy, deleting raw. It only
+ * reads obj, so it can run on a build thread while the object waits.
+ */
+static Hierarchy* BuildHierarchy(GLOD_Object* obj, GLOD_RawObject* raw,
+                                 volatile float* progress) {
+    Hierarchy* hierarchy = NULL;
     Model *model=NULL;
     // Build the object
     if(obj->format == GLOD_DISCRETE || obj->format == GLOD_CONTINUOUS || obj->format == GLOD_DISCRETE_PATCH) {
-        // check our state
-        if(obj->prebuild_buffer == NULL) {
-            GLOD_SetError(GLOD_INVALID_STATE, "Object has already been built:", name);
-            return;
-        }
-        
         // run it through XBS
         
         XBSSimplifier *simp;
@@ -160,8 +170,8 @@ void glodBuildObject (GLuint name) {
         printf("Sharing...\n"); fflush(stdout);
 #endif
         
-        model = new Model((GLOD_RawObject*)obj->prebuild_buffer);
-        delete ((GLOD_RawObject*) obj->prebuild_buffer);
+        model = new Model(raw);
+        delete raw;
         
         model->share(obj->shareTolerance);
         model->indexVertTris();
@@ -189,17 +199,17 @@ void glodBuildObject (GLuint name) {
         
         switch(obj->format) {
         case GLOD_DISCRETE:
-            obj->hierarchy = new DiscreteHierarchy(obj->opType);
+            hierarchy = new DiscreteHierarchy(obj->opType);
             break;
         case GLOD_VDS:
-            obj->hierarchy = new VDSHierarchy();
+            hierarchy = new VDSHierarchy();
             break;
         case GLOD_DISCRETE_PATCH:
-            obj->hierarchy = new DiscretePatchHierarchy(obj->opType);
+            hierarchy = new DiscretePatchHierarchy(obj->opType);
             break;
         }
         simp = new XBSSimplifier(model, obj->opType, obj->queueMode, 
-            obj->hierarchy);
+            hierarchy, 0, progress);
         delete simp;
         simp = NULL;
         delete model;
@@ -209,10 +219,9 @@ void glodBuildObject (GLuint name) {
 #endif
         
     } else if(obj->format == GLOD_DISCRETE_MANUAL) {
-        obj->hierarchy = new DiscreteHierarchy(Edge_Collapse);
-        ((DiscreteHierarchy*)obj->hierarchy)->initialize((GLOD_RawObject*)obj->prebuild_buffer);
-        delete ((GLOD_RawObject*) obj->prebuild_buffer);
-        obj->format = GLOD_DISCRETE; // note that from here on, we pretend that we're discrete in all respects... so we change our format.
+        hierarchy = new DiscreteHierarchy(Edge_Collapse);
+        ((DiscreteHierarchy*)hierarchy)->initialize(raw);
+        delete raw;
         
     } else {
         printf("Model is NULL. invalid hierarchy type?\n");
@@ -220,7 +229,21 @@ void glodBuildObject (GLuint name) {
         exit(0);
     }
 
-    obj->prebuild_buffer = NULL; // each of the above branches must free this themselves.
+    if(progress != NULL)
+        *progress = 1.0;
+    return hierarchy;
+}
+
+/* AttachObject: gives a built object its hierarchy and cut, and adds it to
+ * its group. This may touch GL, so it only runs on the API thread.
+ */
+static void AttachObject(GLOD_Object* obj, Hierarchy* hierarchy) {
+    GLOD_Group* group;
+    
+    if(obj->format == GLOD_DISCRETE_MANUAL)
+        obj->format = GLOD_DISCRETE; // note that from here on, we pretend that we're discrete in all respects... so we change our format.
+    
+    obj->hierarchy = hierarchy;
     
     // put a reference on this hierarchy for later gc
     obj->hierarchy->LockInstance();
@@ -235,19 +258,323 @@ void glodBuildObject (GLuint name) {
         HashtableAdd(s_APIState.group_hash, obj->group_name, group);
     }
     group->addObject(obj);
+}
+
+
+void glodBuildObject (GLuint name) { 
+    
+    GLOD_Object* obj;
+    
+    obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL ) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist: ", name);
+        return;
+    }
+    
+    // check our state
+    if(obj->buildJob != NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object is already being built:", name);
+        return;
+    }
+    if(obj->prebuild_buffer == NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object has already been built:", name);
+        return;
+    }
+    
+    GLOD_RawObject* raw = (GLOD_RawObject*) obj->prebuild_buffer;
+    obj->prebuild_buffer = NULL; // BuildHierarchy frees this
+    
+    AttachObject(obj, BuildHierarchy(obj, raw, NULL));
 } /* End of glodBuildObject() **/
 
 
+/***************************************************************************
+ * ASYNCHRONOUS BUILDS
+ *
+ * glodBuildObjectAsync hands an object's geometry to a pool of build
+ * threads owned by the current context. Each build thread has a private
+ * context, so errors raised while building don't touch the application's
+ * state; they are raised again when the object is attached. Attaching
+ * makes the cut, which may touch GL, so it is only done on the API thread
+ * at safe points: glodTestBuild, glodFinishBuild and glodAdaptGroup.
+ ***************************************************************************/
+
+struct GLOD_BuildPool {
+    ThreadLock lock;
+    ThreadSignal queued;   // a job was queued, or the pool is closing
+    ThreadSignal finished; // a job finished
+    GLOD_BuildJob *queueHead, *queueTail;
+    int numQueued;
+    int numIdle;           // threads waiting for a job
+    bool closing;
+
+    ThreadHandle *threads;
+    int numThreads, maxThreads;
+
+    GLOD_BuildJob *pending; // API thread only
+};
+
+static void BuildThreadMain(void* pParams) {
+    GLOD_BuildPool* pool = (GLOD_BuildPool*) pParams;
+    GLODcontext* context = glodCreateContext();
+    glodMakeCurrent(context);
+    
+    pool->lock.Lock();
+    for(;;) {
+        pool->numIdle++;
+        while((pool->queueHead == NULL) && !pool->closing)
+            pool->queued.Wait(pool->lock);
+        pool->numIdle--;
+        
+        GLOD_BuildJob* job = pool->queueHead;
+        if(job == NULL)
+            break; // closing
+        pool->queueHead = job->nextQueued;
+        if(pool->queueHead == NULL)
+            pool->queueTail = NULL;
+        pool->numQueued--;
+        job->state = GLOD_BuildRunning;
+        pool->lock.Unlock();
+        
+        Hierarchy* hierarchy = BuildHierarchy(job->obj, job->raw, &job->progress);
+        int error = glodGetError();
+        
+        pool->lock.Lock();
+        job->raw = NULL;
+        job->hierarchy = hierarchy;
+        job->error = error;
+        job->state = GLOD_BuildFinished;
+        pool->finished.Broadcast();
+    }
+    pool->lock.Unlock();
+    
+    glodDestroyContext(context);
+}
+
+static GLOD_BuildPool* GetBuildPool() {
+    GLOD_BuildPool* pool = s_pCurrentContext->buildPool;
+    if(pool == NULL) {
+        pool = new GLOD_BuildPool;
+        pool->queueHead = pool->queueTail = NULL;
+        pool->numQueued = pool->numIdle = 0;
+        pool->closing = false;
+        // leave a processor for the application's own thread
+        pool->maxThreads = GetNumSystemProcessors() - 1;
+        if(pool->maxThreads < 1)
+            pool->maxThreads = 1;
+        pool->threads = new ThreadHandle[pool->maxThreads];
+        pool->numThreads = 0;
+        pool->pending = NULL;
+        s_pCurrentContext->buildPool = pool;
+    }
+    return pool;
+}
+
+static bool BuildFinished(GLOD_BuildPool* pool, GLOD_BuildJob* job) {
+    pool->lock.Lock();
+    bool finished = (job->state == GLOD_BuildFinished);
+    pool->lock.Unlock();
+    return finished;
+}
+
+static void WaitForBuild(GLOD_BuildPool* pool, GLOD_BuildJob* job) {
+    pool->lock.Lock();
+    while(job->state != GLOD_BuildFinished)
+        pool->finished.Wait(pool->lock);
+    pool->lock.Unlock();
+}
+
+static void RemovePendingBuild(GLOD_BuildPool* pool, GLOD_BuildJob* job) {
+    GLOD_BuildJob** link = &pool->pending;
+    while(*link != job)
+        link = &(*link)->nextPending;
+    *link = job->nextPending;
+    job->obj->buildJob = NULL;
+}
+
+/* AttachBuild: attaches a finished job's object and frees the job */
+static void AttachBuild(GLOD_BuildPool* pool, GLOD_BuildJob* job) {
+    GLOD_Object* obj = job->obj;
+    RemovePendingBuild(pool, job);
+    AttachObject(obj, job->hierarchy);
+    if(job->error != GLOD_NO_ERROR)
+        GLOD_SetError(job->error, "Error while building object", obj->name);
+    delete job;
+}
+
+/* CancelBuild: drops a job and anything it built. A job that hasn't
+ * started is pulled from the queue; a running one is waited for.
+ */
+static void CancelBuild(GLOD_BuildPool* pool, GLOD_BuildJob* job) {
+    pool->lock.Lock();
+    if(job->state == GLOD_BuildQueued) {
+        GLOD_BuildJob* prev = NULL;
+        GLOD_BuildJob* j = pool->queueHead;
+        while(j != job) {
+            prev = j;
+            j = j->nextQueued;
+        }
+        if(prev == NULL)
+            pool->queueHead = job->nextQueued;
+        else
+            prev->nextQueued = job->nextQueued;
+        if(pool->queueTail == job)
+            pool->queueTail = prev;
+        pool->numQueued--;
+        job->state = GLOD_BuildFinished;
+    }
+    while(job->state != GLOD_BuildFinished)
+        pool->finished.Wait(pool->lock);
+    pool->lock.Unlock();
+    
+    RemovePendingBuild(pool, job);
+    if(job->raw != NULL)
+        delete job->raw;
+    if(job->hierarchy != NULL)
+        delete job->hierarchy;
+    delete job;
+}
+
+void glodBuildObjectAsync (GLuint name) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL ) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist: ", name);
+        return;
+    }
+    if(obj->buildJob != NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object is already being built:", name);
+        return;
+    }
+    if(obj->prebuild_buffer == NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object has already been built:", name);
+        return;
+    }
+    
+    GLOD_BuildPool* pool = GetBuildPool();
+    GLOD_BuildJob* job = new GLOD_BuildJob;
+    job->obj = obj;
+    job->raw = (GLOD_RawObject*) obj->prebuild_buffer;
+    job->hierarchy = NULL;
+    job->error = GLOD_NO_ERROR;
+    job->progress = 0.0;
+    job->state = GLOD_BuildQueued;
+    job->nextQueued = NULL;
+    job->nextPending = pool->pending;
+    pool->pending = job;
+    obj->prebuild_buffer = NULL;
+    obj->buildJob = job;
+    
+    pool->lock.Lock();
+    // start another thread unless one is free to take this job
+    if((pool->numQueued >= pool->numIdle) && (pool->numThreads < pool->maxThreads)) {
+        ThreadHandle thread = StartThread(BuildThreadMain, pool);
+        if(thread != NULL)
+            pool->threads[pool->numThreads++] = thread;
+    }
+    if(pool->numThreads == 0) {
+        // no threads to be had, so build it here
+        pool->lock.Unlock();
+        job->hierarchy = BuildHierarchy(obj, job->raw, &job->progress);
+        job->raw = NULL;
+        job->state = GLOD_BuildFinished;
+        return;
+    }
+    if(pool->queueTail == NULL)
+        pool->queueHead = job;
+    else
+        pool->queueTail->nextQueued = job;
+    pool->queueTail = job;
+    pool->numQueued++;
+    pool->queued.Broadcast();
+    pool->lock.Unlock();
+} /* End of glodBuildObjectAsync() **/
+
+GLboolean glodTestBuild (GLuint name) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL ) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist: ", name);
+        return GL_FALSE;
+    }
+    if(obj->buildJob == NULL)
+        return (obj->hierarchy != NULL) ? GL_TRUE : GL_FALSE;
+    
+    GLOD_BuildPool* pool = s_pCurrentContext->buildPool;
+    if(!BuildFinished(pool, obj->buildJob))
+        return GL_FALSE;
+    AttachBuild(pool, obj->buildJob);
+    return GL_TRUE;
+} /* End of glodTestBuild() **/
+
+void glodFinishBuild (GLuint name) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL ) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist: ", name);
+        return;
+    }
+    if(obj->buildJob == NULL)
+        return;
+    
+    GLOD_BuildPool* pool = s_pCurrentContext->buildPool;
+    WaitForBuild(pool, obj->buildJob);
+    AttachBuild(pool, obj->buildJob);
+} /* End of glodFinishBuild() **/
+
+/* called by glodAdaptGroup */
+void GLOD_AttachFinishedBuilds(GLuint groupname) {
+    GLOD_BuildPool* pool = s_pCurrentContext->buildPool;
+    if(pool == NULL)
+        return;
+    
+    GLOD_BuildJob* next;
+    for(GLOD_BuildJob* job = pool->pending; job != NULL; job = next) {
+        next = job->nextPending;
+        if((job->obj->group_name == groupname) && BuildFinished(pool, job))
+            AttachBuild(pool, job);
+    }
+}
+
+/* called by glodDestroyContext, with context current */
+void GLOD_ShutdownBuilds(GLODcontext* context) {
+    GLOD_BuildPool* pool = context->buildPool;
+    if(pool == NULL)
+        return;
+    
+    // these objects never made it into a group, so delete them here
+    while(pool->pending != NULL)
+        glodDeleteObject(pool->pending->obj->name);
+    
+    pool->lock.Lock();
+    pool->closing = true;
+    pool->queued.Broadcast();
+    pool->lock.Unlock();
+    for(int i = 0; i < pool->numThreads; i++)
+        JoinThread(pool->threads[i]);
+    
+    delete [] pool->threads;
+    delete pool;
+    context->buildPool = NULL;
+}
+
+
 void glodDeleteObject(GLuint name)
 {
     GLOD_Object* obj =
         (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     
     if(obj == NULL ) {
+        int index;
+        GLOD_InstanceSet *set = GLOD_FindInstance(name, &index);
+        if(set != NULL) {
+            set->group->removeInstance(set, index);
+            return;
+        }
         GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist:", name);
         return;
     }
     
+    if(obj->buildJob != NULL)
+        CancelBuild(s_pCurrentContext->buildPool, obj->buildJob);
+    
     FreeHashtableCautious(obj->patch_id_map); // deletes the patch mappings... we're cautious b/c the mappings aren't pointers but actually integers
     
     HashtableDeleteCautious(s_APIState.object_hash, obj->name); // this does not delete the object!!!
@@ -257,6 +584,74 @@ void glodDeleteObject(GLuint name)
 } /* End of glodDeleteObject() */
 
 
+// binds a new view to obj's cut; neither the cut nor its group hears about
+// it unless the transform actually changed, so rebinding an unmoved object
+// is cheap
+static void SetObjectView(GLOD_Object *obj, float m1[16], float m2[16], float m3[16])
+{
+    float previous[16];
+    memcpy(previous, obj->cut->view.matrix.cells, sizeof(previous));
+    obj->cut->view.SetFrom(m1, m2, m3);
+    if (memcmp(previous, obj->cut->view.matrix.cells, sizeof(previous)) == 0)
+        return;
+    obj->cut->viewChanged();
+    if (obj->group != NULL)
+        obj->group->objectChanged(obj);
+}
+
+// as SetObjectView(), for a product already laid out as Mat4::cells
+static void SetObjectMatrix(GLOD_Object *obj, const float rows[16])
+{
+    float *cells = &obj->cut->view.matrix.cells[0][0];
+    if (memcmp(cells, rows, 16*sizeof(float)) == 0)
+        return;
+    memcpy(cells, rows, 16*sizeof(float));
+    obj->cut->viewChanged();
+    if (obj->group != NULL)
+        obj->group->objectChanged(obj);
+}
+
+// rows = camera x model, both column-major as OpenGL keeps them. rows comes
+// out laid out as Mat4::cells, summed in the same order Mat4::operator*
+// uses, so it matches what glodObjectXform(name, camera, model, NULL) binds.
+static void MultXform(const float camera[16], const float model[16], float rows[16])
+{
+#ifdef GLOD_XFORM_SSE
+    __m128 c0 = _mm_loadu_ps(camera);
+    __m128 c1 = _mm_loadu_ps(camera + 4);
+    __m128 c2 = _mm_loadu_ps(camera + 8);
+    __m128 c3 = _mm_loadu_ps(camera + 12);
+    __m128 col[4];
+    for (int j = 0; j < 4; j++) {
+        const float *m = model + 4*j;
+        __m128 sum = _mm_mul_ps(c0, _mm_set1_ps(m[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(m[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(m[2])));
+        col[j] = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(m[3])));
+    }
+    _MM_TRANSPOSE4_PS(col[0], col[1], col[2], col[3]);
+    _mm_storeu_ps(rows, col[0]);
+    _mm_storeu_ps(rows + 4, col[1]);
+    _mm_storeu_ps(rows + 8, col[2]);
+    _mm_storeu_ps(rows + 12, col[3]);
+#else
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            rows[4*i+j] = camera[i]*model[4*j] + camera[4+i]*model[4*j+1]
+                + camera[8+i]*model[4*j+2] + camera[12+i]*model[4*j+3];
+#endif
+}
+
+// a compact instance just keeps the product
+static void SetXform(GLOD_Object *obj, GLOD_InstanceSet *set, int index,
+                     float m1[16], float m2[16], float m3[16])
+{
+    if (set != NULL)
+        set->setXform(index, m1, m2, m3);
+    else
+        SetObjectView(obj, m1, m2, m3);
+}
+
 void glodBindObjectXform(GLuint objectname, GLenum what) {
     float m1[16];
     float m2[16];
@@ -267,13 +662,17 @@ void glodBindObjectXform(GLuint objectname, GLenum what) {
     
     GLOD_Object *obj =
         (GLOD_Object*) HashtableSearch(s_APIState.object_hash, objectname);
+    GLOD_InstanceSet *set = NULL;
+    int index = 0;
     
-    if(obj == NULL ) {
+    if(obj == NULL )
+        set = GLOD_FindInstance(objectname, &index);
+    if(obj == NULL && set == NULL) {
         GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist:", objectname);
         return;
     }
     
-    if(obj->hierarchy == NULL) {
+    if(set == NULL && obj->hierarchy == NULL) {
         GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", objectname);
         return;
     }
@@ -295,30 +694,32 @@ void glodBindObjectXform(GLuint objectname, GLenum what) {
     }
     
     if(h_proj & ! h_model) {
-        obj->cut->view.SetFrom(m1,NULL,NULL);
+        SetXform(obj, set, index, m1,NULL,NULL);
     }else if(h_model & ! h_proj) {
-        obj->cut->view.SetFrom(m2, NULL,NULL);    
+        SetXform(obj, set, index, m2, NULL,NULL);    
     } else if(h_neither) {
-        obj->cut->view.SetFrom(m1, NULL,NULL);
+        SetXform(obj, set, index, m1, NULL,NULL);
     } else if(h_proj & h_model) {
-        obj->cut->view.SetFrom(m1,m2,NULL);
+        SetXform(obj, set, index, m1,m2,NULL);
     }
-    
-    obj->cut->viewChanged();
 }
 
 void glodObjectXform(GLuint objectname, float m1[16], float m2[16], float m3[16])
 {
     GLOD_Object *obj =
         (GLOD_Object*) HashtableSearch(s_APIState.object_hash, objectname);
+    GLOD_InstanceSet *set = NULL;
+    int index = 0;
     float mt[16];
     
-    if(obj == NULL ) {
+    if(obj == NULL )
+        set = GLOD_FindInstance(objectname, &index);
+    if(obj == NULL && set == NULL) {
         GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist:", objectname);
         return;
     }
     
-    if(obj->hierarchy != NULL) {
+    if(set == NULL && obj->hierarchy == NULL) {
         GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", objectname);
         return;
     }
@@ -339,12 +740,94 @@ void glodObjectXform(GLuint objectname, float m1[16], float m2[16], float m3[16]
     }
     
     // now, bind the xform
-    obj->cut->view.SetFrom(m1,m2,m3);
-    obj->cut->viewChanged();  
+    SetXform(obj, set, index, m1,m2,m3);
+}
+
+void glodObjectXforms(GLsizei count, const GLuint *objectnames,
+                      const float camera[16], const float *models)
+{
+    static const float identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    float rows[16];
+    
+    if(count < 0 || (count > 0 && (objectnames == NULL || models == NULL))) {
+        GLOD_SetError(GLOD_INVALID_PARAM, "Need a name and a model matrix per object");
+        return;
+    }
+    if(camera == NULL)
+        camera = identity;
+    
+    // a bad name is reported, but the rest of the batch is still bound
+    for(GLsizei i = 0; i < count; i++) {
+        GLuint objectname = objectnames[i];
+        GLOD_Object *obj =
+            (GLOD_Object*) HashtableSearch(s_APIState.object_hash, objectname);
+        GLOD_InstanceSet *set = NULL;
+        int index = 0;
+        
+        if(obj == NULL)
+            set = GLOD_FindInstance(objectname, &index);
+        if(obj == NULL && set == NULL) {
+            GLOD_SetError(GLOD_INVALID_NAME, "Object doesn't exist:", objectname);
+            continue;
+        }
+        if(set == NULL && obj->hierarchy == NULL) {
+            GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built: ", objectname);
+            continue;
+        }
+        
+        MultXform(camera, models + 16*i, rows);
+        if(set != NULL)
+            set->setMatrix(index, rows);
+        else
+            SetObjectMatrix(obj, rows);
+    }
 }
 
 /***************************************************************************/
 
+// glodReadbackObject's writer: appends to the caller's buffer
+static size_t WriteToBuffer(const GLvoid *data, size_t size, GLvoid *user_data) {
+    char **dst = (char**) user_data;
+    memcpy(*dst, data, size);
+    *dst += size;
+    return size;
+}
+
+// the stream header and the object chunk
+static int WriteObjectChunk(GLOD_Object *obj, GLOD_StreamWriter *out) {
+    if(obj->hierarchy == NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built:", obj->name);
+        return 0;
+    }
+    
+    // the object chunk: format and patch count, then (name, packed id)
+    // for each patch
+    GLuint count = HashtableNumElements(obj->patch_id_map);
+    GLuint *table = new GLuint[2 + 2 * count];
+    GLuint n = 0;
+    table[n++] = obj->format;
+    table[n++] = count;
+    HASHTABLE_WALK(obj->patch_id_map, node);
+    table[n++] = node->key - 1;
+    table[n++] = (GLuint) ((ptrdiff_t) node->data - 1);
+    HASHTABLE_WALK_END(obj->patch_id_map);
+    
+    int ok = out->begin() &&
+        out->writeChunk(GLOD_CHUNK_OBJECT, table, sizeof(GLuint) * n);
+    delete [] table;
+    return ok;
+}
+
+int GLOD_WriteObjectStream(GLOD_Object *obj, GLOD_StreamWriter *out) {
+    if(!WriteObjectChunk(obj, out))
+        return 0;
+    if(!obj->hierarchy->writeStream(out)) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object can't be written to a stream:", obj->name);
+        return 0;
+    }
+    return out->end();
+}
+
 void glodReadbackObject(GLuint name, GLvoid *data) { 
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
     if(obj == NULL) {
@@ -352,77 +835,93 @@ void glodReadbackObject(GLuint name, GLvoid *data) {
         return;
     }
     
-    int offset = 0;
-    
-    // prepend the hierarchy type
-    memcpy(data, &obj->format, sizeof(int)); offset += sizeof(int);
-    
-    // now write out the patch->packed_patch hashtable
-    memcpy(((char*)data)+offset, &obj->patch_id_map->num_elements, sizeof(unsigned int)); offset += sizeof(unsigned int);
-    
-    HASHTABLE_WALK(obj->patch_id_map, node);
-    memcpy(((char*)data)+offset, (void*)&node->key, sizeof(unsigned int)); offset += sizeof(unsigned int);
-    memcpy(((char*)data)+offset, (void*) &node->data, sizeof(unsigned int)); offset += sizeof(unsigned int);
-    HASHTABLE_WALK_END(obj->patch_id_map);
-    
-    // now we have the object
-    obj->hierarchy->readback((void*)((char*)data + offset));
+    char *dst = (char*) data;
+    GLOD_StreamWriter out(WriteToBuffer, &dst);
+    GLOD_WriteObjectStream(obj, &out);
 }
 
-// must stay in sync with the NewObject code
-void glodLoadObject(GLuint name, GLuint group_name, const GLvoid *data) {
+void glodWriteObject(GLuint name, GLODwriteproc write, GLvoid *user_data) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
-    if(obj != NULL) {
-        GLOD_SetError(GLOD_INVALID_NAME, "An object of the specified name already exists.", name);
+    if(obj == NULL) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist:", name);
+        return;
+    }
+    if(write == NULL) {
+        GLOD_SetError(GLOD_INVALID_PARAM, "No write function given for object:", name);
         return;
     }
     
-    // make the object
-    obj = new GLOD_Object();
-    obj->name = name;
-    obj->group_name = group_name;
-    HashtableAdd(s_APIState.object_hash, name, obj); // put it in the namespace
-    
-    // load the header... format and patch-indirect table
-    int format;
-    int offset = 0;
-    memcpy(&format, ((char*)data) + offset, sizeof(int)); offset += sizeof(int);
-    obj->format = format;
+    GLOD_StreamWriter out(write, user_data);
+    GLOD_WriteObjectStream(obj, &out);
+}
+
+void glodWriteProgressiveObject(GLuint name, GLODwriteproc write, GLvoid *user_data) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist:", name);
+        return;
+    }
+    if(write == NULL) {
+        GLOD_SetError(GLOD_INVALID_PARAM, "No write function given for object:", name);
+        return;
+    }
     
-    // load the indirect table
-    obj->patch_id_map = AllocHashtableBySize(PATCH_HASH_BUCKET_SIZE);
-    unsigned int num_indirects;
-    memcpy(&num_indirects, ((char*)data) + offset, sizeof(unsigned int)); offset += sizeof(unsigned int);
-    for(int i = 0; i < num_indirects; i++) {
-        unsigned int k; unsigned int value;
-        memcpy(&k, ((char*)data) + offset, sizeof(unsigned int)); offset += sizeof(unsigned int);    
-        memcpy(&value, ((char*)data) + offset, sizeof(unsigned int)); offset += sizeof(unsigned int);    
-		HashtableAdd(obj->patch_id_map, k, (void*) ((ptrdiff_t) value));
+    GLOD_StreamWriter out(write, user_data);
+    if(!WriteObjectChunk(obj, &out))
+        return;
+    if(!obj->hierarchy->writeProgressiveStream(&out)) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object can't be written to a progressive stream:", name);
+        return;
+    }
+    out.end();
+}
+
+// the first half of loading an object: makes it, with an empty hierarchy
+// of the given format. Must stay in sync with the NewObject code.
+static GLOD_Object* BeginLoadObject(GLuint name, GLuint group_name, int format) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj != NULL || HashtableSearch(s_APIState.instance_hash, name) != NULL) {
+        GLOD_SetError(GLOD_INVALID_NAME, "An object of the specified name already exists.", name);
+        return NULL;
     }
     
-    // read the hierarchy
+    Hierarchy *hierarchy;
     switch(format) {
     case GLOD_DISCRETE:
-        obj->hierarchy = new DiscreteHierarchy(Half_Edge_Collapse); // placeholder: op type gets set in the load()
+    case GLOD_DISCRETE_MANUAL:
+        hierarchy = new DiscreteHierarchy(Half_Edge_Collapse); // placeholder: op type gets set in the load()
         break;
     case GLOD_CONTINUOUS:
-        obj->hierarchy = new VDSHierarchy();
-        ((VDSHierarchy*) obj->hierarchy)->InitForLoad();
+        hierarchy = new VDSHierarchy();
+        ((VDSHierarchy*) hierarchy)->InitForLoad();
         break;
     case GLOD_DISCRETE_PATCH:
-        obj->hierarchy = new DiscretePatchHierarchy(Half_Edge_Collapse);
+        hierarchy = new DiscretePatchHierarchy(Half_Edge_Collapse);
         break;
     default:
         GLOD_SetError(GLOD_BAD_HIERARCHY, "Invalid hierarchy type in source data.", format );
-        FreeHashtableCautious(obj->patch_id_map);
-        HashtableDeleteCautious(s_APIState.object_hash, obj->name);
-        delete obj;
-        return;
+        return NULL;
     }
-    if(obj->hierarchy->load((void*)(((char*)data) + offset)) == 0) {
+    
+    obj = new GLOD_Object();
+    obj->name = name;
+    obj->group_name = group_name;
+    obj->format = format;
+    obj->hierarchy = hierarchy;
+    obj->patch_id_map = AllocHashtableBySize(PATCH_HASH_BUCKET_SIZE);
+    HashtableAdd(s_APIState.object_hash, name, obj); // put it in the namespace
+    return obj;
+}
+
+// the second half: puts the object into production, or if its hierarchy
+// didn't load, gets rid of it again
+static void FinishLoadObject(GLOD_Object* obj, bool loaded) {
+    if(!loaded) {
         // we need to reset the object to a base state
         FreeHashtableCautious(obj->patch_id_map);
         HashtableDeleteCautious(s_APIState.object_hash, obj->name);
+        delete obj->hierarchy;
+        obj->hierarchy = NULL;
         delete obj;
         return;
     }
@@ -440,6 +939,172 @@ void glodLoadObject(GLuint name, GLuint group_name, const GLvoid *data) {
     group->addObject(obj);
 }
 
+// reads an object stream; a progressive one is only begun, and the
+// object's hierarchy keeps the reader if it was
+static bool LoadObjectStream(GLuint name, GLuint group_name, GLOD_StreamReader *in,
+                             bool progressive = false) {
+    GLuint header[2];
+    if(!in->begin() || !in->nextChunk(GLOD_CHUNK_OBJECT) ||
+       !in->read(header, sizeof(header)))
+        return false;
+    
+    GLOD_Object* obj = BeginLoadObject(name, group_name, header[0]);
+    if(obj == NULL)
+        return false;
+    
+    // the patch-indirect table
+    bool ok = header[1] <= in->getRemaining() / (2 * sizeof(GLuint));
+    for(GLuint i = 0; ok && i < header[1]; i++) {
+        GLuint entry[2];
+        ok = in->read(entry, sizeof(entry)) != 0;
+        if(ok)
+            HashtableAdd(obj->patch_id_map, entry[0] + 1, (void*) ((ptrdiff_t) entry[1] + 1));
+    }
+    
+    ok = ok && in->endChunk();
+    if(progressive)
+        ok = ok && obj->hierarchy->beginProgressiveStream(in);
+    else
+        ok = ok && obj->hierarchy->readStream(in) && in->end();
+    if(!ok)
+        GLOD_SetError(GLOD_CORRUPT_BUFFER, "Object could not be loaded from the stream:", name);
+    FinishLoadObject(obj, ok);
+    return ok;
+}
+
+void glodReadObject(GLuint name, GLuint group_name, GLODreadproc read, GLvoid *user_data) {
+    if(read == NULL) {
+        GLOD_SetError(GLOD_INVALID_PARAM, "No read function given for object:", name);
+        return;
+    }
+    GLOD_StreamReader in(read, user_data);
+    LoadObjectStream(name, group_name, &in);
+}
+
+void glodMapObject(GLuint name, GLuint group_name, GLvoid *data, size_t size) {
+    GLOD_StreamReader in(data, size, true);
+    LoadObjectStream(name, group_name, &in);
+}
+
+void glodReadProgressiveObject(GLuint name, GLuint group_name, GLODreadproc read, GLvoid *user_data) {
+    if(read == NULL) {
+        GLOD_SetError(GLOD_INVALID_PARAM, "No read function given for object:", name);
+        return;
+    }
+    // the hierarchy reads from it until the object has all arrived
+    GLOD_StreamReader *in = new GLOD_StreamReader(read, user_data);
+    if(!LoadObjectStream(name, group_name, in, true))
+        delete in;
+}
+
+// reads up to max_records more of an object's progressive stream, and lets
+// its group know if any arrived
+static int ContinueProgressiveObject(GLOD_Object* obj, unsigned int max_records) {
+    unsigned int left = obj->hierarchy->getProgressiveRecordsLeft();
+    int more = obj->hierarchy->continueProgressiveStream(max_records);
+    if(obj->group != NULL && obj->hierarchy->getProgressiveRecordsLeft() != left)
+        obj->group->objectLoaded(obj);
+    return more;
+}
+
+GLboolean glodContinueProgressiveObject(GLuint name, GLuint max_records) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist:", name);
+        return GL_FALSE;
+    }
+    if(obj->hierarchy == NULL)
+        return GL_FALSE;
+    return ContinueProgressiveObject(obj, max_records) ? GL_TRUE : GL_FALSE;
+}
+
+/* called by glodAdaptGroup, before it adapts the group */
+void GLOD_ContinueProgressiveLoads(GLOD_Group *group) {
+    for(int i = 0; i < group->getNumObjects(); i++) {
+        GLOD_Object *obj = group->getObject(i);
+        if(obj->progressiveRecords > 0 && obj->hierarchy != NULL)
+            ContinueProgressiveObject(obj, obj->progressiveRecords);
+    }
+}
+
+// reads streams, and the buffers glodReadbackObject wrote before there
+// were streams
+void glodLoadObject(GLuint name, GLuint group_name, const GLvoid *data) {
+    if(GLOD_StreamReader::isStream(data)) {
+        GLOD_StreamReader in(data, ~(GLOD_StreamSize) 0, false);
+        LoadObjectStream(name, group_name, &in);
+        return;
+    }
+    
+    // load the header... format and patch-indirect table
+    int format;
+    int offset = 0;
+    memcpy(&format, ((char*)data) + offset, sizeof(int)); offset += sizeof(int);
+    
+    GLOD_Object* obj = BeginLoadObject(name, group_name, format);
+    if(obj == NULL)
+        return;
+    
+    // load the indirect table
+    unsigned int num_indirects;
+    memcpy(&num_indirects, ((char*)data) + offset, sizeof(unsigned int)); offset += sizeof(unsigned int);
+    for(int i = 0; i < num_indirects; i++) {
+        unsigned int k; unsigned int value;
+        memcpy(&k, ((char*)data) + offset, sizeof(unsigned int)); offset += sizeof(unsigned int);    
+        memcpy(&value, ((char*)data) + offset, sizeof(unsigned int)); offset += sizeof(unsigned int);    
+		HashtableAdd(obj->patch_id_map, k, (void*) ((ptrdiff_t) value));
+    }
+    
+    // read the hierarchy
+    bool loaded = obj->hierarchy->load((void*)(((char*)data) + offset)) != 0;
+    if(!loaded)
+        GLOD_SetError(GLOD_CORRUPT_BUFFER, "Object could not be loaded from the buffer:", name);
+    FinishLoadObject(obj, loaded);
+}
+
+/***************************************************************************/
+
+void glodReadbackCut(GLuint name, GLvoid *data) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist:", name);
+        return;
+    }
+    if(obj->cut == NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built:", name);
+        return;
+    }
+    if(obj->cut->getSnapshotSize() == 0) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Cut snapshots are only supported for continuous objects:", name);
+        return;
+    }
+    obj->cut->saveSnapshot(data);
+}
+
+// the snapshot must come from a cut of the same hierarchy, i.e. an instance
+// of the object or an object loaded from the same glodReadbackObject() data
+void glodLoadCut(GLuint name, const GLvoid *data) {
+    GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
+    if(obj == NULL) {
+        GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist:", name);
+        return;
+    }
+    if(obj->cut == NULL) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Object has not been built:", name);
+        return;
+    }
+    if(obj->cut->getSnapshotSize() == 0) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Cut snapshots are only supported for continuous objects:", name);
+        return;
+    }
+    if(obj->cut->loadSnapshot(data) == 0) {
+        GLOD_SetError(GLOD_INVALID_DATA_FORMAT, "Cut snapshot does not match the object:", name);
+        return;
+    }
+    if(obj->group != NULL)
+        obj->group->objectChanged(obj);
+}
+
 /***************************************************************************/
 
 /* called by glodInsertArrays and glodInsertElements which are in Raw.cpp */
@@ -464,13 +1129,18 @@ void HandlePatch(GLOD_Object* obj, GLOD_RawPatch* patch, int level, float geomet
 /***************************************************************************/
 void glodDrawPatch(GLuint name, GLuint patchname) {
     GLOD_Object* obj = (GLOD_Object*) HashtableSearch(s_APIState.object_hash, name);
-    if(obj == NULL) {
+    GLOD_InstanceSet *set = NULL;
+    int index = 0;
+    if(obj == NULL)
+        set = GLOD_FindInstance(name, &index);
+    if(obj == NULL && set == NULL) {
         GLOD_SetError(GLOD_INVALID_NAME, "Object does not exist", name);
         return;
     }
     
     // look up the real patch name
-    int patch_id = HashtableSearchInt(obj->patch_id_map, patchname+1); // lameness
+    HashTable *patch_id_map = (set != NULL) ? set->patch_id_map : obj->patch_id_map;
+    int patch_id = HashtableSearchInt(patch_id_map, patchname+1); // lameness
     if(patch_id == 0) {
         // this patch isn't there
         GLOD_SetError(GLOD_INVALID_PATCH, "Patch of the specified doesn't exist.", patchname);
@@ -478,7 +1148,10 @@ void glodDrawPatch(GLuint name, GLuint patchname) {
     }
     patch_id --;// now, correct for the lameness of the hashtable, which stores everything +1
     
-    obj->drawPatch(patch_id);
+    if(set == NULL)
+        obj->drawPatch(patch_id);
+    else if(set->getCut(index) != NULL) // hidden instances draw nothing
+        set->getCut(index)->draw(patch_id);
 }
 
 void DrawRawGLOD(int name);
@@ -0,0 +1,312 @@
+/* GLOD: Object streams
+ ***************************************************************************/
+/******************************************************************************
+ * Copyright 2003 Jonathan Cohen, Nat Duca, David Luebke, Brenden Schubert    *
+ *                Johns Hopkins University and University of Virginia         *
+ ******************************************************************************
+ * This file is distributed as part of the GLOD library, and as such, falls   *
+ * under the terms of the GLOD public license. GLOD is distributed without    *
+ * any warranty, implied or otherwise. See the GLOD license for more details. *
+ *                                                                            *
+ * You should have recieved a copy of the GLOD Open-Source License with this  *
+ * copy of GLOD; if not, please visit the GLOD web page,                      *
+ * http://www.cs.jhu.edu/~graphics/GLOD/license for more information          *
+ ******************************************************************************/
+
+/*----------------------------- Local Includes -----------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "glod_core.h"
+
+/*----------------------------- Local Constants -----------------------------*/
+
+// Adler-32: the largest n for which 255n(n+1)/2 + (n+1)(65520) fits in
+// 32 bits, so the sums need only be reduced once per n bytes
+#define ADLER_BASE 65521
+#define ADLER_NMAX 5552
+
+// skipped chunks are read through a buffer this big
+#define SKIP_BUFFER_SIZE 4096
+
+static const char s_Padding[GLOD_STREAM_ALIGNMENT] = { 0 };
+
+/*---------------------------------Functions-------------------------------- */
+
+GLuint GLOD_Adler32(GLuint adler, const void* data, size_t size) {
+    const unsigned char* p = (const unsigned char*) data;
+    GLuint a = adler & 0xffff;
+    GLuint b = adler >> 16;
+
+    while(size > 0) {
+        size_t n = (size < ADLER_NMAX) ? size : ADLER_NMAX;
+        size -= n;
+        while(n >= 8) {
+            a += p[0]; b += a; a += p[1]; b += a;
+            a += p[2]; b += a; a += p[3]; b += a;
+            a += p[4]; b += a; a += p[5]; b += a;
+            a += p[6]; b += a; a += p[7]; b += a;
+            p += 8; n -= 8;
+        }
+        while(n-- > 0) {
+            a += *p++; b += a;
+        }
+        a %= ADLER_BASE;
+        b %= ADLER_BASE;
+    }
+    return (b << 16) | a;
+}
+
+// padding that puts the payload of a chunk whose header starts after
+// offset bytes on the next multiple of GLOD_STREAM_ALIGNMENT
+static size_t ChunkPadding(GLOD_StreamSize offset) {
+    GLOD_StreamSize payload = offset + sizeof(GLOD_StreamChunk);
+    payload = (payload + GLOD_STREAM_ALIGNMENT - 1) & ~(GLOD_StreamSize) (GLOD_STREAM_ALIGNMENT - 1);
+    return (size_t) (payload - sizeof(GLOD_StreamChunk) - offset);
+}
+
+/*****************************************************************************\
+ @ GLOD_StreamWriter
+ -----------------------------------------------------------------------------
+ description : writes a stream, or counts its size if write is NULL
+ input       : 
+ output      : each call returns 0 once a write has fallen short
+ notes       : 
+\*****************************************************************************/
+GLOD_StreamWriter::GLOD_StreamWriter(GLODwriteproc write, GLvoid* user_data) {
+    this->proc = write;
+    this->user_data = user_data;
+    offset = 0;
+    failed = false;
+}
+
+int GLOD_StreamWriter::put(const void* data, size_t size) {
+    if(failed)
+        return 0;
+    if(proc != NULL && size > 0 && proc(data, size, user_data) != size) {
+        GLOD_SetError(GLOD_INVALID_STATE, "Write to object stream failed.");
+        failed = true;
+        return 0;
+    }
+    offset += size;
+    return 1;
+}
+
+int GLOD_StreamWriter::begin() {
+    GLOD_StreamHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = GLOD_STREAM_MAGIC;
+    header.version_major = GLOD_STREAM_VERSION_MAJOR;
+    header.version_minor = GLOD_STREAM_VERSION_MINOR;
+    header.header_size = sizeof(GLOD_StreamHeader);
+    header.chunk_header_size = sizeof(GLOD_StreamChunk);
+    header.alignment = GLOD_STREAM_ALIGNMENT;
+    header.byte_order = GLOD_STREAM_BYTE_ORDER;
+    return put(&header, sizeof(header));
+}
+
+int GLOD_StreamWriter::writeChunk(GLuint type, int count,
+                                  const void* const* data, const size_t* sizes) {
+    GLOD_StreamSize size = 0;
+    GLuint checksum = 1;
+    int i;
+    
+    for(i = 0; i < count; i++) {
+        size += sizes[i];
+        // the checksum takes another pass over the payload, so it's left
+        // out when only counting
+        if(proc != NULL)
+            checksum = GLOD_Adler32(checksum, data[i], sizes[i]);
+    }
+
+    if(!beginChunk(type, size, checksum))
+        return 0;
+    for(i = 0; i < count; i++)
+        if(!put(data[i], sizes[i]))
+            return 0;
+    return 1;
+}
+
+int GLOD_StreamWriter::beginChunk(GLuint type, GLOD_StreamSize size, GLuint checksum) {
+    GLOD_StreamChunk chunk;
+    
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.type = type;
+    chunk.size = size;
+    chunk.checksum = checksum;
+    return put(s_Padding, ChunkPadding(offset)) && put(&chunk, sizeof(chunk));
+}
+
+// the END chunk, then padding out to the alignment
+int GLOD_StreamWriter::end() {
+    if(!writeChunk(GLOD_CHUNK_END, 0, NULL, NULL))
+        return 0;
+    return put(s_Padding, (size_t) ((GLOD_STREAM_ALIGNMENT - offset % GLOD_STREAM_ALIGNMENT) % GLOD_STREAM_ALIGNMENT));
+}
+
+/*****************************************************************************\
+ @ GLOD_StreamReader
+ -----------------------------------------------------------------------------
+ description : reads a stream from a GLODreadproc, or from memory
+ input       : size may be ~0 if the end of the memory isn't known
+ output      : each call returns 0 (NULL) once anything has failed
+ notes       : in_place is dropped unless data is aligned like the stream
+\*****************************************************************************/
+GLOD_StreamReader::GLOD_StreamReader(GLODreadproc read, GLvoid* user_data) {
+    this->proc = read;
+    this->user_data = user_data;
+    data = NULL;
+    data_size = 0;
+    in_place = false;
+    offset = 0;
+    remaining = 0;
+    checksum = 1;
+    failed = false;
+    memset(&chunk, 0, sizeof(chunk));
+}
+
+GLOD_StreamReader::GLOD_StreamReader(const void* data, GLOD_StreamSize size, bool in_place) {
+    proc = NULL;
+    user_data = NULL;
+    this->data = (const char*) data;
+    data_size = size;
+    this->in_place = in_place &&
+        ((size_t) data & (GLOD_STREAM_ALIGNMENT - 1)) == 0;
+    offset = 0;
+    remaining = 0;
+    checksum = 1;
+    failed = false;
+    memset(&chunk, 0, sizeof(chunk));
+}
+
+bool GLOD_StreamReader::isStream(const void* data) {
+    GLuint magic;
+    memcpy(&magic, data, sizeof(magic));
+    return magic == GLOD_STREAM_MAGIC;
+}
+
+int GLOD_StreamReader::fail(int error, const char* message) {
+    if(!failed)
+        GLOD_SetError(error, message);
+    failed = true;
+    return 0;
+}
+
+int GLOD_StreamReader::get(void* dst, size_t size) {
+    if(failed)
+        return 0;
+    if(proc != NULL) {
+        if(size > 0 && proc(dst, size, user_data) != size)
+            return fail(GLOD_CORRUPT_BUFFER, "Object stream is truncated");
+    } else {
+        if(size > data_size - offset)
+            return fail(GLOD_CORRUPT_BUFFER, "Object stream is truncated");
+        memcpy(dst, data + offset, size);
+    }
+    offset += size;
+    return 1;
+}
+
+int GLOD_StreamReader::skip(GLOD_StreamSize size) {
+    if(proc == NULL) {
+        if(size > data_size - offset)
+            return fail(GLOD_CORRUPT_BUFFER, "Object stream is truncated");
+        offset += size;
+        return 1;
+    }
+    char buffer[SKIP_BUFFER_SIZE];
+    while(size > 0) {
+        size_t n = (size < SKIP_BUFFER_SIZE) ? (size_t) size : SKIP_BUFFER_SIZE;
+        if(!get(buffer, n))
+            return 0;
+        size -= n;
+    }
+    return 1;
+}
+
+int GLOD_StreamReader::begin() {
+    GLOD_StreamHeader header;
+    if(!get(&header, sizeof(header)))
+        return 0;
+    if(header.magic != GLOD_STREAM_MAGIC)
+        return fail(GLOD_BAD_MAGIC, "Not a GLOD object stream");
+    if(header.version_major != GLOD_STREAM_VERSION_MAJOR ||
+       header.byte_order != GLOD_STREAM_BYTE_ORDER)
+        return fail(GLOD_BAD_MAGIC, "Object stream has an incompatible version or byte order");
+    if(header.header_size != sizeof(GLOD_StreamHeader) ||
+       header.chunk_header_size != sizeof(GLOD_StreamChunk) ||
+       header.alignment != GLOD_STREAM_ALIGNMENT)
+        return fail(GLOD_CORRUPT_BUFFER, "Object stream has an incompatible layout");
+    return 1;
+}
+
+/*****************************************************************************\
+ @ GLOD_StreamReader::nextChunk
+ -----------------------------------------------------------------------------
+ description : moves to the next chunk of the given type
+ input       : 
+ output      : 0 if the stream ends (or is corrupt) first
+ notes       : chunks of other types are skipped, so that streams from
+               newer minor versions can be read
+\*****************************************************************************/
+int GLOD_StreamReader::nextChunk(GLuint type) {
+    for(;;) {
+        char padding[GLOD_STREAM_ALIGNMENT];
+        if(!get(padding, ChunkPadding(offset)) || !get(&chunk, sizeof(chunk)))
+            return 0;
+        remaining = chunk.size;
+        checksum = 1;
+        if(chunk.type == type)
+            return 1;
+        if(chunk.type == GLOD_CHUNK_END)
+            return fail(GLOD_CORRUPT_BUFFER, "Object stream is missing a chunk");
+        if(!skip(chunk.size))
+            return 0;
+    }
+}
+
+int GLOD_StreamReader::read(void* dst, size_t size) {
+    if(size > remaining)
+        return fail(GLOD_CORRUPT_BUFFER, "Object stream chunk is too short");
+    if(!get(dst, size))
+        return 0;
+    remaining -= size;
+    checksum = GLOD_Adler32(checksum, dst, size);
+    return 1;
+}
+
+void* GLOD_StreamReader::map(size_t size) {
+    if(!in_place || failed)
+        return NULL;
+    if(size > remaining) {
+        fail(GLOD_CORRUPT_BUFFER, "Object stream chunk is too short");
+        return NULL;
+    }
+    if(size > data_size - offset) {
+        fail(GLOD_CORRUPT_BUFFER, "Object stream is truncated");
+        return NULL;
+    }
+    void* p = (void*) (data + offset);
+    offset += size;
+    remaining -= size;
+    checksum = GLOD_Adler32(checksum, p, size);
+    return p;
+}
+
+int GLOD_StreamReader::end() {
+    char padding[GLOD_STREAM_ALIGNMENT];
+    if(!nextChunk(GLOD_CHUNK_END) || !endChunk())
+        return 0;
+    return get(padding, (size_t) ((GLOD_STREAM_ALIGNMENT - offset % GLOD_STREAM_ALIGNMENT) % GLOD_STREAM_ALIGNMENT));
+}
+
+int GLOD_StreamReader::endChunk() {
+    if(failed)
+        return 0;
+    if(remaining != 0)
+        return fail(GLOD_CORRUPT_BUFFER, "Object stream chunk is too long");
+    if(checksum != chunk.checksum)
+        return fail(GLOD_CORRUPT_BUFFER, "Object stream chunk checksum mismatch");
+    return 1;
+}
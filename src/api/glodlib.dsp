@@ -115,6 +115,10 @@ SOURCE=.\glod_group.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\glod_instances.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\glod_noop_funcs.cpp
 # End Source File
 # Begin Source File
@@ -123,6 +127,10 @@ SOURCE=.\glod_objects.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\glod_stream.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\GroupParams.cpp
 # End Source File
 # Begin Source File
@@ -163,10 +171,18 @@ SOURCE=..\include\glod_group.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\glod_instances.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\glod_raw.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\glod_stream.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\hash.h
 # End Source File
 # Begin Source File
@@ -10,183 +10,316 @@
 #include "hash.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+
+/* A writer fills in a slot's key before it publishes the slot's data, and
+ * fills in a new slot array completely before it publishes the array, so a
+ * reader that sees the data or the array also sees what it depends on.
+ * Replaced arrays go on the retired list rather than being freed, since a
+ * reader may still be probing them; HashtableReclaim() frees them once the
+ * caller knows no reader is, and the table frees what is left. An open
+ * slot's key never changes once it is published, for the same reason:
+ * deleting leaves a tombstone that only a rehash into a new array clears. */
+#if defined(__GNUC__)
+#define HASH_LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define HASH_STORE(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#else
+/* volatile accesses have acquire and release semantics under MSVC */
+#define HASH_LOAD(p) (*(void * volatile *) &(p))
+#define HASH_STORE(p, v) (*(void * volatile *) &(p) = (void *) (v))
+#endif
+
+static char DeletedMarker;
+#define HASH_DELETED ((void *) &DeletedMarker)
+
+static HashSlots *AllocSlots( unsigned int size )
+{
+	HashSlots *slots = (HashSlots *) calloc( 1, offsetof( HashSlots, nodes ) + size * sizeof( HashNode ) );
+	slots->size = size;
+	return slots;
+}
+
+static void RetireSlots( HashTable *h, HashSlots *slots )
+{
+	if ( slots == NULL )
+		return;
+	slots->next_retired = h->retired;
+	h->retired = slots;
+}
+
+static unsigned int doHash( unsigned int key, unsigned int mask )
+{
+	/* Fibonacci hashing spreads runs of consecutive names across the table */
+	unsigned int x = key * 2654435769u;
+	return ( x ^ ( x >> 16 ) ) & mask;
+}
 
 HashTable *AllocHashtable( void )
 {
-	unsigned int i;
-	HashTable *hash = (HashTable *) malloc( sizeof( HashTable )) ;
-        hash->num_buckets = HASH_DEFAULT_NUM_BUCKETS;
-        hash->buckets = (HashNode**) malloc(sizeof(HashNode*) * hash->num_buckets);
-	hash->num_elements = 0;
-	for (i = 0 ; i < hash->num_buckets ; i++)
-	{
-		hash->buckets[i] = NULL;
-	}
+	return AllocHashtableBySize( HASH_DEFAULT_SIZE );
+}
+
+HashTable *AllocHashtableBySize( int size_hint )
+{
+	HashTable *hash = (HashTable *) calloc( 1, sizeof( HashTable ) );
+	hash->open_size_hint = 16;
+	while ( (int) hash->open_size_hint < size_hint )
+		hash->open_size_hint *= 2;
 	return hash;
 }
 
-HashTable *AllocHashtableBySize( int numB )
+void HashtableReclaim( HashTable *h )
 {
-	unsigned int i;
-	HashTable *hash = (HashTable *) malloc( sizeof( HashTable )) ;
-        hash->num_buckets = numB;
-        hash->buckets = (HashNode**) malloc(sizeof(HashNode*) * hash->num_buckets);
-	hash->num_elements = 0;
-	for (i = 0 ; i < hash->num_buckets ; i++)
+	HashSlots *slots;
+
+	while ( ( slots = h->retired ) != NULL )
 	{
-		hash->buckets[i] = NULL;
+		h->retired = slots->next_retired;
+		free( slots );
 	}
-	return hash;
 }
 
-void FreeHashtable( HashTable *hash )
+static void FreeSlots( HashTable *hash, int free_data )
 {
-	unsigned int i;
+	unsigned int i, n;
 
-	for ( i = 0; i < hash->num_buckets; i++ )
+	if ( free_data )
 	{
-		if ( hash->buckets[i] ) 
+		for ( i = 0, n = HashtableNumSlots( hash ); i < n; i++ )
 		{
-			free( hash->buckets[i]->data );
-			free( hash->buckets[i] );
+			HashNode *node = HashtableSlot( hash, i );
+			if ( node )
+				free( node->data );
 		}
 	}
-        free( hash->buckets );
+	free( hash->dense );
+	free( hash->open );
+	HashtableReclaim( hash );
+}
+
+void FreeHashtable( HashTable *hash )
+{
+	FreeSlots( hash, 1 );
 	free( hash );
 }
 
 void FreeHashtableCautious( HashTable *hash )
 {
-	unsigned int i;
+	FreeSlots( hash, 0 );
+	free( hash );
+}
+
+/* Rebuilds the open table in a new array at least twice the size of its
+ * live entries, dropping tombstones */
+static void RehashOpen( HashTable *h )
+{
+	HashSlots *old = h->open, *slots;
+	unsigned int size = old ? old->size : h->open_size_hint;
+	unsigned int i, j;
 
-	for ( i = 0; i < hash->num_buckets; i++ )
+	while ( ( h->open_live + 1 ) * 2 > size )
+		size *= 2;
+	slots = AllocSlots( size );
+	for ( i = 0; old && i < old->size; i++ )
 	{
-		if ( hash->buckets[i] ) 
-		{
-		    HashNode *next = hash->buckets[i];
-		    while (next !=NULL){
-			next = hash->buckets[i]->next;
-			free (hash->buckets[i]);
-			hash->buckets[i] = next;
-		    }
-			free( hash->buckets[i] );
-		}
+		void *data = old->nodes[i].data;
+		if ( data == NULL || data == HASH_DELETED )
+			continue;
+		for ( j = doHash( old->nodes[i].key, size - 1 ); slots->nodes[j].data; j = ( j + 1 ) & ( size - 1 ) )
+			;
+		slots->nodes[j] = old->nodes[i];
 	}
-        free( hash->buckets );
-	free( hash );
+	HASH_STORE( h->open, slots );
+	RetireSlots( h, old );
+	h->open_deleted = 0;
 }
 
+/* Grows the dense table to cover key */
+static void GrowDense( HashTable *h, unsigned int key )
+{
+	HashSlots *old = h->dense, *slots;
+	unsigned int size = old ? old->size : 16;
+	unsigned int i;
+
+	while ( size <= key )
+		size *= 2;
+	if ( size > HASH_DENSE_MAX_KEYS )
+		size = HASH_DENSE_MAX_KEYS;
+	slots = AllocSlots( size );
+	for ( i = 0; i < size; i++ )
+	{
+		slots->nodes[i].key = i;
+		if ( old && i < old->size )
+			slots->nodes[i].data = old->nodes[i].data;
+	}
+	HASH_STORE( h->dense, slots );
+	RetireSlots( h, old );
+}
 
-static unsigned int doHash( HashTable* hash, unsigned int key )
+/* the open slot holding key, or NULL */
+static HashNode *FindOpen( HashTable *h, unsigned int key )
 {
-	return key % hash->num_buckets;
+	HashSlots *slots = h->open;
+	unsigned int i, mask;
+
+	if ( slots == NULL )
+		return NULL;
+	mask = slots->size - 1;
+	for ( i = doHash( key, mask ); slots->nodes[i].data; i = ( i + 1 ) & mask )
+	{
+		if ( slots->nodes[i].data != HASH_DELETED && slots->nodes[i].key == key )
+			return &slots->nodes[i];
+	}
+	return NULL;
 }
 
 void HashtableAdd( HashTable *h, unsigned int key, void *data )
 {
-	HashNode *node = (HashNode *) malloc( sizeof( HashNode ) );
-	node->key = key;
-	node->data = data;
-	node->next = h->buckets[doHash( h, key )];
-	h->buckets[ doHash( h, key ) ] = node;
+	HashSlots *slots;
+	HashNode *node;
+	unsigned int i, mask;
+
+	if ( key < HASH_DENSE_MAX_KEYS )
+	{
+		if ( h->dense == NULL || key >= h->dense->size )
+			GrowDense( h, key );
+		node = &h->dense->nodes[key];
+		if ( node->data == NULL )
+			h->num_elements++;
+		HASH_STORE( node->data, data );
+		return;
+	}
+
+	/* adding a key that is already present replaces its data */
+	if ( ( node = FindOpen( h, key ) ) != NULL )
+	{
+		HASH_STORE( node->data, data );
+		return;
+	}
+	/* keep at least a quarter of the slots empty so probes stay short */
+	if ( h->open == NULL || ( h->open_live + h->open_deleted + 1 ) * 4 > h->open->size * 3 )
+		RehashOpen( h );
+	slots = h->open;
+	mask = slots->size - 1;
+	for ( i = doHash( key, mask ); slots->nodes[i].data; i = ( i + 1 ) & mask )
+		;
+	slots->nodes[i].key = key;
+	HASH_STORE( slots->nodes[i].data, data );
+	h->open_live++;
 	h->num_elements++;
 }
 
-void HashtableDelete( HashTable *h, unsigned int key )
+static void *Remove( HashTable *h, unsigned int key )
 {
-	unsigned int index = doHash( h, key );
-	HashNode *temp, *beftemp = NULL;
-	for ( temp = h->buckets[index]; temp; temp = temp->next )
+	HashNode *node;
+	void *data;
+
+	if ( key < HASH_DENSE_MAX_KEYS )
 	{
-		if ( temp->key == key )
-			break;
-		beftemp = temp;
+		if ( h->dense == NULL || key >= h->dense->size || h->dense->nodes[key].data == NULL )
+			return NULL;
+		node = &h->dense->nodes[key];
+		data = node->data;
+		HASH_STORE( node->data, NULL );
+		h->num_elements--;
+		return data;
 	}
-	if ( !temp )
-		return; /* not an error */
-	if ( beftemp )
-		beftemp->next = temp->next;
-	else
-		h->buckets[index] = temp->next;
+	if ( ( node = FindOpen( h, key ) ) == NULL )
+		return NULL;
+	data = node->data;
+	HASH_STORE( node->data, HASH_DELETED );
+	h->open_live--;
+	h->open_deleted++;
 	h->num_elements--;
-	free( temp->data );
-	free( temp );
+	return data;
+}
+
+void HashtableDelete( HashTable *h, unsigned int key )
+{
+	/* a missing key is not an error */
+	free( Remove( h, key ) );
 }
 
 void HashtableDeleteCautious( HashTable *h, unsigned int key )
 {
-	unsigned int index = doHash( h, key );
-	HashNode *temp, *beftemp = NULL;
-	for ( temp = h->buckets[index]; temp; temp = temp->next )
-	{
-		if ( temp->key == key )
-			break;
-		beftemp = temp;
-	}
-	if ( !temp )
-		return; /* not an error */
-	if ( beftemp )
-		beftemp->next = temp->next;
-	else
-		h->buckets[index] = temp->next;
-	h->num_elements--;
-	free( temp );
+	Remove( h, key );
 }
 
 void *HashtableSearch( HashTable *h, unsigned int key )
 {
-	unsigned int index = doHash( h, key );
-	HashNode *temp;
-	for ( temp = h->buckets[index]; temp; temp = temp->next )
+	HashSlots *slots;
+	unsigned int i, mask;
+	void *data;
+
+	if ( key < HASH_DENSE_MAX_KEYS )
 	{
-		if ( temp->key == key )
-			break;
+		slots = (HashSlots *) HASH_LOAD( h->dense );
+		if ( slots == NULL || key >= slots->size )
+			return NULL;
+		return HASH_LOAD( slots->nodes[key].data );
 	}
-	if ( !temp )
-	{
+
+	slots = (HashSlots *) HASH_LOAD( h->open );
+	if ( slots == NULL )
 		return NULL;
+	mask = slots->size - 1;
+	for ( i = doHash( key, mask ); ( data = HASH_LOAD( slots->nodes[i].data ) ) != NULL; i = ( i + 1 ) & mask )
+	{
+		if ( data != HASH_DELETED && slots->nodes[i].key == key )
+			return data;
 	}
-	return temp->data;
+	return NULL;
 }
 
 int HashtableSearchInt(HashTable* h, unsigned int key)
 {
 	void* ret = HashtableSearch( h, key );
 
-	int* foo = (int*) &ret;
-
-	if (sizeof(void*) == 4)
-	{
-		return foo[0];
-	}
-	else
-	{
-		return foo[1];
-	}
+	/* the integer was stored as a pointer; truncate it back rather than
+	   picking a word out of the pointer, which is endian dependent */
+	return (int) (ptrdiff_t) ret;
 }
 
 void HashtableReplace( HashTable *h, unsigned int key, void *data, int free_mem )
 {
-	unsigned int index = doHash( h, key );
-	HashNode *temp;
-	for ( temp = h->buckets[index]; temp; temp = temp->next )
+	void *old = HashtableSearch( h, key );
+	if ( old && free_mem )
 	{
-		if ( temp->key == key )
-			break;
-	}
-	if ( !temp )
-	{
-		HashtableAdd( h, key, data );
-		return;
+		free( old );
 	}
-	if ( free_mem )
-	{
-		free( temp->data );
-	}
-	temp->data = data;
+	HashtableAdd( h, key, data );
 }
 
 unsigned int HashtableNumElements( HashTable *h) 
 {
 	return h->num_elements;
 }
+
+unsigned int HashtableNumSlots( HashTable *h )
+{
+	return ( h->dense ? h->dense->size : 0 ) + ( h->open ? h->open->size : 0 );
+}
+
+HashNode *HashtableSlot( HashTable *h, unsigned int index )
+{
+	HashNode *node;
+	unsigned int num_dense = h->dense ? h->dense->size : 0;
+
+	node = ( index < num_dense ) ? &h->dense->nodes[index] : &h->open->nodes[index - num_dense];
+	if ( node->data == NULL || node->data == HASH_DELETED )
+		return NULL;
+	return node;
+}
+
+HashNode *HashtableFirstNode( HashTable *h )
+{
+	unsigned int i, n;
+	HashNode *node;
+
+	for ( i = 0, n = HashtableNumSlots( h ); i < n; i++ )
+	{
+		if ( ( node = HashtableSlot( h, i ) ) != NULL )
+			return node;
+	}
+	return NULL;
+}
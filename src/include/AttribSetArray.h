@@ -162,6 +162,39 @@ class AttribSetArray : public AttribSet {
 #undef APPEND
    }
 
+   // copyState()'s state in two parts: the layout and vertex count, then
+   // the vertices themselves, which object streams move in place
+   int getLayoutSize() {
+       return AttribSet::getStateSize() + sizeof(numVerts);
+   }
+   
+   int copyLayout(void* vdst) {
+       char* dst = (char*)vdst;
+       dst += AttribSet::copyState(vdst);
+       memcpy(dst, &numVerts, sizeof(numVerts));
+       return getLayoutSize();
+   }
+   
+   // allocates the vertices, to be filled in through getVertexData();
+   // returns 0 if they would take more than max_size bytes
+   int createLayout(void* vsrc, size_t max_size) {
+       char* src = (char*)vsrc;
+       src += AttribSet::create(vsrc);
+       memcpy(&numVerts, src, sizeof(numVerts));
+       if(numVerts < 0 || getVertexSize() <= 0 ||
+          (size_t) numVerts > max_size / getVertexSize()) {
+           numVerts = 0;
+           return 0;
+       }
+       maxVerts = numVerts;
+       if(numVerts > 0)
+           verts = (unsigned char*) malloc(numVerts * getVertexSize());
+       return getLayoutSize();
+   }
+   
+   unsigned char* getVertexData() { return verts; }
+   int getVertexDataSize() { return getVertexSize() * numVerts; }
+
     
 #ifdef XBSVERTEX
     void setFrom(int idx, xbsVertex* xvert) {
@@ -40,6 +40,8 @@
 #include <vds.h>
 #include <simplifier.h>
 #include <cut.h>
+#include <occlusion.h>
+#include <manager.h>
 #include "vds_callbacks.h"
 
 class xbsVertex;
@@ -47,9 +49,16 @@ class xbsVertex;
 
 //#define GLOD_USE_TILES
 
-extern int GLOD_TILE_ROWS;
-extern int GLOD_TILE_COLS;
-extern int GLOD_NUM_TILES;
+#ifdef _MSC_VER
+#define GLOD_THREAD_LOCAL __declspec(thread)
+#else
+#define GLOD_THREAD_LOCAL __thread
+#endif
+
+// the tile layout of the thread's current context
+extern GLOD_THREAD_LOCAL int GLOD_TILE_ROWS;
+extern GLOD_THREAD_LOCAL int GLOD_TILE_COLS;
+extern GLOD_THREAD_LOCAL int GLOD_NUM_TILES;
 
 typedef struct {
     float min_x;
@@ -58,7 +67,7 @@ typedef struct {
     float max_y;
 } GLOD_Tile;
 
-extern GLOD_Tile *tiles;
+extern GLOD_THREAD_LOCAL GLOD_Tile *tiles;
 
 const GLfloat glodcore_IdentityXform[] = {1.0, 0.0, 0.0, 0.0,
 0.0, 1.0, 0.0, 0.0,
@@ -67,6 +76,10 @@ const GLfloat glodcore_IdentityXform[] = {1.0, 0.0, 0.0, 0.0,
 
 #define PATCH_HASH_BUCKET_SIZE 32
 
+// unfold records glodAdaptGroup reads into a progressively loading object
+// unless GLOD_PROGRESSIVE_RECORDS says otherwise
+#define GLOD_DEFAULT_PROGRESSIVE_RECORDS 256
+
 // in glodBuildObject, if we call model->splitPatchVerts();
 // then we should set the folowing flag.
 #define XBS_SPLIT_BORDER_VERTS 
@@ -80,33 +93,57 @@ typedef struct {
 
     HashTable* object_hash;
     HashTable* group_hash;
+    HashTable* instance_hash; // compact instances: name -> GLOD_InstanceSet
 } GLOD_APIState;
-extern GLOD_APIState s_APIState;
+
+struct GLOD_BuildPool;
+class GLOD_FillScratch;
+class Hierarchy;
+class GLOD_Object;
+class GLOD_RawObject;
+
+// An object handed to glodBuildObjectAsync. The build thread only reads the
+// object; the result is attached by the API thread (see glod_objects.cpp).
+enum GLOD_BuildState { GLOD_BuildQueued, GLOD_BuildRunning, GLOD_BuildFinished };
+
+struct GLOD_BuildJob {
+    GLOD_Object *obj;
+    GLOD_RawObject *raw;        // the object's prebuild_buffer, consumed by the build
+    Hierarchy *hierarchy;       // the result, once finished
+    int error;                  // first error the build raised
+    volatile float progress;    // 0..1, written by the build thread
+    GLOD_BuildState state;      // guarded by the pool lock
+    GLOD_BuildJob *nextQueued;  // guarded by the pool lock
+    GLOD_BuildJob *nextPending; // jobs not yet attached; API thread only
+};
+
+// Everything the API keeps between calls. A thread only touches its current
+// context, so different contexts can be used on different threads at once,
+// but a context must not be current on two threads at once.
+struct GLODcontext {
+    GLOD_APIState state;
+    VDS::Manager memoryManager; // budget shared by the context's groups
+
+    // saved copy of the tile globals while the context isn't current
+    int tileRows, tileCols, numTiles;
+    GLOD_Tile *tiles;
+
+    bool createdByInit; // glodShutdown only destroys contexts glodInit made
+
+    GLOD_BuildPool *buildPool; // workers for glodBuildObjectAsync, made on first use
+    GLOD_FillScratch *fillScratch; // for glodFill*, made on first use
+};
+
+extern GLOD_THREAD_LOCAL GLODcontext *s_pCurrentContext;
+#define s_APIState (s_pCurrentContext->state)
+#define s_VDSMemoryManager (s_pCurrentContext->memoryManager)
 
 #include "glod_raw.h" // Get the Raw objects
+#include "glod_stream.h"
 
 class Hierarchy;
 class GLOD_Group;
 class GLOD_Cut;
-class GLOD_Object_Status ;
-
-class GLOD_Object_Status
-{
-public:
-	unsigned int name; 
-	float errorTermination;
-	int triTermination;
-
-	bool operator==(GLOD_Object_Status& status)
-	{
-		return name == status.name && triTermination == status.triTermination && errorTermination == status.errorTermination ;
-	}
-
-	bool operator!=(GLOD_Object_Status& status)
-	{
-		return name != status.name || triTermination != status.triTermination || errorTermination != status.errorTermination ;
-	}
-} ;
 
 class GLOD_Object {
 
@@ -124,6 +161,7 @@ public:
     // LockInstance/ReleaseInstance
 
     GLOD_Cut* cut;                 // Not a great word. Any better ideas?
+    GLOD_BuildJob* buildJob;       // non-NULL from glodBuildObjectAsync until attached
     int *inArea;
     //unsigned int numAreas;
     QueueMode queueMode;
@@ -132,6 +170,9 @@ public:
     int borderLock;
     int errorMetric;
     float importance;
+    bool occluder; // rasterized into its group's occlusion buffer
+    bool borrowArrays; // inserted patches may point into the caller's arrays
+    int progressiveRecords; // records each glodAdaptGroup reads while loading progressively
     SnapshotMode snapMode;
     float reductionPercent;
     int numSnapshotSpecs;
@@ -146,7 +187,10 @@ public:
 
     HeapElement budgetCoarsenHeapData;
     HeapElement budgetRefineHeapData;
-
+    char budgetDirty;            // waiting in the group's list to be re-keyed
+    int budgetTris;              // triangles counted toward the group's budget
+    unsigned int budgetRefinePass;  // last budget pass that refined this...
+    unsigned int budgetCoarsenPass; // ...and that coarsened it
 
     GLOD_Object() : budgetCoarsenHeapData(this), budgetRefineHeapData(this)
     {
@@ -154,6 +198,10 @@ public:
         group = NULL;
         hierarchy = NULL;
         cut = NULL;
+        buildJob = NULL;
+        budgetDirty = 0;
+        budgetTris = 0;
+        budgetRefinePass = budgetCoarsenPass = 0;
         prebuild_buffer = NULL;
         queueMode = Greedy;
         opType = Half_Edge_Collapse;
@@ -161,6 +209,9 @@ public:
         borderLock = 0;
         errorMetric = GLOD_METRIC_SPHERES;
         importance = 1.0;
+        occluder = false;
+        borrowArrays = false;
+        progressiveRecords = GLOD_DEFAULT_PROGRESSIVE_RECORDS;
         snapMode = PercentReduction;
         reductionPercent = 0.5;
         numSnapshotSpecs = 0;
@@ -197,8 +248,17 @@ public:
     void adaptObjectSpaceErrorThreshold(float threshold);    
 };
 
+#include "glod_instances.h"
 #include "glod_group.h"
 
+// asynchronous builds, in glod_objects.cpp
+void GLOD_AttachFinishedBuilds(GLuint groupname);
+void GLOD_ShutdownBuilds(GLODcontext *context);
+
+// object streams, in glod_objects.cpp
+int GLOD_WriteObjectStream(GLOD_Object *obj, GLOD_StreamWriter *out);
+void GLOD_ContinueProgressiveLoads(GLOD_Group *group);
+
 static void inline GLOD_SetError(int num, const char* message) {
 #ifdef DEBUG
     fprintf(stderr, "GLOD: %s.\n", message);
@@ -39,15 +39,24 @@ private:
     
     bool viewFrustumSimp;
     
-	std::vector<GLOD_Object_Status> RefinedStatusList[2] ;
-	std::vector<GLOD_Object_Status> CoarsenedStatusList[2] ;
-
 private:
     void adaptErrorThreshold();
+    void adaptErrorThresholdParallel(int numThreads);
     void adaptTriangleBudget();
     void initQueues();
     void clearQueues();
-	bool isEndlessLoop() ;
+    void updateQueues();
+    void rekeyBudgetObject(GLOD_Object *obj);
+    void insertBudgetObject(GLOD_Object *obj);
+    bool stepBudgetObject(GLOD_Object *obj, bool refine,
+                          int triTermination, float errorTermination);
+
+    // compact instances, in glod_instances.cpp
+    std::vector<GLOD_InstanceSet*> instanceSets;
+    void adaptInstances();
+    void adaptInstanceBudget(int budget);
+    float fitInstanceBudget(int budget);
+    int instanceTrisAt(float threshold);
     
     //
     // triangle budget mode stuff
@@ -62,6 +71,13 @@ private:
     char firstBudgetAdapt;
     Heap *refineQueue;
     Heap *coarsenQueue;
+
+    // the queues are kept between adapts; objects that changed in the
+    // meantime wait here to be re-keyed
+    std::vector<GLOD_Object*> budgetDirtyObjects;
+    GLOD_Object *budgetVDSObject; // stands in for all of the VDS objects
+    unsigned int budgetPass;      // counts adaptTriangleBudget calls
+    char budgetSettled;           // nothing left to do until something changes
 #ifndef GLOD_USE_TILES
     int triBudget;
     int currentNumTris;
@@ -75,6 +91,36 @@ public:
     VDS::Simplifier* mpSimplifier;
     bool vds_objects_adapted;
     int numTiles;
+
+    // profiling information reported by glodGetGroupStats
+    unsigned int adaptCount;
+    VDS::TimerTicks adaptTicks; // only accumulated with TIMING_LEVEL_1
+    unsigned int occluderTris;
+    VDS::TimerTicks occlusionTicks; // only accumulated with TIMING_LEVEL_1
+
+    // depth buffer the occluder objects are drawn into before each adapt;
+    // NULL unless GLOD_OCCLUSION_CULLING is on
+    VDS::OcclusionBuffer *occlusionBuffer;
+    int occlusionResolution;
+    // positions and indices of a discrete occluder's patch, kept between
+    // adapts so they aren't allocated every frame
+    std::vector<GLfloat> occluderVertices;
+    std::vector<GLuint> occluderIndices;
+
+    // threads error threshold adaptation may use; 0 means one per processor
+    int adaptThreads;
+
+    // most refine/coarsen steps per triangle budget adapt; 0 means no limit
+    int budgetSteps;
+    // how much better a trade of triangles between objects has to be
+    float budgetHysteresis;
+
+    // glodInstanceObject makes compact instances rather than objects
+    bool compactInstances;
+    // cuts a continuous object's compact instances share
+    int instanceTiers;
+    // triangles of the compact instances on screen, as of the last adapt
+    int instanceTris;
     
     
     
@@ -91,6 +137,9 @@ public:
         objectsChanged = budgetChanged = firstBudgetAdapt = 1;
         refineQueue = new Heap;
         coarsenQueue = new Heap;
+        budgetVDSObject = NULL;
+        budgetPass = 0;
+        budgetSettled = 0;
         //currentNumTris = 0;
         viewFrustumSimp = true;
 #ifndef GLOD_USE_TILES
@@ -107,11 +156,26 @@ public:
         mpSimplifier = new VDS::Simplifier;
         //  fprintf(stderr, "new Simplifier\n");
         vds_objects_adapted = false;
+        adaptCount = 0;
+        adaptTicks = 0;
+        occluderTris = 0;
+        occlusionTicks = 0;
+        occlusionBuffer = NULL;
+        occlusionResolution = VDS_DEFAULT_OCCLUSION_RESOLUTION;
+        adaptThreads = 0;
+        budgetSteps = 0;
+        budgetHysteresis = 0.05f;
+        compactInstances = false;
+        instanceTiers = GLOD_DEFAULT_INSTANCE_TIERS;
+        instanceTris = 0;
         
         mpSimplifier->mSimplificationBreakCount = 100;
     };
 
     ~GLOD_Group() {
+        for (unsigned int i=0; i<instanceSets.size(); i++)
+            delete instanceSets[i];
+        instanceSets.clear();
         if (objects != NULL) {
             for (int i=0; i<numObjects; i++) {
                 delete objects[i];
@@ -134,6 +198,8 @@ public:
 
         if(mpSimplifier != NULL)
             delete mpSimplifier;
+        if (occlusionBuffer != NULL)
+            delete occlusionBuffer;
     }
     
     void changeLayout(){
@@ -159,6 +225,11 @@ public:
     GLOD_Object* getObject(int index) { return objects[index];}
     void addObject(GLOD_Object*);
     void removeObject(int index);
+    void objectChanged(GLOD_Object *obj);
+    void objectLoaded(GLOD_Object *obj);
+    void addInstance(GLOD_Object *source, GLuint name);
+    void removeInstance(GLOD_InstanceSet *set, int index);
+    int getNumInstanceSets() { return (int) instanceSets.size(); }
     
     void setTriBudget(int budget)
     {
@@ -170,6 +241,16 @@ public:
 #endif
         budgetChanged = 1;
     }
+    void setBudgetSteps(int steps)
+    {
+        budgetSteps = steps;
+        budgetSettled = 0; // a pass it cut short can carry on
+    }
+    void setBudgetHysteresis(float hysteresis)
+    {
+        budgetHysteresis = hysteresis;
+        budgetSettled = 0; // trades it turned down may now be made
+    }
     void setAdaptMode(AdaptMode mode)
     {
         adaptMode = mode;
@@ -179,6 +260,7 @@ public:
     void setErrorMode(ErrorMode mode)
     {
         errorMode = mode;
+        firstBudgetAdapt = 1; // the queues' keys are in the old mode
         if (mpSimplifier != NULL)
         {
             switch (errorMode)
@@ -206,7 +288,33 @@ public:
     {
         objectSpaceErrorThreshold = threshold;
     }
+    void setViewFrustumSimp(bool enable)
+    {
+        viewFrustumSimp = enable;
+    }
+    
+    void setOcclusionCulling(bool enable)
+    {
+        if (enable && (occlusionBuffer == NULL))
+        {
+            occlusionBuffer = new VDS::OcclusionBuffer;
+            occlusionBuffer->SetResolution(occlusionResolution, occlusionResolution);
+        }
+        else if (!enable && (occlusionBuffer != NULL))
+        {
+            delete occlusionBuffer;
+            occlusionBuffer = NULL;
+        }
+        mpSimplifier->SetOcclusionBuffer(occlusionBuffer);
+    }
+    void setOcclusionResolution(int resolution)
+    {
+        occlusionResolution = resolution;
+        if (occlusionBuffer != NULL)
+            occlusionBuffer->SetResolution(resolution, resolution);
+    }
     
+    void rasterizeOccluders();
     void adapt();
     
     AdaptMode GetAdaptMode() { return adaptMode; }
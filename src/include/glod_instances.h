@@ -0,0 +1,128 @@
+/* GLOD: Compact instances
+ ***************************************************************************/
+/******************************************************************************
+ * Copyright 2003 Jonathan Cohen, Nat Duca, David Luebke, Brenden Schubert    *
+ *                Johns Hopkins University and University of Virginia         *
+ ******************************************************************************
+ * This file is distributed as part of the GLOD library, and as such, falls   *
+ * under the terms of the GLOD public license. GLOD is distributed without    *
+ * any warranty, implied or otherwise. See the GLOD license for more details. *
+ *                                                                            *
+ * You should have recieved a copy of the GLOD Open-Source License with this  *
+ * copy of GLOD; if not, please visit the GLOD web page,                      *
+ * http://www.cs.jhu.edu/~graphics/GLOD/license for more information          *
+ ******************************************************************************/
+#ifndef GLOD_INSTANCES_H
+#define GLOD_INSTANCES_H
+
+#include <vector>
+
+#define GLOD_MAX_INSTANCE_TIERS 16
+#define GLOD_DEFAULT_INSTANCE_TIERS 8
+
+// tier of an instance that is entirely off screen, or that hasn't been
+// adapted yet; it has no triangles to draw or read back
+#define GLOD_INSTANCE_HIDDEN 0xff
+
+class GLOD_Cut;
+
+/* The compact instances of one object in one group, made by
+ * glodInstanceObject() when the group has GLOD_COMPACT_INSTANCES on.
+ *
+ * An instance has no GLOD_Object and no cut of its own, only a record:
+ * its name, transform, importance, and the tier it is drawn with, kept
+ * in arrays indexed by instance. The tiers are a few cuts every instance
+ * shares. A discrete object has one per level. A continuous object has
+ * GLOD_INSTANCE_TIERS of them, adapted to object space errors an octave
+ * apart, so each tier covers a band of distances from the viewer.
+ *
+ * Each instance's error is measured once per transform, from the screen
+ * size of the object's bounding box; it then takes the coarsest tier
+ * that keeps its error under the group's threshold.
+ */
+class GLOD_InstanceSet
+{
+public:
+    GLOD_Group *group;
+    Hierarchy *hierarchy;      // locked once for the whole set
+    HashTable *patch_id_map;   // copy of the source object's, also +1
+    bool continuous;
+
+    // per instance; removing one moves the last into its place
+    std::vector<GLuint> names;
+    std::vector<float> xforms;        // 16 each, as GLOD_View::matrix
+    std::vector<float> importance;
+    std::vector<float> scales;        // screen space error per unit of
+                                      // object space error; 0 off screen,
+                                      // < 0 until measured
+    std::vector<unsigned char> tiers; // or GLOD_INSTANCE_HIDDEN
+    HashTable *index_hash;            // name -> index+1
+
+    // the shared cuts, finest first
+    int numTiers;
+    GLOD_Cut **tierCuts;
+    float *tierErrors;         // object space error of each
+    int *tierInstances;        // instances on each that are on screen
+    GLOD_Object **tierObjects; // continuous: each tier is adapted by
+    GLOD_Group **tierGroups;   // a group of its own
+    int tierBase;              // continuous: tierErrors[t] is 2^(tierBase+t)
+
+    float boxCenter[3];        // the object's bounding box, which each
+    float boxOffsets[3];       // instance is measured by
+
+    int numTris;               // of the instances on screen
+    int numUnmeasured;         // instances whose scale is < 0
+
+    GLOD_InstanceSet(GLOD_Group *group, GLOD_Object *source, int numTiers);
+    ~GLOD_InstanceSet();
+
+    static bool canInstance(GLOD_Object *source);
+
+    int getNumInstances() { return (int) names.size(); }
+    int find(GLuint name)
+    {
+        return HashtableSearchInt(index_hash, name) - 1;
+    }
+    // NULL if the instance is hidden
+    GLOD_Cut *getCut(int index)
+    {
+        int tier = tiers[index];
+        return (tier == GLOD_INSTANCE_HIDDEN) ? NULL : tierCuts[tier];
+    }
+
+    void add(GLuint name, float importance);
+    void remove(int index);
+    void setXform(int index, float m1[16], float m2[16], float m3[16]);
+    void setMatrix(int index, const float rows[16]);
+    void setImportance(int index, float value);
+    float currentError(int index, ErrorMode mode);
+
+    void measure();
+    int trisAt(ErrorMode mode, float threshold);
+    // how far adapt() may move continuous tiers
+    enum TierMotion { HoldTiers, StepTiers, JumpTiers };
+    bool adapt(ErrorMode mode, float threshold, int tierCount, TierMotion motion);
+    void guessTiers(int tierCount);
+    float maxThreshold(ErrorMode mode);
+
+private:
+    float assignedThreshold;
+    ErrorMode assignedMode;
+    bool remeasured;           // scales changed since the tiers were picked
+
+    float measureScale(int index);
+    float requiredError(int index, ErrorMode mode, float threshold);
+    int pickTier(float required);
+    void makeTiers(int count);
+    void freeTiers();
+    bool placeTiers(float finest, TierMotion motion);
+};
+
+// the compact instance called name, if there is one
+GLOD_InstanceSet *GLOD_FindInstance(GLuint name, int *index);
+void GLOD_GetInstanceParameteriv(GLOD_InstanceSet *set, int index,
+                                 GLenum pname, GLint *param);
+void GLOD_GetInstanceParameterfv(GLOD_InstanceSet *set, int index,
+                                 GLenum pname, GLfloat *param);
+
+#endif /* GLOD_INSTANCES_H */
@@ -18,18 +18,26 @@
 #ifndef GLOD_RAW_H
 #define GLOD_RAW_H
 
+#include <stdlib.h>
+#include <string.h>
+
 #define GLOD_HAS_VERTEX_COLORS_3  0x0001
 #define GLOD_HAS_VERTEX_COLORS_4  0x0002
 #define GLOD_HAS_VERTEX_NORMALS   0x0004
 #define GLOD_HAS_TEXTURE_COORDS_2 0x0008
 #define GLOD_HAS_TEXTURE_COORDS_3 0x0010
 
+/* arrays a patch points into but doesn't own (see GLOD_BORROW_ARRAYS) */
+#define GLOD_BORROWED_VERTICES    0x0001 /* all of the vertex data */
+#define GLOD_BORROWED_TRIANGLES   0x0002
+
 class GLOD_RawPatch {
  public:
   int name;
   GLuint level;
   GLfloat geometric_error;
   unsigned int data_flags; /* one of the above constants */
+  unsigned int borrowed;   /* GLOD_BORROWED_* bits; these aren't freed */
   
   unsigned int num_triangles;
   unsigned int num_vertices;
@@ -44,6 +52,7 @@ class GLOD_RawPatch {
  public:
   GLOD_RawPatch() { 
       num_triangles = num_vertices = 0;
+      borrowed = 0;
       triangles = NULL;
       vertices = vertex_texture_coords = vertex_normals = vertex_colors = NULL;
   };
@@ -81,6 +90,119 @@ class GLOD_RawObject {
   unsigned int bufsize;
 };
 
+/* GLOD_FillScratch: per-context tables GLOD_FillTarget numbers vertices
+ * with. remap is all -1 between fills, so it is never cleared wholesale.
+ */
+class GLOD_FillScratch {
+ public:
+  GLint* remap;   /* source vertex -> number in the patch, or -1 */
+  GLuint* order;  /* number in the patch -> source vertex */
+  GLuint remap_size, order_size;
+
+  GLOD_FillScratch() { remap = NULL; order = NULL; remap_size = order_size = 0; }
+  ~GLOD_FillScratch() { free(remap); free(order); }
+
+  void reserve(GLuint num_src_vertices, GLuint num_indices) {
+    if(num_src_vertices > remap_size) {
+      remap = (GLint*) realloc(remap, sizeof(GLint) * num_src_vertices);
+      memset(remap + remap_size, 0xff, sizeof(GLint) * (num_src_vertices - remap_size));
+      remap_size = num_src_vertices;
+    }
+    if(num_indices > order_size) {
+      order = (GLuint*) realloc(order, sizeof(GLuint) * num_indices);
+      order_size = num_indices;
+    }
+  }
+};
+
+template <class Index, class Source>
+inline GLuint GLOD_RemapIndices(const Source* src, GLuint n, Index* dst, GLuint base,
+                                GLint* remap, GLuint* order) {
+  GLuint used = 0;
+  for(GLuint k = 0; k < n; k++) {
+    GLint d = remap[src[k]];
+    if(d < 0) {
+      d = remap[src[k]] = (GLint) used;
+      order[used++] = (GLuint) src[k];
+    }
+    dst[k] = (Index) (base + d);
+  }
+  for(GLuint k = 0; k < used; k++)
+    remap[order[k]] = -1;
+  return used;
+}
+
+template <class Index, class Source>
+inline void GLOD_CopyIndices(const Source* src, GLuint n, Index* dst, GLuint base) {
+  for(GLuint k = 0; k < n; k++)
+    dst[k] = (Index) (base + src[k]);
+}
+
+/* GLOD_FillTarget: the caller's vertex arrays, which GLOD_Cut::fill()
+ * writes a patch into without a GLOD_RawPatch in between. Positions,
+ * normals and texture coordinates are GL_FLOAT; colors are GL_FLOAT or
+ * GL_UNSIGNED_BYTE. Unused arrays are NULL and strides are in bytes.
+ * Indices are GL_UNSIGNED_INT or GL_UNSIGNED_SHORT, offset by index_base;
+ * if indices is NULL a vertex is written per index instead, as
+ * glodFillArrays() does. Nothing is read back from the arrays, so they may
+ * be mapped buffer objects.
+ */
+class GLOD_FillTarget {
+ public:
+  char* vertices;        GLsizei vertex_stride;
+  char* normals;         GLsizei normal_stride;
+  char* texture_coords;  GLsizei texture_coord_stride;
+  char* colors;          GLsizei color_stride;  GLenum color_type;
+  void* indices;         GLenum index_type;     GLuint index_base;
+  GLOD_FillScratch* scratch;
+
+  GLuint num_vertices; /* set by fill() */
+  GLuint num_indices;
+
+  /* writes n indices, numbering the num_src_vertices source vertices in
+     the order they are first used; scratch->order then maps each number
+     back. Returns how many vertices were used. */
+  template <class Source>
+  GLuint remapIndices(const Source* src, GLuint n, GLuint num_src_vertices) {
+    scratch->reserve(num_src_vertices, n);
+    if(index_type == GL_UNSIGNED_SHORT)
+      return GLOD_RemapIndices(src, n, (GLushort*) indices, index_base,
+                               scratch->remap, scratch->order);
+    return GLOD_RemapIndices(src, n, (GLuint*) indices, index_base,
+                             scratch->remap, scratch->order);
+  }
+
+  /* writes n indices as they are */
+  template <class Source>
+  void copyIndices(const Source* src, GLuint n) {
+    if(index_type == GL_UNSIGNED_SHORT)
+      GLOD_CopyIndices(src, n, (GLushort*) indices, index_base);
+    else
+      GLOD_CopyIndices(src, n, (GLuint*) indices, index_base);
+  }
+
+  /* writes vertex i; attributes the source lacks are passed as NULL and
+     left alone, as readback() leaves them */
+  void setVertex(GLuint i, const GLfloat* position, const GLfloat* normal,
+                 const GLfloat* texcoord, const unsigned char* color) {
+    memcpy(vertices + (ptrdiff_t) i * vertex_stride, position, 3 * sizeof(GLfloat));
+    if(normals && normal)
+      memcpy(normals + (ptrdiff_t) i * normal_stride, normal, 3 * sizeof(GLfloat));
+    if(texture_coords && texcoord)
+      memcpy(texture_coords + (ptrdiff_t) i * texture_coord_stride, texcoord, 2 * sizeof(GLfloat));
+    if(colors && color) {
+      char* dst = colors + (ptrdiff_t) i * color_stride;
+      if(color_type == GL_UNSIGNED_BYTE) {
+        memcpy(dst, color, 3);
+      } else {
+        GLfloat c[3];
+        c[0] = color[0] / 255.0f; c[1] = color[1] / 255.0f; c[2] = color[2] / 255.0f;
+        memcpy(dst, c, sizeof(c));
+      }
+    }
+  }
+};
+
 #endif
 /***************************************************************************
  * $Log: glod_raw.h,v $
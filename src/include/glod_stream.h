@@ -0,0 +1,173 @@
+/* GLOD: Object streams
+ ***************************************************************************/
+/******************************************************************************
+ * Copyright 2003 Jonathan Cohen, Nat Duca, David Luebke, Brenden Schubert    *
+ *                Johns Hopkins University and University of Virginia         *
+ ******************************************************************************
+ * This file is distributed as part of the GLOD library, and as such, falls   *
+ * under the terms of the GLOD public license. GLOD is distributed without    *
+ * any warranty, implied or otherwise. See the GLOD license for more details. *
+ *                                                                            *
+ * You should have recieved a copy of the GLOD Open-Source License with this  *
+ * copy of GLOD; if not, please visit the GLOD web page,                      *
+ * http://www.cs.jhu.edu/~graphics/GLOD/license for more information          *
+ ******************************************************************************/
+#ifndef GLOD_STREAM_H
+#define GLOD_STREAM_H
+
+#include <stddef.h>
+
+/* The container glodWriteObject, glodReadObject, glodMapObject and
+ * glodReadbackObject use for whole objects.
+ *
+ * A stream is a GLOD_StreamHeader followed by chunks. Each chunk is a
+ * GLOD_StreamChunk and then its payload; zero padding before the chunk
+ * header puts every payload on a multiple of GLOD_STREAM_ALIGNMENT bytes
+ * from the start of the stream, so arrays in a mapped stream can be used
+ * in place. The checksum is the Adler-32 of the payload alone.
+ *
+ * An object is an OBJ chunk, its hierarchy's chunks, and an END chunk:
+ *   OBJ   format, patch count, then (name, packed id) per patch
+ *   discrete: DHDR (operator, level count, errors), and per level a DLOD
+ *         (patch count) followed by a DPCH per patch: a flag, then if it
+ *         is set AttribSetArray::copyLayout() and the vertex data, then
+ *         the index count and indices
+ *   continuous: VHDR (a VDS::VDSFileHeader), then VERR, VNOD, VREN and
+ *         VTRI holding the forest's arrays exactly as they are in memory
+ *
+ * glodWriteProgressiveObject writes a continuous object as an OBJ chunk,
+ * a VPRG chunk holding a progressive VDS stream (see forestprogressive.cpp)
+ * and an END chunk. The VPRG payload is read a record at a time while the
+ * object is in use, so its checksum is only checked once it has all arrived.
+ *
+ * The stream ends padded to a multiple of GLOD_STREAM_ALIGNMENT, so
+ * streams can be concatenated and each still mapped in place.
+ *
+ * Everything is in the writer's byte order, which byte_order records.
+ * Readers reject other major versions; newer minor versions only add
+ * chunk types, which readers skip.
+ */
+#define GLOD_STREAM_FOURCC(a,b,c,d) \
+    ((GLuint)(a) | ((GLuint)(b) << 8) | ((GLuint)(c) << 16) | ((GLuint)(d) << 24))
+
+#define GLOD_STREAM_MAGIC         GLOD_STREAM_FOURCC('G','L','O','D')
+#define GLOD_STREAM_VERSION_MAJOR 1
+#define GLOD_STREAM_VERSION_MINOR 1
+#define GLOD_STREAM_BYTE_ORDER    0x01020304
+#define GLOD_STREAM_ALIGNMENT     64
+
+#define GLOD_CHUNK_OBJECT     GLOD_STREAM_FOURCC('O','B','J',' ')
+#define GLOD_CHUNK_END        GLOD_STREAM_FOURCC('E','N','D',' ')
+#define GLOD_CHUNK_DISCRETE   GLOD_STREAM_FOURCC('D','H','D','R')
+#define GLOD_CHUNK_LEVEL      GLOD_STREAM_FOURCC('D','L','O','D')
+#define GLOD_CHUNK_PATCH      GLOD_STREAM_FOURCC('D','P','C','H')
+#define GLOD_CHUNK_VDS        GLOD_STREAM_FOURCC('V','H','D','R')
+#define GLOD_CHUNK_VDS_ERRORS GLOD_STREAM_FOURCC('V','E','R','R')
+#define GLOD_CHUNK_VDS_NODES  GLOD_STREAM_FOURCC('V','N','O','D')
+#define GLOD_CHUNK_VDS_RENDER GLOD_STREAM_FOURCC('V','R','E','N')
+#define GLOD_CHUNK_VDS_TRIS   GLOD_STREAM_FOURCC('V','T','R','I')
+#define GLOD_CHUNK_VDS_PROGRESSIVE GLOD_STREAM_FOURCC('V','P','R','G')
+
+#ifdef _WIN32
+typedef unsigned __int64 GLOD_StreamSize;
+#else
+typedef unsigned long long GLOD_StreamSize;
+#endif
+
+struct GLOD_StreamHeader
+{
+    GLuint magic;             // GLOD_STREAM_MAGIC
+    GLuint version_major;
+    GLuint version_minor;
+    GLuint header_size;       // sizeof(GLOD_StreamHeader)
+    GLuint chunk_header_size; // sizeof(GLOD_StreamChunk)
+    GLuint alignment;         // GLOD_STREAM_ALIGNMENT
+    GLuint byte_order;        // GLOD_STREAM_BYTE_ORDER
+    GLuint reserved;
+};
+
+struct GLOD_StreamChunk
+{
+    GLuint type;
+    GLuint flags;             // 0; reserved
+    GLOD_StreamSize size;     // of the payload, without padding
+    GLuint checksum;
+    GLuint reserved[3];
+};
+
+GLuint GLOD_Adler32(GLuint adler, const void* data, size_t size);
+
+/* Writes a stream through a GLODwriteproc, or only counts its size if
+ * there is none. Chunks are written from pieces, so their contents go
+ * straight from the hierarchy's arrays to the stream.
+ */
+class GLOD_StreamWriter
+{
+ private:
+    GLODwriteproc proc;
+    GLvoid* user_data;
+    GLOD_StreamSize offset;
+    bool failed;
+
+    int put(const void* data, size_t size);
+    
+ public:
+    GLOD_StreamWriter(GLODwriteproc write, GLvoid* user_data);
+
+    int begin();
+    int writeChunk(GLuint type, int count, const void* const* data, const size_t* sizes);
+    int writeChunk(GLuint type, const void* data, size_t size) {
+        return writeChunk(type, 1, &data, &size);
+    }
+    // for payloads made on the fly: the chunk header, given the payload's
+    // size and checksum, after which the payload goes through write()
+    int beginChunk(GLuint type, GLOD_StreamSize size, GLuint checksum);
+    int write(const void* data, size_t size) { return put(data, size); }
+    int end();
+
+    GLOD_StreamSize getSize() { return offset; }
+};
+
+/* Reads a stream a chunk at a time, from a GLODreadproc or from memory.
+ * Payloads are read in order with read(); a memory reader set up for
+ * in place loading can also hand out pointers into them with map().
+ * Failures set the GLOD error and make every later call fail too.
+ */
+class GLOD_StreamReader
+{
+ private:
+    GLODreadproc proc;
+    GLvoid* user_data;
+    const char* data;          // memory readers
+    GLOD_StreamSize data_size;
+    bool in_place;
+    
+    GLOD_StreamSize offset;
+    GLOD_StreamChunk chunk;
+    GLOD_StreamSize remaining; // of the current payload
+    GLuint checksum;
+    bool failed;
+
+    int get(void* dst, size_t size);
+    int skip(GLOD_StreamSize size);
+    int fail(int error, const char* message);
+    
+ public:
+    GLOD_StreamReader(GLODreadproc read, GLvoid* user_data);
+    GLOD_StreamReader(const void* data, GLOD_StreamSize size, bool in_place);
+
+    // whether the stream starts with a GLOD_StreamHeader
+    static bool isStream(const void* data);
+
+    int begin();
+    int nextChunk(GLuint type);
+    int read(void* dst, size_t size);
+    void* map(size_t size);
+    int endChunk();
+    int end();
+
+    bool inPlace() { return in_place; }
+    GLOD_StreamSize getRemaining() { return remaining; }
+};
+
+#endif /* GLOD_STREAM_H */
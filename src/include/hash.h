@@ -12,22 +12,48 @@
 extern "C" {
 #endif
 
-#define HASH_DEFAULT_NUM_BUCKETS 1047
+/* Keys below HASH_DENSE_MAX_KEYS index an array directly; the rest go in an
+ * open-addressed table with linear probing. GLOD names and patch ids are
+ * usually small integers, so most lookups are a single array access.
+ *
+ * HashtableSearch() may be called from any number of threads without a lock
+ * while one thread adds, replaces or deletes entries. Writers must still be
+ * serialized by the caller. Data pointers must not be NULL, since NULL is
+ * what HashtableSearch() returns for a missing key.
+ *
+ * Growing or rehashing a table replaces its slot array, and a search on
+ * another thread may still be probing the old one, so old arrays are kept
+ * until HashtableReclaim() or the table is freed. Call HashtableReclaim()
+ * at a point where no search on the table can be in progress; without it
+ * a table whose names keep coming and going keeps every array it had.
+ * GLOD's name tables are only searched from their context's thread, and
+ * glodAdaptGroup() reclaims them. */
+#define HASH_DEFAULT_SIZE 1024
+#define HASH_DENSE_MAX_KEYS 65536
 
 typedef struct HashNode {
         unsigned int key;
         void *data;
-        struct HashNode *next;
 } HashNode;
 
+typedef struct HashSlots {
+        unsigned int size;
+        struct HashSlots *next_retired;
+        HashNode nodes[1];
+} HashSlots;
+
 typedef struct HashTable {
-        unsigned int num_buckets;
         unsigned int num_elements;
-        HashNode **buckets;
+        HashSlots *dense;        /* indexed by key; NULL until a small key is added */
+        HashSlots *open;         /* power of two sized; NULL until a large key is added */
+        unsigned int open_live;  /* entries in the open table... */
+        unsigned int open_deleted; /* ...and the tombstones they left behind */
+        unsigned int open_size_hint;
+        HashSlots *retired;      /* arrays replaced while readers may still be using them */
 } HashTable;
 
 HashTable *AllocHashtable( void );
-HashTable *AllocHashtableBySize( int num_buckets );
+HashTable *AllocHashtableBySize( int size_hint );
 void FreeHashtable( HashTable *hash );
 void FreeHashtableCautious ( HashTable *hash ); // does not free data pointer
 void HashtableAdd( HashTable *h, unsigned int key, void *data );
@@ -37,12 +63,19 @@ void *HashtableSearch( HashTable *h, unsigned int key );
 int HashtableSearchInt(HashTable* h, unsigned int key);
 void HashtableReplace( HashTable *h, unsigned int key, void *data, int free_mem );
 unsigned int HashtableNumElements( HashTable *h) ;
+void HashtableReclaim( HashTable *h );
+
+/* slot access for the walk macros; HashtableSlot() returns NULL for slots
+ * that hold no entry */
+unsigned int HashtableNumSlots( HashTable *h );
+HashNode *HashtableSlot( HashTable *h, unsigned int index );
+HashNode *HashtableFirstNode( HashTable *h );
 
 #define HASHTABLE_WALK( h, t ) {         \
   HashNode *t;                            \
-  int _;                                        \
-  for (_ = 0 ; _ < h->num_buckets ; _++) {  \
-    for (t = h->buckets[_] ; t; t = t->next)   {
+  unsigned int _, _n = HashtableNumSlots(h);    \
+  for (_ = 0 ; _ < _n ; _++) {  \
+    if ((t = HashtableSlot(h, _)) != NULL)   {
 
 
 #define HASHTABLE_WALK_END( h )          \
@@ -51,13 +84,7 @@ unsigned int HashtableNumElements( HashTable *h) ;
 }
 
 #define HASHTABLE_FIRST_NODE( h, t ) \
-   HashNode *t = NULL; \
-   int _; \
-   for (_ = 0 ; _ < h->num_buckets ; _++) {  \
-		if(h->buckets[_] != NULL)	    \
-			break; \
-   } \
-   t = h->buckets[_];
+   HashNode *t = HashtableFirstNode(h);
 
 
 #ifdef __cplusplus
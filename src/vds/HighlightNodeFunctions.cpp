@@ -49,9 +49,9 @@ void Cut::PrintHighlightedNodeInfo()
 	cout << "\tFirst Child: " << mpForest->mpNodes[miHighlightedNode].miFirstChild << endl;
 	cout << "\tLeft Sibling: " << mpForest->mpNodes[miHighlightedNode].miLeftSibling << endl;
 	cout << "\tRight Sibling: " << mpForest->mpNodes[miHighlightedNode].miRightSibling << endl;
-	cout << "\tPosition: (" << mpForest->mpNodes[miHighlightedNode].mpRenderData->Position.X << ", "
-		<< mpForest->mpNodes[miHighlightedNode].mpRenderData->Position.Y << ", "
-		<< mpForest->mpNodes[miHighlightedNode].mpRenderData->Position.Z << ")" << endl;
+	cout << "\tPosition: (" << mpForest->GetNodeRenderData(miHighlightedNode)->Position.X << ", "
+		<< mpForest->GetNodeRenderData(miHighlightedNode)->Position.Y << ", "
+		<< mpForest->GetNodeRenderData(miHighlightedNode)->Position.Z << ")" << endl;
 }
 
 void Cut::PrintHighlightedNodeStructure()
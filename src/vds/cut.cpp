@@ -17,6 +17,7 @@
 #endif
 
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include "cut.h"
 #include "forest.h"
@@ -40,6 +41,9 @@ Cut::Cut()
 								0, 0, 1, 0,
 								0, 0, 0, 1};
 	mTransformMatrix.Set(identitymatrix);
+	CalcFrustumPlanes();
+	mFrustumStamp = 1;
+	mCulledStamp = 0;
 	miHighlightedNode = 0;
 	miHighlightedTri = 0;
 	mpExternalViewClass = NULL;
@@ -52,6 +56,9 @@ Cut::~Cut()
 		int i;
         unsigned int j;
 
+        // return parked nodes to the unfold queue so they're nullified below with the rest
+        mpSimplifier->UnparkAll(this);
+
         // nullify the mpNodeRefs that are in the fold queue ... they're already free'd
         NodeQueue* q = mpSimplifier->mpFoldQueue;
         for(i = 0; i <= q->Size; i++)
@@ -147,11 +154,50 @@ void Cut::SetForest(Forest *pForest)
 void Cut::SetTransformationMatrix(float *ColMajorFloat16Matrix)
 {
 	mTransformMatrix.Set(ColMajorFloat16Matrix);
+	CalcFrustumPlanes();
+	++mFrustumStamp;
 }
 
 void Cut::SetTransformationMatrix(Mat4 ColMajorFloat16Matrix)
 {
     mTransformMatrix = ColMajorFloat16Matrix;
+	CalcFrustumPlanes();
+	++mFrustumStamp;
+}
+
+void Cut::CalcFrustumPlanes()
+{
+	// a point p is inside the clip volume when -w <= x,y,z <= w for (x,y,z,w) = M p, so each
+	// plane is the sum or difference of the fourth row of M and one of the first three
+	const Float (*m)[4] = mTransformMatrix.cells;
+	int i;
+
+	for (i = 0; i < 3; ++i)
+	{
+		mFrustumPlanes[2*i].Set(m[3][0] + m[i][0], m[3][1] + m[i][1], m[3][2] + m[i][2], -(m[3][3] + m[i][3]));
+		mFrustumPlanes[2*i+1].Set(m[3][0] - m[i][0], m[3][1] - m[i][1], m[3][2] - m[i][2], -(m[3][3] - m[i][3]));
+	}
+}
+
+bool Cut::BoxOutsideFrustum(const BudgetItem *pItem, unsigned char &rPlaneMask) const
+{
+	Float Distance, Radius;
+	int i;
+
+	for (i = 0; i < 6; ++i)
+	{
+		if (!(rPlaneMask & (1 << i)))
+			continue;
+		const Plane3 &rPlane = mFrustumPlanes[i];
+		// distance of the box center from the plane, and of the box's farthest corner from its center
+		Distance = rPlane * pItem->mBBoxCenter;
+		Radius = fabs(rPlane.A) * pItem->mXBBoxOffset + fabs(rPlane.B) * pItem->mYBBoxOffset + fabs(rPlane.C) * pItem->mZBBoxOffset;
+		if (Distance < -Radius)
+			return true;
+		if (Distance >= Radius)
+			rPlaneMask &= ~(1 << i);
+	}
+	return false;
 }
 
 /*
@@ -263,6 +309,118 @@ void Cut::InitializeRefs()
 		mpTriRefs[i] = NULL;
 }
 
+const unsigned int Cut::VDS_CUT_SNAPSHOT_VERSION = 1;
+
+bool Cut::NodeIsUnfolded(NodeIndex iNode) const
+{
+	NodeIndex iChild = mpForest->mpNodes[iNode].miFirstChild;
+	return ((mpNodeRefs[iNode] != NULL) && (iChild != Forest::iNIL_NODE) && (mpNodeRefs[iChild] != NULL));
+}
+
+NodeIndex Cut::GetUnfoldedNodes(NodeIndex *pNodes)
+{
+	Node *pForestNodes = mpForest->mpNodes;
+	NodeIndex iNode = Forest::iROOT_NODE;
+	NodeIndex NumUnfolded = 0;
+
+	// preorder walk of the active part of the forest
+	while (iNode != Forest::iNIL_NODE)
+	{
+		if (NodeIsUnfolded(iNode))
+		{
+			if (pNodes != NULL)
+				pNodes[NumUnfolded] = iNode;
+			++NumUnfolded;
+			iNode = pForestNodes[iNode].miFirstChild;
+			continue;
+		}
+		while ((iNode != Forest::iNIL_NODE) && (pForestNodes[iNode].miRightSibling == Forest::iNIL_NODE))
+			iNode = pForestNodes[iNode].miParent;
+		if (iNode != Forest::iNIL_NODE)
+			iNode = pForestNodes[iNode].miRightSibling;
+	}
+	return NumUnfolded;
+}
+
+// snapshot layout, all unsigned ints: version, forest node count, forest tri count,
+// number of unfolded nodes, then the unfolded nodes in preorder
+unsigned int Cut::GetSnapshotSize()
+{
+	return (4 + GetUnfoldedNodes(NULL)) * sizeof(unsigned int);
+}
+
+void Cut::SaveSnapshot(void *pData)
+{
+	unsigned int *pHeader = (unsigned int *) pData;
+	NodeIndex NumUnfolded = GetUnfoldedNodes(NULL);
+	NodeIndex *pNodes = new NodeIndex[NumUnfolded + 1];
+	NodeIndex i;
+
+	GetUnfoldedNodes(pNodes);
+	pHeader[0] = VDS_CUT_SNAPSHOT_VERSION;
+	pHeader[1] = mpForest->mNumNodes;
+	pHeader[2] = mpForest->mNumTris;
+	pHeader[3] = NumUnfolded;
+	for (i = 0; i < NumUnfolded; ++i)
+		pHeader[4 + i] = pNodes[i];
+	delete[] pNodes;
+}
+
+bool Cut::LoadSnapshot(const void *pData)
+{
+	const unsigned int *pHeader = (const unsigned int *) pData;
+	unsigned int NumUnfolded, i;
+	unsigned int NumTris, BytesUsed;
+	NodeIndex iNode;
+
+	if (pHeader[0] != VDS_CUT_SNAPSHOT_VERSION)
+	{
+		cerr << "Error - cut snapshot version " << pHeader[0] << " not supported" << endl;
+		return false;
+	}
+	if ((pHeader[1] != mpForest->mNumNodes) || (pHeader[2] != mpForest->mNumTris))
+	{
+		cerr << "Error - cut snapshot was not saved from a cut of this forest" << endl;
+		return false;
+	}
+	if ((mpSimplifier == NULL) || (mpNodeRefs[Forest::iROOT_NODE] == NULL))
+	{
+		cerr << "Error - cut must be added to a simplifier before loading a snapshot" << endl;
+		return false;
+	}
+	NumUnfolded = pHeader[3];
+	for (i = 0; i < NumUnfolded; ++i)
+	{
+		if ((pHeader[4 + i] < Forest::iROOT_NODE) || (pHeader[4 + i] > mpForest->mNumNodes))
+		{
+			cerr << "Error - cut snapshot node " << pHeader[4 + i] << " out of range" << endl;
+			return false;
+		}
+	}
+
+	NumTris = mpSimplifier->GetTriangleCount();
+	BytesUsed = mpSimplifier->GetMemoryUsage();
+
+	// fold the cut back to its roots in one bottom-up walk of its unfolded nodes
+	for (iNode = Forest::iROOT_NODE; iNode != Forest::iNIL_NODE; iNode = mpForest->mpNodes[iNode].miRightSibling)
+		mpSimplifier->FoldSubtree(this, iNode, NumTris, BytesUsed);
+
+	// parents come before children, so each node is active by the time it's unfolded
+	for (i = 0; i < NumUnfolded; ++i)
+	{
+		iNode = pHeader[4 + i];
+		if (NodeIsUnfolded(iNode))
+			continue; // already unfolded along with a coincident node
+		if (mpNodeRefs[iNode] == NULL)
+		{
+			cerr << "Error - cut snapshot node " << iNode << " is not in the cut when it is unfolded" << endl;
+			return false;
+		}
+		mpSimplifier->Unfold(mpNodeRefs[iNode], NumTris, BytesUsed);
+	}
+	return true;
+}
+
 void Cut::CheckForDuplicateNodeRefs()
 {
 	NodeIndex i,j;
@@ -19,6 +19,9 @@
 #include "simplifier.h"
 #include "forest.h"
 
+// plane mask with a bit set for each of the six frustum planes
+#define VDS_ALL_FRUSTUM_PLANES 0x3F
+
 class VDS::Cut
 {
 public: // PUBLIC FUNCTIONS
@@ -42,12 +45,31 @@ public: // PUBLIC FUNCTIONS
 	void SetTransformationMatrix(float *ColMajorFloat16Matrix);
 	void SetTransformationMatrix(Mat4 ColMajorFloat16Matrix);
 
+	// extracts the view frustum planes from the transformation matrix; called by SetTransformationMatrix()
+	void CalcFrustumPlanes();
+
+	// tests pItem's bbox against the frustum planes whose bits are set in rPlaneMask, clearing
+	// the bits of planes the box is entirely inside of; returns true if the box is entirely
+	// outside one of the planes
+	bool BoxOutsideFrustum(const BudgetItem *pItem, unsigned char &rPlaneMask) const;
+
 	// Updates the cut's simplifiers view parameters from cut's transform matrix
 	// Call after SetTransformationMatrix() to update the view-dependent simplification parameters using the new matrix
 //	void UpdateViewParametersFromMatrix();
 
 	// initializes NodeRefs and TriRefs
 	void InitializeRefs();
+
+	// cut snapshots record the nodes that are unfolded in the cut, parents first; loading
+	// a snapshot folds the cut back to the root node and then replays those unfolds
+	unsigned int GetSnapshotSize();
+	void SaveSnapshot(void *pData);
+	bool LoadSnapshot(const void *pData);
+
+	// fills pNodes (if not NULL) with the unfolded nodes of the cut in preorder;
+	// returns the number of unfolded nodes
+	NodeIndex GetUnfoldedNodes(NodeIndex *pNodes);
+	bool NodeIsUnfolded(NodeIndex iNode) const;
 	
 // DEBUG FUNCTIONS
 	void CheckForDuplicateNodeRefs();
@@ -72,6 +94,8 @@ public: // DEBUG FUNCTIONS
 	void PrintHighlightedTriInfo();
 
 public: // PUBLIC DATA
+	static const unsigned int VDS_CUT_SNAPSHOT_VERSION;
+
 	Forest *mpForest;
 	Renderer *mpRenderer;
 	Simplifier *mpSimplifier;
@@ -83,6 +107,13 @@ public: // PUBLIC DATA
 	unsigned int mBytesPerNode;
 	Mat4 mTransformMatrix; // object-to-eye transformation matrix
 
+	// frustum planes extracted from mTransformMatrix, oriented so that Plane * Point >= 0 inside;
+	// mFrustumStamp changes whenever the matrix does, and mCulledStamp records the stamp the
+	// simplifier last culled this cut's subtrees against
+	Plane3 mFrustumPlanes[6];
+	unsigned int mFrustumStamp;
+	unsigned int mCulledStamp;
+
 	// Refs
 	BudgetItem **mpNodeRefs;
 	TriProxyBackRef **mpTriRefs;
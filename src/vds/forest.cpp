@@ -28,6 +28,13 @@
 #include <time.h>
 #include <set>
 #include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "vds.h"
 #include "forest.h"
@@ -45,18 +52,15 @@ using namespace VDS;
 const NodeIndex Forest::iNIL_NODE  = 0;
 const NodeIndex Forest::iNIL_TRI   = 0;
 const NodeIndex Forest::iROOT_NODE = 1;
-const unsigned int Forest::VDS_FILE_FORMAT_MAJOR = 1;
-const unsigned int Forest::VDS_FILE_FORMAT_MINOR = 4;
+const unsigned int Forest::VDS_FILE_FORMAT_MAJOR = 2;
+const unsigned int Forest::VDS_FILE_FORMAT_MINOR = 1;
 const unsigned int Forest::VIF_FILE_FORMAT_MAJOR = 2;
 const unsigned int Forest::VIF_FILE_FORMAT_MINOR = 1;
 
 // utility function prototypes
 void sort_three(NodeIndex &rA, NodeIndex &rB, NodeIndex &rC);
-#ifdef _WIN32
-void WriteArray(void *pArray, unsigned int Length, HANDLE FileHandle);
-#else
-void WriteArray(void *pArray, unsigned int Length, int FileHandle);
-#endif
+bool WriteArray(const void *pArray, size_t Length, VDSFileOffset Offset, FILE *pFile, VDSFileOffset &rFilePos);
+bool ReadArray(void *pArray, size_t Length, VDSFileOffset Offset, FILE *pFile, VDSFileOffset &rFilePos);
 
 Forest::Forest()
 {
@@ -68,11 +72,18 @@ Forest::Forest()
 	mNumTextures = 0;
     mIsValid = false;
     mIsMMapped = false;
+	mIsBorrowed = false;
 	mMMapFile = NULL;
+	mMMapSize = 0;
+	mpPager = NULL;
+	mpNodeLoaded = NULL;
+	mpLoader = NULL;
     mNumNodes = 0;
 	mNumNodePositions = 0;
 	mNumPatches = 0;
 	mNumTris = 0;
+	mNumCoarseNodes = 0;
+	mpCoarseSubtreeStarts = NULL;
 	DepthFirstArray = NULL;
 	LocInArray = NULL;
 	miHighlightedNode = iNIL_NODE;
@@ -90,25 +101,47 @@ Forest::~Forest()
 void Forest::GiveContents(Forest &rForest)
 {
     assert (mIsValid);
+	DisablePaging();
     rForest.Reset();
     rForest.mpNodes = mpNodes;
+	rForest.mpNodeRenderData = mpNodeRenderData;
 	rForest.mpTris = mpTris;
+	rForest.mpErrorParams = mpErrorParams;
     rForest.mNumNodes = mNumNodes;
+	rForest.mNumNodePositions = mNumNodePositions;
 	rForest.mNumTris = mNumTris;
+	rForest.mNumErrorParams = mNumErrorParams;
+	rForest.mErrorParamSize = mErrorParamSize;
+	rForest.mNumCoarseNodes = mNumCoarseNodes;
+	rForest.mpCoarseSubtreeStarts = mpCoarseSubtreeStarts;
+	mNumCoarseNodes = 0;
+	mpCoarseSubtreeStarts = NULL;
     mpNodes = NULL;
+	mpNodeRenderData = NULL;
     mpTris = NULL;
+	mpErrorParams = NULL;
     mIsValid = false;
     mNumNodes = 0;
+	mNumNodePositions = 0;
 	mNumTris = 0;
+	mNumErrorParams = 0;
     if (mIsMMapped)
     {
+		// the mapping now belongs to rForest, which unmaps it on Reset
         rForest.mIsMMapped = true;
         rForest.mMMapFile = mMMapFile;
-#ifdef _WIN32
-	UnmapViewOfFile(mMMapFile);
-#endif
+		rForest.mMMapSize = mMMapSize;
     }
     mIsMMapped = false;
+	mMMapFile = NULL;
+	mMMapSize = 0;
+	rForest.mIsBorrowed = mIsBorrowed;
+	mIsBorrowed = false;
+	// a progressive load in progress carries on in rForest
+	rForest.mpNodeLoaded = mpNodeLoaded;
+	rForest.mpLoader = mpLoader;
+	mpNodeLoaded = NULL;
+	mpLoader = NULL;
 }
 
 bool Forest::GetDataFromVif(const Vif &v)
@@ -179,7 +212,7 @@ bool Forest::GetDataFromVif(const Vif &v)
 
 	for (i = 1; i <= mNumNodes; ++i)
 	{
-		mpNodes[i].mpRenderData = &(mpNodeRenderData[v.Vertices[i-1].VertexPosition]);
+		mpNodes[i].miRenderData = v.Vertices[i-1].VertexPosition;
 		mpNodes[i].mPatchID = v.Vertices[i-1].PatchID - 1;
 		if (v.Vertices[i-1].CoincidentVertexFlag)
 		{
@@ -248,7 +281,7 @@ bool Forest::GetDataFromVif(const Vif &v)
 
 		for (j = 0; j < 3; j++)
 		{
-			mAvgEdgeLength += mpNodes[mpTris[i].miCorners[j]].mpRenderData->Position.DistanceTo(mpNodes[mpTris[i].miCorners[(j + 1) % 3]].mpRenderData->Position);
+			mAvgEdgeLength += GetNodeRenderData(mpTris[i].miCorners[j])->Position.DistanceTo(GetNodeRenderData(mpTris[i].miCorners[(j + 1) % 3])->Position);
 		}
 
 		if ((mpTris[i].mPatchID != mpNodes[mpTris[i].miCorners[0]].mPatchID)
@@ -419,7 +452,7 @@ bool Forest::GiveDataToVif(Vif &v)
 	v.Vertices = new VifVertex[v.NumVerts];
 	for (i = 0; i < mNumNodes; ++i)
 	{
-		v.Vertices[i].VertexPosition = mpNodes[i+1].mpRenderData - mpNodeRenderData;
+		v.Vertices[i].VertexPosition = mpNodes[i+1].miRenderData;
 		v.Vertices[i].PatchID = mpNodes[i+1].mPatchID + 1;
 		if (mpNodes[i+1].mCoincidentVertex == iNIL_NODE)
 		{
@@ -507,366 +540,410 @@ bool Forest::GiveDataToVif(Vif &v)
 	return true;
 }
 
-int Forest::ReadBinaryVDSfromBuffer(char* buffer)
+// A binary VDS file (and a GLOD readback buffer) is a VDSFileHeader followed by the
+// error params, nodes, node render data and tris.  Each array starts on a 
+// VDS_FILE_SECTION_ALIGNMENT boundary and is stored exactly as it is laid out in 
+// memory; since nodes refer to their render data by index, nothing needs to be 
+// fixed up after the arrays are read or mapped.
+static VDSFileOffset AlignFileOffset(VDSFileOffset Offset)
 {
-  char* cur_buf = buffer;
-  DWORD num_bytes_read = 0;
-  unsigned int major, minor;
+	return (Offset + VDS_FILE_SECTION_ALIGNMENT - 1) & ~((VDSFileOffset) VDS_FILE_SECTION_ALIGNMENT - 1);
+}
 
-  Reset();
-  mIsMMapped = false;
-	
-#define READ(a,b,c,d,e) memcpy((void*)b, cur_buf, c); cur_buf += c; *d += c;
-  READ(hFile, &major, sizeof(VDS_FILE_FORMAT_MAJOR), &num_bytes_read, NULL);
-  READ(hFile, &minor, sizeof(VDS_FILE_FORMAT_MINOR), &num_bytes_read, NULL);
-  if (major != VDS_FILE_FORMAT_MAJOR || minor != VDS_FILE_FORMAT_MINOR)
-  {
-    cerr << "Incompatible VDS file version." << endl;
-    return 0;
-  }    
-  
-  READ(hFile, &mColorsPresent, sizeof(mColorsPresent), &num_bytes_read, NULL);
-  READ(hFile, &mNormalsPresent, sizeof(mNormalsPresent), &num_bytes_read, NULL);
-  READ(hFile, &mNumTextures, sizeof(mNumTextures), &num_bytes_read, NULL);
-  READ(hFile, &mNumNodes, sizeof(NodeIndex), &num_bytes_read, NULL);
-  READ(hFile, &mNumNodePositions, sizeof(NodeIndex), &num_bytes_read, NULL);
-  READ(hFile, &mNumTris, sizeof(NodeIndex), &num_bytes_read, NULL);
-  READ(hFile, &mNumPatches, sizeof(PatchIndex), &num_bytes_read, NULL);
-  READ(hFile, &mNumErrorParams, sizeof(NodeIndex), &num_bytes_read, NULL);
-  READ(hFile, &mErrorParamSize, sizeof(int), &num_bytes_read, NULL);
-  
-  mpErrorParams = new float[mNumErrorParams * mErrorParamSize];
-  READ(hFile, mpErrorParams, mErrorParamSize * mNumErrorParams * sizeof(float), &num_bytes_read, NULL);
-  
-  mpNodes = new Node[mNumNodes + 1];
-  READ(hFile, mpNodes, sizeof(Node) * (mNumNodes + 1), &num_bytes_read, NULL);
-
-  mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
-  READ(hFile, mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), &num_bytes_read, NULL);
-  
-  mpTris = new Tri[mNumTris + 1];
-  READ(hFile, mpTris, sizeof(Tri) * (mNumTris + 1), &num_bytes_read,NULL);
-    
-  VertexRenderDataIndicesToPointers();
-
-  SetValid();
-  return 1;
+// A section of Count elements of ElementSize bytes must start on an alignment boundary
+// at or after rEnd (the end of the previous section) and end within FileSize; on success
+// rEnd is moved to the end of this section.
+static bool CheckFileSection(VDSFileOffset Offset, VDSFileOffset Count, VDSFileOffset ElementSize,
+							 VDSFileOffset FileSize, VDSFileOffset &rEnd)
+{
+	if ((Offset & (VDS_FILE_SECTION_ALIGNMENT - 1)) != 0 || Offset < rEnd || Offset > FileSize)
+		return false;
+	if (Count > (FileSize - Offset) / ElementSize)
+		return false;
+	rEnd = Offset + Count * ElementSize;
+	return true;
 }
 
-bool Forest::ReadBinaryVDS(const char *Filename)
+void Forest::FillFileHeader(VDSFileHeader &rHeader) const
 {
-#ifdef _WIN32
-    HANDLE hFile; 
-#else
-    int hFile;
-#endif
-    DWORD num_bytes_read;
-    unsigned int major, minor;
+	memset(&rHeader, 0, sizeof(VDSFileHeader));
+	rHeader.Major = VDS_FILE_FORMAT_MAJOR;
+	rHeader.Minor = VDS_FILE_FORMAT_MINOR;
+	rHeader.HeaderSize = sizeof(VDSFileHeader);
+	rHeader.NodeSize = sizeof(Node);
+	rHeader.TriSize = sizeof(Tri);
+	rHeader.RenderDatumSize = sizeof(VertexRenderDatum);
+	rHeader.IndexSize = sizeof(NodeIndex);
+	rHeader.ColorsPresent = mColorsPresent;
+	rHeader.NormalsPresent = mNormalsPresent;
+	rHeader.NumTextures = mNumTextures;
+	rHeader.NumPatches = mNumPatches;
+	rHeader.ErrorParamSize = mErrorParamSize;
+	rHeader.NumNodes = mNumNodes;
+	rHeader.NumNodePositions = mNumNodePositions;
+	rHeader.NumTris = mNumTris;
+	rHeader.NumErrorParams = mNumErrorParams;
+
+	rHeader.ErrorParamsOffset = AlignFileOffset(sizeof(VDSFileHeader));
+	rHeader.NodesOffset = AlignFileOffset(rHeader.ErrorParamsOffset + 
+		(VDSFileOffset) mNumErrorParams * mErrorParamSize * sizeof(float));
+	rHeader.NodeRenderDataOffset = AlignFileOffset(rHeader.NodesOffset + 
+		(VDSFileOffset) (mNumNodes + 1) * sizeof(Node));
+	rHeader.TrisOffset = AlignFileOffset(rHeader.NodeRenderDataOffset + 
+		(VDSFileOffset) mNumNodePositions * sizeof(VertexRenderDatum));
+	rHeader.FileSize = rHeader.TrisOffset + (VDSFileOffset) (mNumTris + 1) * sizeof(Tri);
+	rHeader.NumCoarseNodes = mNumCoarseNodes;
+}
 
-    Reset();
-    mIsMMapped = false;
-#ifdef _WIN32	
-    hFile = CreateFile(Filename,       // create Filename
-		GENERIC_READ,                // open for reading 
-		0,                            // do not share
-		NULL,                         // no security 
-		OPEN_EXISTING,                // open existing file only 
-		FILE_ATTRIBUTE_NORMAL,        // normal file
-		NULL);                        // no attr. template 
+bool Forest::GetDataFromFileHeader(const VDSFileHeader &rHeader, VDSFileOffset AvailableSize)
+{
+	if (AvailableSize < sizeof(VDSFileHeader))
+	{
+		cerr << "VDS file is truncated." << endl;
+		return false;
+	}
+	if (rHeader.Major != VDS_FILE_FORMAT_MAJOR || rHeader.Minor != VDS_FILE_FORMAT_MINOR)
+	{
+		cerr << "Incompatible VDS file version." << endl;
+		return false;
+	}
+	// the arrays are stored as raw structs, so the reader must share the writer's layout
+	if ((rHeader.HeaderSize != sizeof(VDSFileHeader)) || (rHeader.NodeSize != sizeof(Node)) || 
+		(rHeader.TriSize != sizeof(Tri)) || (rHeader.RenderDatumSize != sizeof(VertexRenderDatum)) ||
+		(rHeader.IndexSize != sizeof(NodeIndex)))
+	{
+		cerr << "VDS file was written with an incompatible data layout." << endl;
+		return false;
+	}
+	if (rHeader.FileSize > AvailableSize)
+	{
+		cerr << "VDS file is truncated." << endl;
+		return false;
+	}
+	// the counts must fit the in-memory index types, and the sections must lie in order,
+	// without overlapping, on alignment boundaries within the file; everything that maps,
+	// copies or allocates the arrays relies on this
+	VDSFileOffset end = sizeof(VDSFileHeader);
+	if (rHeader.FileSize != (VDSFileOffset) (size_t) rHeader.FileSize ||
+		rHeader.NumPatches > (PatchIndex) ~(PatchIndex) 0 || rHeader.ErrorParamSize < 0 ||
+		rHeader.NumNodes >= (NodeIndex) ~(NodeIndex) 0 || rHeader.NumNodePositions > (NodeIndex) ~(NodeIndex) 0 ||
+		rHeader.NumTris >= (TriIndex) ~(TriIndex) 0 || rHeader.NumErrorParams > (NodeIndex) ~(NodeIndex) 0 ||
+		(rHeader.ErrorParamSize != 0 && 
+			rHeader.NumErrorParams > (NodeIndex) ~(NodeIndex) 0 / (VDSFileOffset) rHeader.ErrorParamSize) ||
+		!CheckFileSection(rHeader.ErrorParamsOffset, rHeader.NumErrorParams * rHeader.ErrorParamSize, 
+			sizeof(float), rHeader.FileSize, end) ||
+		!CheckFileSection(rHeader.NodesOffset, rHeader.NumNodes + 1, sizeof(Node), rHeader.FileSize, end) ||
+		!CheckFileSection(rHeader.NodeRenderDataOffset, rHeader.NumNodePositions, sizeof(VertexRenderDatum), 
+			rHeader.FileSize, end) ||
+		!CheckFileSection(rHeader.TrisOffset, rHeader.NumTris + 1, sizeof(Tri), rHeader.FileSize, end) ||
+		rHeader.NumCoarseNodes > rHeader.NumNodes)
+	{
+		cerr << "VDS file header is corrupt." << endl;
+		return false;
+	}
+	mColorsPresent = (rHeader.ColorsPresent != 0);
+	mNormalsPresent = (rHeader.NormalsPresent != 0);
+	mNumTextures = rHeader.NumTextures;
+	mNumPatches = (PatchIndex) rHeader.NumPatches;
+	mErrorParamSize = rHeader.ErrorParamSize;
+	mNumNodes = (NodeIndex) rHeader.NumNodes;
+	mNumNodePositions = (NodeIndex) rHeader.NumNodePositions;
+	mNumTris = (TriIndex) rHeader.NumTris;
+	mNumErrorParams = (NodeIndex) rHeader.NumErrorParams;
+	mNumCoarseNodes = (NodeIndex) rHeader.NumCoarseNodes;
+	return true;
+}
+
+int Forest::ReadBinaryVDSfromBuffer(char* buffer)
+{
+	VDSFileHeader header;
+
+	Reset();
+	mIsMMapped = false;
+
+	// the buffer belongs to the application and need not stay around (or be aligned),
+	// so everything is copied out of it
+	memcpy(&header, buffer, sizeof(VDSFileHeader));
+	if (!GetDataFromFileHeader(header, header.FileSize))
+	{
+		Reset();
+		return 0;
+	}
 
-    if (hFile == INVALID_HANDLE_VALUE) 
-    {
-        return false;
-    } 
-	
-    ReadFile(hFile, &major, sizeof(VDS_FILE_FORMAT_MAJOR), &num_bytes_read, NULL);
-    ReadFile(hFile, &minor, sizeof(VDS_FILE_FORMAT_MINOR), &num_bytes_read, NULL);
-    if (major != VDS_FILE_FORMAT_MAJOR || minor != VDS_FILE_FORMAT_MINOR)
-    {
-        cerr << "Incompatible VDS file version." << endl;
-        CloseHandle(hFile);
-        return false;
-    }    
-	
-    ReadFile(hFile, &mColorsPresent, sizeof(mColorsPresent), &num_bytes_read, NULL);
-    ReadFile(hFile, &mNormalsPresent, sizeof(mNormalsPresent), &num_bytes_read, NULL);
-    ReadFile(hFile, &mNumTextures, sizeof(mNumTextures), &num_bytes_read, NULL);
-    ReadFile(hFile, &mNumNodes, sizeof(NodeIndex), &num_bytes_read, NULL);
-	ReadFile(hFile, &mNumNodePositions, sizeof(NodeIndex), &num_bytes_read, NULL);
-    ReadFile(hFile, &mNumTris, sizeof(NodeIndex), &num_bytes_read, NULL);
-	ReadFile(hFile, &mNumPatches, sizeof(PatchIndex), &num_bytes_read, NULL);
-	ReadFile(hFile, &mNumErrorParams, sizeof(NodeIndex), &num_bytes_read, NULL);
-	ReadFile(hFile, &mErrorParamSize, sizeof(int), &num_bytes_read, NULL);
-    
 	mpErrorParams = new float[mNumErrorParams * mErrorParamSize];
-    ReadFile(hFile, mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float), &num_bytes_read, NULL);
+	memcpy(mpErrorParams, buffer + header.ErrorParamsOffset, mNumErrorParams * mErrorParamSize * sizeof(float));
 
 	mpNodes = new Node[mNumNodes + 1];
-    ReadFile(hFile, mpNodes, sizeof(Node) * (mNumNodes + 1), &num_bytes_read, NULL);
+	memcpy(mpNodes, buffer + header.NodesOffset, sizeof(Node) * (mNumNodes + 1));
 
 	mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
-	ReadFile(hFile, mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), &num_bytes_read, NULL);
+	memcpy(mpNodeRenderData, buffer + header.NodeRenderDataOffset, sizeof(VertexRenderDatum) * (mNumNodePositions));
 
-    mpTris = new Tri[mNumTris + 1];
-    ReadFile(hFile, mpTris, sizeof(Tri) * (mNumTris + 1), &num_bytes_read,NULL);
-    
-    CloseHandle(hFile);
-	
-	VertexRenderDataIndicesToPointers();
+	mpTris = new Tri[mNumTris + 1];
+	memcpy(mpTris, buffer + header.TrisOffset, sizeof(Tri) * (mNumTris + 1));
 
-    SetValid();
-    return true;
-#else
-    hFile = 0;
-    num_bytes_read = major = minor = 0;
-    fprintf(stderr, "file i/o not implemented for non-win32");
-    return false;
-#endif
+	SetValid();
+	return 1;
+}
+
+bool Forest::BeginBinaryVDS(const VDSFileHeader &rHeader, bool Borrowed)
+{
+	Reset();
+	if (!GetDataFromFileHeader(rHeader, rHeader.FileSize))
+	{
+		Reset();
+		return false;
+	}
+	mIsBorrowed = Borrowed;
+	if (!Borrowed)
+	{
+		mpErrorParams = new float[mNumErrorParams * mErrorParamSize];
+		mpNodes = new Node[mNumNodes + 1];
+		mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
+		mpTris = new Tri[mNumTris + 1];
+	}
+	return true;
+}
+
+bool Forest::ReadBinaryVDS(const char *Filename)
+{
+	VDSFileHeader header;
+	VDSFileOffset FilePos;
+	FILE *pFile;
+	bool ok;
+
+	Reset();
+	mIsMMapped = false;
+
+	pFile = fopen(Filename, "rb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+	memset(&header, 0, sizeof(VDSFileHeader));
+	if (fread(&header, 1, sizeof(VDSFileHeader), pFile) != sizeof(VDSFileHeader))
+	{
+		header.FileSize = 0;
+	}
+	if (header.Major == VDS_PROGRESSIVE_FILE_MAGIC)
+	{
+		fclose(pFile);
+		return ReadProgressiveVDS(Filename);
+	}
+	if (header.Major == VDS_COMPRESSED_FILE_MAGIC)
+	{
+		fclose(pFile);
+		return ReadCompressedVDS(Filename);
+	}
+	// the real file size is checked as the arrays are read
+	if (!GetDataFromFileHeader(header, header.FileSize))
+	{
+		fclose(pFile);
+		Reset();
+		return false;
+	}
+	FilePos = sizeof(VDSFileHeader);
+
+	mpErrorParams = new float[mNumErrorParams * mErrorParamSize];
+	mpNodes = new Node[mNumNodes + 1];
+	mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
+	mpTris = new Tri[mNumTris + 1];
+
+	ok = ReadArray(mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float), header.ErrorParamsOffset, pFile, FilePos) &&
+		ReadArray(mpNodes, sizeof(Node) * (mNumNodes + 1), header.NodesOffset, pFile, FilePos) &&
+		ReadArray(mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), header.NodeRenderDataOffset, pFile, FilePos) &&
+		ReadArray(mpTris, sizeof(Tri) * (mNumTris + 1), header.TrisOffset, pFile, FilePos);
+	fclose(pFile);
+
+	if (!ok)
+	{
+		cerr << "Error reading VDS file " << Filename << endl;
+		Reset();
+		return false;
+	}
+	SetValid();
+	return true;
 }
 
 bool Forest::MemoryMapVDS(const char *Filename)
 {
+	VDSFileHeader header;
+	VDSFileOffset FileSize;
+
+	Reset();
 #ifdef _WIN32
-    HANDLE hFile;
-    HANDLE hFileMapping;
-    unsigned int major, minor;
-    unsigned int offset;
-//    unsigned int i;
-    Reset();
-    
-    hFile = CreateFile(Filename,       // create Filename 
-		GENERIC_READ | GENERIC_WRITE,                // open for reading 
-		0,                            // do not share 
+	HANDLE hFile;
+	HANDLE hFileMapping;
+	LARGE_INTEGER Size;
+
+	hFile = CreateFile(Filename,       // open Filename 
+		GENERIC_READ,                 // open for reading 
+		FILE_SHARE_READ,              // let other processes map it too 
 		NULL,                         // no security 
-		OPEN_ALWAYS,                // open existing file only 
+		OPEN_EXISTING,                // open existing file only 
 		FILE_ATTRIBUTE_NORMAL,        // normal file
 		NULL);                        // no attr. template 
-	
-    if (hFile == INVALID_HANDLE_VALUE) 
-    { 
-        return false;
-    } 
-    
-    hFileMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
-    if (hFileMapping == INVALID_HANDLE_VALUE || hFileMapping == NULL)
-    {      
-        CloseHandle(hFile);        
-        return false;
-    }
-    mMMapFile = (PBYTE) MapViewOfFile(hFileMapping, FILE_MAP_COPY, 0, 0, 0);
-    offset = 0;
-    major = *((unsigned int *)mMMapFile);
-    offset += sizeof(VDS_FILE_FORMAT_MAJOR + offset);
-    minor = *((unsigned int *)(mMMapFile + offset));
-    offset += sizeof(VDS_FILE_FORMAT_MINOR);
-	
-    if (major != VDS_FILE_FORMAT_MAJOR || minor != VDS_FILE_FORMAT_MINOR)
-    {
-        cerr << "Incompatible VDS file version." << endl;
-        CloseHandle(hFileMapping);
-        CloseHandle(hFile);
-        UnmapViewOfFile(mMMapFile);
-        return false;
-    }
-    mIsMMapped = true;
-    mColorsPresent = *((bool *) (mMMapFile + offset));
-    offset += sizeof(mColorsPresent);
-    mNormalsPresent = *((bool *) (mMMapFile + offset));
-    offset += sizeof(mNormalsPresent);
-    mNumTextures = *((unsigned int *) (mMMapFile + offset));
-    offset += sizeof(mNumTextures);
-    mNumNodes = *((NodeIndex *) (mMMapFile + offset));
-    offset += sizeof(mNumNodes);
-	mNumNodePositions = *((NodeIndex *) (mMMapFile + offset));
-	offset += sizeof(mNumNodePositions);
-    mNumTris = *((TriIndex *) (mMMapFile + offset));
-    offset += sizeof(mNumTris);
-	mNumPatches = *((PatchIndex *) (mMMapFile + offset));
-	offset += sizeof(mNumPatches);
-	mNumErrorParams = *((NodeIndex *) (mMMapFile + offset));
-	offset += sizeof(mNumErrorParams);
-	mErrorParamSize = *((int *) (mMMapFile + offset));
-	offset += sizeof(mErrorParamSize);
-	
-	// TODO: set up memory mapping to use interleaved render data instead of parallel arrays
-	
-	mpErrorParams = (float *) (mMMapFile + offset);
-	offset += (mNumErrorParams * mErrorParamSize * sizeof(float));
-    mpNodes = (Node *) (mMMapFile + offset);
-    offset += (mNumNodes + 1) * sizeof(Node);
-    mpNodeRenderData = (VertexRenderDatum *) (mMMapFile + offset);
-    offset += (mNumNodePositions) * sizeof(VertexRenderDatum);
-    mpTris = (Tri *) (mMMapFile + offset);
-    offset += (mNumTris + 1) * sizeof(Tri);
-	
-	VertexRenderDataIndicesToPointers();
+	if (hFile == INVALID_HANDLE_VALUE) 
+	{ 
+		return false;
+	}
+	if (!GetFileSizeEx(hFile, &Size))
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	FileSize = Size.QuadPart;
 
-    CloseHandle(hFileMapping);
-    CloseHandle(hFile);
-    SetValid();
-    return true;
+	// copy-on-write: pages stay shared with the file cache until something writes to them
+	hFileMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (hFileMapping == INVALID_HANDLE_VALUE || hFileMapping == NULL)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+	mMMapFile = (PBYTE) MapViewOfFile(hFileMapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(hFileMapping);
+	CloseHandle(hFile);
+	if (mMMapFile == NULL)
+	{
+		return false;
+	}
 #else
-    fprintf(stderr, "memory mapping not implemented for non-win32");
-    return false;
+	int hFile;
+	struct stat FileStat;
+	void *pMapping;
+
+	hFile = open(Filename, O_RDONLY);
+	if (hFile < 0)
+	{
+		return false;
+	}
+	if (fstat(hFile, &FileStat) != 0 || FileStat.st_size == 0)
+	{
+		close(hFile);
+		return false;
+	}
+	FileSize = FileStat.st_size;
+
+	// copy-on-write: pages stay shared with the page cache until something writes to them
+	pMapping = mmap(NULL, (size_t) FileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, hFile, 0);
+	close(hFile);
+	if (pMapping == MAP_FAILED)
+	{
+		return false;
+	}
+	mMMapFile = (char *) pMapping;
 #endif
+	mMMapSize = FileSize;
+	mIsMMapped = true;
+
+	memcpy(&header, mMMapFile, (FileSize < sizeof(VDSFileHeader)) ? (size_t) FileSize : sizeof(VDSFileHeader));
+	if (header.Major == VDS_PROGRESSIVE_FILE_MAGIC)
+	{
+		// progressive files aren't laid out for use in place either
+		Reset();
+		return ReadProgressiveVDS(Filename);
+	}
+	if (header.Major == VDS_COMPRESSED_FILE_MAGIC)
+	{
+		// compressed files can't be used in place, so decompress into memory instead
+		Reset();
+		return ReadCompressedVDS(Filename);
+	}
+	if (!GetDataFromFileHeader(header, FileSize))
+	{
+		Reset();
+		return false;
+	}
+
+	// the arrays are used in place; their pages are brought in as they are first touched
+	mpErrorParams = (float *) (mMMapFile + header.ErrorParamsOffset);
+	mpNodes = (Node *) (mMMapFile + header.NodesOffset);
+	mpNodeRenderData = (VertexRenderDatum *) (mMMapFile + header.NodeRenderDataOffset);
+	mpTris = (Tri *) (mMMapFile + header.TrisOffset);
+
+	SetValid();
+	return true;
 }
 
 int Forest::GetBinaryVDSSize() // added by Nat for GLOD compatibility on 8/29/03
                                // GLOD must know in-advance the size of the VDS file that will be created.
 {
-    DWORD num_bytes_written = 0;
-//    unsigned int i;
-	
-    assert(mIsValid);
-#define COUNT_BYTE(a,b,c,d,e) num_bytes_written += c;
-#define COUNT_ARRAY(a,b,c) num_bytes_written += b;
-    
-    COUNT_BYTE(hFile, &VDS_FILE_FORMAT_MAJOR, sizeof(VDS_FILE_FORMAT_MAJOR), &num_bytes_written,NULL);
-    COUNT_BYTE(hFile, &VDS_FILE_FORMAT_MINOR, sizeof(VDS_FILE_FORMAT_MINOR), &num_bytes_written,NULL);
-    
-    COUNT_BYTE(hFile, &mColorsPresent, sizeof(mColorsPresent), &num_bytes_written, NULL);
-    COUNT_BYTE(hFile, &mNormalsPresent, sizeof(mNormalsPresent), &num_bytes_written, NULL);
-    COUNT_BYTE(hFile, &mNumTextures, sizeof(mNumTextures), &num_bytes_written, NULL);
-    COUNT_BYTE(hFile, &mNumNodes, sizeof(NodeIndex), &num_bytes_written, NULL);
-    COUNT_BYTE(hFile, &mNumNodePositions, sizeof(NodeIndex), &num_bytes_written, NULL);
-    COUNT_BYTE(hFile, &mNumTris, sizeof(NodeIndex), &num_bytes_written, NULL);
-    COUNT_BYTE(hFile, &mNumPatches, sizeof(PatchIndex), &num_bytes_written, NULL);
-	COUNT_BYTE(hFile, &mNumErrorParams, sizeof(NodeIndex), &num_bytes_written, NULL);
-	COUNT_BYTE(hFile, &mErrorParamSize, sizeof(int), &num_bytes_written, NULL);
-    
-	COUNT_ARRAY(mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float), hFile);
-
-    VertexRenderDataPointersToIndices();
-    COUNT_ARRAY(mpNodes, sizeof(Node) * (mNumNodes + 1), hFile);
-    VertexRenderDataIndicesToPointers();
-
-    COUNT_ARRAY(mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), hFile);
-
-    COUNT_ARRAY(mpTris, sizeof(Tri) * (mNumTris + 1), hFile);
-
-    return num_bytes_written;
+	VDSFileHeader header;
+
+	assert(mIsValid);
+	FillFileHeader(header);
+	return (int) header.FileSize;
 }
 
-int Forest::WriteBinaryVDStoBuffer(char* buffer) { /* Added by Nat for GLOD compat on 8/29/03 */
-  char* cur_buf = buffer;
-  DWORD num_bytes_written=0;
-//  unsigned int i;
-	
-  assert(mIsValid);
-
-#define WRITE(a,b,c,d,e) memcpy(cur_buf, b, c); cur_buf += c; *d += c;
-#define WRITE_A(a,b,c) memcpy(cur_buf, a, b); cur_buf += b;
-
-  WRITE(hFile, &VDS_FILE_FORMAT_MAJOR, sizeof(VDS_FILE_FORMAT_MAJOR), &num_bytes_written,NULL);
-  WRITE(hFile, &VDS_FILE_FORMAT_MINOR, sizeof(VDS_FILE_FORMAT_MINOR), &num_bytes_written,NULL);
-  
-  WRITE(hFile, &mColorsPresent, sizeof(mColorsPresent), &num_bytes_written, NULL);
-  WRITE(hFile, &mNormalsPresent, sizeof(mNormalsPresent), &num_bytes_written, NULL);
-  WRITE(hFile, &mNumTextures, sizeof(mNumTextures), &num_bytes_written, NULL);
-  WRITE(hFile, &mNumNodes, sizeof(NodeIndex), &num_bytes_written, NULL);
-  WRITE(hFile, &mNumNodePositions, sizeof(NodeIndex), &num_bytes_written, NULL);
-  WRITE(hFile, &mNumTris, sizeof(NodeIndex), &num_bytes_written, NULL);
-  WRITE(hFile, &mNumPatches, sizeof(PatchIndex), &num_bytes_written, NULL);
-  WRITE(hFile, &mNumErrorParams, sizeof(NodeIndex), &num_bytes_written, NULL);
-  WRITE(hFile, &mErrorParamSize, sizeof(int), &num_bytes_written, NULL);
-
-  WRITE_A(mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float), hFile);
-  
-  VertexRenderDataPointersToIndices();
-  WRITE_A(mpNodes, sizeof(Node) * (mNumNodes + 1), hFile);
-  VertexRenderDataIndicesToPointers();
-  
-  WRITE_A(mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), hFile);
-  
-  WRITE_A(mpTris, sizeof(Tri) * (mNumTris + 1), hFile);
-  
-  return true;
+int Forest::WriteBinaryVDStoBuffer(char* buffer) /* Added by Nat for GLOD compat on 8/29/03 */
+{
+	VDSFileHeader header;
+
+	assert(mIsValid);
+	FillFileHeader(header);
+
+	// zero the header and the padding between sections so the output is deterministic
+	memset(buffer, 0, (size_t) header.FileSize);
+	memcpy(buffer, &header, sizeof(VDSFileHeader));
+	memcpy(buffer + header.ErrorParamsOffset, mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float));
+	memcpy(buffer + header.NodesOffset, mpNodes, sizeof(Node) * (mNumNodes + 1));
+	memcpy(buffer + header.NodeRenderDataOffset, mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions));
+	memcpy(buffer + header.TrisOffset, mpTris, sizeof(Tri) * (mNumTris + 1));
+
+	return true;
 }
 
 /***************** NOTE: KEEP the above two functions in SYNC
  *****************       with this function!                   */
 bool Forest::WriteBinaryVDS(const char *Filename)
 {
-#ifdef _WIN32
-    HANDLE hFile; 
-    DWORD num_bytes_written;
-//    unsigned int i;
-	
-    assert(mIsValid);
-    hFile = CreateFile(Filename,       // create
-		GENERIC_WRITE,                // open for writing 
-		0,                            // do not share 
-		NULL,                         // no security 
-		CREATE_ALWAYS,                // overwrite existing 
-		FILE_ATTRIBUTE_NORMAL,        // normal file
-		NULL);                        // no attr. template 
-    
-    if (hFile == INVALID_HANDLE_VALUE)
-    {
-        return false;
-    }
-    
-    WriteFile(hFile, &VDS_FILE_FORMAT_MAJOR, sizeof(VDS_FILE_FORMAT_MAJOR), &num_bytes_written,NULL);
-    WriteFile(hFile, &VDS_FILE_FORMAT_MINOR, sizeof(VDS_FILE_FORMAT_MINOR), &num_bytes_written,NULL);
-    
-    WriteFile(hFile, &mColorsPresent, sizeof(mColorsPresent), &num_bytes_written, NULL);
-    WriteFile(hFile, &mNormalsPresent, sizeof(mNormalsPresent), &num_bytes_written, NULL);
-    WriteFile(hFile, &mNumTextures, sizeof(mNumTextures), &num_bytes_written, NULL);
-    WriteFile(hFile, &mNumNodes, sizeof(NodeIndex), &num_bytes_written, NULL);
-    WriteFile(hFile, &mNumNodePositions, sizeof(NodeIndex), &num_bytes_written, NULL);
-    WriteFile(hFile, &mNumTris, sizeof(NodeIndex), &num_bytes_written, NULL);
-    WriteFile(hFile, &mNumPatches, sizeof(PatchIndex), &num_bytes_written, NULL);
-	WriteFile(hFile, &mNumErrorParams, sizeof(NodeIndex), &num_bytes_written, NULL);
-	WriteFile(hFile, &mErrorParamSize, sizeof(int), &num_bytes_written, NULL);
-
-	WriteArray(mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float), hFile);
-    
-    VertexRenderDataPointersToIndices();
-    WriteArray(mpNodes, sizeof(Node) * (mNumNodes + 1), hFile);
-    VertexRenderDataIndicesToPointers();
-
-    WriteArray(mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), hFile);
-
-    WriteArray(mpTris, sizeof(Tri) * (mNumTris + 1), hFile);
-    CloseHandle(hFile);
+	VDSFileHeader header;
+	VDSFileOffset FilePos;
+	FILE *pFile;
+	bool ok;
 
-    return true;
-#else
-    fprintf(stderr, "vds binary writing not implemented for non-win32");
-    return false;
-#endif
-}
+	assert(mIsValid);
+	FillFileHeader(header);
 
-void Forest::VertexRenderDataIndicesToPointers()
-{
-	unsigned int i;
-	for (i = 1; i <= mNumNodes; ++i)
+	pFile = fopen(Filename, "wb");
+	if (pFile == NULL)
 	{
-		mpNodes[i].mpRenderData = &(mpNodeRenderData[((uintptr_t)mpNodes[i].mpRenderData)]);
+		return false;
 	}
-}
-
-void Forest::VertexRenderDataPointersToIndices()
-{
-	unsigned int i;
-	for (i = 1; i <= mNumNodes; ++i)
+	FilePos = 0;
+	ok = WriteArray(&header, sizeof(VDSFileHeader), 0, pFile, FilePos) &&
+		WriteArray(mpErrorParams, mNumErrorParams * mErrorParamSize * sizeof(float), header.ErrorParamsOffset, pFile, FilePos) &&
+		WriteArray(mpNodes, sizeof(Node) * (mNumNodes + 1), header.NodesOffset, pFile, FilePos) &&
+		WriteArray(mpNodeRenderData, sizeof(VertexRenderDatum) * (mNumNodePositions), header.NodeRenderDataOffset, pFile, FilePos) &&
+		WriteArray(mpTris, sizeof(Tri) * (mNumTris + 1), header.TrisOffset, pFile, FilePos);
+	if (fclose(pFile) != 0)
+	{
+		ok = false;
+	}
+	if (!ok)
 	{
-		mpNodes[i].mpRenderData = (VertexRenderDatum*)(mpNodes[i].mpRenderData - mpNodeRenderData);
+		cerr << "Error writing VDS file " << Filename << endl;
 	}
+	return ok;
 }
 
 void Forest::Reset()
 {
+	// the pager's thread touches the mapping, so it must go first
+	DisablePaging();
+	EndProgressiveVDS();
+	delete[] mpNodeLoaded;
+	mpNodeLoaded = NULL;
     if (mIsMMapped)
 	{
 #ifdef _WIN32
-		VertexRenderDataPointersToIndices();
         UnmapViewOfFile(mMMapFile);
 #else
-		(void) 1;
+		munmap(mMMapFile, (size_t) mMMapSize);
 #endif
 	}
-    else
+    else if (!mIsBorrowed)
     {
         if (mpNodes != NULL)
 		{
@@ -894,11 +971,17 @@ void Forest::Reset()
 	mNumTextures = 0;
     mIsValid = false;
     mNumNodes = 0;
+	mNumNodePositions = 0;
 	mNumTris = 0;
 	mNumErrorParams = 0;
 	mErrorParamSize = 0;
+	mNumCoarseNodes = 0;
+	delete[] mpCoarseSubtreeStarts;
+	mpCoarseSubtreeStarts = NULL;
     mIsMMapped = false;
+	mIsBorrowed = false;
 	mMMapFile = NULL;
+	mMMapSize = 0;
 	miHighlightedNode = iNIL_NODE;
 	miHighlightedTri = iNIL_TRI;
 }
@@ -910,18 +993,18 @@ void Forest::GetBoundingBox(float &minx, float &maxx, float &miny, float &maxy,
 	maxx = maxy = maxz = -1e10;
 	for (i = 1; i <= mNumNodes; ++i)
 	{
-		if (mpNodes[i].mpRenderData->Position.X < minx)
-			minx = mpNodes[i].mpRenderData->Position.X;
-		if (mpNodes[i].mpRenderData->Position.X > maxx)
-			maxx = mpNodes[i].mpRenderData->Position.X;
-		if (mpNodes[i].mpRenderData->Position.Y < miny)
-			miny = mpNodes[i].mpRenderData->Position.Y;
-		if (mpNodes[i].mpRenderData->Position.Y > maxy)
-			maxy = mpNodes[i].mpRenderData->Position.Y;
-		if (mpNodes[i].mpRenderData->Position.Z < minz)
-			minz = mpNodes[i].mpRenderData->Position.Z;
-		if (mpNodes[i].mpRenderData->Position.Z > maxz)
-			maxz = mpNodes[i].mpRenderData->Position.Z;
+		if (GetNodeRenderData(i)->Position.X < minx)
+			minx = GetNodeRenderData(i)->Position.X;
+		if (GetNodeRenderData(i)->Position.X > maxx)
+			maxx = GetNodeRenderData(i)->Position.X;
+		if (GetNodeRenderData(i)->Position.Y < miny)
+			miny = GetNodeRenderData(i)->Position.Y;
+		if (GetNodeRenderData(i)->Position.Y > maxy)
+			maxy = GetNodeRenderData(i)->Position.Y;
+		if (GetNodeRenderData(i)->Position.Z < minz)
+			minz = GetNodeRenderData(i)->Position.Z;
+		if (GetNodeRenderData(i)->Position.Z > maxz)
+			maxz = GetNodeRenderData(i)->Position.Z;
 	}
 	if (minx == 1e10)
 		minx = 0;
@@ -954,8 +1037,9 @@ bool Forest::NodesAreCoincidentOrEqual(NodeIndex iNode1, NodeIndex iNode2)
 	if (mpNodes[iNode1].mCoincidentVertex == iNIL_NODE)
 		return false;
 
+	// the ring can be broken while a progressive load hasn't brought in all its nodes
 	NodeIndex i = iNode1;
-	while (mpNodes[i].mCoincidentVertex != iNode1)
+	while ((mpNodes[i].mCoincidentVertex != iNode1) && (mpNodes[i].mCoincidentVertex != iNIL_NODE))
 	{
 		i = mpNodes[i].mCoincidentVertex;
 		if (i == iNode2)
@@ -974,6 +1058,14 @@ void Forest::SetValid()
     {
         mIsValid = false;
     }
+
+	// a progressive load brings the coarse subtree starts in with its first record, 
+	// before the nodes they're taken from have arrived
+	if (mIsValid && (mNumCoarseNodes > 0) && (mpCoarseSubtreeStarts == NULL) && !ComputeCoarseSubtreeStarts())
+	{
+		cerr << "VDS coarse node links are corrupt." << endl;
+		mIsValid = false;
+	}
 }
 
 // this function now only for use in preprocessing stage
@@ -1205,8 +1297,8 @@ void Forest::SwapNodes(NodeIndex iNode1, NodeIndex iNode2, TriIndex *FirstLiveTr
 // currently only used to swap root node to index 1
 void Forest::SwapNodeMemory(NodeIndex iNode1, NodeIndex iNode2)
 {
-	VertexRenderDatum *node1renderdata = mpNodes[iNode1].mpRenderData;
-	VertexRenderDatum *node2renderdata = mpNodes[iNode2].mpRenderData;
+	NodeIndex node1renderdata = mpNodes[iNode1].miRenderData;
+	NodeIndex node2renderdata = mpNodes[iNode2].miRenderData;
 
     unsigned int *p;
     unsigned int *q;
@@ -1216,7 +1308,7 @@ void Forest::SwapNodeMemory(NodeIndex iNode1, NodeIndex iNode2)
 	
     p = (unsigned int *) &mpNodes[iNode1];
     q = (unsigned int *) &mpNodes[iNode2];
-    num_words = sizeof(Node) / sizeof(p);
+    num_words = sizeof(Node) / sizeof(*p);
     for (i = 0; i < num_words; i++, p++, q++)
     {
         *p ^= *q;
@@ -1224,8 +1316,8 @@ void Forest::SwapNodeMemory(NodeIndex iNode1, NodeIndex iNode2)
         *p ^= *q;
     }
 
-	mpNodes[iNode1].mpRenderData = node2renderdata;
-	mpNodes[iNode2].mpRenderData = node1renderdata;
+	mpNodes[iNode1].miRenderData = node2renderdata;
+	mpNodes[iNode2].miRenderData = node1renderdata;
 }
 
 void Forest::ReorderNodesDepthFirst(TriIndex *FirstLiveTris, TriIndex **NextLiveTris)
@@ -1288,7 +1380,7 @@ void Forest::ReorderNodesDepthFirst(TriIndex *FirstLiveTris, TriIndex **NextLive
 		new_node_array[i].mBBoxCenter.Z = mpNodes[DepthFirstArray[i]].mBBoxCenter.Z;
 		new_node_array[i].miErrorParamIndex = mpNodes[DepthFirstArray[i]].miErrorParamIndex;
 		new_node_array[i].miFirstSubTri = mpNodes[DepthFirstArray[i]].miFirstSubTri;
-		new_node_array[i].mpRenderData = mpNodes[DepthFirstArray[i]].mpRenderData;
+		new_node_array[i].miRenderData = mpNodes[DepthFirstArray[i]].miRenderData;
 		new_node_array[i].mPatchID = mpNodes[DepthFirstArray[i]].mPatchID;
 		new_node_array[i].mCoincidentVertex = LocInArray[mpNodes[DepthFirstArray[i]].mCoincidentVertex];
 
@@ -1375,7 +1467,7 @@ void Forest::ForestComputeBBoxes(NodeIndex iNode, TriIndex *FirstLiveTris, TriIn
     std::vector<Point3>::iterator pt_iter;    
 //    Float radius_squared;
 //    Float distance_squared;
-    Point3 node_position(mpNodes[iNode].mpRenderData->Position[0], mpNodes[iNode].mpRenderData->Position[1], mpNodes[iNode].mpRenderData->Position[2]);
+    Point3 node_position(GetNodeRenderData(iNode)->Position[0], GetNodeRenderData(iNode)->Position[1], GetNodeRenderData(iNode)->Position[2]);
 //    Float child_distance;
 //	mpNodes[iNode].mRadius = 0.0;
 	mpNodes[iNode].mXBBoxOffset = 0.0f;
@@ -1408,17 +1500,17 @@ void Forest::ForestComputeBBoxes(NodeIndex iNode, TriIndex *FirstLiveTris, TriIn
 		livetri = FirstLiveTris[iNode];
 		while (livetri != iNIL_NODE)
 		{
-			Point3 v0(mpNodes[mpTris[livetri].miCorners[0]].mpRenderData->Position[0],
-				mpNodes[mpTris[livetri].miCorners[0]].mpRenderData->Position[1],
-				mpNodes[mpTris[livetri].miCorners[0]].mpRenderData->Position[2]);
+			Point3 v0(GetNodeRenderData(mpTris[livetri].miCorners[0])->Position[0],
+				GetNodeRenderData(mpTris[livetri].miCorners[0])->Position[1],
+				GetNodeRenderData(mpTris[livetri].miCorners[0])->Position[2]);
 			point_vector.push_back(v0);
-			Point3 v1(mpNodes[mpTris[livetri].miCorners[1]].mpRenderData->Position[0],
-				mpNodes[mpTris[livetri].miCorners[1]].mpRenderData->Position[1],
-				mpNodes[mpTris[livetri].miCorners[1]].mpRenderData->Position[2]);
+			Point3 v1(GetNodeRenderData(mpTris[livetri].miCorners[1])->Position[0],
+				GetNodeRenderData(mpTris[livetri].miCorners[1])->Position[1],
+				GetNodeRenderData(mpTris[livetri].miCorners[1])->Position[2]);
 			point_vector.push_back(v1);
-			Point3 v2(mpNodes[mpTris[livetri].miCorners[2]].mpRenderData->Position[0],
-				mpNodes[mpTris[livetri].miCorners[2]].mpRenderData->Position[1],
-				mpNodes[mpTris[livetri].miCorners[2]].mpRenderData->Position[2]);
+			Point3 v2(GetNodeRenderData(mpTris[livetri].miCorners[2])->Position[0],
+				GetNodeRenderData(mpTris[livetri].miCorners[2])->Position[1],
+				GetNodeRenderData(mpTris[livetri].miCorners[2])->Position[2]);
 			point_vector.push_back(v2);
 			k = mpTris[livetri].GetNodeIndexC(livetri, iNode, *this);
 			livetri = NextLiveTris[livetri][k];
@@ -1467,33 +1559,49 @@ void Forest::ForestComputeBBoxes(NodeIndex iNode, TriIndex *FirstLiveTris, TriIn
 	mpNodes[iNode].mZBBoxOffset = (zmax - zmin) / 2.0f;
 }
 
-#ifdef _WIN32
-void WriteArray(void *pArray, unsigned int Length, HANDLE FileHandle)
-#else
-void WriteArray(void *pArray, unsigned int Length, int FileHandle)
-#endif
+// Writes Length bytes of pArray at Offset in the file, zero filling the gap from
+// the current file position rFilePos (which must not be past Offset).
+bool WriteArray(const void *pArray, size_t Length, VDSFileOffset Offset, FILE *pFile, VDSFileOffset &rFilePos)
 {
-#ifdef _WIN32 
-    volatile static const unsigned int max_chars_to_write = 50000000 / sizeof(char);
-    unsigned char *p;
-    DWORD num_bytes_written;
-	
-    p = (unsigned char *) pArray;
-    while (p < (unsigned char *) pArray + Length)
+    static const size_t max_chars_to_write = 50000000 / sizeof(char);
+    const unsigned char *p;
+    size_t count;
+
+    assert(rFilePos <= Offset);
+    for (; rFilePos < Offset; ++rFilePos)
     {
-        if (p + max_chars_to_write < (unsigned char *) pArray + Length)
-        {
-            WriteFile(FileHandle, p, sizeof(unsigned char) * max_chars_to_write, &num_bytes_written, NULL);
-        }
-        else
-        {
-            WriteFile(FileHandle, p, sizeof(unsigned char) * (Length % max_chars_to_write), &num_bytes_written, NULL);
-        }
-        p += max_chars_to_write;
+        if (fputc(0, pFile) == EOF)
+            return false;
     }
-#else
-    fprintf(stderr, "array writing not implemented for non-win32");
-#endif
+    p = (const unsigned char *) pArray;
+    while (Length > 0)
+    {
+        count = (Length < max_chars_to_write) ? Length : max_chars_to_write;
+        if (fwrite(p, sizeof(unsigned char), count, pFile) != count)
+            return false;
+        p += count;
+        Length -= count;
+        rFilePos += count;
+    }
+    return true;
+}
+
+// Reads Length bytes at Offset in the file into pArray, skipping forward from the
+// current file position rFilePos (which must not be past Offset).
+bool ReadArray(void *pArray, size_t Length, VDSFileOffset Offset, FILE *pFile, VDSFileOffset &rFilePos)
+{
+    assert(rFilePos <= Offset);
+    if (rFilePos < Offset)
+    {
+        // sections are only separated by alignment padding, so this never seeks far
+        if (fseek(pFile, (long) (Offset - rFilePos), SEEK_CUR) != 0)
+            return false;
+        rFilePos = Offset;
+    }
+    if (Length > 0 && fread(pArray, sizeof(unsigned char), Length, pFile) != Length)
+        return false;
+    rFilePos += Length;
+    return true;
 }
 
 //function for sorting corners in BuildSubTriLists
@@ -15,12 +15,58 @@
 #define FOREST_H
 
 #include "vds.h"
+#include "node.h"
 #include "renderer.h"
 #include "vif.h"
+#include "pager.h"
+
+// every array in a binary VDS file starts on a multiple of this many bytes
+#define VDS_FILE_SECTION_ALIGNMENT 64
+
+// first word of a compressed VDS file ("VDSZ"); binary VDS files start with their major version
+#define VDS_COMPRESSED_FILE_MAGIC 0x5a534456
+// maximum number of array elements in each independently decodable chunk of a compressed VDS file
+#define VDS_COMPRESSED_CHUNK_RECORDS 16384
+
+// first word of a progressive VDS file ("VDSP")
+#define VDS_PROGRESSIVE_FILE_MAGIC 0x50534456
+// unfold records read per ContinueProgressiveVDS call when a progressive file is read all at once
+#define VDS_PROGRESSIVE_RECORDS_PER_STEP 4096
 
 namespace VDS
 {
 
+struct VDSProgressiveLoader;
+
+// Header at the start of a binary VDS file (and of GLOD readback buffers).
+// The arrays follow at the given offsets, stored exactly as they are laid out in
+// memory, so the sizes recorded here must match the reader's for the file to load.
+struct VDSFileHeader
+{
+	unsigned int Major;
+	unsigned int Minor;
+	unsigned int HeaderSize;
+	unsigned int NodeSize;
+	unsigned int TriSize;
+	unsigned int RenderDatumSize;
+	unsigned int IndexSize;
+	unsigned int ColorsPresent;
+	unsigned int NormalsPresent;
+	unsigned int NumTextures;
+	unsigned int NumPatches;
+	int ErrorParamSize;
+	VDSFileOffset NumNodes;
+	VDSFileOffset NumNodePositions;
+	VDSFileOffset NumTris;
+	VDSFileOffset NumErrorParams;
+	VDSFileOffset ErrorParamsOffset;
+	VDSFileOffset NodesOffset;
+	VDSFileOffset NodeRenderDataOffset;
+	VDSFileOffset TrisOffset;
+	VDSFileOffset FileSize;
+	VDSFileOffset NumCoarseNodes;	// see Forest::mNumCoarseNodes
+};
+
 class Forest
 {
 public: // PUBLIC FUNCTIONS
@@ -42,10 +88,11 @@ public: // PUBLIC FUNCTIONS
 	// Returns true if successful, false if error occurred
 	bool GiveDataToVif(Vif &v);
 
-	// Reads All VDSdata structure data from a binary VDS file
+	// Reads All VDSdata structure data from a binary VDS file (or a compressed one)
 	bool ReadBinaryVDS(const char *Filename);
 
-	// Memory maps a binary VDS file instead of reading it into memory
+	// Memory maps a binary VDS file instead of reading it into memory. The file's
+	// arrays are used in place (copy-on-write) with no pointer fix-up.
 	bool MemoryMapVDS(const char *Filename);
 
 	// GLOD Readback Functions --- these are hacked copies of the Read/WriteBinaryVDS functions
@@ -53,14 +100,70 @@ public: // PUBLIC FUNCTIONS
         int WriteBinaryVDStoBuffer(char* buffer);
         int ReadBinaryVDSfromBuffer(char* buffer);
 
+	// GLOD object streams move a binary VDS file's header and arrays one at a time.
+	// BeginBinaryVDS checks the header and allocates the arrays for the caller to read
+	// into or, if Borrowed, leaves the caller to point them at memory that outlives
+	// the forest.  EndBinaryVDS is called once they are all in place.
+	void GetBinaryVDSHeader(VDSFileHeader &rHeader) const { FillFileHeader(rHeader); }
+	bool BeginBinaryVDS(const VDSFileHeader &rHeader, bool Borrowed);
+	void EndBinaryVDS() { SetValid(); }
+
 	// Writes All VDSdata structure data to a binary VDS file
 	bool WriteBinaryVDS(const char *Filename);
 
-	// converts vertex renderdata member of nodes from indices to pointers
-	void VertexRenderDataIndicesToPointers();
+	// Writes a compressed VDS file, coded in independent chunks by NumThreads threads
+	// (0 means one per processor).  PositionBits and NormalBits quantize vertex positions
+	// and normals to that many bits per component; 0 stores them exactly.
+	bool WriteCompressedVDS(const char *Filename, unsigned int PositionBits = 0, unsigned int NormalBits = 0, int NumThreads = 0);
+
+	// Reads a compressed VDS file, with NumThreads threads (0 means one per processor) each
+	// reading and decoding their share of the chunks
+	bool ReadCompressedVDS(const char *Filename, int NumThreads = 0);
+
+	// Starts paging a memory mapped forest: at most MemoryBudget bytes of the file are
+	// kept resident, and nodes whose data isn't resident are left folded until a
+	// background thread has loaded it.  Returns false if the forest isn't memory mapped.
+	bool EnablePaging(VDSFileOffset MemoryBudget, unsigned int PageSize = VDS_DEFAULT_PAGE_SIZE);
+	void DisablePaging();
+
+	// Renumbers the nodes so the coarse levels of the forest come first, breadth first,
+	// followed by the subtrees below them, each depth first; then reorders tris, node 
+	// render data and error params to follow the node order, so the data read when 
+	// unfolding a node sits near the node itself.  The coarse region holds as many whole
+	// levels as fit in MaxCoarseNodes nodes (0 means a sixteenth of the forest).  Use
+	// before WriteBinaryVDS to produce files that page well; no cuts may be attached.
+	bool ReorderForPaging(NodeIndex MaxCoarseNodes = 0);
 
-	// converts vertex renderdata member of nodes from pointers to indices
-	void VertexRenderDataPointersToIndices();
+	// returns false if the nodes aren't numbered as ReorderForPaging leaves them: 
+	// coarse levels breadth first, and every subtree below them depth first
+	bool CheckPagingLayout() const;
+
+	// For finding tri proxies: subtrees below the coarse region are numbered depth
+	// first, so the nodes under a child of a node unfolding there lie from its index
+	// up to its right sibling's.  A coarse node has instead the first index of the
+	// depth first subtrees under it (or after it, if there are none under it).
+	NodeIndex GetSubtreeStart(NodeIndex iNode) const { return (iNode > mNumCoarseNodes) ? iNode : mpCoarseSubtreeStarts[iNode]; }
+
+	// Writes a progressive VDS file: the forest as a stream of unfold records, coarsest first
+	bool WriteProgressiveVDS(const char *Filename);
+	bool WriteProgressiveVDS(VDSWriteFunc fWrite, void *pUserData);
+
+	// Starts loading a progressive VDS file or stream.  Only the roots are read before
+	// returning; the forest can then be used right away, and each ContinueProgressiveVDS
+	// call reads up to MaxRecords more unfold records (returning false once there are no
+	// more).  Nodes whose records haven't arrived yet are not unfolded.  When reading from
+	// fRead, it must stay callable until loading finishes or the forest is reset.
+	bool BeginProgressiveVDS(const char *Filename);
+	bool BeginProgressiveVDS(VDSReadFunc fRead, void *pUserData);
+	bool ContinueProgressiveVDS(unsigned int MaxRecords);
+	// number of unfold records still to be read; 0 once loading has stopped
+	VDSFileOffset GetProgressiveRecordsLeft() const;
+
+	// Reads a whole progressive VDS file
+	bool ReadProgressiveVDS(const char *Filename);
+
+	// returns false if iNode's children or subtris are still being loaded progressively
+	bool NodeIsLoaded(NodeIndex iNode) const { return (mpNodeLoaded == NULL) || mpNodeLoaded[iNode]; }
 
 	// Resets Forests member variables and frees all memory allocated by Forest.
 	// User callbacks are retained.
@@ -71,11 +174,21 @@ public: // PUBLIC FUNCTIONS
 	// returns true if iNode1 and iNode2 are coincident or if iNode1 == iNode2
 	bool NodesAreCoincidentOrEqual(NodeIndex iNode1, NodeIndex iNode2);
 
+	// returns the original render data (position, color, etc.) of a node
+	VertexRenderDatum *GetNodeRenderData(NodeIndex iNode) const { return &mpNodeRenderData[mpNodes[iNode].miRenderData]; }
+
 protected: // PRIVATE FUNCTIONS
 		
 	//Initializes Refs if needed and checks for existence of nodes and tris
 	void SetValid();
 
+	// Fills in a binary VDS file header (including section offsets) for this forest
+	void FillFileHeader(VDSFileHeader &rHeader) const;
+
+	// Checks a binary VDS file header against this build's data layout and the 
+	// AvailableSize bytes of file, and copies its counts into the forest
+	bool GetDataFromFileHeader(const VDSFileHeader &rHeader, VDSFileOffset AvailableSize);
+
 	//Swaps any two nodes.  Only fixes node-node relationships and subtri lists.
 	//Everything else must be fixed by the caller.
 	void SwapNodes(NodeIndex iNode1, NodeIndex iNode2, TriIndex *FirstLiveTris);
@@ -89,6 +202,12 @@ protected: // PRIVATE FUNCTIONS
 
 	NodeIndex first_ancestor_of(NodeIndex a, NodeIndex b);
 
+	// stops reading a progressive VDS stream, closing it if the forest opened it
+	void EndProgressiveVDS();
+
+	// fills in mpCoarseSubtreeStarts from the links of the coarse nodes
+	bool ComputeCoarseSubtreeStarts();
+
 public: // DEBUG FUNCTIONS
 	void PrintForestInfo(Cut *pCut);
 	void PrintForestStructure();
@@ -110,17 +229,26 @@ public:	// PUBLIC DATA
 	unsigned int mNumTextures;	// (CURRENTLY ONLY SINGLE TEXTURE SUPPORTED)
 	bool mIsValid;
 	bool mIsMMapped;
+	bool mIsBorrowed;	// the arrays belong to someone else, who frees them
 #ifdef _WIN32
 	BYTE *mMMapFile;
 #else
 	char *mMMapFile;
 #endif
+	VDSFileOffset mMMapSize;
+	ForestPager *mpPager;	// non-NULL while paging is enabled
+	unsigned char *mpNodeLoaded;	// per node flags; non-NULL while loading progressively
+	VDSProgressiveLoader *mpLoader;
 	NodeIndex mNumNodes;
 	NodeIndex mNumNodePositions;
 	TriIndex mNumTris;
 	PatchIndex mNumPatches;
 	NodeIndex mNumErrorParams;
 	int mErrorParamSize;
+	// nodes 1 to mNumCoarseNodes are the coarse levels, numbered breadth first; the
+	// rest are numbered depth first.  0 (the usual case) if all nodes are depth first
+	NodeIndex mNumCoarseNodes;
+	NodeIndex *mpCoarseSubtreeStarts;	// mNumCoarseNodes + 1 entries; see GetSubtreeStart()
 
 protected: // PRIVATE DATA
 	NodeIndex DFSindex;
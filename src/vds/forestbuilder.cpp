@@ -22,6 +22,7 @@
 #include <algorithm>
 #include "vds.h"
 #include "forestbuilder.h"
+#include "threads.h"
 #include <limits.h>
 #include <math.h>
 #if defined(_WIN32) || defined(__APPLE__)
@@ -36,6 +37,11 @@
 #define FLT_MAX 1e32
 #endif
 
+// nodes or tris per thread below which the post-processing passes aren't split up
+#define BUILDER_MIN_THREAD_ITEMS 4096
+// subtrees handed to each thread by a bottom-up pass, so the threads finish together
+#define BUILDER_SUBTREES_PER_THREAD 8
+
 extern void VDS::StdViewIndependentError(NodeIndex iNode, const Forest &Forest);
 
 using namespace std;
@@ -95,7 +101,7 @@ void ForestBuilder::Reset()
 
 Point3 ForestBuilder::GetNodePosition(NodeIndex n) const
 {
-	return mpNodes[n].mpRenderData->Position;
+	return GetNodeRenderData(n)->Position;
 }
 
 void ForestBuilder::SetMergePositionCreationFunc(MergePositionCreationFunc fMergePositionCreation)
@@ -166,7 +172,7 @@ void ForestBuilder::EndForest()
 	BuildSubTriLists();
 
 //	ComputeRadii(iROOT_NODE);
-	ForestComputeBBoxes(iROOT_NODE, mFirstLiveTris, mNextLiveTris);
+	ComputeBBoxes();
 	ComputeViewIndependentErrors();
 
     SetValid();
@@ -357,7 +363,7 @@ bool ForestBuilder::ReallocateNodes(NodeIndex NewSize)
 	mpNodeRenderData = new_renderdata_array;
 	for (i = 1; i <= mNumNodes; ++i)
 	{
-		mpNodes[i].mpRenderData = &mpNodeRenderData[i-1];
+		mpNodes[i].miRenderData = i-1;
 	}
 
     new_node_array = new Node[NewSize];
@@ -475,11 +481,11 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition, const ByteColor &rColo
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-    mpNodes[node].mpRenderData->Color = (ByteColorA) rColor;
-    mpNodes[node].mpRenderData->Normal = rNormal;
-	mpNodes[node].mpRenderData->TexCoords = rTexCoords;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+    GetNodeRenderData(node)->Color = (ByteColorA) rColor;
+    GetNodeRenderData(node)->Normal = rNormal;
+	GetNodeRenderData(node)->TexCoords = rTexCoords;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
     return mNumNodes;
@@ -503,10 +509,10 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition, const Vec3 &rNormal, c
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-    mpNodes[node].mpRenderData->Normal = rNormal;
-	mpNodes[node].mpRenderData->TexCoords = rTexCoords;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+    GetNodeRenderData(node)->Normal = rNormal;
+	GetNodeRenderData(node)->TexCoords = rTexCoords;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
     return mNumNodes;
@@ -526,10 +532,10 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition, const ByteColor &rColo
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-    mpNodes[node].mpRenderData->Color = (ByteColorA) rColor;
-	mpNodes[node].mpRenderData->TexCoords = rTexCoords;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+    GetNodeRenderData(node)->Color = (ByteColorA) rColor;
+	GetNodeRenderData(node)->TexCoords = rTexCoords;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
     return mNumNodes;
@@ -550,9 +556,9 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition, const Point2 &rTexCoor
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-	mpNodes[node].mpRenderData->TexCoords = rTexCoords;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+	GetNodeRenderData(node)->TexCoords = rTexCoords;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
 	return mNumNodes;
@@ -575,9 +581,9 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition, const Vec3 &rNormal)
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-    mpNodes[node].mpRenderData->Normal = rNormal;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+    GetNodeRenderData(node)->Normal = rNormal;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
 	return mNumNodes;
@@ -596,9 +602,9 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition, const ByteColor &rColo
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-    mpNodes[node].mpRenderData->Color = (ByteColorA) rColor;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+    GetNodeRenderData(node)->Color = (ByteColorA) rColor;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
 	return mNumNodes;
@@ -618,8 +624,8 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition)
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
     return mNumNodes;
@@ -642,10 +648,10 @@ NodeIndex ForestBuilder::AddNode(const Point3 &rPosition,  const ByteColor &rCol
     ++mNumNodes;
 	++mNumNodePositions;
     node = mNumNodes;
-	mpNodes[node].mpRenderData = &mpNodeRenderData[node-1];
-    mpNodes[node].mpRenderData->Position = rPosition;
-    mpNodes[node].mpRenderData->Color = (ByteColorA) rColor;
-    mpNodes[node].mpRenderData->Normal = rNormal;
+	mpNodes[node].miRenderData = node-1;
+    GetNodeRenderData(node)->Position = rPosition;
+    GetNodeRenderData(node)->Color = (ByteColorA) rColor;
+    GetNodeRenderData(node)->Normal = rNormal;
 	mpNodes[node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[node].mPatchID = 0;
 	return mNumNodes;
@@ -679,7 +685,7 @@ TriIndex ForestBuilder::AddTri(NodeIndex iNode1, NodeIndex iNode2, NodeIndex iNo
 
     for (i = 0; i < 3; i++)
     {
-		mAvgEdgeLength += mpNodes[mpTris[mNumTris].miCorners[i]].mpRenderData->Position.DistanceTo(mpNodes[mpTris[mNumTris].miCorners[(i + 1) % 3]].mpRenderData->Position);
+		mAvgEdgeLength += GetNodeRenderData(mpTris[mNumTris].miCorners[i])->Position.DistanceTo(GetNodeRenderData(mpTris[mNumTris].miCorners[(i + 1) % 3])->Position);
     }
   return mNumTris;
 }
@@ -718,7 +724,7 @@ NodeIndex ForestBuilder::SetupMergeNode(const NodeIndexVector &rChildren)
 	++mNumNodePositions;
     new_node = mNumNodes;
 
-	mpNodes[new_node].mpRenderData = &mpNodeRenderData[new_node-1];
+	mpNodes[new_node].miRenderData = new_node-1;
     mpNodes[new_node].miFirstChild = rChildren[0];
 	mpNodes[new_node].mCoincidentVertex = iNIL_NODE;
 	mpNodes[new_node].mPatchID = 0;
@@ -763,32 +769,32 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren)
     new_node = SetupMergeNode(rChildren);
     if (NULL == mfMergePositionCreation)
     {
-        mpNodes[new_node].mpRenderData->Position = DefaultMergePositionCreation(rChildren);
+        GetNodeRenderData(new_node)->Position = DefaultMergePositionCreation(rChildren);
     }
     else
     {
-        mpNodes[new_node].mpRenderData->Position = mfMergePositionCreation(rChildren, *this);
+        GetNodeRenderData(new_node)->Position = mfMergePositionCreation(rChildren, *this);
     }
     if (mNormalsPresent)
     {
         if (NULL == mfMergeNormalCreation)
         {
-            mpNodes[new_node].mpRenderData->Normal = DefaultMergeNormalCreation(rChildren);
+            GetNodeRenderData(new_node)->Normal = DefaultMergeNormalCreation(rChildren);
         }
         else
         {
-            mpNodes[new_node].mpRenderData->Normal = mfMergeNormalCreation(rChildren, *this);
+            GetNodeRenderData(new_node)->Normal = mfMergeNormalCreation(rChildren, *this);
         }
     }
     if (mColorsPresent)
     {
         if (NULL == mfMergeColorCreation)
         {
-            mpNodes[new_node].mpRenderData->Color = (ByteColorA) DefaultMergeColorCreation(rChildren);
+            GetNodeRenderData(new_node)->Color = (ByteColorA) DefaultMergeColorCreation(rChildren);
         }
         else
         {
-            mpNodes[new_node].mpRenderData->Color = (ByteColorA) mfMergeColorCreation(rChildren, *this);
+            GetNodeRenderData(new_node)->Color = (ByteColorA) mfMergeColorCreation(rChildren, *this);
         }
     }
     if (mNumTextures > 0)
@@ -826,10 +832,10 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
     assert(mNumTextures > 0 && mColorsPresent && mNormalsPresent);
 //    unsigned int i;
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-    mpNodes[parent].mpRenderData->Color = (ByteColorA) rColor;
-    mpNodes[parent].mpRenderData->Normal = rNormal;
-	mpNodes[parent].mpRenderData->TexCoords = rTexCoords;
+    GetNodeRenderData(parent)->Position = rPosition;
+    GetNodeRenderData(parent)->Color = (ByteColorA) rColor;
+    GetNodeRenderData(parent)->Normal = rNormal;
+	GetNodeRenderData(parent)->TexCoords = rTexCoords;
     return parent;
 }
 
@@ -855,9 +861,9 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
     assert(mNumTextures > 0 && !mColorsPresent && mNormalsPresent);
 //    unsigned int i;
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-    mpNodes[parent].mpRenderData->Normal = rNormal;
-	mpNodes[parent].mpRenderData->TexCoords = rTexCoords;
+    GetNodeRenderData(parent)->Position = rPosition;
+    GetNodeRenderData(parent)->Normal = rNormal;
+	GetNodeRenderData(parent)->TexCoords = rTexCoords;
     return parent;
 }
 
@@ -882,9 +888,9 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
     assert(mNumTextures > 0 && mColorsPresent && !mNormalsPresent);
 //    unsigned int i;
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-    mpNodes[parent].mpRenderData->Color = (ByteColorA) rColor;
-	mpNodes[parent].mpRenderData->TexCoords = rTexCoords;
+    GetNodeRenderData(parent)->Position = rPosition;
+    GetNodeRenderData(parent)->Color = (ByteColorA) rColor;
+	GetNodeRenderData(parent)->TexCoords = rTexCoords;
     return parent;
 }
 
@@ -909,8 +915,8 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
     assert(mNumTextures > 0 && !mColorsPresent && !mNormalsPresent);
 //    unsigned int i;
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-	mpNodes[parent].mpRenderData->TexCoords = rTexCoords;
+    GetNodeRenderData(parent)->Position = rPosition;
+	GetNodeRenderData(parent)->TexCoords = rTexCoords;
     return parent;
 }
 
@@ -933,8 +939,8 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
 
     assert(mNumTextures == 0 && !mColorsPresent && mNormalsPresent);    
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-    mpNodes[parent].mpRenderData->Normal = rNormal;
+    GetNodeRenderData(parent)->Position = rPosition;
+    GetNodeRenderData(parent)->Normal = rNormal;
     return parent;
 }
 
@@ -956,8 +962,8 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
 
     assert(mNumTextures == 0 && mColorsPresent && !mNormalsPresent);
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-    mpNodes[parent].mpRenderData->Color = (ByteColorA) rColor;
+    GetNodeRenderData(parent)->Position = rPosition;
+    GetNodeRenderData(parent)->Color = (ByteColorA) rColor;
     return parent;
 }
 
@@ -980,7 +986,7 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
 
     assert(mNumTextures == 0 && !mColorsPresent && !mNormalsPresent);
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
+    GetNodeRenderData(parent)->Position = rPosition;
     return parent;
 }
 
@@ -1003,9 +1009,9 @@ NodeIndex ForestBuilder::MergeNodes(const NodeIndexVector &rChildren, const Poin
 
     assert(mNumTextures == 0 && mColorsPresent && mNormalsPresent);
     parent = SetupMergeNode(rChildren);
-    mpNodes[parent].mpRenderData->Position = rPosition;
-    mpNodes[parent].mpRenderData->Color = (ByteColorA) rColor;
-    mpNodes[parent].mpRenderData->Normal = rNormal;
+    GetNodeRenderData(parent)->Position = rPosition;
+    GetNodeRenderData(parent)->Color = (ByteColorA) rColor;
+    GetNodeRenderData(parent)->Normal = rNormal;
     return parent;
 }
 
@@ -1069,6 +1075,526 @@ void sort_three(NodeIndex &rA, NodeIndex &rB, NodeIndex &rC)
     }
 }
 
+// The post-processing passes below work on a forest whose nodes are numbered
+// depth-first, so that every subtree occupies a contiguous range of node indices
+// and every node comes after its ancestors.  A bottom-up pass hands whole subtrees
+// to different threads, each walking its ranges from the highest index down, and
+// then finishes the nodes above those subtrees on the calling thread.
+
+namespace {
+
+typedef void (*NodeVisitFunc)(Forest &rForest, NodeIndex iNode, int iThread, void *pData);
+
+int ChooseBuilderThreads(int NumThreads, size_t NumItems)
+{
+	if (NumThreads <= 0)
+		NumThreads = GetNumSystemProcessors();
+	if ((size_t) NumThreads > NumItems)
+		NumThreads = (int) NumItems;
+	return (NumThreads > 0) ? NumThreads : 1;
+}
+
+// state shared by the threads of a pass over the nodes
+struct NodePassJob
+{
+	Forest *pForest;
+	NodeVisitFunc fVisit;
+	void *pData;
+	const NodeIndex *pSubtreeEnd;		// bottom-up passes only
+	const vector<NodeIndex> *pSubtrees;	// bottom-up passes only
+};
+
+// thread i visits the i'th contiguous range of nodes
+void NodeRangeThread(int iThread, int NumThreads, void *pParams)
+{
+	NodePassJob *job = (NodePassJob *) pParams;
+	NodeIndex num_nodes = job->pForest->mNumNodes;
+	NodeIndex first = 1 + (NodeIndex) ((double) num_nodes * iThread / NumThreads);
+	NodeIndex last = (NodeIndex) ((double) num_nodes * (iThread + 1) / NumThreads);
+	NodeIndex node;
+
+	for (node = first; node <= last; ++node)
+		job->fVisit(*job->pForest, node, iThread, job->pData);
+}
+
+// thread i visits subtrees i, i + NumThreads, ..., children before parents
+void SubtreesThread(int iThread, int NumThreads, void *pParams)
+{
+	NodePassJob *job = (NodePassJob *) pParams;
+	size_t i;
+	NodeIndex root, node;
+
+	for (i = iThread; i < job->pSubtrees->size(); i += NumThreads)
+	{
+		root = (*job->pSubtrees)[i];
+		for (node = job->pSubtreeEnd[root] - 1; node >= root; --node)
+			job->fVisit(*job->pForest, node, iThread, job->pData);
+	}
+}
+
+// Visits every node once, in no particular order
+void ForEachNode(Forest &rForest, int NumThreads, NodeVisitFunc fVisit, void *pData)
+{
+	NodePassJob job;
+
+	job.pForest = &rForest;
+	job.fVisit = fVisit;
+	job.pData = pData;
+	job.pSubtreeEnd = NULL;
+	job.pSubtrees = NULL;
+	ForkAndJoinThreads(NumThreads, NodeRangeThread, &job);
+}
+
+// Visits every node once, always after all of its children
+void ForEachNodeBottomUp(Forest &rForest, int NumThreads, NodeVisitFunc fVisit, void *pData)
+{
+	NodeIndex num_nodes = rForest.mNumNodes;
+	NodeIndex *subtree_end = new NodeIndex[num_nodes + 1];
+	vector<NodeIndex> subtrees, upper_nodes, stack;
+	NodeIndex node, child, max_subtree_nodes;
+	NodePassJob job;
+	size_t i;
+
+	// one past the last node in each subtree
+	for (node = 1; node <= num_nodes; ++node)
+		subtree_end[node] = node + 1;
+	for (node = num_nodes; node > Forest::iROOT_NODE; --node)
+	{
+		if (subtree_end[node] > subtree_end[rForest.mpNodes[node].miParent])
+			subtree_end[rForest.mpNodes[node].miParent] = subtree_end[node];
+	}
+
+	// cut the forest into subtrees small enough to balance the threads' work
+	max_subtree_nodes = num_nodes;
+	if (NumThreads > 1)
+	{
+		max_subtree_nodes = num_nodes / (NumThreads * BUILDER_SUBTREES_PER_THREAD);
+		if (max_subtree_nodes < BUILDER_MIN_THREAD_ITEMS)
+			max_subtree_nodes = BUILDER_MIN_THREAD_ITEMS;
+	}
+	stack.push_back(Forest::iROOT_NODE);
+	while (!stack.empty())
+	{
+		node = stack.back();
+		stack.pop_back();
+		if (subtree_end[node] - node <= max_subtree_nodes)
+			subtrees.push_back(node);
+		else
+		{
+			upper_nodes.push_back(node);
+			for (child = rForest.mpNodes[node].miFirstChild; child != Forest::iNIL_NODE; child = rForest.mpNodes[child].miRightSibling)
+				stack.push_back(child);
+		}
+	}
+
+	job.pForest = &rForest;
+	job.fVisit = fVisit;
+	job.pData = pData;
+	job.pSubtreeEnd = subtree_end;
+	job.pSubtrees = &subtrees;
+	ForkAndJoinThreads(NumThreads, SubtreesThread, &job);
+
+	// every node above the subtrees has a smaller index than its descendants
+	sort(upper_nodes.begin(), upper_nodes.end());
+	for (i = upper_nodes.size(); i > 0; --i)
+		fVisit(rForest, upper_nodes[i - 1], 0, pData);
+	delete[] subtree_end;
+}
+
+struct SubTriJob
+{
+	const Forest *pForest;
+	NodeIndex *pOwners;		// node each tri is a subtri of
+};
+
+// see ForestBuilder::BuildSubTriLists
+void FindSubTriOwnersThread(int iThread, int NumThreads, void *pParams)
+{
+	SubTriJob *job = (SubTriJob *) pParams;
+	const Node *nodes = job->pForest->mpNodes;
+	const Tri *tris = job->pForest->mpTris;
+	TriIndex num_tris = job->pForest->mNumTris;
+	TriIndex first = 1 + (TriIndex) ((double) num_tris * iThread / NumThreads);
+	TriIndex last = (TriIndex) ((double) num_tris * (iThread + 1) / NumThreads);
+	TriIndex tri;
+	NodeIndex a, b, c, ancestor;
+
+	//sort corners of each tri such that a<b<c
+	//if bc_first_ancestor > a then tri is a subtri of i_bc_first_ancestor
+	//otherwise tri is a subtri of i_ab_first_ancestor
+	for (tri = first; tri <= last; ++tri)
+	{
+		a = tris[tri].miCorners[0];
+		b = tris[tri].miCorners[1];
+		c = tris[tri].miCorners[2];
+		sort_three(a, b, c);
+		//to find the ancestor climb Forest from greater ID node
+		//until a node with ID > lesser ID node is reached.
+		ancestor = nodes[c].miParent;
+		while (ancestor > b)
+			ancestor = nodes[ancestor].miParent;
+		if (ancestor < a)
+		{
+			ancestor = nodes[b].miParent;
+			while (ancestor > a)
+				ancestor = nodes[ancestor].miParent;
+		}
+		job->pOwners[tri] = ancestor;
+	}
+}
+
+struct BBoxJob
+{
+	TriIndex *pFirstNodeTri;	// node i supports pNodeTris[pFirstNodeTri[i]..pFirstNodeTri[i+1]-1]
+	TriIndex *pNodeTris;
+	vector<unsigned int> NumEmptyLeaves;	// per thread
+};
+
+void ComputeNodeBBox(Forest &rForest, NodeIndex iNode, int iThread, void *pData)
+{
+	BBoxJob *job = (BBoxJob *) pData;
+	Node &node = rForest.mpNodes[iNode];
+	NodeIndex child;
+	TriIndex i;
+	int k;
+	Float xmin = FLT_MAX;
+	Float xmax = -FLT_MAX;
+	Float ymin = FLT_MAX;
+	Float ymax = -FLT_MAX;
+	Float zmin = FLT_MAX;
+	Float zmax = -FLT_MAX;
+
+	if (node.miFirstChild != Forest::iNIL_NODE)
+	{
+		// bound opposite corners of the children's bboxes
+		for (child = node.miFirstChild; child != Forest::iNIL_NODE; child = rForest.mpNodes[child].miRightSibling)
+		{
+			const Node &c = rForest.mpNodes[child];
+			Point3 lo(c.mBBoxCenter.X - c.mXBBoxOffset, c.mBBoxCenter.Y - c.mYBBoxOffset, c.mBBoxCenter.Z - c.mZBBoxOffset);
+			Point3 hi(c.mBBoxCenter.X + c.mXBBoxOffset, c.mBBoxCenter.Y + c.mYBBoxOffset, c.mBBoxCenter.Z + c.mZBBoxOffset);
+			if (lo.X < xmin) xmin = lo.X;
+			if (hi.X > xmax) xmax = hi.X;
+			if (lo.Y < ymin) ymin = lo.Y;
+			if (hi.Y > ymax) ymax = hi.Y;
+			if (lo.Z < zmin) zmin = lo.Z;
+			if (hi.Z > zmax) zmax = hi.Z;
+		}
+	}
+	else if (job->pFirstNodeTri[iNode] != job->pFirstNodeTri[iNode + 1])
+	{
+		// leaf node - bound all vertices of all triangles it supports
+		for (i = job->pFirstNodeTri[iNode]; i < job->pFirstNodeTri[iNode + 1]; ++i)
+		{
+			for (k = 0; k < 3; ++k)
+			{
+				const Point3 &p = rForest.GetNodeRenderData(rForest.mpTris[job->pNodeTris[i]].miCorners[k])->Position;
+				if (p.X < xmin) xmin = p.X;
+				if (p.X > xmax) xmax = p.X;
+				if (p.Y < ymin) ymin = p.Y;
+				if (p.Y > ymax) ymax = p.Y;
+				if (p.Z < zmin) zmin = p.Z;
+				if (p.Z > zmax) zmax = p.Z;
+			}
+		}
+	}
+	else
+	{
+		++job->NumEmptyLeaves[iThread];
+		node.mBBoxCenter = rForest.GetNodeRenderData(iNode)->Position;
+		node.mXBBoxOffset = 0.0f;
+		node.mYBBoxOffset = 0.0f;
+		node.mZBBoxOffset = 0.0f;
+		return;
+	}
+	node.mBBoxCenter.X = (xmax + xmin) / 2.0f;
+	node.mBBoxCenter.Y = (ymax + ymin) / 2.0f;
+	node.mBBoxCenter.Z = (zmax + zmin) / 2.0f;
+	node.mXBBoxOffset = (xmax - xmin) / 2.0f;
+	node.mYBBoxOffset = (ymax - ymin) / 2.0f;
+	node.mZBBoxOffset = (zmax - zmin) / 2.0f;
+}
+
+void ComputeNodeError(Forest &rForest, NodeIndex iNode, int iThread, void *pData)
+{
+	// leaves all share error param 0
+	if (rForest.mpNodes[iNode].miFirstChild != Forest::iNIL_NODE)
+		StdViewIndependentError(iNode, rForest);
+}
+
+// the hierarchy handed to ForestBuilder::BuildForest, indexed by node number + 1
+struct BulkHierarchy
+{
+	Forest *pForest;
+	const BulkForestData *pData;
+	NodeIndex *pParent;
+	NodeIndex *pFirstChild;
+	NodeIndex *pLeftSibling;
+	NodeIndex *pRightSibling;
+	NodeIndex *pNewIndex;	// depth-first index of each node (pNewIndex[0] is iNIL_NODE)
+	NodeIndex *pOldIndex;	// and the reverse
+	vector<Float> EdgeLengths;	// per thread
+	vector<char> BadTris;		// per thread
+};
+
+// copies node i from the hierarchy in its new place
+void CopyBulkNode(Forest &rForest, NodeIndex iNode, int iThread, void *pParams)
+{
+	BulkHierarchy *h = (BulkHierarchy *) pParams;
+	const BulkForestData &data = *h->pData;
+	Node &node = rForest.mpNodes[iNode];
+	NodeIndex old = h->pOldIndex[iNode];
+
+	node.miParent = h->pNewIndex[h->pParent[old]];
+	node.miFirstChild = h->pNewIndex[h->pFirstChild[old]];
+	node.miLeftSibling = h->pNewIndex[h->pLeftSibling[old]];
+	node.miRightSibling = h->pNewIndex[h->pRightSibling[old]];
+	node.miFirstSubTri = Forest::iNIL_TRI;
+	node.miRenderData = (data.pNodeRenderData != NULL) ? data.pNodeRenderData[old - 1] : old - 1;
+	node.mPatchID = (data.pNodePatches != NULL) ? data.pNodePatches[old - 1] : 0;
+	node.mCoincidentVertex = Forest::iNIL_NODE;
+	if ((data.pCoincidentNodes != NULL) && (data.pCoincidentNodes[old - 1] != old - 1))
+		node.mCoincidentVertex = h->pNewIndex[data.pCoincidentNodes[old - 1] + 1];
+	node.miErrorParamIndex = 0;
+}
+
+// thread i copies the i'th contiguous range of tris, with their corners renumbered
+void CopyBulkTrisThread(int iThread, int NumThreads, void *pParams)
+{
+	BulkHierarchy *h = (BulkHierarchy *) pParams;
+	const BulkForestData &data = *h->pData;
+	Forest *pForest = h->pForest;
+	TriIndex num_tris = pForest->mNumTris;
+	TriIndex first = 1 + (TriIndex) ((double) num_tris * iThread / NumThreads);
+	TriIndex last = (TriIndex) ((double) num_tris * (iThread + 1) / NumThreads);
+	TriIndex tri;
+	NodeIndex corners[3];
+	PatchIndex patch;
+	Float edge_lengths = 0.0;
+	int i;
+
+	for (tri = first; tri <= last; ++tri)
+	{
+		for (i = 0; i < 3; ++i)
+			corners[i] = data.pTriCorners[3 * (tri - 1) + i];
+		if ((corners[0] >= data.NumNodes) || (corners[1] >= data.NumNodes) || (corners[2] >= data.NumNodes) ||
+			(corners[0] == corners[1]) || (corners[0] == corners[2]) || (corners[1] == corners[2]))
+		{
+			h->BadTris[iThread] = true;
+			return;
+		}
+		patch = (data.pTriPatches != NULL) ? data.pTriPatches[tri - 1] : 0;
+		for (i = 0; i < 3; ++i)
+		{
+			pForest->mpTris[tri].miCorners[i] = h->pNewIndex[corners[i] + 1];
+			if (pForest->mpNodes[pForest->mpTris[tri].miCorners[i]].mPatchID != patch)
+			{
+				h->BadTris[iThread] = true;
+				return;
+			}
+			edge_lengths += pForest->GetNodeRenderData(pForest->mpTris[tri].miCorners[i])->Position.DistanceTo(
+				pForest->GetNodeRenderData(h->pNewIndex[corners[(i + 1) % 3] + 1])->Position);
+		}
+		pForest->mpTris[tri].mPatchID = patch;
+		pForest->mpTris[tri].miNextSubTri = Forest::iNIL_TRI;
+	}
+	h->EdgeLengths[iThread] = edge_lengths;
+}
+
+} // namespace
+
+BulkForestData::BulkForestData()
+{
+	ColorsPresent = false;
+	NormalsPresent = false;
+	NumTextures = 0;
+	NumPatches = 1;
+	NumRenderData = 0;
+	pRenderData = NULL;
+	NumNodes = 0;
+	pNodeRenderData = NULL;
+	pNodePatches = NULL;
+	pCoincidentNodes = NULL;
+	NumTris = 0;
+	pTriCorners = NULL;
+	pTriPatches = NULL;
+	NumMerges = 0;
+	pMergeParents = NULL;
+	pNumMergeChildren = NULL;
+	pMergeChildren = NULL;
+}
+
+bool ForestBuilder::BuildForest(const BulkForestData &rData, int NumThreads)
+{
+	assert(!mForestStarted && !mIsValid);
+	assert(rData.NumTextures <= 1); // currently only single texture supported
+	NodeIndex num_nodes = rData.NumNodes;
+	BulkHierarchy h;
+	vector<NodeIndex> stack;
+	NodeIndex node, parent, child, root, prev, num_visited;
+	unsigned int merge, i;
+	const NodeIndex *children;
+	Float edge_lengths;
+	bool ok = true;
+	int thread;
+
+	if ((num_nodes == 0) || (rData.NumTris == 0) || (rData.NumMerges == 0) || (rData.NumPatches == 0) ||
+		(rData.NumRenderData < ((rData.pNodeRenderData != NULL) ? 1 : num_nodes)))
+	{
+		cerr << "Error - BuildForest() needs nodes, render data, tris, patches and merges." << endl;
+		return false;
+	}
+	for (node = 0; node < num_nodes; ++node)
+	{
+		if (((rData.pNodeRenderData != NULL) && (rData.pNodeRenderData[node] >= rData.NumRenderData)) ||
+			((rData.pNodePatches != NULL) && (rData.pNodePatches[node] >= rData.NumPatches)) ||
+			((rData.pCoincidentNodes != NULL) && (rData.pCoincidentNodes[node] >= num_nodes)))
+		{
+			cerr << "Error - BuildForest() node " << node << " has render data, patch or coincident node out of range." << endl;
+			return false;
+		}
+	}
+
+	// link up the hierarchy, still in the caller's numbering
+	h.pForest = this;
+	h.pData = &rData;
+	h.pParent = new NodeIndex[num_nodes + 1];
+	h.pFirstChild = new NodeIndex[num_nodes + 1];
+	h.pLeftSibling = new NodeIndex[num_nodes + 1];
+	h.pRightSibling = new NodeIndex[num_nodes + 1];
+	h.pNewIndex = new NodeIndex[num_nodes + 1];
+	h.pOldIndex = new NodeIndex[num_nodes + 1];
+	for (node = 0; node <= num_nodes; ++node)
+	{
+		h.pParent[node] = h.pFirstChild[node] = h.pLeftSibling[node] = h.pRightSibling[node] = iNIL_NODE;
+		h.pNewIndex[node] = iNIL_NODE;
+	}
+	children = rData.pMergeChildren;
+	for (merge = 0; (merge < rData.NumMerges) && ok; ++merge)
+	{
+		parent = rData.pMergeParents[merge] + 1;
+		if ((rData.pMergeParents[merge] >= num_nodes) || (rData.pNumMergeChildren[merge] == 0) || (h.pFirstChild[parent] != iNIL_NODE))
+		{
+			cerr << "Error - merge " << merge << " has an invalid or already merged parent, or no children." << endl;
+			ok = false;
+			break;
+		}
+		prev = iNIL_NODE;
+		for (i = 0; i < rData.pNumMergeChildren[merge]; ++i)
+		{
+			child = children[i] + 1;
+			if ((children[i] >= num_nodes) || (child == parent) || (h.pParent[child] != iNIL_NODE))
+			{
+				cerr << "Error - merge " << merge << " has an invalid or already merged child." << endl;
+				ok = false;
+				break;
+			}
+			h.pParent[child] = parent;
+			h.pLeftSibling[child] = prev;
+			if (prev == iNIL_NODE)
+				h.pFirstChild[parent] = child;
+			else
+				h.pRightSibling[prev] = child;
+			prev = child;
+		}
+		children += rData.pNumMergeChildren[merge];
+	}
+
+	// number the nodes depth-first from the single root
+	root = iNIL_NODE;
+	for (node = 1; (node <= num_nodes) && ok; ++node)
+	{
+		if (h.pParent[node] == iNIL_NODE)
+		{
+			if (root != iNIL_NODE)
+			{
+				cerr << "Error - BuildForest() merges leave more than one root." << endl;
+				ok = false;
+			}
+			root = node;
+		}
+	}
+	num_visited = 0;
+	if (ok && (root != iNIL_NODE))
+	{
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			node = stack.back();
+			stack.pop_back();
+			++num_visited;
+			h.pNewIndex[node] = num_visited;
+			h.pOldIndex[num_visited] = node;
+			size_t first_child = stack.size();
+			for (child = h.pFirstChild[node]; child != iNIL_NODE; child = h.pRightSibling[child])
+				stack.push_back(child);
+			reverse(stack.begin() + first_child, stack.end());
+		}
+	}
+	if (ok && (num_visited != num_nodes))
+	{
+		cerr << "Error - BuildForest() merges don't form a tree." << endl;
+		ok = false;
+	}
+	if (!ok)
+	{
+		delete[] h.pParent;
+		delete[] h.pFirstChild;
+		delete[] h.pLeftSibling;
+		delete[] h.pRightSibling;
+		delete[] h.pNewIndex;
+		delete[] h.pOldIndex;
+		return false;
+	}
+
+	mForestStarted = mGeometryStarted = mGeometryEnded = mForestEnded = true;
+	mColorsPresent = rData.ColorsPresent;
+	mNormalsPresent = rData.NormalsPresent;
+	mNumTextures = rData.NumTextures;
+	mNumPatches = rData.NumPatches;
+	mNumNodes = num_nodes;
+	mNumNodePositions = rData.NumRenderData;
+	mNumTris = rData.NumTris;
+	mNumAllocatedNodes = mNumNodes + 1;
+	mNumAllocatedTris = mNumTris + 1;
+
+	// render data is used as is; nodes and tris are copied in their new order
+	mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
+	memcpy(mpNodeRenderData, rData.pRenderData, mNumNodePositions * sizeof(VertexRenderDatum));
+	mpNodes = new Node[mNumNodes + 1];
+	mpTris = new Tri[mNumTris + 1];
+	NumThreads = ChooseBuilderThreads(NumThreads, (mNumNodes + mNumTris) / BUILDER_MIN_THREAD_ITEMS);
+	ForEachNode(*this, NumThreads, CopyBulkNode, &h);
+	h.EdgeLengths.assign(NumThreads, 0.0);
+	h.BadTris.assign(NumThreads, false);
+	ForkAndJoinThreads(NumThreads, CopyBulkTrisThread, &h);
+
+	edge_lengths = 0.0;
+	for (thread = 0; thread < NumThreads; ++thread)
+	{
+		edge_lengths += h.EdgeLengths[thread];
+		ok = ok && !h.BadTris[thread];
+	}
+	mAvgEdgeLength = edge_lengths / ((Float) mNumTris * 3.0);
+	delete[] h.pParent;
+	delete[] h.pFirstChild;
+	delete[] h.pLeftSibling;
+	delete[] h.pRightSibling;
+	delete[] h.pNewIndex;
+	delete[] h.pOldIndex;
+	if (!ok)
+	{
+		cerr << "Error - BuildForest() given a tri with invalid or repeated corners, or a patch differing from a corner's." << endl;
+		Reset();
+		return false;
+	}
+
+	BuildSubTriLists(NumThreads);
+	ComputeBBoxes(NumThreads);
+	ComputeViewIndependentErrors(NumThreads);
+	SetValid();
+	return true;
+}
+
 //A node's subtris are the additional triangles that must
 //be rendered when the node is unfolded.  A tri is first
 //rendered when all three of its corners have unique proxies
@@ -1076,50 +1602,69 @@ void sort_three(NodeIndex &rA, NodeIndex &rB, NodeIndex &rC)
 //Forest that is an ancestor of two or more of the corners unfolds
 //all three corners have unique proxies above or on the boundary.
 //Therefore the triangle is a subtri of this node.
-void ForestBuilder::BuildSubTriLists()
+//The owners are found for ranges of tris on separate threads, then linked in
+//on this one so the lists come out the same as when built serially.
+void ForestBuilder::BuildSubTriLists(int NumThreads)
 {
     assert(mForestEnded && !mIsValid);
     TriIndex tri;
-    NodeIndex a, b, c;
-    NodeIndex ab_first_ancestor, bc_first_ancestor;
+	SubTriJob job;
 
-    //sort corners of each tri such that a<b<c
-    //if bc_first_ancestor > a then tri is a subtri of i_bc_first_ancestor
-    //otherwise tri is a subtri of i_ab_first_ancestor
-    //trust me :)
-    
+	job.pForest = this;
+	job.pOwners = new NodeIndex[mNumTris + 1];
+	ForkAndJoinThreads(ChooseBuilderThreads(NumThreads, mNumTris / BUILDER_MIN_THREAD_ITEMS), FindSubTriOwnersThread, &job);
     for (tri = 1; tri <= mNumTris; tri++)
-    {        
-        std::vector<NodeIndex> vec;
-        a = mpTris[tri].miCorners[0];
-        b = mpTris[tri].miCorners[1];
-        c = mpTris[tri].miCorners[2];
-        sort_three(a, b, c);        
-        //to find the ancestor climb Forest from greater ID node
-        //until a node with ID > lesser ID node is reached.
-        bc_first_ancestor = mpNodes[c].miParent;
-        while (bc_first_ancestor > b)
-        {        
-            bc_first_ancestor = mpNodes[bc_first_ancestor].miParent;
-        }
-        
-        if (bc_first_ancestor >= a) //found node tri is subtri of
-        {
-            mpTris[tri].AddToSubTriList(tri, bc_first_ancestor, *this);
-        }
-        else //the node the tri is a subtri of is ancestor of a,b
-        {       
-            ab_first_ancestor = mpNodes[b].miParent;
-            while (ab_first_ancestor > a)
-            {        
-                ab_first_ancestor = mpNodes[ab_first_ancestor].miParent;
-			}
-            mpTris[tri].AddToSubTriList(tri, ab_first_ancestor, *this);
-        }
+    {
+		mpTris[tri].AddToSubTriList(tri, job.pOwners[tri], *this);
     }
+	delete[] job.pOwners;
+}
+
+// Bounds each leaf's supported tris, and each interior node's children
+void ForestBuilder::ComputeBBoxes(int NumThreads)
+{
+	BBoxJob job;
+	TriIndex tri;
+	NodeIndex node;
+	unsigned int i, num_empty_leaves;
+	int thread;
+
+	assert(mForestEnded && !mIsValid);
+	// tris supported by each node, stored contiguously by node
+	job.pFirstNodeTri = new TriIndex[mNumNodes + 2];
+	job.pNodeTris = new TriIndex[3 * mNumTris];
+	for (node = 0; node <= mNumNodes + 1; ++node)
+		job.pFirstNodeTri[node] = 0;
+	for (tri = 1; tri <= mNumTris; ++tri)
+	{
+		for (i = 0; i < 3; ++i)
+			++job.pFirstNodeTri[mpTris[tri].miCorners[i] + 1];
+	}
+	for (node = 1; node <= mNumNodes + 1; ++node)
+		job.pFirstNodeTri[node] += job.pFirstNodeTri[node - 1];
+	for (tri = 1; tri <= mNumTris; ++tri)
+	{
+		for (i = 0; i < 3; ++i)
+			job.pNodeTris[job.pFirstNodeTri[mpTris[tri].miCorners[i]]++] = tri;
+	}
+	for (node = mNumNodes + 1; node > 0; --node)
+		job.pFirstNodeTri[node] = job.pFirstNodeTri[node - 1];
+	job.pFirstNodeTri[0] = 0;
+
+	NumThreads = ChooseBuilderThreads(NumThreads, mNumNodes / BUILDER_MIN_THREAD_ITEMS);
+	job.NumEmptyLeaves.assign(NumThreads, 0);
+	ForEachNodeBottomUp(*this, NumThreads, ComputeNodeBBox, &job);
+
+	num_empty_leaves = 0;
+	for (thread = 0; thread < NumThreads; ++thread)
+		num_empty_leaves += job.NumEmptyLeaves[thread];
+	if (num_empty_leaves > 0)
+		cerr << "Warning: in node bounding box calculation; " << num_empty_leaves << " leaf nodes support no triangles" << endl;
+	delete[] job.pFirstNodeTri;
+	delete[] job.pNodeTris;
 }
 
-void ForestBuilder::ComputeViewIndependentErrors()
+void ForestBuilder::ComputeViewIndependentErrors(int NumThreads)
 {
 	NodeIndex i;
 	int num_interior_nodes = 0;
@@ -1129,6 +1674,7 @@ void ForestBuilder::ComputeViewIndependentErrors()
 			++num_interior_nodes;
 	}
 	mpErrorParams = new float[num_interior_nodes + 1];
+	mpErrorParams[0] = 0.0f;
 	mNumErrorParams = num_interior_nodes + 1;
 	mErrorParamSize = 1;
 	int error_index_assigned = 1;
@@ -1142,11 +1688,8 @@ void ForestBuilder::ComputeViewIndependentErrors()
 		else
 			mpNodes[i].miErrorParamIndex = 0;
 	}
-
-	for (i = iROOT_NODE; i <= mNumNodes; ++i)
-	{
-		StdViewIndependentError(i, *this);
-	}
+	// each error only depends on its own node's bounding box
+	ForEachNode(*this, ChooseBuilderThreads(NumThreads, mNumNodes / BUILDER_MIN_THREAD_ITEMS), ComputeNodeError, NULL);
 }
 
 Float ForestBuilder::DefaultClusterImportance(NodeIndex iNode) const
@@ -1171,9 +1714,9 @@ Point3 ForestBuilder::DefaultMergePositionCreation(const NodeIndexVector &NodeVe
     p.X = p.Y = p.Z = 0.0;
     for(i = 0; i < num_nodes; i++)
     {
-        p.X += mpNodes[NodeVector[i]].mpRenderData->Position.X;
-        p.Y += mpNodes[NodeVector[i]].mpRenderData->Position.Y;
-        p.Z += mpNodes[NodeVector[i]].mpRenderData->Position.Z;
+        p.X += GetNodeRenderData(NodeVector[i])->Position.X;
+        p.Y += GetNodeRenderData(NodeVector[i])->Position.Y;
+        p.Z += GetNodeRenderData(NodeVector[i])->Position.Z;
     }
     p.X /= (Float) num_nodes;
     p.Y /= (Float) num_nodes;
@@ -1190,7 +1733,7 @@ Vec3 ForestBuilder::DefaultMergeNormalCreation(const NodeIndexVector &NodeVector
     num_nodes = NodeVector.size();
     for(i = 0; i < num_nodes; i++)
     {
-        normal += mpNodes[NodeVector[i]].mpRenderData->Normal;
+        normal += GetNodeRenderData(NodeVector[i])->Normal;
     }
     normal /= (Float) num_nodes;
 	normal.Normalize();
@@ -1207,9 +1750,9 @@ ByteColor ForestBuilder::DefaultMergeColorCreation(const NodeIndexVector &NodeVe
     //cannot add all colors first then divide b/c of overflow
     for(i = 0; i < num_nodes; i++)
     {
-        c.R = c.R + (BYTE) (mpNodes[NodeVector[i]].mpRenderData->Color.R / (Float) num_nodes);
-        c.G = c.G + (BYTE) (mpNodes[NodeVector[i]].mpRenderData->Color.G / (Float) num_nodes);
-        c.B = c.B + (BYTE) (mpNodes[NodeVector[i]].mpRenderData->Color.B / (Float) num_nodes);
+        c.R = c.R + (BYTE) (GetNodeRenderData(NodeVector[i])->Color.R / (Float) num_nodes);
+        c.G = c.G + (BYTE) (GetNodeRenderData(NodeVector[i])->Color.G / (Float) num_nodes);
+        c.B = c.B + (BYTE) (GetNodeRenderData(NodeVector[i])->Color.B / (Float) num_nodes);
     }
     return c;
 }
@@ -1224,8 +1767,8 @@ Point2 ForestBuilder::DefaultMergeTexCoordsCreation(const NodeIndexVector &NodeV
     tex_coords.X = tex_coords.Y = 0.0;
 	for (j = 0; j < num_nodes; j++)
 	{
-		tex_coords.X += mpNodes[NodeVector[j]].mpRenderData->TexCoords.X;
-		tex_coords.Y += mpNodes[NodeVector[j]].mpRenderData->TexCoords.Y;
+		tex_coords.X += GetNodeRenderData(NodeVector[j])->TexCoords.X;
+		tex_coords.Y += GetNodeRenderData(NodeVector[j])->TexCoords.Y;
     }
     tex_coords.X /= (Float) num_nodes;
     tex_coords.Y /= (Float) num_nodes;
@@ -1248,14 +1791,14 @@ Float ForestBuilder::LongestNodeEdge(NodeIndex iNode) const
 	while (iNIL_TRI != tri) 
     {
         i = mpTris[tri].GetNodeIndexC(tri, iNode, *this);
-   	    dx = mpNodes[iNode].mpRenderData->Position[0] - mpNodes[mpTris[tri].miCorners[(i + 1) % 3]].mpRenderData->Position[0];
-        dy = mpNodes[iNode].mpRenderData->Position[1] - mpNodes[mpTris[tri].miCorners[(i + 1) % 3]].mpRenderData->Position[1];
-        dz = mpNodes[iNode].mpRenderData->Position[2] - mpNodes[mpTris[tri].miCorners[(i + 1) % 3]].mpRenderData->Position[2];
+   	    dx = GetNodeRenderData(iNode)->Position[0] - GetNodeRenderData(mpTris[tri].miCorners[(i + 1) % 3])->Position[0];
+        dy = GetNodeRenderData(iNode)->Position[1] - GetNodeRenderData(mpTris[tri].miCorners[(i + 1) % 3])->Position[1];
+        dz = GetNodeRenderData(iNode)->Position[2] - GetNodeRenderData(mpTris[tri].miCorners[(i + 1) % 3])->Position[2];
         dist1_squared = dx*dx + dy*dy + dz*dz;
 
-	    dx = mpNodes[iNode].mpRenderData->Position[0] - mpNodes[mpTris[tri].miCorners[(i + 2) % 3]].mpRenderData->Position[0];
-        dy = mpNodes[iNode].mpRenderData->Position[1] - mpNodes[mpTris[tri].miCorners[(i + 2) % 3]].mpRenderData->Position[1];
-        dz = mpNodes[iNode].mpRenderData->Position[2] - mpNodes[mpTris[tri].miCorners[(i + 2) % 3]].mpRenderData->Position[2];
+	    dx = GetNodeRenderData(iNode)->Position[0] - GetNodeRenderData(mpTris[tri].miCorners[(i + 2) % 3])->Position[0];
+        dy = GetNodeRenderData(iNode)->Position[1] - GetNodeRenderData(mpTris[tri].miCorners[(i + 2) % 3])->Position[1];
+        dz = GetNodeRenderData(iNode)->Position[2] - GetNodeRenderData(mpTris[tri].miCorners[(i + 2) % 3])->Position[2];
         dist2_squared = dx*dx + dy*dy + dz*dz;
 
 		if (dist1_squared > max_distance_squared)
@@ -1291,15 +1834,15 @@ Float ForestBuilder::GreatestFaceAngle(NodeIndex iNode) const
 
     while (tri != iNIL_TRI)
     {
-        v0.Set(mpNodes[mpTris[tri].miCorners[0]].mpRenderData->Position[0],
-               mpNodes[mpTris[tri].miCorners[0]].mpRenderData->Position[1],
-               mpNodes[mpTris[tri].miCorners[0]].mpRenderData->Position[2]);
-        v1.Set(mpNodes[mpTris[tri].miCorners[1]].mpRenderData->Position[0],
-               mpNodes[mpTris[tri].miCorners[1]].mpRenderData->Position[1],
-               mpNodes[mpTris[tri].miCorners[1]].mpRenderData->Position[2]);
-        v2.Set(mpNodes[mpTris[tri].miCorners[2]].mpRenderData->Position[0],
-               mpNodes[mpTris[tri].miCorners[2]].mpRenderData->Position[1],
-               mpNodes[mpTris[tri].miCorners[2]].mpRenderData->Position[2]);
+        v0.Set(GetNodeRenderData(mpTris[tri].miCorners[0])->Position[0],
+               GetNodeRenderData(mpTris[tri].miCorners[0])->Position[1],
+               GetNodeRenderData(mpTris[tri].miCorners[0])->Position[2]);
+        v1.Set(GetNodeRenderData(mpTris[tri].miCorners[1])->Position[0],
+               GetNodeRenderData(mpTris[tri].miCorners[1])->Position[1],
+               GetNodeRenderData(mpTris[tri].miCorners[1])->Position[2]);
+        v2.Set(GetNodeRenderData(mpTris[tri].miCorners[2])->Position[0],
+               GetNodeRenderData(mpTris[tri].miCorners[2])->Position[1],
+               GetNodeRenderData(mpTris[tri].miCorners[2])->Position[2]);
         
         normal = (v1 - v0) % (v2 - v1);
         normal.Normalize();
@@ -24,6 +24,39 @@
 
 namespace VDS
 {
+
+// Arrays describing a whole forest, for ForestBuilder::BuildForest().  Render data,
+// nodes, tris and merges are all numbered from 0, as in a VIF file.  The merges must
+// join all the nodes into a single tree.
+struct BulkForestData
+{
+	bool ColorsPresent;
+	bool NormalsPresent;
+	unsigned int NumTextures;
+	PatchIndex NumPatches;
+
+	NodeIndex NumRenderData;
+	const VertexRenderDatum *pRenderData;
+
+	NodeIndex NumNodes;					// original vertices and merge parents alike
+	const NodeIndex *pNodeRenderData;	// render datum of each node; NULL if node i uses datum i
+	const PatchIndex *pNodePatches;		// NULL if every node is in patch 0
+	const NodeIndex *pCoincidentNodes;	// next node in each node's ring of coincident nodes (the
+										// node itself if it has none); NULL if there are none
+
+	TriIndex NumTris;
+	const NodeIndex *pTriCorners;		// 3 per tri
+	const PatchIndex *pTriPatches;		// NULL if every tri is in patch 0
+
+	// merge i makes node pMergeParents[i] the parent of the next pNumMergeChildren[i]
+	// nodes listed in pMergeChildren
+	unsigned int NumMerges;
+	const NodeIndex *pMergeParents;
+	const unsigned int *pNumMergeChildren;
+	const NodeIndex *pMergeChildren;
+
+	BulkForestData();	// no arrays, one patch
+};
 	
 class ForestBuilder : public Forest
 {
@@ -48,6 +81,13 @@ public:
 	// After EndForest the Forest cannot be modified.
     void BeginForest();
     void EndForest();
+
+	// Builds the whole forest in one call from the arrays in rData, in place of
+	// BeginForest(), AddNode(), AddTri(), MergeNodes() and EndForest().  The arrays are
+	// copied, not kept.  The post-processing passes are split among NumThreads threads
+	// (0 means one per processor).  Returns false if the arrays don't describe a valid
+	// forest.
+	bool BuildForest(const BulkForestData &rData, int NumThreads = 0);
 	
     // All nodes and triangles are added after a call to beginGeometry.
     void BeginGeometry(bool IsColors, bool IsNormals, unsigned int NumTextures = 0, NodeIndex NumNodes = STARTING_MAX_NODES, TriIndex NumTris = STARTING_MAX_TRIS);
@@ -134,9 +174,12 @@ private:
 	// the face angle opposite it in RADIANS
     Float GreatestFaceAngle(NodeIndex index) const;
 	
-    void BuildSubTriLists();        
+	// These passes need the nodes in depth-first order; they are split among NumThreads
+	// threads (0 means one per processor)
+    void BuildSubTriLists(int NumThreads = 0);
 //    void ComputeRadii(NodeIndex iNode);
-	void ComputeViewIndependentErrors();
+	void ComputeBBoxes(int NumThreads = 0);
+	void ComputeViewIndependentErrors(int NumThreads = 0);
 	
     bool ReallocateNodes(NodeIndex NewSize = 0);
     bool ReallocateTris(TriIndex NewSize = 0); 
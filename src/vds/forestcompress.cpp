@@ -0,0 +1,901 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+// Compressed VDS files.
+//
+// A compressed file is a VDSCompressedHeader, a table of VDSCompressedChunks and
+// the chunk data.  Each array of the forest (error params, nodes, node render data,
+// tris) is cut into chunks of up to VDS_COMPRESSED_CHUNK_RECORDS elements, and every
+// chunk is coded on its own, so chunks can be read and decoded by several threads at
+// once.  Within a chunk each field of each element is predicted (node and tri links
+// relative to the element's own index, everything else from the previous element),
+// the prediction residual is written as a zigzag varint, and the varint bytes are
+// entropy coded with an adaptive binary range coder using a separate model per field.
+// Positions and normals can optionally be quantized before prediction.
+//
+// Unlike binary VDS files, compressed files are coded field by field and don't depend
+// on the struct layout of the build that wrote them (byte order still must match).
+#ifdef _WIN32
+#pragma warning(disable: 4530)
+#pragma warning(disable: 4786)
+#include <windows.h>
+#endif
+
+#include <cassert>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "vds.h"
+#include "forest.h"
+#include "node.h"
+#include "tri.h"
+#include "threads.h"
+
+using namespace std;
+using namespace VDS;
+
+#define VDS_COMPRESSED_FORMAT_VERSION 2
+
+// chunk sections, in file order
+#define VDS_SECTION_ERROR_PARAMS 0
+#define VDS_SECTION_NODES 1
+#define VDS_SECTION_NODE_RENDER_DATA 2
+#define VDS_SECTION_TRIS 3
+#define VDS_NUM_SECTIONS 4
+
+// range coder constants
+#define RC_TOP_VALUE (1u << 24)
+#define RC_PROB_BITS 11
+#define RC_PROB_INIT (1u << (RC_PROB_BITS - 1))
+#define RC_MOVE_BITS 5
+
+// value models: one per field, and per byte position within a varint
+#define MAX_CODED_FIELDS 16
+#define VARINT_BYTE_CONTEXTS 4
+#define MAX_VARINT_BYTES 10
+
+#define MAX_POSITION_BITS 24
+#define MAX_NORMAL_BITS 16
+
+namespace VDS
+{
+
+struct VDSCompressedHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	unsigned int ColorsPresent;
+	unsigned int NormalsPresent;
+	unsigned int NumTextures;
+	unsigned int NumPatches;
+	int ErrorParamSize;
+	unsigned int PositionBits;	// 0 if positions are stored exactly
+	unsigned int NormalBits;	// 0 if normals are stored exactly
+	float PositionMin[3];
+	float PositionScale[3];
+	float NormalScale;
+	unsigned int ChunkRecords;
+	unsigned int NumChunks;
+	VDSFileOffset NumNodes;
+	VDSFileOffset NumNodePositions;
+	VDSFileOffset NumTris;
+	VDSFileOffset NumErrorParams;
+	VDSFileOffset NumCoarseNodes;	// see Forest::mNumCoarseNodes
+};
+
+struct VDSCompressedChunk
+{
+	unsigned int Section;
+	unsigned int NumRecords;
+	VDSFileOffset FirstRecord;
+	VDSFileOffset Offset;	// from the start of the file
+	VDSFileOffset Size;
+};
+
+} // namespace VDS
+
+namespace
+{
+
+// fields of each section
+enum { FIELD_ERROR_PARAM };
+enum { FIELD_PARENT, FIELD_LEFT_SIBLING, FIELD_RIGHT_SIBLING, FIELD_FIRST_CHILD, FIELD_FIRST_SUB_TRI,
+	FIELD_NODE_PATCH, FIELD_COINCIDENT, FIELD_ERROR_PARAM_INDEX, FIELD_RENDER_DATA, FIELD_BBOX };
+enum { FIELD_POSITION = 0, FIELD_NORMAL = 3, FIELD_COLOR = 6, FIELD_TEXCOORDS = 10, FIELD_NODE = 12 };
+enum { FIELD_NEXT_SUB_TRI, FIELD_CORNER, FIELD_TRI_PATCH = 4 };
+
+inline VDSFileOffset ZigZag(VDSFileOffset Delta)
+{
+	return (Delta << 1) ^ (VDSFileOffset) ((long long) Delta >> 63);
+}
+
+inline VDSFileOffset UnZigZag(VDSFileOffset Value)
+{
+	return (Value >> 1) ^ (VDSFileOffset) (-(long long) (Value & 1));
+}
+
+inline unsigned int FloatBits(Float Value)
+{
+	unsigned int bits;
+	memcpy(&bits, &Value, sizeof(bits));
+	return bits;
+}
+
+inline Float BitsFloat(unsigned int Bits)
+{
+	Float value;
+	memcpy(&value, &Bits, sizeof(value));
+	return value;
+}
+
+// Per-chunk adaptive probabilities for the bytes of each field's varints
+struct ValueModels
+{
+	ValueModels()
+	{
+		for (unsigned short *p = &mProbs[0][0][0]; p != &mProbs[0][0][0] + sizeof(mProbs) / sizeof(unsigned short); ++p)
+			*p = RC_PROB_INIT;
+	}
+	unsigned short *Byte(int Field, int iByte)
+	{
+		assert(Field < MAX_CODED_FIELDS);
+		return mProbs[Field][(iByte < VARINT_BYTE_CONTEXTS) ? iByte : VARINT_BYTE_CONTEXTS - 1];
+	}
+	unsigned short mProbs[MAX_CODED_FIELDS][VARINT_BYTE_CONTEXTS][256];
+};
+
+class ChunkEncoder
+{
+public:
+	static const bool DECODING = false;
+
+	ChunkEncoder(vector<unsigned char> &rOut) : mrOut(rOut), mLow(0), mRange(0xFFFFFFFF), mCache(0), mCacheSize(1) { }
+
+	void Flush()
+	{
+		for (int i = 0; i < 5; ++i)
+			ShiftLow();
+	}
+
+	void Unsigned(int Field, VDSFileOffset Value)
+	{
+		int i = 0;
+		do
+		{
+			unsigned int byte = (unsigned int) (Value & 0x7f);
+			Value >>= 7;
+			if (Value != 0)
+				byte |= 0x80;
+			EncodeByte(mModels.Byte(Field, i++), byte);
+		} while (Value != 0);
+	}
+
+	// 0 (nil) is coded on its own; other values relative to Predicted
+	void Link(int Field, VDSFileOffset &rValue, VDSFileOffset Predicted)
+	{
+		Unsigned(Field, (rValue == 0) ? 0 : ZigZag(rValue - Predicted) + 1);
+	}
+
+	void Delta(int Field, VDSFileOffset &rValue, VDSFileOffset Predicted)
+	{
+		Unsigned(Field, ZigZag(rValue - Predicted));
+	}
+
+	void Exact(int Field, Float &rValue, unsigned int &rPrevBits)
+	{
+		unsigned int bits = FloatBits(rValue);
+		int delta = (int) (bits - rPrevBits);
+		Unsigned(Field, (VDSFileOffset) (((unsigned int) delta << 1) ^ (unsigned int) (delta >> 31)));
+		rPrevBits = bits;
+	}
+
+	void Quantized(int Field, Float &rValue, Float Min, Float Scale, unsigned int Bits, VDSFileOffset &rPrev)
+	{
+		double q = floor(((double) rValue - Min) * Scale + 0.5);
+		double max_q = (double) ((1u << Bits) - 1);
+		VDSFileOffset value = (VDSFileOffset) ((q < 0) ? 0 : ((q > max_q) ? max_q : q));
+		Delta(Field, value, rPrev);
+		rPrev = value;
+	}
+
+	bool CheckIndex(VDSFileOffset, VDSFileOffset) { return true; }
+
+private:
+	void EncodeBit(unsigned short &rProb, unsigned int Bit)
+	{
+		unsigned int bound = (mRange >> RC_PROB_BITS) * rProb;
+		if (Bit == 0)
+		{
+			mRange = bound;
+			rProb += ((1u << RC_PROB_BITS) - rProb) >> RC_MOVE_BITS;
+		}
+		else
+		{
+			mLow += bound;
+			mRange -= bound;
+			rProb -= rProb >> RC_MOVE_BITS;
+		}
+		while (mRange < RC_TOP_VALUE)
+		{
+			mRange <<= 8;
+			ShiftLow();
+		}
+	}
+
+	void EncodeByte(unsigned short *pProbs, unsigned int Byte)
+	{
+		unsigned int m = 1;
+		for (int i = 7; i >= 0; --i)
+		{
+			unsigned int bit = (Byte >> i) & 1;
+			EncodeBit(pProbs[m], bit);
+			m = (m << 1) | bit;
+		}
+	}
+
+	void ShiftLow()
+	{
+		if ((unsigned int) mLow < 0xFF000000u || (unsigned int) (mLow >> 32) != 0)
+		{
+			unsigned char carry = (unsigned char) (mLow >> 32);
+			unsigned char temp = mCache;
+			do
+			{
+				mrOut.push_back((unsigned char) (temp + carry));
+				temp = 0xFF;
+			} while (--mCacheSize != 0);
+			mCache = (unsigned char) ((unsigned int) mLow >> 24);
+		}
+		++mCacheSize;
+		mLow = (mLow & 0x00FFFFFF) << 8;
+	}
+
+	vector<unsigned char> &mrOut;
+	ValueModels mModels;
+	VDSFileOffset mLow;
+	unsigned int mRange;
+	unsigned char mCache;
+	VDSFileOffset mCacheSize;
+};
+
+class ChunkDecoder
+{
+public:
+	static const bool DECODING = true;
+
+	ChunkDecoder(const unsigned char *pIn, size_t Size) : mpIn(pIn), mpEnd(pIn + Size), mRange(0xFFFFFFFF), mCode(0), mIsCorrupt(false)
+	{
+		for (int i = 0; i < 5; ++i)
+			mCode = (mCode << 8) | NextByte();
+	}
+
+	bool IsCorrupt() const { return mIsCorrupt; }
+
+	VDSFileOffset Unsigned(int Field)
+	{
+		VDSFileOffset value = 0;
+		unsigned int byte;
+		int i = 0;
+		do
+		{
+			byte = DecodeByte(mModels.Byte(Field, i));
+			value |= (VDSFileOffset) (byte & 0x7f) << (7 * i);
+			if (++i == MAX_VARINT_BYTES && (byte & 0x80))
+			{
+				mIsCorrupt = true;
+				break;
+			}
+		} while (byte & 0x80);
+		return value;
+	}
+
+	void Link(int Field, VDSFileOffset &rValue, VDSFileOffset Predicted)
+	{
+		VDSFileOffset value = Unsigned(Field);
+		rValue = (value == 0) ? 0 : Predicted + UnZigZag(value - 1);
+	}
+
+	void Delta(int Field, VDSFileOffset &rValue, VDSFileOffset Predicted)
+	{
+		rValue = Predicted + UnZigZag(Unsigned(Field));
+	}
+
+	void Exact(int Field, Float &rValue, unsigned int &rPrevBits)
+	{
+		unsigned int value = (unsigned int) Unsigned(Field);
+		rPrevBits += (value >> 1) ^ (unsigned int) (-(int) (value & 1));
+		rValue = BitsFloat(rPrevBits);
+	}
+
+	void Quantized(int Field, Float &rValue, Float Min, Float Scale, unsigned int, VDSFileOffset &rPrev)
+	{
+		Delta(Field, rPrev, rPrev);
+		rValue = (Scale > 0) ? (Float) (Min + (double) rPrev / Scale) : Min;
+	}
+
+	bool CheckIndex(VDSFileOffset Value, VDSFileOffset Limit)
+	{
+		if (Value >= Limit)
+			mIsCorrupt = true;
+		return !mIsCorrupt;
+	}
+
+private:
+	unsigned int NextByte()
+	{
+		if (mpIn < mpEnd)
+			return *mpIn++;
+		mIsCorrupt = true;
+		return 0;
+	}
+
+	unsigned int DecodeBit(unsigned short &rProb)
+	{
+		unsigned int bound = (mRange >> RC_PROB_BITS) * rProb;
+		unsigned int bit;
+		if (mCode < bound)
+		{
+			mRange = bound;
+			rProb += ((1u << RC_PROB_BITS) - rProb) >> RC_MOVE_BITS;
+			bit = 0;
+		}
+		else
+		{
+			mCode -= bound;
+			mRange -= bound;
+			rProb -= rProb >> RC_MOVE_BITS;
+			bit = 1;
+		}
+		while (mRange < RC_TOP_VALUE)
+		{
+			mRange <<= 8;
+			mCode = (mCode << 8) | NextByte();
+		}
+		return bit;
+	}
+
+	unsigned int DecodeByte(unsigned short *pProbs)
+	{
+		unsigned int m = 1;
+		for (int i = 0; i < 8; ++i)
+			m = (m << 1) | DecodeBit(pProbs[m]);
+		return m & 0xff;
+	}
+
+	const unsigned char *mpIn;
+	const unsigned char *mpEnd;
+	ValueModels mModels;
+	unsigned int mRange;
+	unsigned int mCode;
+	bool mIsCorrupt;
+};
+
+// Wrappers so the section coders below read fields when encoding and write them when
+// decoding; both directions run the same code, so they can't drift apart.
+template <class Coder, class T>
+inline void CodeLink(Coder &rCoder, int Field, T &rValue, VDSFileOffset Predicted)
+{
+	VDSFileOffset value = rValue;
+	rCoder.Link(Field, value, Predicted);
+	if (Coder::DECODING)
+		rValue = (T) value;
+}
+
+template <class Coder, class T>
+inline void CodeDelta(Coder &rCoder, int Field, T &rValue, VDSFileOffset Predicted)
+{
+	VDSFileOffset value = rValue;
+	rCoder.Delta(Field, value, Predicted);
+	if (Coder::DECODING)
+		rValue = (T) value;
+}
+
+template <class Coder>
+void CodeErrorParams(Coder &rCoder, float *pParams, VDSFileOffset First, unsigned int Count)
+{
+	unsigned int prev_bits = 0;
+	for (VDSFileOffset i = First; i < First + Count; ++i)
+		rCoder.Exact(FIELD_ERROR_PARAM, pParams[i], prev_bits);
+}
+
+template <class Coder>
+void CodeNodes(Coder &rCoder, const Forest &rForest, VDSFileOffset First, unsigned int Count)
+{
+	VDSFileOffset prev_sub_tri = 0;
+	VDSFileOffset prev_patch = 0;
+	unsigned int prev_bits[6] = {0, 0, 0, 0, 0, 0};
+	int i;
+
+	for (VDSFileOffset iNode = First; iNode < First + Count; ++iNode)
+	{
+		Node &node = rForest.mpNodes[iNode];
+		CodeLink(rCoder, FIELD_PARENT, node.miParent, iNode);
+		CodeLink(rCoder, FIELD_LEFT_SIBLING, node.miLeftSibling, iNode);
+		CodeLink(rCoder, FIELD_RIGHT_SIBLING, node.miRightSibling, iNode);
+		CodeLink(rCoder, FIELD_FIRST_CHILD, node.miFirstChild, iNode);
+		CodeLink(rCoder, FIELD_FIRST_SUB_TRI, node.miFirstSubTri, prev_sub_tri);
+		if (node.miFirstSubTri != Forest::iNIL_TRI)
+			prev_sub_tri = node.miFirstSubTri;
+		CodeDelta(rCoder, FIELD_NODE_PATCH, node.mPatchID, prev_patch);
+		prev_patch = node.mPatchID;
+		CodeLink(rCoder, FIELD_COINCIDENT, node.mCoincidentVertex, iNode);
+		CodeDelta(rCoder, FIELD_ERROR_PARAM_INDEX, node.miErrorParamIndex, iNode);
+		CodeDelta(rCoder, FIELD_RENDER_DATA, node.miRenderData, iNode);
+
+		Float *bbox[6] = { &node.mBBoxCenter.X, &node.mBBoxCenter.Y, &node.mBBoxCenter.Z,
+			&node.mXBBoxOffset, &node.mYBBoxOffset, &node.mZBBoxOffset };
+		for (i = 0; i < 6; ++i)
+			rCoder.Exact(FIELD_BBOX + i, *bbox[i], prev_bits[i]);
+
+		// the nil node is never followed, and may hold anything
+		if (iNode != Forest::iNIL_NODE && !(rCoder.CheckIndex(node.miParent, rForest.mNumNodes + 1) &&
+			rCoder.CheckIndex(node.miLeftSibling, rForest.mNumNodes + 1) &&
+			rCoder.CheckIndex(node.miRightSibling, rForest.mNumNodes + 1) &&
+			rCoder.CheckIndex(node.miFirstChild, rForest.mNumNodes + 1) &&
+			rCoder.CheckIndex(node.mCoincidentVertex, rForest.mNumNodes + 1) &&
+			rCoder.CheckIndex(node.miFirstSubTri, rForest.mNumTris + 1) &&
+			rCoder.CheckIndex(node.miRenderData, rForest.mNumNodePositions)))
+			return;
+	}
+}
+
+template <class Coder>
+void CodeNodeRenderData(Coder &rCoder, const Forest &rForest, const VDSCompressedHeader &rHeader,
+						VDSFileOffset First, unsigned int Count)
+{
+	unsigned int prev_bits[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	VDSFileOffset prev_q[6] = {0, 0, 0, 0, 0, 0};
+	VDSFileOffset prev_color[4] = {0, 0, 0, 0};
+	int i;
+
+	for (VDSFileOffset iDatum = First; iDatum < First + Count; ++iDatum)
+	{
+		VertexRenderDatum &datum = rForest.mpNodeRenderData[iDatum];
+		Float *position[3] = { &datum.Position.X, &datum.Position.Y, &datum.Position.Z };
+		Float *normal[3] = { &datum.Normal.X, &datum.Normal.Y, &datum.Normal.Z };
+		Byte *color[4] = { &datum.Color.R, &datum.Color.G, &datum.Color.B, &datum.Color.A };
+		Float *texcoords[2] = { &datum.TexCoords.X, &datum.TexCoords.Y };
+
+		for (i = 0; i < 3; ++i)
+		{
+			if (rHeader.PositionBits != 0)
+				rCoder.Quantized(FIELD_POSITION + i, *position[i], rHeader.PositionMin[i],
+					rHeader.PositionScale[i], rHeader.PositionBits, prev_q[i]);
+			else
+				rCoder.Exact(FIELD_POSITION + i, *position[i], prev_bits[i]);
+		}
+		for (i = 0; i < 3; ++i)
+		{
+			if (rHeader.NormalBits != 0)
+				rCoder.Quantized(FIELD_NORMAL + i, *normal[i], -1.0f, rHeader.NormalScale,
+					rHeader.NormalBits, prev_q[3 + i]);
+			else
+				rCoder.Exact(FIELD_NORMAL + i, *normal[i], prev_bits[3 + i]);
+		}
+		for (i = 0; i < 4; ++i)
+		{
+			CodeDelta(rCoder, FIELD_COLOR + i, *color[i], prev_color[i]);
+			prev_color[i] = *color[i];
+		}
+		for (i = 0; i < 2; ++i)
+			rCoder.Exact(FIELD_TEXCOORDS + i, *texcoords[i], prev_bits[6 + i]);
+		CodeDelta(rCoder, FIELD_NODE, datum.Node, iDatum + 1);
+	}
+}
+
+template <class Coder>
+void CodeTris(Coder &rCoder, const Forest &rForest, VDSFileOffset First, unsigned int Count)
+{
+	VDSFileOffset prev_corner = 0;
+	VDSFileOffset prev_patch = 0;
+	int i;
+
+	for (VDSFileOffset iTri = First; iTri < First + Count; ++iTri)
+	{
+		Tri &tri = rForest.mpTris[iTri];
+		CodeLink(rCoder, FIELD_NEXT_SUB_TRI, tri.miNextSubTri, iTri);
+		CodeDelta(rCoder, FIELD_CORNER, tri.miCorners[0], prev_corner);
+		prev_corner = tri.miCorners[0];
+		CodeDelta(rCoder, FIELD_CORNER + 1, tri.miCorners[1], tri.miCorners[0]);
+		CodeDelta(rCoder, FIELD_CORNER + 2, tri.miCorners[2], tri.miCorners[0]);
+		CodeDelta(rCoder, FIELD_TRI_PATCH, tri.mPatchID, prev_patch);
+		prev_patch = tri.mPatchID;
+
+		if (iTri == Forest::iNIL_TRI)
+			continue;
+		if (!rCoder.CheckIndex(tri.miNextSubTri, rForest.mNumTris + 1))
+			return;
+		for (i = 0; i < 3; ++i)
+		{
+			if (!rCoder.CheckIndex(tri.miCorners[i], rForest.mNumNodes + 1))
+				return;
+		}
+	}
+}
+
+template <class Coder>
+void CodeChunk(Coder &rCoder, const Forest &rForest, const VDSCompressedHeader &rHeader, const VDSCompressedChunk &rChunk)
+{
+	switch (rChunk.Section)
+	{
+	case VDS_SECTION_ERROR_PARAMS:
+		CodeErrorParams(rCoder, rForest.mpErrorParams, rChunk.FirstRecord, rChunk.NumRecords);
+		break;
+	case VDS_SECTION_NODES:
+		CodeNodes(rCoder, rForest, rChunk.FirstRecord, rChunk.NumRecords);
+		break;
+	case VDS_SECTION_NODE_RENDER_DATA:
+		CodeNodeRenderData(rCoder, rForest, rHeader, rChunk.FirstRecord, rChunk.NumRecords);
+		break;
+	case VDS_SECTION_TRIS:
+		CodeTris(rCoder, rForest, rChunk.FirstRecord, rChunk.NumRecords);
+		break;
+	}
+}
+
+VDSFileOffset SectionSize(const VDSCompressedHeader &rHeader, unsigned int Section)
+{
+	switch (Section)
+	{
+	case VDS_SECTION_ERROR_PARAMS:
+		return rHeader.NumErrorParams * rHeader.ErrorParamSize;
+	case VDS_SECTION_NODES:
+		return rHeader.NumNodes + 1;
+	case VDS_SECTION_NODE_RENDER_DATA:
+		return rHeader.NumNodePositions;
+	case VDS_SECTION_TRIS:
+		return rHeader.NumTris + 1;
+	}
+	return 0;
+}
+
+// true if the header's counts fit the in-memory index types, the sizes of the arrays
+// ReadCompressedVDS allocates, and the arithmetic of SectionSize
+bool HeaderCountsFit(const VDSCompressedHeader &rHeader)
+{
+	const VDSFileOffset max_node = (NodeIndex) ~(NodeIndex) 0;
+	const VDSFileOffset max_tri = (TriIndex) ~(TriIndex) 0;
+	const VDSFileOffset max_size = (size_t) ~(size_t) 0;
+
+	if (rHeader.NumPatches > (PatchIndex) ~(PatchIndex) 0)
+		return false;
+	if (rHeader.NumNodes >= max_node || rHeader.NumNodes >= max_size / sizeof(Node))
+		return false;
+	if (rHeader.NumNodePositions > max_node || rHeader.NumNodePositions > max_size / sizeof(VertexRenderDatum))
+		return false;
+	if (rHeader.NumTris >= max_tri || rHeader.NumTris >= max_size / sizeof(Tri))
+		return false;
+	if (rHeader.NumErrorParams > max_node)
+		return false;
+	if (rHeader.NumCoarseNodes > rHeader.NumNodes)
+		return false;
+	return rHeader.ErrorParamSize == 0 ||
+		rHeader.NumErrorParams <= max_size / sizeof(float) / (VDSFileOffset) rHeader.ErrorParamSize;
+}
+
+int FileSeek(FILE *pFile, VDSFileOffset Offset)
+{
+#ifdef _WIN32
+	return _fseeki64(pFile, (__int64) Offset, SEEK_SET);
+#else
+	return fseeko(pFile, (off_t) Offset, SEEK_SET);
+#endif
+}
+
+// leaves the file positioned at its start
+bool FileLength(FILE *pFile, VDSFileOffset &rLength)
+{
+#ifdef _WIN32
+	__int64 length;
+	if (_fseeki64(pFile, 0, SEEK_END) != 0 || (length = _ftelli64(pFile)) < 0)
+		return false;
+#else
+	off_t length;
+	if (fseeko(pFile, 0, SEEK_END) != 0 || (length = ftello(pFile)) < 0)
+		return false;
+#endif
+	rLength = (VDSFileOffset) length;
+	return FileSeek(pFile, 0) == 0;
+}
+
+// state shared by the threads compressing or decompressing a file's chunks;
+// thread i handles chunks i, i + NumThreads, ...
+struct ChunkJob
+{
+	const Forest *pForest;
+	const VDSCompressedHeader *pHeader;
+	vector<VDSCompressedChunk> *pChunks;
+	vector< vector<unsigned char> > *pChunkData;	// when compressing
+	const char *Filename;	// when decompressing
+	vector<char> *pFailed;
+};
+
+void CompressChunksThread(int iThread, int NumThreads, void *pParams)
+{
+	ChunkJob *job = (ChunkJob *) pParams;
+	for (size_t i = iThread; i < job->pChunks->size(); i += NumThreads)
+	{
+		vector<unsigned char> &data = (*job->pChunkData)[i];
+		ChunkEncoder encoder(data);
+		CodeChunk(encoder, *job->pForest, *job->pHeader, (*job->pChunks)[i]);
+		encoder.Flush();
+	}
+}
+
+void DecompressChunksThread(int iThread, int NumThreads, void *pParams)
+{
+	ChunkJob *job = (ChunkJob *) pParams;
+	vector<unsigned char> data;
+	FILE *pFile;
+	size_t i;
+
+	// each thread reads its own chunks, so reads from slow storage overlap with decoding
+	pFile = fopen(job->Filename, "rb");
+	for (i = iThread; i < job->pChunks->size(); i += NumThreads)
+	{
+		const VDSCompressedChunk &chunk = (*job->pChunks)[i];
+		if (pFile == NULL || (VDSFileOffset) (size_t) chunk.Size != chunk.Size)
+		{
+			(*job->pFailed)[i] = true;
+			continue;
+		}
+		data.resize((size_t) chunk.Size);
+		if (FileSeek(pFile, chunk.Offset) != 0 ||
+			(chunk.Size != 0 && fread(&data[0], 1, (size_t) chunk.Size, pFile) != chunk.Size))
+		{
+			(*job->pFailed)[i] = true;
+			continue;
+		}
+		ChunkDecoder decoder(chunk.Size ? &data[0] : NULL, (size_t) chunk.Size);
+		CodeChunk(decoder, *job->pForest, *job->pHeader, chunk);
+		(*job->pFailed)[i] = decoder.IsCorrupt();
+	}
+	if (pFile != NULL)
+		fclose(pFile);
+}
+
+int ChooseNumThreads(int NumThreads, size_t NumChunks)
+{
+	if (NumThreads <= 0)
+		NumThreads = GetNumSystemProcessors();
+	if ((size_t) NumThreads > NumChunks)
+		NumThreads = (int) NumChunks;
+	return (NumThreads > 0) ? NumThreads : 1;
+}
+
+} // namespace
+
+bool Forest::WriteCompressedVDS(const char *Filename, unsigned int PositionBits, unsigned int NormalBits, int NumThreads)
+{
+	VDSCompressedHeader header;
+	vector<VDSCompressedChunk> chunks;
+	vector< vector<unsigned char> > chunk_data;
+	vector<char> failed;
+	VDSCompressedChunk chunk;
+	VDSFileOffset offset;
+	ChunkJob job;
+	FILE *pFile;
+	bool ok;
+	unsigned int section;
+	NodeIndex i;
+	int j;
+
+	assert(mIsValid);
+	if (PositionBits > MAX_POSITION_BITS)
+		PositionBits = MAX_POSITION_BITS;
+	if (NormalBits > MAX_NORMAL_BITS)
+		NormalBits = MAX_NORMAL_BITS;
+
+	memset(&header, 0, sizeof(VDSCompressedHeader));
+	header.Magic = VDS_COMPRESSED_FILE_MAGIC;
+	header.Version = VDS_COMPRESSED_FORMAT_VERSION;
+	header.ColorsPresent = mColorsPresent;
+	header.NormalsPresent = mNormalsPresent;
+	header.NumTextures = mNumTextures;
+	header.NumPatches = mNumPatches;
+	header.ErrorParamSize = mErrorParamSize;
+	header.PositionBits = PositionBits;
+	header.NormalBits = NormalBits;
+	header.ChunkRecords = VDS_COMPRESSED_CHUNK_RECORDS;
+	header.NumNodes = mNumNodes;
+	header.NumNodePositions = mNumNodePositions;
+	header.NumTris = mNumTris;
+	header.NumErrorParams = mNumErrorParams;
+	header.NumCoarseNodes = mNumCoarseNodes;
+
+	// quantization grid covers the bounding box of all positions
+	if (PositionBits != 0 && mNumNodePositions > 0)
+	{
+		for (j = 0; j < 3; ++j)
+		{
+			Float min = mpNodeRenderData[0].Position[j];
+			Float max = min;
+			for (i = 1; i < mNumNodePositions; ++i)
+			{
+				if (mpNodeRenderData[i].Position[j] < min)
+					min = mpNodeRenderData[i].Position[j];
+				if (mpNodeRenderData[i].Position[j] > max)
+					max = mpNodeRenderData[i].Position[j];
+			}
+			header.PositionMin[j] = min;
+			header.PositionScale[j] = (max > min) ? (float) (((1u << PositionBits) - 1) / ((double) max - min)) : 0.0f;
+		}
+	}
+	if (NormalBits != 0)
+	{
+		header.NormalScale = (float) (((1u << NormalBits) - 1) / 2.0);
+	}
+
+	for (section = 0; section < VDS_NUM_SECTIONS; ++section)
+	{
+		VDSFileOffset size = SectionSize(header, section);
+		for (offset = 0; offset < size; offset += VDS_COMPRESSED_CHUNK_RECORDS)
+		{
+			chunk.Section = section;
+			chunk.FirstRecord = offset;
+			chunk.NumRecords = (unsigned int) ((size - offset < VDS_COMPRESSED_CHUNK_RECORDS) ? size - offset : VDS_COMPRESSED_CHUNK_RECORDS);
+			chunk.Offset = 0;
+			chunk.Size = 0;
+			chunks.push_back(chunk);
+		}
+	}
+	header.NumChunks = (unsigned int) chunks.size();
+	chunk_data.resize(chunks.size());
+
+	job.pForest = this;
+	job.pHeader = &header;
+	job.pChunks = &chunks;
+	job.pChunkData = &chunk_data;
+	job.Filename = NULL;
+	job.pFailed = &failed;
+	ForkAndJoinThreads(ChooseNumThreads(NumThreads, chunks.size()), CompressChunksThread, &job);
+
+	offset = sizeof(VDSCompressedHeader) + chunks.size() * sizeof(VDSCompressedChunk);
+	for (i = 0; i < chunks.size(); ++i)
+	{
+		chunks[i].Offset = offset;
+		chunks[i].Size = chunk_data[i].size();
+		offset += chunks[i].Size;
+	}
+
+	pFile = fopen(Filename, "wb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+	ok = (fwrite(&header, sizeof(VDSCompressedHeader), 1, pFile) == 1) &&
+		(chunks.empty() || fwrite(&chunks[0], sizeof(VDSCompressedChunk), chunks.size(), pFile) == chunks.size());
+	for (i = 0; ok && i < chunks.size(); ++i)
+	{
+		ok = chunk_data[i].empty() || (fwrite(&chunk_data[i][0], 1, chunk_data[i].size(), pFile) == chunk_data[i].size());
+	}
+	if (fclose(pFile) != 0)
+	{
+		ok = false;
+	}
+	if (!ok)
+	{
+		cerr << "Error writing VDS file " << Filename << endl;
+	}
+	return ok;
+}
+
+bool Forest::ReadCompressedVDS(const char *Filename, int NumThreads)
+{
+	VDSCompressedHeader header;
+	vector<VDSCompressedChunk> chunks;
+	vector<char> failed;
+	ChunkJob job;
+	FILE *pFile;
+	VDSFileOffset file_length = 0, data_start = 0;
+	bool ok;
+	size_t i;
+
+	Reset();
+	mIsMMapped = false;
+
+	pFile = fopen(Filename, "rb");
+	if (pFile == NULL)
+	{
+		return false;
+	}
+	ok = FileLength(pFile, file_length) &&
+		(fread(&header, sizeof(VDSCompressedHeader), 1, pFile) == 1);
+	if (ok && (header.Magic != VDS_COMPRESSED_FILE_MAGIC || header.Version != VDS_COMPRESSED_FORMAT_VERSION))
+	{
+		cerr << "Incompatible VDS file version." << endl;
+		fclose(pFile);
+		return false;
+	}
+	ok = ok && (header.ChunkRecords != 0) && (header.ChunkRecords <= VDS_COMPRESSED_CHUNK_RECORDS) &&
+		(header.PositionBits <= MAX_POSITION_BITS) && (header.NormalBits <= MAX_NORMAL_BITS) &&
+		(header.ErrorParamSize >= 0) && HeaderCountsFit(header);
+	// the chunk table must fit in the file before it is allocated
+	ok = ok && (header.NumChunks <= (file_length - sizeof(VDSCompressedHeader)) / sizeof(VDSCompressedChunk));
+	if (ok)
+	{
+		data_start = sizeof(VDSCompressedHeader) + (VDSFileOffset) header.NumChunks * sizeof(VDSCompressedChunk);
+		chunks.resize(header.NumChunks);
+		ok = chunks.empty() || (fread(&chunks[0], sizeof(VDSCompressedChunk), chunks.size(), pFile) == chunks.size());
+	}
+	fclose(pFile);
+
+	// every chunk's data must lie in the file after the chunk table, and every element
+	// of every section must be covered by exactly one chunk, in order; together these
+	// bound each array ReadCompressedVDS allocates by the length of the file
+	VDSFileOffset next_record = 0;
+	unsigned int section = 0;
+	for (i = 0; ok && i < chunks.size(); ++i)
+	{
+		while (section < chunks[i].Section && next_record == SectionSize(header, section))
+		{
+			++section;
+			next_record = 0;
+		}
+		ok = (chunks[i].Offset >= data_start) && (chunks[i].Offset <= file_length) &&
+			(chunks[i].Size <= file_length - chunks[i].Offset) &&
+			(chunks[i].Section == section) && (chunks[i].FirstRecord == next_record) &&
+			(chunks[i].NumRecords > 0) && (chunks[i].NumRecords <= header.ChunkRecords) &&
+			(next_record + chunks[i].NumRecords <= SectionSize(header, section));
+		next_record += chunks[i].NumRecords;
+	}
+	while (ok && section < VDS_NUM_SECTIONS && next_record == SectionSize(header, section))
+	{
+		++section;
+		next_record = 0;
+	}
+	if (!ok || section != VDS_NUM_SECTIONS)
+	{
+		cerr << "VDS file " << Filename << " is corrupt." << endl;
+		return false;
+	}
+
+	mColorsPresent = (header.ColorsPresent != 0);
+	mNormalsPresent = (header.NormalsPresent != 0);
+	mNumTextures = header.NumTextures;
+	mNumPatches = (PatchIndex) header.NumPatches;
+	mErrorParamSize = header.ErrorParamSize;
+	mNumNodes = (NodeIndex) header.NumNodes;
+	mNumNodePositions = (NodeIndex) header.NumNodePositions;
+	mNumTris = (TriIndex) header.NumTris;
+	mNumErrorParams = (NodeIndex) header.NumErrorParams;
+	mNumCoarseNodes = (NodeIndex) header.NumCoarseNodes;
+
+	mpErrorParams = new float[mNumErrorParams * mErrorParamSize];
+	mpNodes = new Node[mNumNodes + 1];
+	mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
+	mpTris = new Tri[mNumTris + 1];
+
+	failed.resize(chunks.size(), false);
+	job.pForest = this;
+	job.pHeader = &header;
+	job.pChunks = &chunks;
+	job.pChunkData = NULL;
+	job.Filename = Filename;
+	job.pFailed = &failed;
+	ForkAndJoinThreads(ChooseNumThreads(NumThreads, chunks.size()), DecompressChunksThread, &job);
+
+	for (i = 0; i < chunks.size(); ++i)
+	{
+		if (failed[i])
+		{
+			cerr << "Error reading VDS file " << Filename << endl;
+			Reset();
+			return false;
+		}
+	}
+	SetValid();
+	return true;
+}
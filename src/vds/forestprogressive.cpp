@@ -0,0 +1,408 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+// Progressive VDS files.
+//
+// A progressive file holds a forest as a stream of unfold records ordered coarse to 
+// fine, so a forest can be used as soon as its first records have been read and the
+// rest can be streamed in while it's being rendered.  The file is a 
+// VDSProgressiveHeader followed by the base record (the nil node and the root nodes)
+// and then one record per node that can be unfolded, holding everything an unfold of
+// that node reads: its children (with their render data and error params) and its
+// subtris.  Records come out in order of decreasing node error, breadth first from the
+// roots, so every node's record follows its parent's.  Node and tri indices are those
+// of the in-memory forest, so nothing needs remapping as records arrive.
+//
+// If the forest was laid out by ReorderForPaging, the base record also carries its
+// coarse subtree starts, since they can't be worked out until all coarse nodes arrive.
+//
+// Like binary VDS files, the records hold raw structs, so the reader must share the
+// writer's data layout.
+#ifdef _WIN32
+#pragma warning(disable: 4530)
+#pragma warning(disable: 4786)
+#include <windows.h>
+#endif
+
+#include <cassert>
+#include <iostream>
+#include <queue>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "vds.h"
+#include "forest.h"
+#include "node.h"
+#include "tri.h"
+
+using namespace std;
+using namespace VDS;
+
+#define VDS_PROGRESSIVE_FORMAT_VERSION 2
+
+namespace VDS
+{
+
+struct VDSProgressiveHeader
+{
+	unsigned int Magic;
+	unsigned int Version;
+	VDSFileOffset NumRecords;	// not counting the base record
+	VDSFileHeader Layout;		// section offsets are unused
+};
+
+// each record is followed by NumNodes node entries (NodeIndex, Node, VertexRenderDatum,
+// ErrorParamSize floats) and NumTris tri entries (TriIndex, Tri); the base record is 
+// then followed by the Layout.NumCoarseNodes + 1 coarse subtree starts, if there are any
+struct VDSProgressiveRecord
+{
+	NodeIndex iNode;	// node the record unfolds; iNIL_NODE for the base record
+	unsigned int NumNodes;
+	unsigned int NumTris;
+};
+
+struct VDSProgressiveLoader
+{
+	VDSReadFunc fRead;
+	void *pUserData;
+	FILE *pFile;	// set if the loader opened the file itself
+	VDSFileOffset NumRecordsLeft;
+	vector<char> Buffer;
+};
+
+} // namespace VDS
+
+static size_t ReadFromFile(void *pBuffer, size_t Size, void *pUserData)
+{
+	return fread(pBuffer, 1, Size, (FILE *) pUserData);
+}
+
+static size_t WriteToFile(const void *pBuffer, size_t Size, void *pUserData)
+{
+	return fwrite(pBuffer, 1, Size, (FILE *) pUserData);
+}
+
+static void Append(vector<char> &rBuffer, const void *pData, size_t Size)
+{
+	size_t Offset = rBuffer.size();
+	rBuffer.resize(Offset + Size);
+	memcpy(&rBuffer[Offset], pData, Size);
+}
+
+// refinement priority of a node; larger errors are streamed first
+static float ProgressiveError(const Forest &rForest, NodeIndex iNode)
+{
+	const Node &rNode = rForest.mpNodes[iNode];
+	if ((rForest.mpErrorParams != NULL) && (rForest.mErrorParamSize > 0) && (rNode.miErrorParamIndex < rForest.mNumErrorParams))
+		return rForest.mpErrorParams[rNode.miErrorParamIndex];
+	return rNode.mXBBoxOffset * rNode.mXBBoxOffset + rNode.mYBBoxOffset * rNode.mYBBoxOffset + rNode.mZBBoxOffset * rNode.mZBBoxOffset;
+}
+
+static void AppendNodeEntry(vector<char> &rBuffer, const Forest &rForest, NodeIndex iNode)
+{
+	const Node &rNode = rForest.mpNodes[iNode];
+	VertexRenderDatum datum;
+
+	memset(&datum, 0, sizeof(VertexRenderDatum));
+	if (rNode.miRenderData < rForest.mNumNodePositions)
+		datum = rForest.mpNodeRenderData[rNode.miRenderData];
+	Append(rBuffer, &iNode, sizeof(NodeIndex));
+	Append(rBuffer, &rNode, sizeof(Node));
+	Append(rBuffer, &datum, sizeof(VertexRenderDatum));
+	for (int i = 0; i < rForest.mErrorParamSize; ++i)
+	{
+		float param = 0.0f;
+		if ((rForest.mpErrorParams != NULL) && ((VDSFileOffset) rNode.miErrorParamIndex + i < (VDSFileOffset) rForest.mNumErrorParams * rForest.mErrorParamSize))
+			param = rForest.mpErrorParams[rNode.miErrorParamIndex + i];
+		Append(rBuffer, &param, sizeof(float));
+	}
+}
+
+bool Forest::WriteProgressiveVDS(const char *Filename)
+{
+	FILE *pFile = fopen(Filename, "wb");
+	if (pFile == NULL)
+	{
+		cerr << "Couldn't open " << Filename << " for writing." << endl;
+		return false;
+	}
+	bool ok = WriteProgressiveVDS(WriteToFile, pFile);
+	if (fclose(pFile) != 0)
+		ok = false;
+	return ok;
+}
+
+bool Forest::WriteProgressiveVDS(VDSWriteFunc fWrite, void *pUserData)
+{
+	VDSProgressiveHeader header;
+	VDSProgressiveRecord record;
+	vector<char> Buffer;
+	vector<NodeIndex> Order;
+	priority_queue<pair<float, NodeIndex> > Queue;
+	NodeIndex iNode, iChild;
+	TriIndex iTri;
+	unsigned int i;
+
+	if (!mIsValid)
+		return false;
+
+	// order the unfoldable nodes by error, always after their parents
+	for (iNode = iROOT_NODE; iNode <= mNumNodes; ++iNode)
+	{
+		if (mpNodes[iNode].miParent == iNIL_NODE)
+			Queue.push(make_pair(ProgressiveError(*this, iNode), iNode));
+	}
+	vector<NodeIndex> Roots;
+	while (!Queue.empty())
+	{
+		iNode = Queue.top().second;
+		Queue.pop();
+		if (mpNodes[iNode].miParent == iNIL_NODE)
+			Roots.push_back(iNode);
+		if ((mpNodes[iNode].miFirstChild == iNIL_NODE) && (mpNodes[iNode].miFirstSubTri == iNIL_TRI))
+			continue;
+		Order.push_back(iNode);
+		for (iChild = mpNodes[iNode].miFirstChild; iChild != iNIL_NODE; iChild = mpNodes[iChild].miRightSibling)
+			Queue.push(make_pair(ProgressiveError(*this, iChild), iChild));
+	}
+
+	memset(&header, 0, sizeof(VDSProgressiveHeader));
+	header.Magic = VDS_PROGRESSIVE_FILE_MAGIC;
+	header.Version = VDS_PROGRESSIVE_FORMAT_VERSION;
+	header.NumRecords = Order.size();
+	FillFileHeader(header.Layout);
+	if (fWrite(&header, sizeof(VDSProgressiveHeader), pUserData) != sizeof(VDSProgressiveHeader))
+		return false;
+
+	// base record: the nil node and the roots
+	record.iNode = iNIL_NODE;
+	record.NumNodes = (unsigned int) Roots.size() + 1;
+	record.NumTris = 0;
+	Append(Buffer, &record, sizeof(VDSProgressiveRecord));
+	AppendNodeEntry(Buffer, *this, iNIL_NODE);
+	for (i = 0; i < Roots.size(); ++i)
+		AppendNodeEntry(Buffer, *this, Roots[i]);
+	if (mNumCoarseNodes > 0)
+		Append(Buffer, mpCoarseSubtreeStarts, (mNumCoarseNodes + 1) * sizeof(NodeIndex));
+	if (fWrite(&Buffer[0], Buffer.size(), pUserData) != Buffer.size())
+		return false;
+
+	for (i = 0; i < Order.size(); ++i)
+	{
+		iNode = Order[i];
+		Buffer.clear();
+		record.iNode = iNode;
+		record.NumNodes = 0;
+		record.NumTris = 0;
+		Append(Buffer, &record, sizeof(VDSProgressiveRecord));
+		for (iChild = mpNodes[iNode].miFirstChild; iChild != iNIL_NODE; iChild = mpNodes[iChild].miRightSibling)
+		{
+			AppendNodeEntry(Buffer, *this, iChild);
+			++record.NumNodes;
+		}
+		for (iTri = mpNodes[iNode].miFirstSubTri; iTri != iNIL_TRI; iTri = mpTris[iTri].miNextSubTri)
+		{
+			Append(Buffer, &iTri, sizeof(TriIndex));
+			Append(Buffer, &mpTris[iTri], sizeof(Tri));
+			++record.NumTris;
+		}
+		memcpy(&Buffer[0], &record, sizeof(VDSProgressiveRecord));
+		if (fWrite(&Buffer[0], Buffer.size(), pUserData) != Buffer.size())
+			return false;
+	}
+	return true;
+}
+
+bool Forest::BeginProgressiveVDS(const char *Filename)
+{
+	FILE *pFile = fopen(Filename, "rb");
+	if (pFile == NULL)
+		return false;
+	if (!BeginProgressiveVDS(ReadFromFile, pFile))
+	{
+		fclose(pFile);
+		return false;
+	}
+	mpLoader->pFile = pFile;
+	return true;
+}
+
+bool Forest::BeginProgressiveVDS(VDSReadFunc fRead, void *pUserData)
+{
+	VDSProgressiveHeader header;
+	NodeIndex i;
+
+	Reset();
+	if ((fRead(&header, sizeof(VDSProgressiveHeader), pUserData) != sizeof(VDSProgressiveHeader)) ||
+		(header.Magic != VDS_PROGRESSIVE_FILE_MAGIC) || (header.Version != VDS_PROGRESSIVE_FORMAT_VERSION))
+	{
+		cerr << "Progressive VDS file is truncated or has an incompatible version." << endl;
+		return false;
+	}
+	if (!GetDataFromFileHeader(header.Layout, header.Layout.FileSize))
+	{
+		Reset();
+		return false;
+	}
+
+	// everything starts out empty (nil links) and is filled in as records arrive
+	mpNodes = new Node[mNumNodes + 1];
+	mpNodeRenderData = new VertexRenderDatum[mNumNodePositions];
+	memset(mpNodeRenderData, 0, sizeof(VertexRenderDatum) * mNumNodePositions);
+	mpTris = new Tri[mNumTris + 1];
+	mpErrorParams = new float[mNumErrorParams * mErrorParamSize];
+	memset(mpErrorParams, 0, sizeof(float) * mNumErrorParams * mErrorParamSize);
+	mpNodeLoaded = new unsigned char[mNumNodes + 1];
+	for (i = 0; i <= mNumNodes; ++i)
+		mpNodeLoaded[i] = 0;
+
+	mpLoader = new VDSProgressiveLoader;
+	mpLoader->fRead = fRead;
+	mpLoader->pUserData = pUserData;
+	mpLoader->pFile = NULL;
+	mpLoader->NumRecordsLeft = header.NumRecords + 1;
+
+	// the base record is needed before anything can be done with the forest
+	if (!ContinueProgressiveVDS(1) && (mpNodeLoaded != NULL))
+	{
+		Reset();
+		return false;
+	}
+	SetValid();
+	return true;
+}
+
+bool Forest::ReadProgressiveVDS(const char *Filename)
+{
+	if (!BeginProgressiveVDS(Filename))
+		return false;
+	while (ContinueProgressiveVDS(VDS_PROGRESSIVE_RECORDS_PER_STEP))
+		;
+	if (mpNodeLoaded != NULL)
+	{
+		Reset();
+		return false;
+	}
+	return true;
+}
+
+bool Forest::ContinueProgressiveVDS(unsigned int MaxRecords)
+{
+	VDSProgressiveRecord record;
+	size_t NodeEntrySize = sizeof(NodeIndex) + sizeof(Node) + sizeof(VertexRenderDatum) + mErrorParamSize * sizeof(float);
+	size_t TriEntrySize = sizeof(TriIndex) + sizeof(Tri);
+	NodeIndex iNode;
+	TriIndex iTri;
+	unsigned int i;
+	char *p;
+
+	if (mpLoader == NULL)
+		return false;
+
+	for (; (MaxRecords > 0) && (mpLoader->NumRecordsLeft > 0); --MaxRecords)
+	{
+		if (mpLoader->fRead(&record, sizeof(VDSProgressiveRecord), mpLoader->pUserData) != sizeof(VDSProgressiveRecord) ||
+			(record.iNode > mNumNodes) || (record.NumNodes > mNumNodes + 1) || (record.NumTris > mNumTris))
+		{
+			break;
+		}
+		size_t Size = record.NumNodes * NodeEntrySize + record.NumTris * TriEntrySize;
+		size_t StartsSize = ((record.iNode == iNIL_NODE) && (mNumCoarseNodes > 0)) ? (mNumCoarseNodes + 1) * sizeof(NodeIndex) : 0;
+		Size += StartsSize;
+		mpLoader->Buffer.resize(Size + 1);
+		if (mpLoader->fRead(&mpLoader->Buffer[0], Size, mpLoader->pUserData) != Size)
+			break;
+
+		// check the whole record before using any of it
+		bool valid = true;
+		for (i = 0, p = &mpLoader->Buffer[0]; valid && (i < record.NumNodes); ++i, p += NodeEntrySize)
+		{
+			const Node *pNode = (const Node *) (p + sizeof(NodeIndex));
+			memcpy(&iNode, p, sizeof(NodeIndex));
+			valid = (iNode <= mNumNodes) && ((pNode->miRenderData < mNumNodePositions) || (iNode == iNIL_NODE)) &&
+				((mErrorParamSize == 0) || ((VDSFileOffset) pNode->miErrorParamIndex + mErrorParamSize <= (VDSFileOffset) mNumErrorParams * mErrorParamSize) || (iNode == iNIL_NODE));
+		}
+		for (i = 0; valid && (i < record.NumTris); ++i, p += TriEntrySize)
+		{
+			memcpy(&iTri, p, sizeof(TriIndex));
+			valid = (iTri != iNIL_TRI) && (iTri <= mNumTris);
+		}
+		for (i = 1; valid && (StartsSize > 0) && (i <= mNumCoarseNodes); ++i)
+		{
+			memcpy(&iNode, p + i * sizeof(NodeIndex), sizeof(NodeIndex));
+			valid = (iNode > mNumCoarseNodes) && (iNode <= mNumNodes + 1);
+		}
+		if (!valid)
+			break;
+		if (StartsSize > 0)
+		{
+			delete[] mpCoarseSubtreeStarts;
+			mpCoarseSubtreeStarts = new NodeIndex[mNumCoarseNodes + 1];
+			memcpy(mpCoarseSubtreeStarts, p, StartsSize);
+		}
+
+		for (i = 0, p = &mpLoader->Buffer[0]; i < record.NumNodes; ++i, p += NodeEntrySize)
+		{
+			memcpy(&iNode, p, sizeof(NodeIndex));
+			Node &rNode = mpNodes[iNode];
+			memcpy(&rNode, p + sizeof(NodeIndex), sizeof(Node));
+			if (rNode.miRenderData < mNumNodePositions)
+				memcpy(&mpNodeRenderData[rNode.miRenderData], p + sizeof(NodeIndex) + sizeof(Node), sizeof(VertexRenderDatum));
+			if ((mErrorParamSize > 0) && ((VDSFileOffset) rNode.miErrorParamIndex + mErrorParamSize <= (VDSFileOffset) mNumErrorParams * mErrorParamSize))
+				memcpy(&mpErrorParams[rNode.miErrorParamIndex], p + sizeof(NodeIndex) + sizeof(Node) + sizeof(VertexRenderDatum), mErrorParamSize * sizeof(float));
+			// nodes with nothing to unfold have no record of their own
+			if ((rNode.miFirstChild == iNIL_NODE) && (rNode.miFirstSubTri == iNIL_TRI))
+				mpNodeLoaded[iNode] = 1;
+		}
+		for (i = 0; i < record.NumTris; ++i, p += TriEntrySize)
+		{
+			memcpy(&iTri, p, sizeof(TriIndex));
+			memcpy(&mpTris[iTri], p + sizeof(TriIndex), sizeof(Tri));
+		}
+		mpNodeLoaded[record.iNode] = 1;
+		--mpLoader->NumRecordsLeft;
+	}
+
+	if ((mpLoader->NumRecordsLeft > 0) && (MaxRecords > 0))
+	{
+		// the stream ended early or is corrupt; whatever was loaded stays usable, and the
+		// nodes that weren't are never unfolded
+		cerr << "Progressive VDS stream is truncated or corrupt." << endl;
+		EndProgressiveVDS();
+		return false;
+	}
+	if (mpLoader->NumRecordsLeft == 0)
+	{
+		EndProgressiveVDS();
+		delete[] mpNodeLoaded;
+		mpNodeLoaded = NULL;
+		return false;
+	}
+	return true;
+}
+
+VDSFileOffset Forest::GetProgressiveRecordsLeft() const
+{
+	return (mpLoader != NULL) ? mpLoader->NumRecordsLeft : 0;
+}
+
+void Forest::EndProgressiveVDS()
+{
+	if (mpLoader == NULL)
+		return;
+	if (mpLoader->pFile != NULL)
+		fclose(mpLoader->pFile);
+	delete mpLoader;
+	mpLoader = NULL;
+}
@@ -18,7 +18,10 @@
 #endif
 
 #include <iostream>
+#include <string.h>
 #include "manager.h"
+#include "cut.h"
+#include "simplifier.h"
 
 using namespace std;
 using namespace VDS;
@@ -26,13 +29,13 @@ using namespace VDS;
 
 Manager::Manager()
 {
-	mNumRenderers = 0;
 //	mNumMemoryBlocks = 0;
 
 //	mpSystemMemoryPool = NULL;
 //	mSystemMemoryPoolSize = 0;
 	mpFastMemoryPool = NULL;
 	mFastMemoryPoolSize = 0;
+	mMemoryBudget = 0;
 	mInitialized = false;
 }
 
@@ -54,7 +57,7 @@ void Manager::Initialize(/*void *pSystemMemory, unsigned int SystemMemorySize,*/
 void Manager::Reset()
 {
 	unsigned int i;
-	for (i = 0; i < mNumRenderers; ++i)
+	for (i = 0; i < mpMemoryBlocks.size(); ++i)
 	{
 		mpMemoryBlocks[i].pRenderer->mpFastVertexRenderData = NULL;
 		mpMemoryBlocks[i].pRenderer->mNumVerticesAllocated = 0;
@@ -127,17 +130,19 @@ bool Manager::AllocateSystemMemory(Renderer *pRenderer, unsigned int SizeOfVerte
 }
 */
 
-bool Manager::AddRenderer(Renderer *pRenderer)
+void Manager::AddRenderer(Renderer *pRenderer)
 {
-	if (mNumRenderers >= MAX_MEMORY_BLOCKS)
-	{
-		cerr << "Error - maximum number of renderer memory blocks exceeded" << endl;
-		return false;
-	}
+	RenderMemoryBlock Block;
 
-	pRenderer->mpMemoryManager = this;
+	if (pRenderer->mpMemoryManager == this)
+		return;
 
-	mpMemoryBlocks[mNumRenderers].pRenderer = pRenderer;
+	memset(&Block, 0, sizeof(Block));
+	Block.pRenderer = pRenderer;
+	Block.mImportance = 1.0;
+	pRenderer->mpMemoryManager = this;
+	pRenderer->miMemoryBlock = mpMemoryBlocks.size();
+	mpMemoryBlocks.push_back(Block);
 // TODO: replace these with pass-through functions to let user specify fast memory per object (renderer)
 //	mpMemoryBlocks[mNumRenderers].mBaseAddressOfVertexMemoryAllocated = mpFastMemoryPool;
 //	mpMemoryBlocks[mNumRenderers].mTopAddressOfVertexMemoryAllocated = &((char*)mpFastMemoryPool)[mFastMemoryPoolSize - 1];
@@ -146,21 +151,135 @@ bool Manager::AddRenderer(Renderer *pRenderer)
 
 // TODO: need to make separate mNumFastVerticesAllocated to allow for there to be different amounts of fast and system vertex render data available
 //	mpMemoryBlocks[mNumRenderers].pRenderer->mNumVerticesAllocated = mpMemoryBlocks[mNumRenderers].mSizeOfVertexMemoryAllocated / sizeof(VertexRenderDatum);
-
-	++mNumRenderers;
-	return true;
 }
 
 void Manager::RemoveRenderer(Renderer *pRenderer) {
-    unsigned int i;
-    for(i = 0; i < mNumRenderers; i++) {
-        if(mpMemoryBlocks[i].pRenderer == pRenderer) {
-            pRenderer->mpMemoryManager = NULL;
-            memmove(&mpMemoryBlocks[i], &mpMemoryBlocks[i+1], sizeof(RenderMemoryBlock) * mNumRenderers - i);
-            mNumRenderers--;
-            return;
-        }
+    int i = GetRendererIndex(pRenderer);
+    if (i < 0)
+        return;
+    pRenderer->mpMemoryManager = NULL;
+    // the last block takes the removed one's place, so removal doesn't renumber every renderer
+    if ((unsigned int) i != mpMemoryBlocks.size() - 1)
+    {
+        mpMemoryBlocks[i] = mpMemoryBlocks.back();
+        mpMemoryBlocks[i].pRenderer->miMemoryBlock = i;
     }
+    mpMemoryBlocks.pop_back();
+}
+
+void Manager::SetMemoryBudget(unsigned int Bytes)
+{
+	mMemoryBudget = Bytes;
+}
+
+unsigned int Manager::GetMemoryAllocated()
+{
+	unsigned int i, Bytes = 0;
+	for (i = 0; i < mpMemoryBlocks.size(); ++i)
+	{
+		Bytes += mpMemoryBlocks[i].pRenderer->GetMemoryAllocated();
+	}
+	return Bytes;
+}
+
+unsigned int Manager::GetMemoryUsage()
+{
+	unsigned int i, Bytes = 0;
+	for (i = 0; i < mpMemoryBlocks.size(); ++i)
+	{
+		if (mpMemoryBlocks[i].pRenderer->mpCut != NULL)
+			Bytes += mpMemoryBlocks[i].pRenderer->mpCut->mBytesUsed;
+	}
+	return Bytes;
+}
+
+void Manager::SetRendererImportance(Renderer *pRenderer, float Importance)
+{
+	int i = GetRendererIndex(pRenderer);
+	if (i >= 0)
+		mpMemoryBlocks[i].mImportance = Importance;
+}
+
+bool Manager::ReserveMemory(Renderer *pRenderer, unsigned int Bytes)
+{
+	unsigned int Allocated;
+	int i;
+
+	if (mMemoryBudget == 0)
+		return true;
+	Allocated = GetMemoryAllocated();
+	if (Allocated + Bytes <= mMemoryBudget)
+		return true;
+
+	// pRenderer is in the middle of adding render data, so leave its own arrays alone
+	vector<bool> Trimmed(mpMemoryBlocks.size(), false);
+	i = GetRendererIndex(pRenderer);
+	if (i >= 0)
+		Trimmed[i] = true;
+	while ((Allocated + Bytes > mMemoryBudget) && ((i = GetLeastImportantRenderer(Trimmed)) >= 0))
+	{
+		Trimmed[i] = true;
+		Allocated -= mpMemoryBlocks[i].pRenderer->TrimTriRenderData();
+	}
+	return (Allocated + Bytes <= mMemoryBudget);
+}
+
+void Manager::EnforceBudget()
+{
+	unsigned int Allocated, Excess, Used, Target;
+	unsigned int j;
+	Simplifier *pSimplifier;
+	Renderer *pRenderer;
+	bool Stuck;
+	int i;
+
+	if (mMemoryBudget == 0)
+		return;
+	Allocated = GetMemoryAllocated();
+	if (Allocated <= mMemoryBudget)
+		return;
+
+	// slack is free to give back
+	vector<bool> Visited(mpMemoryBlocks.size(), false);
+	while ((Allocated > mMemoryBudget) && ((i = GetLeastImportantRenderer(Visited)) >= 0))
+	{
+		Visited[i] = true;
+		Allocated -= mpMemoryBlocks[i].pRenderer->TrimTriRenderData();
+	}
+
+	// then coarsen the least important cuts.  a simplifier folds all of its cuts in
+	// error order, so every renderer sharing it gives up memory at once; it is moved
+	// on from only once it can't fold any further
+	Visited.assign(mpMemoryBlocks.size(), false);
+	while ((Allocated > mMemoryBudget) && ((i = GetLeastImportantRenderer(Visited)) >= 0))
+	{
+		pRenderer = mpMemoryBlocks[i].pRenderer;
+		if ((pRenderer->mpCut == NULL) || (pRenderer->mpCut->mpSimplifier == NULL))
+		{
+			Visited[i] = true;
+			continue;
+		}
+		pSimplifier = pRenderer->mpCut->mpSimplifier;
+
+		Excess = Allocated - mMemoryBudget;
+		Used = pSimplifier->GetMemoryUsage();
+		Target = (Used > Excess) ? Used - Excess : 0;
+		if (Target <= (unsigned int) pSimplifier->mBudgetTolerance)
+			Target = pSimplifier->mBudgetTolerance + 1;
+		pSimplifier->SimplifyBudget(Target, false);
+		Stuck = (pSimplifier->GetMemoryUsage() >= Used);
+
+		for (j = 0; j < mpMemoryBlocks.size(); ++j)
+		{
+			if ((mpMemoryBlocks[j].pRenderer->mpCut != NULL) && (mpMemoryBlocks[j].pRenderer->mpCut->mpSimplifier == pSimplifier))
+			{
+				if (Stuck)
+					Visited[j] = true;
+				mpMemoryBlocks[j].pRenderer->TrimTriRenderData();
+			}
+		}
+		Allocated = GetMemoryAllocated();
+	}
 }
 
 /*
@@ -259,13 +378,24 @@ void Manager::ReceiveFastRenderMemory(void *pFastRenderMem, unsigned int FastRen
 */
 
 int Manager::GetRendererIndex(Renderer *pRenderer)
+{
+	if ((pRenderer->mpMemoryManager == this) && (pRenderer->miMemoryBlock < mpMemoryBlocks.size()) &&
+		(mpMemoryBlocks[pRenderer->miMemoryBlock].pRenderer == pRenderer))
+		return pRenderer->miMemoryBlock;
+	cerr << "Error - GetRendererIndex didn't find renderer pointer" << endl;
+	return -666;
+}
+
+int Manager::GetLeastImportantRenderer(const vector<bool> &Visited) const
 {
 	unsigned int i;
-	for (i = 0; i < mNumRenderers; ++i)
+	int Least = -1;
+	for (i = 0; i < mpMemoryBlocks.size(); ++i)
 	{
-		if (mpMemoryBlocks[i].pRenderer == pRenderer)
-			return i;
+		if (Visited[i])
+			continue;
+		if ((Least < 0) || (mpMemoryBlocks[i].mImportance < mpMemoryBlocks[Least].mImportance))
+			Least = i;
 	}
-	cerr << "Error - GetRendererIndex didn't find renderer pointer" << endl;
-	return -666;
+	return Least;
 }
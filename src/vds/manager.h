@@ -14,6 +14,7 @@
 #ifndef MANAGER_H
 #define MANAGER_H
 
+#include <vector>
 #include "vds.h"
 #include "renderer.h"
 
@@ -37,7 +38,6 @@
 #define GL_FENCE_CONDITION_NV 0x84F4
 #endif
 
-#define MAX_MEMORY_BLOCKS 64
 #define MAX_RECORDS 8
 
 namespace VDS
@@ -49,6 +49,7 @@ struct RenderMemoryBlock
 	void *mBaseAddressOfVertexMemoryAllocated;
 	void *mTopAddressOfVertexMemoryAllocated;
 	unsigned int mSizeOfVertexMemoryAllocated;
+	float mImportance; // renderers with lower importance give up memory first
 //	void *mBaseAddressOfProxyMemoryAllocated;
 //	void *mTopAddressOfProxyMemoryAllocated;
 //	unsigned int mSizeOfProxyMemoryAllocated;
@@ -76,10 +77,31 @@ public:
 
 	void Initialize(/*void *pSystemMemory, unsigned int SystemMemorySize,*/ void *pFastMemory, unsigned int FastMemorySize);
 
-	// Add renderer for memory management
-	// returns an ID which is the index in the manager's arrays for this renderer
-	bool AddRenderer(Renderer *pRenderer);
+	// Add renderer for memory management; there is no limit on the number of renderers.
+	// the renderer's miMemoryBlock is set to its index in the manager's arrays
+	void AddRenderer(Renderer *pRenderer);
     void RemoveRenderer(Renderer *pRenderer);
+
+	// sets the budget, in bytes, for the render data of all renderers together; 0 means no limit
+	void SetMemoryBudget(unsigned int Bytes);
+	unsigned int GetMemoryBudget() const { return mMemoryBudget; }
+
+	// bytes of render data allocated by all renderers
+	unsigned int GetMemoryAllocated();
+
+	// bytes of render data in use by all renderers' cuts (see Simplifier::GetMemoryUsage())
+	unsigned int GetMemoryUsage();
+
+	void SetRendererImportance(Renderer *pRenderer, float Importance);
+
+	// called by pRenderer before it allocates Bytes more render data.  if that would go over
+	// budget, trims slack from the other renderers, least important first; returns false if
+	// the allocation still doesn't fit
+	bool ReserveMemory(Renderer *pRenderer, unsigned int Bytes);
+
+	// if the renderers are over budget, trims their slack and then coarsens the cuts of the
+	// least important ones through their simplifiers until they fit
+	void EnforceBudget();
 //	bool AllocateSystemMemory(Renderer *pRenderer, unsigned int SizeOfVertexMemory, unsigned int SizeOfProxyMemory, unsigned int SizeOfProxyBackRefMemory);
 //	bool AllocateFastMemory(Renderer *pRenderer, unsigned int SizeOfVertexMemory);
 
@@ -101,13 +123,15 @@ public:
 
 protected:
 	int GetRendererIndex(Renderer *pRenderer);
+
+	// returns the index of the least important renderer not yet marked in Visited, or -1
+	int GetLeastImportantRenderer(const std::vector<bool> &Visited) const;
 	
 
 public:
 	bool mInitialized;
 
-	RenderMemoryBlock mpMemoryBlocks[MAX_MEMORY_BLOCKS];
-	unsigned int mNumRenderers;
+	std::vector<RenderMemoryBlock> mpMemoryBlocks;
 //	unsigned int mNumMemoryBlocks;
 
 //	RendererMemoryRecord mpRecords[MAX_RECORDS];
@@ -117,6 +141,8 @@ public:
 	void *mpFastMemoryPool;
 	unsigned int mFastMemoryPoolSize;
 
+	unsigned int mMemoryBudget;
+
 }; // class Manager
 
 } // namespace VDS
@@ -26,12 +26,13 @@ using namespace VDS;
 
 Node::Node()
 {
-	mpRenderData = NULL;
+	miRenderData = 0;
     miParent = Forest::iNIL_NODE;
     miLeftSibling= Forest::iNIL_NODE;
     miRightSibling = Forest::iNIL_NODE;
     miFirstChild = Forest::iNIL_NODE;
     miFirstSubTri = Forest::iNIL_TRI;
+	mCoincidentVertex = Forest::iNIL_NODE;
 //    mRadius = 0.0;
 	mXBBoxOffset = 0.0f;
 	mYBBoxOffset = 0.0f;
@@ -20,7 +20,7 @@ class VDS::Node
 public:
     Node();
     Node(const Node &); //not implemented
-    virtual ~Node();
+    ~Node();
 	
 	// Following access functions simply return a data member
     NodeIndex GetParent() const;
@@ -44,7 +44,7 @@ public:		// making these public for "debugging convenience"
 	NodeIndex mCoincidentVertex;
 //	ViewIndependentError mViewIndependentError;
 	unsigned int miErrorParamIndex;
-	VertexRenderDatum *mpRenderData;
+	NodeIndex miRenderData;	// index into Forest::mpNodeRenderData
 
 	Point3 mBBoxCenter;
 	Float mXBBoxOffset;
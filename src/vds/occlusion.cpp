@@ -0,0 +1,380 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+#include <cmath>
+#include "occlusion.h"
+#include "cut.h"
+#include "renderer.h"
+#ifdef VDS_OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+using namespace VDS;
+
+// clip space w below which a vertex is treated as being at the eye
+#define OCCLUSION_MIN_W 1e-6f
+
+OcclusionBuffer::OcclusionBuffer()
+{
+	mWidth = mHeight = 0;
+	mNumLevels = 0;
+	mpLevelWidths = mpLevelHeights = mpLevelStrides = NULL;
+	mpLevels = NULL;
+	mPyramidIsValid = false;
+	mNumOccluderTris = 0;
+	SetResolution(VDS_DEFAULT_OCCLUSION_RESOLUTION, VDS_DEFAULT_OCCLUSION_RESOLUTION);
+}
+
+OcclusionBuffer::~OcclusionBuffer()
+{
+	SetResolution(0, 0);
+}
+
+void OcclusionBuffer::SetResolution(unsigned int Width, unsigned int Height)
+{
+	unsigned int i, w, h;
+
+	for (i = 0; i < mNumLevels; ++i)
+		delete[] mpLevels[i];
+	delete[] mpLevels;
+	delete[] mpLevelWidths;
+	delete[] mpLevelHeights;
+	delete[] mpLevelStrides;
+	mpLevels = NULL;
+	mpLevelWidths = mpLevelHeights = mpLevelStrides = NULL;
+	mNumLevels = 0;
+	mWidth = Width;
+	mHeight = Height;
+	mPyramidIsValid = false;
+	if ((Width == 0) || (Height == 0))
+		return;
+
+	for (w = Width, h = Height, mNumLevels = 1; (w > 1) || (h > 1); ++mNumLevels)
+	{
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	mpLevels = new float* [mNumLevels];
+	mpLevelWidths = new unsigned int [mNumLevels];
+	mpLevelHeights = new unsigned int [mNumLevels];
+	mpLevelStrides = new unsigned int [mNumLevels];
+	for (i = 0, w = Width, h = Height; i < mNumLevels; ++i)
+	{
+		mpLevelWidths[i] = w;
+		mpLevelHeights[i] = h;
+		mpLevelStrides[i] = (w + 3) & ~3;
+		mpLevels[i] = new float [mpLevelStrides[i] * h];
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+	Clear();
+}
+
+void OcclusionBuffer::Clear()
+{
+	unsigned int i, Size;
+	float *pDepth;
+
+	if (mNumLevels == 0)
+		return;
+	pDepth = mpLevels[0];
+	Size = mpLevelStrides[0] * mHeight;
+	for (i = 0; i < Size; ++i)
+		pDepth[i] = 1.0f;
+	mPyramidIsValid = false;
+	mNumOccluderTris = 0;
+}
+
+void OcclusionBuffer::RasterizeTriangles(const Mat4 &rObjectToClip, const Point3 *pVertices, unsigned int VertexStride,
+	const ProxyIndex *pIndices, unsigned int NumTris)
+{
+	const Float (*m)[4] = rObjectToClip.cells;
+	const char *pBase = (const char *) pVertices;
+	Float Clip[3][4], Poly[4][4], Screen[4][3], t;
+	unsigned int iTri, k, NumPoly;
+	int a, b;
+
+	if (mNumLevels == 0)
+		return;
+	mPyramidIsValid = false;
+
+	for (iTri = 0; iTri < NumTris; ++iTri, pIndices += 3)
+	{
+		if ((pIndices[0] == pIndices[1]) || (pIndices[1] == pIndices[2]) || (pIndices[0] == pIndices[2]))
+			continue;
+		for (k = 0; k < 3; ++k)
+		{
+			const Point3 *p = (const Point3 *) (pBase + pIndices[k] * VertexStride);
+			for (a = 0; a < 4; ++a)
+				Clip[k][a] = m[a][0] * p->X + m[a][1] * p->Y + m[a][2] * p->Z + m[a][3];
+		}
+
+		// clip to the near plane (z >= -w), which leaves a triangle or a quad
+		NumPoly = 0;
+		for (a = 0, b = 2; a < 3; b = a++)
+		{
+			Float da = Clip[a][2] + Clip[a][3], db = Clip[b][2] + Clip[b][3];
+			if ((db >= 0) != (da >= 0))
+			{
+				t = db / (db - da);
+				for (k = 0; k < 4; ++k)
+					Poly[NumPoly][k] = Clip[b][k] + t * (Clip[a][k] - Clip[b][k]);
+				++NumPoly;
+			}
+			if (da >= 0)
+			{
+				for (k = 0; k < 4; ++k)
+					Poly[NumPoly][k] = Clip[a][k];
+				++NumPoly;
+			}
+		}
+		if (NumPoly < 3)
+			continue;
+
+		for (k = 0; k < NumPoly; ++k)
+		{
+			if (Poly[k][3] < OCCLUSION_MIN_W)
+				break;
+			Screen[k][0] = (Poly[k][0] / Poly[k][3] * 0.5f + 0.5f) * mWidth;
+			Screen[k][1] = (Poly[k][1] / Poly[k][3] * 0.5f + 0.5f) * mHeight;
+			Screen[k][2] = Poly[k][2] / Poly[k][3] * 0.5f + 0.5f;
+		}
+		if (k < NumPoly)
+			continue;
+
+		RasterizeTriangle(Screen[0], Screen[1], Screen[2]);
+		if (NumPoly == 4)
+			RasterizeTriangle(Screen[0], Screen[2], Screen[3]);
+		++mNumOccluderTris;
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const Float *pV0, const Float *pV1, const Float *pV2)
+{
+	Float Area, Depth, A[3], B[3], C[3], E[3];
+	Float MinX, MaxX, MinY, MaxY;
+	int x, y, x0, x1, y0, y1, k;
+	const Float *pV[3];
+	unsigned int Stride = mpLevelStrides[0];
+	float *pRow;
+
+	// the triangle's farthest depth stands for it everywhere it covers
+	Depth = pV0[2];
+	if (pV1[2] > Depth) Depth = pV1[2];
+	if (pV2[2] > Depth) Depth = pV2[2];
+	if (Depth >= 1.0f)
+		return;
+
+	Area = (pV1[0] - pV0[0]) * (pV2[1] - pV0[1]) - (pV2[0] - pV0[0]) * (pV1[1] - pV0[1]);
+	if (Area == 0)
+		return;
+	pV[0] = pV0;
+	pV[1] = (Area > 0) ? pV1 : pV2;
+	pV[2] = (Area > 0) ? pV2 : pV1;
+
+	MinX = MaxX = pV0[0];
+	MinY = MaxY = pV0[1];
+	for (k = 1; k < 3; ++k)
+	{
+		if (pV[k][0] < MinX) MinX = pV[k][0];
+		if (pV[k][0] > MaxX) MaxX = pV[k][0];
+		if (pV[k][1] < MinY) MinY = pV[k][1];
+		if (pV[k][1] > MaxY) MaxY = pV[k][1];
+	}
+	// pixels whose centers lie within the triangle's bounds
+	x0 = (MinX > 0.5f) ? (int) ceil(MinX - 0.5f) : 0;
+	y0 = (MinY > 0.5f) ? (int) ceil(MinY - 0.5f) : 0;
+	x1 = (MaxX < mWidth) ? (int) floor(MaxX - 0.5f) : (int) mWidth - 1;
+	y1 = (MaxY < mHeight) ? (int) floor(MaxY - 0.5f) : (int) mHeight - 1;
+	if ((x0 > x1) || (y0 > y1))
+		return;
+
+	// edge functions, positive inside. Coverage is sampled at pixel centers, as OpenGL
+	// does; testing for full coverage instead would leave a crack along every shared edge
+	// of the occluder, and the max-depth pyramid would spread the cracks up every level.
+	// Pixels on shared edges are written by both triangles, which is harmless here.
+	for (k = 0; k < 3; ++k)
+	{
+		const Float *pA = pV[k], *pB = pV[(k + 1) % 3];
+		A[k] = pA[1] - pB[1];
+		B[k] = pB[0] - pA[0];
+		C[k] = pA[0] * pB[1] - pA[1] * pB[0];
+	}
+
+	// start rows on a four pixel boundary; the padding at the end of each row absorbs the
+	// overrun, and pixels outside the triangle's bounds always fail an edge test
+	x0 &= ~3;
+
+#ifdef VDS_OCCLUSION_SSE
+	__m128 Zero = _mm_setzero_ps(), One = _mm_set1_ps(1.0f), TriDepth = _mm_set1_ps(Depth);
+	__m128 Steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	__m128 A4[3], E4[3];
+	for (k = 0; k < 3; ++k)
+		A4[k] = _mm_set1_ps(4.0f * A[k]);
+#endif
+
+	for (y = y0; y <= y1; ++y)
+	{
+		pRow = mpLevels[0] + y * Stride;
+		for (k = 0; k < 3; ++k)
+			E[k] = A[k] * (x0 + 0.5f) + B[k] * (y + 0.5f) + C[k];
+#ifdef VDS_OCCLUSION_SSE
+		for (k = 0; k < 3; ++k)
+			E4[k] = _mm_add_ps(_mm_set1_ps(E[k]), _mm_mul_ps(_mm_set1_ps(A[k]), Steps));
+		for (x = x0; x <= x1; x += 4)
+		{
+			__m128 Inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(E4[0], Zero), _mm_cmpge_ps(E4[1], Zero)),
+				_mm_cmpge_ps(E4[2], Zero));
+			if (_mm_movemask_ps(Inside))
+			{
+				__m128 New = _mm_or_ps(_mm_and_ps(Inside, TriDepth), _mm_andnot_ps(Inside, One));
+				_mm_storeu_ps(pRow + x, _mm_min_ps(_mm_loadu_ps(pRow + x), New));
+			}
+			for (k = 0; k < 3; ++k)
+				E4[k] = _mm_add_ps(E4[k], A4[k]);
+		}
+#else
+		for (x = x0; x <= x1; ++x)
+		{
+			if ((E[0] >= 0) && (E[1] >= 0) && (E[2] >= 0) && (Depth < pRow[x]))
+				pRow[x] = Depth;
+			E[0] += A[0];
+			E[1] += A[1];
+			E[2] += A[2];
+		}
+#endif
+	}
+}
+
+void OcclusionBuffer::RasterizeCut(Cut *pCut)
+{
+	Renderer *pRenderer = pCut->mpRenderer;
+	PatchIndex iPatch;
+
+	if ((pRenderer == NULL) || (pRenderer->mpVertexRenderData == NULL))
+		return;
+	for (iPatch = 0; iPatch < pRenderer->mNumPatches; ++iPatch)
+	{
+		PatchRenderTris &rPatch = pRenderer->mpPatchTriData[iPatch];
+		if (rPatch.NumTris == 0)
+			continue;
+		// removed tris have all three proxies set to 0, so they're skipped as degenerate
+		RasterizeTriangles(pCut->mTransformMatrix, &pRenderer->mpVertexRenderData[0].Position,
+			sizeof(VertexRenderDatum), rPatch.TriProxiesArray[0].proxies, rPatch.LastActiveTri + 1);
+	}
+}
+
+void OcclusionBuffer::BuildPyramid()
+{
+	unsigned int iLevel, x, y, xa, xb, ya, yb;
+	float *pDst, *pSrc, Depth;
+
+	for (iLevel = 1; iLevel < mNumLevels; ++iLevel)
+	{
+		unsigned int SrcW = mpLevelWidths[iLevel-1], SrcH = mpLevelHeights[iLevel-1];
+		unsigned int SrcStride = mpLevelStrides[iLevel-1], DstStride = mpLevelStrides[iLevel];
+		pSrc = mpLevels[iLevel-1];
+		pDst = mpLevels[iLevel];
+		for (y = 0; y < mpLevelHeights[iLevel]; ++y)
+		{
+			ya = 2 * y;
+			yb = (ya + 1 < SrcH) ? ya + 1 : ya;
+			for (x = 0; x < mpLevelWidths[iLevel]; ++x)
+			{
+				xa = 2 * x;
+				xb = (xa + 1 < SrcW) ? xa + 1 : xa;
+				Depth = pSrc[ya * SrcStride + xa];
+				if (pSrc[ya * SrcStride + xb] > Depth) Depth = pSrc[ya * SrcStride + xb];
+				if (pSrc[yb * SrcStride + xa] > Depth) Depth = pSrc[yb * SrcStride + xa];
+				if (pSrc[yb * SrcStride + xb] > Depth) Depth = pSrc[yb * SrcStride + xb];
+				pDst[y * DstStride + x] = Depth;
+			}
+		}
+	}
+	mPyramidIsValid = (mNumLevels > 0);
+}
+
+bool OcclusionBuffer::BoxOccluded(const Mat4 &rObjectToClip, const Point3 &rCenter, Float XOffset, Float YOffset, Float ZOffset) const
+{
+	const Float (*m)[4] = rObjectToClip.cells;
+	Float Center[4], Axes[3][4], Corner[4];
+	Float MinX, MaxX, MinY, MaxY, MinZ, x, y, z;
+	int i, Corners, x0, x1, y0, y1;
+	unsigned int iLevel;
+
+	if (!mPyramidIsValid)
+		return false;
+
+	// the corners are the center's clip coordinates plus or minus those of the half-axes
+	for (i = 0; i < 4; ++i)
+	{
+		Center[i] = m[i][0] * rCenter.X + m[i][1] * rCenter.Y + m[i][2] * rCenter.Z + m[i][3];
+		Axes[0][i] = m[i][0] * XOffset;
+		Axes[1][i] = m[i][1] * YOffset;
+		Axes[2][i] = m[i][2] * ZOffset;
+	}
+	MinX = MinY = MinZ = 3.402823466e+38F;
+	MaxX = MaxY = -3.402823466e+38F;
+	for (Corners = 0; Corners < 8; ++Corners)
+	{
+		for (i = 0; i < 4; ++i)
+		{
+			Corner[i] = Center[i] + ((Corners & 1) ? Axes[0][i] : -Axes[0][i]) +
+				((Corners & 2) ? Axes[1][i] : -Axes[1][i]) + ((Corners & 4) ? Axes[2][i] : -Axes[2][i]);
+		}
+		// boxes reaching in front of the near plane can't be behind anything
+		if ((Corner[3] < OCCLUSION_MIN_W) || (Corner[2] < -Corner[3]))
+			return false;
+		x = Corner[0] / Corner[3];
+		y = Corner[1] / Corner[3];
+		z = Corner[2] / Corner[3];
+		if (x < MinX) MinX = x;
+		if (x > MaxX) MaxX = x;
+		if (y < MinY) MinY = y;
+		if (y > MaxY) MaxY = y;
+		if (z < MinZ) MinZ = z;
+	}
+	if ((MaxX < -1) || (MinX > 1) || (MaxY < -1) || (MinY > 1))
+		return false;
+
+	// the texels the box's screen rectangle touches, moved up the pyramid until there are
+	// no more than eight of them in each direction; coarser levels are cheaper to test but
+	// smear the depth of the occluders' outlines over more of the screen
+	MinX = (MinX * 0.5f + 0.5f) * mWidth;
+	MaxX = (MaxX * 0.5f + 0.5f) * mWidth;
+	MinY = (MinY * 0.5f + 0.5f) * mHeight;
+	MaxY = (MaxY * 0.5f + 0.5f) * mHeight;
+	x0 = (MinX > 0) ? (int) MinX : 0;
+	y0 = (MinY > 0) ? (int) MinY : 0;
+	x1 = (MaxX < mWidth) ? (int) MaxX : (int) mWidth - 1;
+	y1 = (MaxY < mHeight) ? (int) MaxY : (int) mHeight - 1;
+	for (iLevel = 0; (iLevel + 1 < mNumLevels) && ((x1 - x0 > 7) || (y1 - y0 > 7)); ++iLevel)
+	{
+		x0 >>= 1; x1 >>= 1;
+		y0 >>= 1; y1 >>= 1;
+	}
+
+	z = MinZ * 0.5f + 0.5f;
+	const float *pLevel = mpLevels[iLevel];
+	unsigned int Stride = mpLevelStrides[iLevel];
+	for (int ty = y0; ty <= y1; ++ty)
+	{
+		for (int tx = x0; tx <= x1; ++tx)
+		{
+			if (z <= pLevel[ty * Stride + tx])
+				return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "vds.h"
+
+// default resolution of an OcclusionBuffer, in each of x and y
+#define VDS_DEFAULT_OCCLUSION_RESOLUTION 128
+
+// the four-wide rasterization loop uses SSE where the compiler targets it
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define VDS_OCCLUSION_SSE
+#endif
+
+// A coarse software depth buffer covering the clip volume, for occlusion culling on the
+// CPU.  Occluder triangles are rasterized into it each frame, sampled at pixel centers;
+// each writes its farthest depth to the pixels it covers, so within an occluder's outline
+// the buffer never claims more is hidden than really is.  BuildPyramid() then makes a max-depth pyramid
+// over the buffer, which lets BoxOccluded() test a box against a few texels of the level
+// matching its size on screen rather than every pixel it covers.
+//
+// Depths are clip space z/w mapped to [0,1]; the buffer is shared by cuts with different
+// object-to-clip matrices as long as they have the same view and projection.
+class VDS::OcclusionBuffer
+{
+public:
+	OcclusionBuffer();
+	~OcclusionBuffer();
+
+	void SetResolution(unsigned int Width, unsigned int Height);
+	unsigned int GetWidth() const { return mWidth; }
+	unsigned int GetHeight() const { return mHeight; }
+
+	// empties the buffer; call before rasterizing each frame's occluders
+	void Clear();
+
+	// rasterizes NumTris triangles given as index triples into an array of positions
+	// VertexStride bytes apart, transforming them by rObjectToClip
+	void RasterizeTriangles(const Mat4 &rObjectToClip, const Point3 *pVertices, unsigned int VertexStride,
+		const ProxyIndex *pIndices, unsigned int NumTris);
+
+	// rasterizes the triangles of pCut's current cut using its transformation matrix
+	void RasterizeCut(Cut *pCut);
+
+	// builds the depth pyramid; call after rasterizing and before testing boxes
+	void BuildPyramid();
+
+	// returns true if the box with the given center and half-extents is entirely behind
+	// the occluders; boxes crossing the near plane or off screen are never occluded
+	bool BoxOccluded(const Mat4 &rObjectToClip, const Point3 &rCenter, Float XOffset, Float YOffset, Float ZOffset) const;
+
+public:
+	unsigned int mNumOccluderTris; // triangles rasterized since the last Clear()
+
+protected:
+	void RasterizeTriangle(const Float *pV0, const Float *pV1, const Float *pV2);
+
+	unsigned int mWidth;
+	unsigned int mHeight;
+	// pyramid level 0 is the buffer itself; each level above holds the farthest depth of
+	// the 2x2 texels below it.  Rows are padded to a multiple of four floats
+	unsigned int mNumLevels;
+	unsigned int *mpLevelWidths;
+	unsigned int *mpLevelHeights;
+	unsigned int *mpLevelStrides;
+	float **mpLevels;
+	bool mPyramidIsValid;
+};
+
+#endif // #ifndef OCCLUSION_H
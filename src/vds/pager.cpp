@@ -0,0 +1,597 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+#ifdef _WIN32
+#pragma warning(disable: 4530)
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+#include "pager.h"
+#include "forest.h"
+#include "node.h"
+#include "tri.h"
+
+using namespace std;
+using namespace VDS;
+
+// pages are touched at this stride when being faulted in
+#define PAGER_TOUCH_STRIDE 4096
+
+static unsigned int GetSystemPageSize()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	long size = sysconf(_SC_PAGESIZE);
+	return (size > 0) ? (unsigned int) size : PAGER_TOUCH_STRIDE;
+#endif
+}
+
+ForestPager::ForestPager(Forest *pForest, VDSFileOffset MemoryBudget, unsigned int PageSize)
+{
+	unsigned int i;
+	unsigned int SystemPageSize = GetSystemPageSize();
+
+	if (PageSize < SystemPageSize)
+		PageSize = SystemPageSize;
+	mPageSize = ((PageSize + SystemPageSize - 1) / SystemPageSize) * SystemPageSize;
+
+	mpForest = pForest;
+	mpBase = (char *) pForest->mMMapFile;
+	mMappedSize = pForest->mMMapSize;
+	mNumPages = (unsigned int) ((mMappedSize + mPageSize - 1) / mPageSize);
+	mMemoryBudget = MemoryBudget;
+
+	mpPageStates = new unsigned char[mNumPages];
+	mpPrevPage = new unsigned int[mNumPages];
+	mpNextPage = new unsigned int[mNumPages];
+	for (i = 0; i < mNumPages; ++i)
+	{
+		mpPageStates[i] = PAGE_ABSENT;
+		mpPrevPage[i] = mpNextPage[i] = mNumPages;
+	}
+	miLRUHead = miLRUTail = mNumPages;
+	mNumResidentPages = 0;
+
+	mNumLoading = 0;
+	mShutdown = false;
+	mLoaderThread = StartThread(LoaderThreadFunc, this);
+	if (mLoaderThread == NULL)
+		cerr << "ForestPager couldn't start its loader thread; pages will be faulted in on demand" << endl;
+
+	// every cut reads the coarse levels of a forest laid out by ReorderForPaging, so 
+	// they are asked for up front
+	if ((mLoaderThread != NULL) && (pForest->mNumCoarseNodes > 0))
+	{
+		mLock.Lock();
+		RangeIsReady(pForest->mpNodes, (VDSFileOffset) (pForest->mNumCoarseNodes + 1) * sizeof(Node));
+		mLock.Unlock();
+	}
+}
+
+ForestPager::~ForestPager()
+{
+	mLock.Lock();
+	mShutdown = true;
+	mRequestSignal.Broadcast();
+	mLock.Unlock();
+	JoinThread(mLoaderThread);
+
+	delete[] mpPageStates;
+	delete[] mpPrevPage;
+	delete[] mpNextPage;
+}
+
+bool ForestPager::NodeIsReady(NodeIndex iNode)
+{
+	Node *pNodes = mpForest->mpNodes;
+	Tri *pTris = mpForest->mpTris;
+	NodeIndex iChild;
+	TriIndex iSubTri;
+	bool ready;
+
+	if (mLoaderThread == NULL)
+		return true;
+
+	mLock.Lock();
+	if (!RangeIsReady(&pNodes[iNode], sizeof(Node)))
+	{
+		mLock.Unlock();
+		return false;
+	}
+	ready = true;
+
+	// children and everything unfold reads from them
+	for (iChild = pNodes[iNode].miFirstChild; iChild != Forest::iNIL_NODE; iChild = pNodes[iChild].miRightSibling)
+	{
+		if (!RangeIsReady(&pNodes[iChild], sizeof(Node)))
+		{
+			ready = false;
+			break;
+		}
+		if (!RangeIsReady(mpForest->GetNodeRenderData(iChild), sizeof(VertexRenderDatum)))
+			ready = false;
+		if ((mpForest->mpErrorParams != NULL) && (mpForest->mErrorParamSize > 0) &&
+			!RangeIsReady(&mpForest->mpErrorParams[pNodes[iChild].miErrorParamIndex], mpForest->mErrorParamSize * sizeof(float)))
+			ready = false;
+	}
+
+	// tris introduced by the unfold
+	for (iSubTri = pNodes[iNode].miFirstSubTri; iSubTri != Forest::iNIL_TRI; iSubTri = pTris[iSubTri].miNextSubTri)
+	{
+		if (!RangeIsReady(&pTris[iSubTri], sizeof(Tri)))
+		{
+			ready = false;
+			break;
+		}
+	}
+	mLock.Unlock();
+	return ready;
+}
+
+bool ForestPager::RangeIsReady(const void *pStart, VDSFileOffset Size)
+{
+	VDSFileOffset Offset = (VDSFileOffset) ((const char *) pStart - mpBase);
+	unsigned int iPage, iLastPage;
+	bool ready = true;
+
+	if ((Offset >= mMappedSize) || (Size == 0))
+		return true;
+	iPage = (unsigned int) (Offset / mPageSize);
+	iLastPage = (unsigned int) ((Offset + Size - 1) / mPageSize);
+	if (iLastPage >= mNumPages)
+		iLastPage = mNumPages - 1;
+
+	for (; iPage <= iLastPage; ++iPage)
+	{
+		switch (mpPageStates[iPage])
+		{
+		case PAGE_RESIDENT:
+			if (miLRUHead != iPage)
+			{
+				Unlink(iPage);
+				LinkAtHead(iPage);
+			}
+			break;
+		case PAGE_ABSENT:
+			mpPageStates[iPage] = PAGE_REQUESTED;
+			mRequests.push_back(iPage);
+			mRequestSignal.Broadcast();
+			ready = false;
+			break;
+		default:
+			ready = false;
+			break;
+		}
+	}
+	return ready;
+}
+
+void ForestPager::LinkAtHead(unsigned int iPage)
+{
+	mpPrevPage[iPage] = mNumPages;
+	mpNextPage[iPage] = miLRUHead;
+	if (miLRUHead != mNumPages)
+		mpPrevPage[miLRUHead] = iPage;
+	else
+		miLRUTail = iPage;
+	miLRUHead = iPage;
+}
+
+void ForestPager::Unlink(unsigned int iPage)
+{
+	if (mpPrevPage[iPage] != mNumPages)
+		mpNextPage[mpPrevPage[iPage]] = mpNextPage[iPage];
+	else
+		miLRUHead = mpNextPage[iPage];
+	if (mpNextPage[iPage] != mNumPages)
+		mpPrevPage[mpNextPage[iPage]] = mpPrevPage[iPage];
+	else
+		miLRUTail = mpPrevPage[iPage];
+	mpPrevPage[iPage] = mpNextPage[iPage] = mNumPages;
+}
+
+void ForestPager::EvictPages(unsigned int iKeepPage)
+{
+	unsigned int iPage;
+
+	while (((VDSFileOffset) mNumResidentPages * mPageSize > mMemoryBudget) && (miLRUTail != mNumPages) && (miLRUTail != iKeepPage))
+	{
+		iPage = miLRUTail;
+		Unlink(iPage);
+		mpPageStates[iPage] = PAGE_ABSENT;
+		--mNumResidentPages;
+
+		// nothing writes to the forest at runtime, so the page is clean and can simply
+		// be dropped; it is read back from the file if touched again
+		char *pPage = mpBase + (VDSFileOffset) iPage * mPageSize;
+		size_t Length = (size_t) ((iPage == mNumPages - 1) ? (mMappedSize - (VDSFileOffset) iPage * mPageSize) : mPageSize);
+#ifdef _WIN32
+		VirtualUnlock(pPage, Length);
+#else
+		madvise(pPage, Length, MADV_DONTNEED);
+#endif
+	}
+}
+
+void ForestPager::SetMemoryBudget(VDSFileOffset MemoryBudget)
+{
+	mLock.Lock();
+	mMemoryBudget = MemoryBudget;
+	EvictPages(miLRUHead);
+	mLock.Unlock();
+}
+
+VDSFileOffset ForestPager::GetResidentBytes()
+{
+	VDSFileOffset Bytes;
+	mLock.Lock();
+	Bytes = (VDSFileOffset) mNumResidentPages * mPageSize;
+	mLock.Unlock();
+	return Bytes;
+}
+
+unsigned int ForestPager::GetNumPendingPages()
+{
+	unsigned int NumPending;
+	mLock.Lock();
+	NumPending = (unsigned int) mRequests.size() + mNumLoading;
+	mLock.Unlock();
+	return NumPending;
+}
+
+void ForestPager::WaitForPendingPages()
+{
+	mLock.Lock();
+	while (!mShutdown && (mLoaderThread != NULL) && (!mRequests.empty() || (mNumLoading != 0)))
+		mIdleSignal.Wait(mLock);
+	mLock.Unlock();
+}
+
+void ForestPager::LoaderThreadFunc(void *pParams)
+{
+	((ForestPager *) pParams)->LoadPages();
+}
+
+void ForestPager::LoadPages()
+{
+	unsigned int iPage;
+	VDSFileOffset Start, End, Offset;
+	volatile char Sink = 0;
+
+	mLock.Lock();
+	while (!mShutdown)
+	{
+		if (mRequests.empty())
+		{
+			mIdleSignal.Broadcast();
+			mRequestSignal.Wait(mLock);
+			continue;
+		}
+		iPage = mRequests.front();
+		mRequests.pop_front();
+		++mNumLoading;
+		mLock.Unlock();
+
+		// fault the page in without holding the lock
+		Start = (VDSFileOffset) iPage * mPageSize;
+		End = Start + mPageSize;
+		if (End > mMappedSize)
+			End = mMappedSize;
+		for (Offset = Start; Offset < End; Offset += PAGER_TOUCH_STRIDE)
+			Sink += *(volatile char *) (mpBase + Offset);
+
+		mLock.Lock();
+		--mNumLoading;
+		mpPageStates[iPage] = PAGE_RESIDENT;
+		LinkAtHead(iPage);
+		++mNumResidentPages;
+		EvictPages(iPage);
+	}
+	mIdleSignal.Broadcast();
+	mLock.Unlock();
+}
+
+bool Forest::EnablePaging(VDSFileOffset MemoryBudget, unsigned int PageSize)
+{
+	if (!mIsMMapped)
+	{
+		cerr << "Paging requires a memory mapped forest" << endl;
+		return false;
+	}
+	if (mpPager != NULL)
+	{
+		mpPager->SetMemoryBudget(MemoryBudget);
+		return true;
+	}
+	mpPager = new ForestPager(this, MemoryBudget, PageSize);
+	return true;
+}
+
+void Forest::DisablePaging()
+{
+	delete mpPager;
+	mpPager = NULL;
+}
+
+// Lists the nodes in paging order: whole levels breadth first for as long as they fit
+// in MaxCoarseNodes nodes, then the subtree under each node of the first level left out,
+// depth first.  Returns the number of coarse nodes.
+static NodeIndex GetPagingOrder(const Node *pNodes, NodeIndex NumNodes, NodeIndex MaxCoarseNodes, vector<NodeIndex> &rOrder)
+{
+	vector<NodeIndex> Level, NextLevel, Stack;
+	NodeIndex iNode, iChild, NumCoarseNodes = 0;
+	size_t i, j;
+
+	rOrder.clear();
+	rOrder.push_back(Forest::iNIL_NODE);
+	for (iNode = Forest::iROOT_NODE; (iNode != Forest::iNIL_NODE) && (Level.size() <= NumNodes); iNode = pNodes[iNode].miRightSibling)
+		Level.push_back(iNode);
+
+	while (!Level.empty() && (NumCoarseNodes + Level.size() <= MaxCoarseNodes))
+	{
+		NextLevel.clear();
+		for (i = 0; i < Level.size(); ++i)
+		{
+			rOrder.push_back(Level[i]);
+			for (iChild = pNodes[Level[i]].miFirstChild; (iChild != Forest::iNIL_NODE) && (NextLevel.size() <= NumNodes); iChild = pNodes[iChild].miRightSibling)
+				NextLevel.push_back(iChild);
+		}
+		NumCoarseNodes += (NodeIndex) Level.size();
+		Level.swap(NextLevel);
+	}
+
+	for (i = Level.size(); i > 0; --i)
+		Stack.push_back(Level[i - 1]);
+	while (!Stack.empty() && (rOrder.size() <= NumNodes))
+	{
+		iNode = Stack.back();
+		Stack.pop_back();
+		rOrder.push_back(iNode);
+		j = Stack.size();
+		for (iChild = pNodes[iNode].miFirstChild; (iChild != Forest::iNIL_NODE) && (Stack.size() - j <= NumNodes); iChild = pNodes[iChild].miRightSibling)
+			Stack.push_back(iChild);
+		reverse(Stack.begin() + j, Stack.end());
+	}
+	return NumCoarseNodes;
+}
+
+bool Forest::ReorderForPaging(NodeIndex MaxCoarseNodes)
+{
+	vector<NodeIndex> Order;
+	NodeIndex iNode, NumCoarseNodes;
+	TriIndex iTri, iNewTri;
+	NodeIndex i, iNewDatum;
+	unsigned int iNewParam;
+	int k;
+
+	if (!mIsValid || (mpPager != NULL) || (mpNodeLoaded != NULL))
+		return false;
+
+	// nodes: the coarse levels first, so a coarse cut reads a compact run of pages at the
+	// start of each array, and then each subtree below them in one piece, depth first, 
+	// which is what Tri::MoveProxyDown() relies on there
+	if (MaxCoarseNodes == 0)
+		MaxCoarseNodes = mNumNodes / 16;
+	NumCoarseNodes = GetPagingOrder(mpNodes, mNumNodes, MaxCoarseNodes, Order);
+	if (Order.size() != (size_t) mNumNodes + 1)
+	{
+		cerr << "ReorderForPaging: not every node is reached from the roots" << endl;
+		return false;
+	}
+	NodeIndex *pNewNodeIndex = new NodeIndex[mNumNodes + 1];
+	for (i = 0; i <= mNumNodes; ++i)
+		pNewNodeIndex[Order[i]] = i;
+	Node *pNewNodes = new Node[mNumNodes + 1];
+	memcpy(&pNewNodes[iNIL_NODE], &mpNodes[iNIL_NODE], sizeof(Node));
+	for (i = iROOT_NODE; i <= mNumNodes; ++i)
+	{
+		memcpy(&pNewNodes[i], &mpNodes[Order[i]], sizeof(Node));
+		pNewNodes[i].miParent = pNewNodeIndex[pNewNodes[i].miParent];
+		pNewNodes[i].miLeftSibling = pNewNodeIndex[pNewNodes[i].miLeftSibling];
+		pNewNodes[i].miRightSibling = pNewNodeIndex[pNewNodes[i].miRightSibling];
+		pNewNodes[i].miFirstChild = pNewNodeIndex[pNewNodes[i].miFirstChild];
+		pNewNodes[i].mCoincidentVertex = pNewNodeIndex[pNewNodes[i].mCoincidentVertex];
+	}
+	memcpy(mpNodes, pNewNodes, sizeof(Node) * (mNumNodes + 1));
+	for (iTri = 1; iTri <= mNumTris; ++iTri)
+	{
+		for (k = 0; k < 3; ++k)
+			mpTris[iTri].miCorners[k] = pNewNodeIndex[mpTris[iTri].miCorners[k]];
+	}
+	delete[] pNewNodes;
+	delete[] pNewNodeIndex;
+	mNumCoarseNodes = NumCoarseNodes;
+	delete[] mpCoarseSubtreeStarts;
+	mpCoarseSubtreeStarts = NULL;
+	if ((mNumCoarseNodes > 0) && !ComputeCoarseSubtreeStarts())
+		return false;
+
+	// everything else is laid out in the order the nodes first use it
+
+	// tris, in subtri list order
+	TriIndex *pNewTriIndex = new TriIndex[mNumTris + 1];
+	TriIndex *pOldTriIndex = new TriIndex[mNumTris + 1];
+	for (iTri = 0; iTri <= mNumTris; ++iTri)
+		pNewTriIndex[iTri] = iNIL_TRI;
+	iNewTri = 1;
+	for (iNode = iROOT_NODE; iNode <= mNumNodes; ++iNode)
+	{
+		for (iTri = mpNodes[iNode].miFirstSubTri; iTri != iNIL_TRI; iTri = mpTris[iTri].miNextSubTri)
+		{
+			pOldTriIndex[iNewTri] = iTri;
+			pNewTriIndex[iTri] = iNewTri++;
+		}
+	}
+	for (iTri = 1; iTri <= mNumTris; ++iTri)
+	{
+		if (pNewTriIndex[iTri] == iNIL_TRI)
+		{
+			pOldTriIndex[iNewTri] = iTri;
+			pNewTriIndex[iTri] = iNewTri++;
+		}
+	}
+	Tri *pNewTris = new Tri[mNumTris + 1];
+	memcpy(&pNewTris[0], &mpTris[0], sizeof(Tri));
+	for (iTri = 1; iTri <= mNumTris; ++iTri)
+	{
+		memcpy(&pNewTris[iTri], &mpTris[pOldTriIndex[iTri]], sizeof(Tri));
+		pNewTris[iTri].miNextSubTri = pNewTriIndex[pNewTris[iTri].miNextSubTri];
+	}
+	memcpy(mpTris, pNewTris, sizeof(Tri) * (mNumTris + 1));
+	for (iNode = 0; iNode <= mNumNodes; ++iNode)
+		mpNodes[iNode].miFirstSubTri = pNewTriIndex[mpNodes[iNode].miFirstSubTri];
+	delete[] pNewTris;
+	delete[] pOldTriIndex;
+	delete[] pNewTriIndex;
+
+	// node render data (which coincident nodes may share)
+	NodeIndex *pNewDatumIndex = new NodeIndex[mNumNodePositions];
+	for (i = 0; i < mNumNodePositions; ++i)
+		pNewDatumIndex[i] = mNumNodePositions;
+	iNewDatum = 0;
+	for (iNode = iROOT_NODE; iNode <= mNumNodes; ++iNode)
+	{
+		i = mpNodes[iNode].miRenderData;
+		if ((i < mNumNodePositions) && (pNewDatumIndex[i] == mNumNodePositions))
+			pNewDatumIndex[i] = iNewDatum++;
+	}
+	for (i = 0; i < mNumNodePositions; ++i)
+	{
+		if (pNewDatumIndex[i] == mNumNodePositions)
+			pNewDatumIndex[i] = iNewDatum++;
+	}
+	VertexRenderDatum *pNewRenderData = new VertexRenderDatum[mNumNodePositions];
+	for (i = 0; i < mNumNodePositions; ++i)
+		memcpy(&pNewRenderData[pNewDatumIndex[i]], &mpNodeRenderData[i], sizeof(VertexRenderDatum));
+	memcpy(mpNodeRenderData, pNewRenderData, sizeof(VertexRenderDatum) * mNumNodePositions);
+	for (iNode = 0; iNode <= mNumNodes; ++iNode)
+	{
+		if (mpNodes[iNode].miRenderData < mNumNodePositions)
+			mpNodes[iNode].miRenderData = pNewDatumIndex[mpNodes[iNode].miRenderData];
+	}
+	delete[] pNewRenderData;
+	delete[] pNewDatumIndex;
+
+	// error params; only single float params can be moved independently
+	if ((mpErrorParams != NULL) && (mErrorParamSize == 1))
+	{
+		unsigned int *pNewParamIndex = new unsigned int[mNumErrorParams];
+		for (i = 0; i < mNumErrorParams; ++i)
+			pNewParamIndex[i] = mNumErrorParams;
+		iNewParam = 0;
+		for (iNode = iROOT_NODE; iNode <= mNumNodes; ++iNode)
+		{
+			i = mpNodes[iNode].miErrorParamIndex;
+			if ((i < mNumErrorParams) && (pNewParamIndex[i] == mNumErrorParams))
+				pNewParamIndex[i] = iNewParam++;
+		}
+		for (i = 0; i < mNumErrorParams; ++i)
+		{
+			if (pNewParamIndex[i] == mNumErrorParams)
+				pNewParamIndex[i] = iNewParam++;
+		}
+		float *pNewErrorParams = new float[mNumErrorParams];
+		for (i = 0; i < mNumErrorParams; ++i)
+			pNewErrorParams[pNewParamIndex[i]] = mpErrorParams[i];
+		memcpy(mpErrorParams, pNewErrorParams, sizeof(float) * mNumErrorParams);
+		for (iNode = 0; iNode <= mNumNodes; ++iNode)
+		{
+			if (mpNodes[iNode].miErrorParamIndex < mNumErrorParams)
+				mpNodes[iNode].miErrorParamIndex = pNewParamIndex[mpNodes[iNode].miErrorParamIndex];
+		}
+		delete[] pNewErrorParams;
+		delete[] pNewParamIndex;
+	}
+	return true;
+}
+
+bool Forest::CheckPagingLayout() const
+{
+	vector<NodeIndex> Order;
+	NodeIndex i;
+
+	if (GetPagingOrder(mpNodes, mNumNodes, mNumCoarseNodes, Order) != mNumCoarseNodes)
+		return false;
+	if (Order.size() != (size_t) mNumNodes + 1)
+		return false;
+	for (i = 0; i <= mNumNodes; ++i)
+	{
+		if (Order[i] != i)
+			return false;
+	}
+	for (i = 1; i <= mNumCoarseNodes; ++i)
+	{
+		if ((mpCoarseSubtreeStarts == NULL) || (mpCoarseSubtreeStarts[i] <= mNumCoarseNodes) || (mpCoarseSubtreeStarts[i] > mNumNodes + 1))
+			return false;
+	}
+	return true;
+}
+
+bool Forest::ComputeCoarseSubtreeStarts()
+{
+	vector<NodeIndex> Stack, Pending;
+	NodeIndex iNode, iChild, NumVisited = 0;
+	size_t i, j;
+
+	delete[] mpCoarseSubtreeStarts;
+	mpCoarseSubtreeStarts = new NodeIndex[mNumCoarseNodes + 1];
+	mpCoarseSubtreeStarts[iNIL_NODE] = iNIL_NODE;
+
+	// walk the coarse nodes left to right, depth first.  the depth first subtrees hanging
+	// off them are met in the order they're numbered, so a coarse node's start is the
+	// first of them met at or after it
+	for (iNode = iROOT_NODE; iNode != iNIL_NODE; iNode = mpNodes[iNode].miRightSibling)
+	{
+		if ((iNode > mNumNodes) || (Stack.size() > mNumNodes))
+			return false;
+		Stack.push_back(iNode);
+	}
+	reverse(Stack.begin(), Stack.end());
+	while (!Stack.empty())
+	{
+		iNode = Stack.back();
+		Stack.pop_back();
+		if (iNode > mNumCoarseNodes)
+		{
+			for (i = 0; i < Pending.size(); ++i)
+				mpCoarseSubtreeStarts[Pending[i]] = iNode;
+			Pending.clear();
+			continue;
+		}
+		if (++NumVisited > mNumCoarseNodes)
+			return false;
+		Pending.push_back(iNode);
+		j = Stack.size();
+		for (iChild = mpNodes[iNode].miFirstChild; iChild != iNIL_NODE; iChild = mpNodes[iChild].miRightSibling)
+		{
+			if ((iChild > mNumNodes) || (Stack.size() - j > mNumNodes))
+				return false;
+			Stack.push_back(iChild);
+		}
+		reverse(Stack.begin() + j, Stack.end());
+	}
+	for (i = 0; i < Pending.size(); ++i)
+		mpCoarseSubtreeStarts[Pending[i]] = mNumNodes + 1;
+	return (NumVisited == mNumCoarseNodes);
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+#ifndef PAGER_H
+#define PAGER_H
+
+#include <deque>
+#include "vds.h"
+#include "threads.h"
+
+// default size of the pages a ForestPager tracks; rounded up to a multiple of the OS page size
+#define VDS_DEFAULT_PAGE_SIZE (64*1024)
+
+// Keeps a bounded working set of a memory mapped Forest resident.  The mapped file is
+// divided into fixed size pages; the simplifier asks NodeIsReady() before unfolding a
+// node, and pages it would touch that aren't resident are queued for a background
+// thread to fault in.  Once more than the memory budget is resident, the least recently
+// used pages are dropped from memory (they're clean, so they're re-read from the file
+// if needed again).  Touching a page that has been dropped is still safe - it just
+// faults synchronously.
+class VDS::ForestPager
+{
+public:
+	ForestPager(Forest *pForest, VDSFileOffset MemoryBudget, unsigned int PageSize);
+	~ForestPager();
+
+	// returns true if everything needed to unfold iNode is resident; otherwise requests
+	// the missing pages and returns false
+	bool NodeIsReady(NodeIndex iNode);
+
+	void SetMemoryBudget(VDSFileOffset MemoryBudget);
+	VDSFileOffset GetMemoryBudget() const { return mMemoryBudget; }
+	unsigned int GetPageSize() const { return mPageSize; }
+
+	VDSFileOffset GetResidentBytes();
+	unsigned int GetNumPendingPages();
+
+	// blocks until all requested pages have been loaded
+	void WaitForPendingPages();
+
+protected:
+	// these must be called with mLock held
+	bool RangeIsReady(const void *pStart, VDSFileOffset Size);
+	void LinkAtHead(unsigned int iPage);
+	void Unlink(unsigned int iPage);
+	void EvictPages(unsigned int iKeepPage);
+
+	static void LoaderThreadFunc(void *pParams);
+	void LoadPages();
+
+	enum PageState { PAGE_ABSENT, PAGE_REQUESTED, PAGE_RESIDENT };
+
+	Forest *mpForest;
+	char *mpBase;
+	VDSFileOffset mMappedSize;
+	unsigned int mPageSize;
+	unsigned int mNumPages;
+	VDSFileOffset mMemoryBudget;
+
+	unsigned char *mpPageStates;
+	// LRU list of resident pages, most recently used first; mNumPages is the nil page
+	unsigned int *mpPrevPage;
+	unsigned int *mpNextPage;
+	unsigned int miLRUHead;
+	unsigned int miLRUTail;
+	unsigned int mNumResidentPages;
+
+	std::deque<unsigned int> mRequests;
+	unsigned int mNumLoading;
+	bool mShutdown;
+	ThreadLock mLock;
+	ThreadSignal mRequestSignal;
+	ThreadSignal mIdleSignal;
+	ThreadHandle mLoaderThread;
+};
+
+#endif // #ifndef PAGER_H
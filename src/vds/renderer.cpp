@@ -44,6 +44,7 @@ Renderer::Renderer(unsigned int NumInitialVerticesToAllocate, unsigned int NumIn
 	mpVertexUseCounts = NULL;
 	mpVertexNodeIDs = NULL;
 	mpCut = NULL;
+	mCopyTicks = 0;
 
 	mVertexDataStride = sizeof(VertexRenderDatum);
 	if ((mVertexDataStride % 4) != 0)
@@ -55,8 +56,12 @@ Renderer::Renderer(unsigned int NumInitialVerticesToAllocate, unsigned int NumIn
 	mNumPatches = 0;
 	mNumTris = 0;
 	mpPatchTriData = NULL;
+	mMaxTriCompactionMoves = 0;
+	mMaxTriReorderTris = 0;
+	mVertexCacheSize = DEFAULT_VERTEX_CACHE_SIZE;
 
 	mpMemoryManager = NULL;
+	miMemoryBlock = 0;
 	mSlackBytes = 0;
 	mNumVerticesAllocated = 0;
 
@@ -90,7 +95,8 @@ Renderer::Renderer(unsigned int NumInitialVerticesToAllocate, unsigned int NumIn
 Renderer::~Renderer()
 {
     // detatch from memory manager...
-    mpMemoryManager->RemoveRenderer(this);
+    if (mpMemoryManager != NULL)
+        mpMemoryManager->RemoveRenderer(this);
     
     unsigned int i;
 	if (mpPatchTriData != NULL)
@@ -113,6 +119,10 @@ Renderer::~Renderer()
 
 void Renderer::RenderPatch(PatchIndex PatchID)
 {
+	if (mMaxTriCompactionMoves > 0)
+		CompactTriRenderData(PatchID, mMaxTriCompactionMoves);
+	if (mMaxTriReorderTris > 0)
+		ReorderTriRenderData(PatchID, mMaxTriReorderTris);
 	mfRender(*this, PatchID);
 }
 
@@ -121,6 +131,11 @@ void Renderer::SetRenderFunc(RenderFunc fRender)
     mfRender = fRender;
 }
 
+void Renderer::SetTriCompaction(unsigned int MaxMovesPerPatch)
+{
+	mMaxTriCompactionMoves = MaxMovesPerPatch;
+}
+
 void Renderer::FlushRenderData()
 {
 	unsigned int i, j;
@@ -130,6 +145,8 @@ void Renderer::FlushRenderData()
 		mpPatchTriData[i].TriFreeSlots.Reset();
 		mpPatchTriData[i].NumTris = 0;
 		mpPatchTriData[i].LastActiveTri = 0;
+		mpPatchTriData[i].LowestFreeTri = 0;
+		mpPatchTriData[i].ReorderCursor = 0;
 
 		for (j = 0; j < mpPatchTriData[i].NumTrisAllocated; ++j)
 		{
@@ -202,6 +219,8 @@ void Renderer::AddCut(Cut *pCut)
 		mpPatchTriData[i].NormalsPresent = pCut->mpForest->mNormalsPresent;
 		mpPatchTriData[i].NumTris = 0;
 		mpPatchTriData[i].LastActiveTri = 0;
+		mpPatchTriData[i].LowestFreeTri = 0;
+		mpPatchTriData[i].ReorderCursor = 0;
 #ifdef VERBOSE_MEM_MANAGEMENT
 	cerr << "Allocating Patch " << i << " Tri RenderData; capacity is " << TrisAllocatedPerPatch << " Tris." << endl;
 #endif
@@ -290,7 +309,7 @@ VertexRenderDatum *Renderer::AddVertexRenderDatum(NodeIndex iNode)
 		return NULL;
 	}
 
-	VertexRenderDatum *pNewVertexRenderDatum = CacheVertex(CacheLocation, &(mpCut->mpForest->mpNodes[iNode]));
+	VertexRenderDatum *pNewVertexRenderDatum = CacheVertex(CacheLocation, iNode);
 
 	mpVertexActiveFlags[CacheLocation] = true;
 	mpVertexUseCounts[CacheLocation] = 0;
@@ -306,12 +325,13 @@ VertexRenderDatum *Renderer::AddVertexRenderDatum(NodeIndex iNode)
 	return pNewVertexRenderDatum;	
 }
 
-VertexRenderDatum *Renderer::CacheVertex(NodeIndex iVertexArrayLocation, Node *pNode)
+VertexRenderDatum *Renderer::CacheVertex(NodeIndex iVertexArrayLocation, NodeIndex iNode)
 {
-	mpVertexRenderData[iVertexArrayLocation].Position = pNode->mpRenderData->Position;
-	mpVertexRenderData[iVertexArrayLocation].Color = pNode->mpRenderData->Color;
-	mpVertexRenderData[iVertexArrayLocation].Normal = pNode->mpRenderData->Normal;
-	mpVertexRenderData[iVertexArrayLocation].TexCoords = pNode->mpRenderData->TexCoords;
+	const VertexRenderDatum *pNodeRenderDatum = mpCut->mpForest->GetNodeRenderData(iNode);
+	mpVertexRenderData[iVertexArrayLocation].Position = pNodeRenderDatum->Position;
+	mpVertexRenderData[iVertexArrayLocation].Color = pNodeRenderDatum->Color;
+	mpVertexRenderData[iVertexArrayLocation].Normal = pNodeRenderDatum->Normal;
+	mpVertexRenderData[iVertexArrayLocation].TexCoords = pNodeRenderDatum->TexCoords;
 	return &mpVertexRenderData[iVertexArrayLocation];
 }
 
@@ -416,6 +436,8 @@ void Renderer::RemoveTriRenderDatum(TriIndex iTri, PatchIndex PatchID)
 
 	mpPatchTriData[PatchID].TriFreeSlots.AddFreeSlot(iTri);
 	mpPatchTriData[PatchID].NumTriSlotsFree++;
+	if (iTri < mpPatchTriData[PatchID].LowestFreeTri)
+		mpPatchTriData[PatchID].LowestFreeTri = iTri;
 	--mpPatchTriData[PatchID].NumTris;
 	--mNumTris;
 	if (iTri == mpPatchTriData[PatchID].LastActiveTri)
@@ -457,7 +479,7 @@ NodeIndex Renderer::GetVertexCacheBackRef(NodeIndex iVertexCacheIndex, Forest *p
 
 bool Renderer::ReallocateTriRenderData(PatchIndex PatchID, unsigned int newTrisAllocated)
 {
-	unsigned int i, index;
+	unsigned int i, index, numTrisKept;
 	unsigned int newTriProxiesSize = newTrisAllocated * sizeof(TriProxy);
 	unsigned int newTriProxyBackRefsSize = newTrisAllocated * sizeof(TriProxyBackRef);
 	void *newTriMemory = malloc(newTriProxiesSize + newTriProxyBackRefsSize);
@@ -471,11 +493,16 @@ bool Renderer::ReallocateTriRenderData(PatchIndex PatchID, unsigned int newTrisA
 	cerr << "Reallocating Patch " << PatchID << " Tri RenderData; capacity increased to " << newTrisAllocated << " Tris." << endl;
 #endif
 
+	// when shrinking, the caller has already compacted the live tris below newTrisAllocated
+	numTrisKept = mpPatchTriData[PatchID].NumTrisAllocated;
+	if (numTrisKept > newTrisAllocated)
+		numTrisKept = newTrisAllocated;
+
 	TriProxy *newTriProxiesArray = (TriProxy *) newTriMemory;
-	memcpy(newTriProxiesArray, mpPatchTriData[PatchID].TriProxiesArray, mpPatchTriData[PatchID].NumTrisAllocated * sizeof(TriProxy));
+	memcpy(newTriProxiesArray, mpPatchTriData[PatchID].TriProxiesArray, numTrisKept * sizeof(TriProxy));
 	void *newBackRefsStart = &newTriProxiesArray[newTrisAllocated];
 	TriProxyBackRef *newTriProxyBackRefs = (TriProxyBackRef *)newBackRefsStart;
-	memcpy(newTriProxyBackRefs, mpPatchTriData[PatchID].TriProxyBackRefs, mpPatchTriData[PatchID].NumTrisAllocated * sizeof(TriProxyBackRef));
+	memcpy(newTriProxyBackRefs, mpPatchTriData[PatchID].TriProxyBackRefs, numTrisKept * sizeof(TriProxyBackRef));
 	
 	for (i = mpPatchTriData[PatchID].NumTrisAllocated; i < newTrisAllocated; ++i)
 	{
@@ -490,7 +517,7 @@ bool Renderer::ReallocateTriRenderData(PatchIndex PatchID, unsigned int newTrisA
 	
 	for (i = 1; i <= mpCut->mpForest->mNumTris; ++i)
 	{
-		if (mpCut->mpTriRefs[i] != NULL)
+		if ((mpCut->mpTriRefs[i] != NULL) && (mpCut->mpForest->mpTris[i].mPatchID == PatchID))
 		{
 			index = mpCut->mpTriRefs[i] - mpPatchTriData[PatchID].TriProxyBackRefs;
 			if ((index >= 0) && (index < mpPatchTriData[PatchID].NumTrisAllocated))
@@ -500,13 +527,85 @@ bool Renderer::ReallocateTriRenderData(PatchIndex PatchID, unsigned int newTrisA
 		}
 	}
 
-	free(mpPatchTriData[PatchID].TriProxiesArray);
+	free(mpPatchTriData[PatchID].TriMemoryAllocated);
+	mpPatchTriData[PatchID].TriMemoryAllocated = newTriMemory;
 	mpPatchTriData[PatchID].TriProxiesArray = newTriProxiesArray;
 	mpPatchTriData[PatchID].TriProxyBackRefs = newTriProxyBackRefs;
 	mpPatchTriData[PatchID].NumTrisAllocated = newTrisAllocated;
 	return true;
 }
 
+unsigned int Renderer::GetMemoryAllocated()
+{
+	unsigned int i, Bytes;
+
+	Bytes = mNumVerticesAllocated * sizeof(VertexRenderDatum);
+	if (mpVertexActiveFlags != NULL)
+		Bytes += mNumVerticesAllocated * (2 * sizeof(bool) + sizeof(unsigned int));
+	for (i = 0; i < mNumPatches; ++i)
+	{
+		Bytes += mpPatchTriData[i].NumTrisAllocated * (sizeof(TriProxy) + sizeof(TriProxyBackRef));
+	}
+	return Bytes;
+}
+
+bool Renderer::ReserveTriRenderData(PatchIndex PatchID, unsigned int NumTris)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	unsigned int NumTrisNeeded = pPatch->NumTris + NumTris;
+	unsigned int newTrisAllocated;
+
+	// free slots and the unused tail together always number NumTrisAllocated - NumTris
+	if (NumTrisNeeded <= pPatch->NumTrisAllocated)
+		return true;
+
+	// grow the way AddTriRenderDatum() does, or by just what's needed if the budget is tight
+	newTrisAllocated = (unsigned int) (1.5 * pPatch->NumTrisAllocated);
+	if (newTrisAllocated < NumTrisNeeded)
+		newTrisAllocated = NumTrisNeeded;
+	if ((mpMemoryManager != NULL) &&
+		!mpMemoryManager->ReserveMemory(this, (newTrisAllocated - pPatch->NumTrisAllocated) * (sizeof(TriProxy) + sizeof(TriProxyBackRef))))
+	{
+		newTrisAllocated = NumTrisNeeded;
+		if (!mpMemoryManager->ReserveMemory(this, (newTrisAllocated - pPatch->NumTrisAllocated) * (sizeof(TriProxy) + sizeof(TriProxyBackRef))))
+			return false;
+	}
+	return ReallocateTriRenderData(PatchID, newTrisAllocated);
+}
+
+unsigned int Renderer::TrimTriRenderData()
+{
+	unsigned int BytesBefore = GetMemoryAllocated();
+	unsigned int newTrisAllocated;
+	PatchRenderTris *pPatch;
+	PatchIndex i;
+
+	for (i = 0; i < mNumPatches; ++i)
+	{
+		pPatch = &mpPatchTriData[i];
+		newTrisAllocated = pPatch->NumTris + pPatch->NumTris / 4;
+		if (newTrisAllocated < MIN_PATCH_TRIS_ALLOCATED)
+			newTrisAllocated = MIN_PATCH_TRIS_ALLOCATED;
+
+		// a patch that has just grown by half stays below this, so it is left alone
+		if (pPatch->NumTrisAllocated <= newTrisAllocated + newTrisAllocated / 4)
+			continue;
+
+		CompactTriRenderData(i, pPatch->NumTris);
+		if (!ReallocateTriRenderData(i, newTrisAllocated))
+			continue;
+
+		// every slot from NumTris up is now free
+		pPatch->NumTriSlotsFree = newTrisAllocated - pPatch->NumTris;
+		pPatch->LowestFreeTri = pPatch->NumTris;
+		if (pPatch->ReorderCursor >= pPatch->NumTris)
+			pPatch->ReorderCursor = 0;
+		pPatch->TriFreeSlots.Reset();
+		PopulateTriSlotsCache(i);
+	}
+	return BytesBefore - GetMemoryAllocated();
+}
+
 /*
 bool Renderer::ReallocateMemoryForRenderData(unsigned int NumNodes, unsigned int NumTris)
 {
@@ -573,6 +672,9 @@ bool Renderer::AllocateFastMemoryForVertexRenderData()
 */
 void Renderer::CopyVertexDataToFastMemory()
 {
+#ifdef TIMING_LEVEL_1
+	ScopedTimer CopyTimer(mCopyTicks);
+#endif
 	memcpy(mpFastVertexRenderData, mpSystemVertexRenderData, (mLastActiveVertex + 1) * sizeof(VertexRenderDatum));
 }
 
@@ -686,17 +788,377 @@ void Renderer::PopulateVertexSlotsCache()
 void Renderer::PopulateTriSlotsCache(VDS::PatchIndex PatchID)
 {
 	unsigned int k;
-	for (k = 0; k < mpPatchTriData[PatchID].NumTrisAllocated; ++k)
+	for (k = mpPatchTriData[PatchID].LowestFreeTri; k < mpPatchTriData[PatchID].NumTrisAllocated; ++k)
 	{
 		if (mpPatchTriData[PatchID].TriProxyBackRefs[k][0] == Forest::iNIL_NODE)
 		{
 			mpPatchTriData[PatchID].TriFreeSlots.AddFreeSlot(k);
-			if (mpPatchTriData[PatchID].TriFreeSlots.mSlotsCached >= mpPatchTriData[PatchID].NumTriSlotsFree)
+			if ((mpPatchTriData[PatchID].TriFreeSlots.mSlotsCached >= mpPatchTriData[PatchID].NumTriSlotsFree) || (mpPatchTriData[PatchID].TriFreeSlots.mSlotsCached == FREELISTSIZE))
 				return;
 		}
 	}
 }
 
+unsigned int Renderer::CompactTriRenderData(PatchIndex PatchID, unsigned int MaxMoves)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	unsigned int NumMoves = 0;
+	TriIndex i;
+
+	while (NumMoves < MaxMoves)
+	{
+		while ((pPatch->LowestFreeTri < pPatch->LastActiveTri) && 
+			(pPatch->TriProxyBackRefs[pPatch->LowestFreeTri][0] != Forest::iNIL_NODE))
+		{
+			++pPatch->LowestFreeTri;
+		}
+		if (pPatch->LowestFreeTri >= pPatch->LastActiveTri)
+			break;
+
+		MoveTriRenderDatum(PatchID, pPatch->LastActiveTri, pPatch->LowestFreeTri);
+		++pPatch->LowestFreeTri;
+		++NumMoves;
+
+		i = pPatch->LastActiveTri;
+		while ((i > 0) && (pPatch->TriProxyBackRefs[i][0] == Forest::iNIL_NODE))
+		{
+			--i;
+		}
+		pPatch->LastActiveTri = i;
+	}
+
+	// cached free slots may have been filled by the moves; the cache gets
+	// repopulated lowest-first from LowestFreeTri, which keeps new tris dense too
+	if (NumMoves > 0)
+		pPatch->TriFreeSlots.Reset();
+
+	return NumMoves;
+}
+
+// finds the forest tri whose tri render datum is in slot iSlot of the patch.  the
+// tri is on the livetri list of each of its proxies, so walk the first one's
+TriIndex Renderer::FindTriRenderDatumOwner(PatchIndex PatchID, TriIndex iSlot)
+{
+	TriProxyBackRef *pSlot = &mpPatchTriData[PatchID].TriProxyBackRefs[iSlot];
+	NodeIndex iNode = pSlot->backrefs[0];
+	Tri *pTris = mpCut->mpForest->mpTris;
+	TriIndex iTri;
+	int k;
+
+	iTri = mpCut->mpNodeRefs[iNode]->miFirstLiveTri;
+	while (mpCut->mpTriRefs[iTri] != pSlot)
+	{
+		k = pTris[iTri].GetNodeIndex(iTri, iNode, mpCut->mpForest, this);
+		iTri = mpCut->mpTriRefs[iTri]->miNextLiveTris[k];
+		assert(iTri != Forest::iNIL_TRI);
+	}
+	return iTri;
+}
+
+// moves the live tri in slot iFrom into the free slot iTo.  the livetri links
+// are stored by forest TriIndex, so only the tri's TriRef needs updating
+void Renderer::MoveTriRenderDatum(PatchIndex PatchID, TriIndex iFrom, TriIndex iTo)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	TriProxyBackRef *pFrom = &pPatch->TriProxyBackRefs[iFrom];
+	TriIndex iTri;
+
+	assert(pPatch->TriProxyBackRefs[iTo][0] == Forest::iNIL_NODE);
+
+	iTri = FindTriRenderDatumOwner(PatchID, iFrom);
+
+	pPatch->TriProxiesArray[iTo] = pPatch->TriProxiesArray[iFrom];
+	pPatch->TriProxyBackRefs[iTo] = *pFrom;
+	mpCut->mpTriRefs[iTri] = &pPatch->TriProxyBackRefs[iTo];
+
+	pFrom->backrefs[0] = Forest::iNIL_NODE;
+	pFrom->miNextLiveTris[0] = Forest::iNIL_TRI;
+	pFrom->miNextLiveTris[1] = Forest::iNIL_TRI;
+	pFrom->miNextLiveTris[2] = Forest::iNIL_TRI;
+	pPatch->TriProxiesArray[iFrom][0] = 0;
+	pPatch->TriProxiesArray[iFrom][1] = 0;
+	pPatch->TriProxiesArray[iFrom][2] = 0;
+}
+
+// exchanges the live tris in slots iA and iB
+void Renderer::SwapTriRenderDatums(PatchIndex PatchID, TriIndex iA, TriIndex iB)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	TriIndex iTriA, iTriB;
+	TriProxy TempProxy;
+	TriProxyBackRef TempBackRef;
+
+	iTriA = FindTriRenderDatumOwner(PatchID, iA);
+	iTriB = FindTriRenderDatumOwner(PatchID, iB);
+
+	TempProxy = pPatch->TriProxiesArray[iA];
+	pPatch->TriProxiesArray[iA] = pPatch->TriProxiesArray[iB];
+	pPatch->TriProxiesArray[iB] = TempProxy;
+
+	TempBackRef = pPatch->TriProxyBackRefs[iA];
+	pPatch->TriProxyBackRefs[iA] = pPatch->TriProxyBackRefs[iB];
+	pPatch->TriProxyBackRefs[iB] = TempBackRef;
+
+	mpCut->mpTriRefs[iTriA] = &pPatch->TriProxyBackRefs[iB];
+	mpCut->mpTriRefs[iTriB] = &pPatch->TriProxyBackRefs[iA];
+}
+
+// Forsyth-style vertex score: recently used vertices and vertices with few remaining
+// tris score highest
+static float VertexCacheScore(int CachePosition, unsigned int RemainingTris, unsigned int CacheSize)
+{
+	float Score = 0.0f;
+
+	if (RemainingTris == 0)
+		return -1.0f;
+	if (CachePosition >= 0)
+	{
+		if (CachePosition < 3)
+			Score = 0.75f;
+		else
+			Score = pow(1.0f - (float)(CachePosition - 3) / (float)(CacheSize - 3), 1.5f);
+	}
+	Score += 2.0f / sqrt((float)RemainingTris);
+	return Score;
+}
+
+unsigned int Renderer::ReorderTriRenderDataWindow(PatchIndex PatchID, TriIndex iStart, TriIndex &iNext)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	TriIndex Slots[TRI_REORDER_WINDOW];
+	unsigned int TriVerts[TRI_REORDER_WINDOW][3];
+	ProxyIndex Verts[3 * TRI_REORDER_WINDOW];
+	unsigned int VertRemaining[3 * TRI_REORDER_WINDOW];
+	int VertCachePos[3 * TRI_REORDER_WINDOW];
+	float VertScore[3 * TRI_REORDER_WINDOW];
+	int Cache[MAX_VERTEX_CACHE_SIZE + 3];
+	unsigned int Order[TRI_REORDER_WINDOW];
+	unsigned int At[TRI_REORDER_WINDOW];
+	unsigned int Pos[TRI_REORDER_WINDOW];
+	bool Emitted[TRI_REORDER_WINDOW];
+	unsigned int NumSlots = 0;
+	unsigned int NumVerts = 0;
+	unsigned int CacheSize = mVertexCacheSize;
+	unsigned int CacheUsed = 0;
+	unsigned int NumSwaps = 0;
+	unsigned int i, j, k, p, Best;
+	float Score, BestScore;
+	TriIndex t;
+
+	// gather the window's live tris and the distinct vertices they use
+	for (t = iStart; (t <= pPatch->LastActiveTri) && (NumSlots < TRI_REORDER_WINDOW); ++t)
+	{
+		if (pPatch->TriProxyBackRefs[t][0] == Forest::iNIL_NODE)
+			continue;
+		for (k = 0; k < 3; ++k)
+		{
+			ProxyIndex v = pPatch->TriProxiesArray[t][k];
+			for (j = 0; j < NumVerts; ++j)
+			{
+				if (Verts[j] == v)
+					break;
+			}
+			if (j == NumVerts)
+			{
+				Verts[NumVerts] = v;
+				VertRemaining[NumVerts] = 0;
+				VertCachePos[NumVerts] = -1;
+				++NumVerts;
+			}
+			TriVerts[NumSlots][k] = j;
+			++VertRemaining[j];
+		}
+		Emitted[NumSlots] = false;
+		Slots[NumSlots++] = t;
+	}
+	iNext = t;
+	if (NumSlots < 3)
+		return 0;
+
+	// seed the simulated cache with the vertices of the tris drawn just before the window;
+	// vertices outside the window only take up room, so they are stored as -1
+	for (t = iStart; (t > 0) && (iStart - t < CacheSize) && (CacheUsed < CacheSize); )
+	{
+		--t;
+		if (pPatch->TriProxyBackRefs[t][0] == Forest::iNIL_NODE)
+			continue;
+		for (k = 0; (k < 3) && (CacheUsed < CacheSize); ++k)
+		{
+			ProxyIndex v = pPatch->TriProxiesArray[t][k];
+			for (j = 0; j < NumVerts; ++j)
+			{
+				if (Verts[j] == v)
+					break;
+			}
+			if (j < NumVerts)
+			{
+				if (VertCachePos[j] >= 0)
+					continue;
+				VertCachePos[j] = CacheUsed;
+				Cache[CacheUsed++] = j;
+			}
+			else
+				Cache[CacheUsed++] = -1;
+		}
+	}
+
+	for (j = 0; j < NumVerts; ++j)
+		VertScore[j] = VertexCacheScore(VertCachePos[j], VertRemaining[j], CacheSize);
+
+	// greedily emit the highest scoring tri, updating the simulated LRU cache
+	for (p = 0; p < NumSlots; ++p)
+	{
+		Best = 0;
+		BestScore = -1.0f;
+		for (i = 0; i < NumSlots; ++i)
+		{
+			if (Emitted[i])
+				continue;
+			Score = VertScore[TriVerts[i][0]] + VertScore[TriVerts[i][1]] + VertScore[TriVerts[i][2]];
+			if (Score > BestScore)
+			{
+				BestScore = Score;
+				Best = i;
+			}
+		}
+		Emitted[Best] = true;
+		Order[p] = Best;
+
+		for (k = 0; k < 3; ++k)
+		{
+			int v = TriVerts[Best][k];
+			unsigned int From;
+			--VertRemaining[v];
+			for (From = 0; From < CacheUsed; ++From)
+			{
+				if (Cache[From] == v)
+					break;
+			}
+			if (From == CacheUsed)
+				++CacheUsed;
+			for (i = From; i > 0; --i)
+				Cache[i] = Cache[i - 1];
+			Cache[0] = v;
+		}
+		if (CacheUsed > CacheSize)
+			CacheUsed = CacheSize;
+		for (j = 0; j < NumVerts; ++j)
+			VertCachePos[j] = -1;
+		for (i = 0; i < CacheUsed; ++i)
+		{
+			if (Cache[i] >= 0)
+				VertCachePos[Cache[i]] = i;
+		}
+		for (j = 0; j < NumVerts; ++j)
+			VertScore[j] = VertexCacheScore(VertCachePos[j], VertRemaining[j], CacheSize);
+	}
+
+	// permute the window's tris into emission order with swaps
+	for (p = 0; p < NumSlots; ++p)
+	{
+		At[p] = p;
+		Pos[p] = p;
+	}
+	for (p = 0; p < NumSlots; ++p)
+	{
+		unsigned int q = Pos[Order[p]];
+		if (q == p)
+			continue;
+		SwapTriRenderDatums(PatchID, Slots[p], Slots[q]);
+		At[q] = At[p];
+		Pos[At[q]] = q;
+		At[p] = Order[p];
+		Pos[Order[p]] = p;
+		++NumSwaps;
+	}
+	return NumSwaps;
+}
+
+unsigned int Renderer::ReorderTriRenderData(PatchIndex PatchID, unsigned int MaxTris)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	unsigned int NumSwaps = 0;
+	unsigned int NumVisited = 0;
+	TriIndex iNext;
+	bool Wrapped = false;
+
+	if (pPatch->NumTris < 3)
+		return 0;
+
+	while (NumVisited < MaxTris)
+	{
+		if (pPatch->ReorderCursor > pPatch->LastActiveTri)
+		{
+			if (Wrapped)
+				break;
+			pPatch->ReorderCursor = 0;
+			Wrapped = true;
+		}
+		NumSwaps += ReorderTriRenderDataWindow(PatchID, pPatch->ReorderCursor, iNext);
+		NumVisited += iNext - pPatch->ReorderCursor;
+		pPatch->ReorderCursor = iNext;
+	}
+	return NumSwaps;
+}
+
+void Renderer::SetTriReordering(unsigned int MaxTrisPerPatch)
+{
+	mMaxTriReorderTris = MaxTrisPerPatch;
+}
+
+void Renderer::SetVertexCacheSize(unsigned int CacheSize)
+{
+	if (CacheSize < 4)
+		CacheSize = 4;
+	if (CacheSize > MAX_VERTEX_CACHE_SIZE)
+		CacheSize = MAX_VERTEX_CACHE_SIZE;
+	mVertexCacheSize = CacheSize;
+}
+
+// simulates a FIFO post-transform vertex cache of mVertexCacheSize entries over the
+// tris the render callbacks submit for the patch; returns cache misses per tri
+float Renderer::GetPatchACMR(PatchIndex PatchID)
+{
+	PatchRenderTris *pPatch = &mpPatchTriData[PatchID];
+	ProxyIndex Cache[MAX_VERTEX_CACHE_SIZE];
+	unsigned int CacheUsed = 0;
+	unsigned int CacheHead = 0;
+	unsigned int NumMisses = 0;
+	unsigned int NumTris = 0;
+	unsigned int i, k;
+	TriIndex t;
+
+	if (pPatch->NumTris == 0)
+		return 0.0f;
+
+	for (t = 0; t <= pPatch->LastActiveTri; ++t)
+	{
+		if (pPatch->TriProxyBackRefs[t][0] == Forest::iNIL_NODE)
+			continue;
+		++NumTris;
+		for (k = 0; k < 3; ++k)
+		{
+			ProxyIndex v = pPatch->TriProxiesArray[t][k];
+			for (i = 0; i < CacheUsed; ++i)
+			{
+				if (Cache[i] == v)
+					break;
+			}
+			if (i < CacheUsed)
+				continue;
+			++NumMisses;
+			if (CacheUsed < mVertexCacheSize)
+				Cache[CacheUsed++] = v;
+			else
+			{
+				Cache[CacheHead] = v;
+				CacheHead = (CacheHead + 1) % mVertexCacheSize;
+			}
+		}
+	}
+	return (float)NumMisses / (float)NumTris;
+}
+
 void Renderer::SetVertexRenderDatumAboveParentsOfBoundary(VertexRenderDatum *pVRD, bool newflag)
 {
 	unsigned int index = pVRD - mpVertexRenderData;
@@ -19,6 +19,15 @@
 #include "node.h"
 #include "freelist.h"
 #include "primtypes.h"
+#include "timing.h"
+
+// number of live tris reordered together for vertex cache reuse
+#define TRI_REORDER_WINDOW 64
+#define DEFAULT_VERTEX_CACHE_SIZE 24
+#define MAX_VERTEX_CACHE_SIZE 64
+
+// TrimTriRenderData() never shrinks a patch's tri render data below this many tris
+#define MIN_PATCH_TRIS_ALLOCATED 16
 
 #ifndef APIENTRY
 #ifdef __APPLE__
@@ -58,6 +67,13 @@ struct PatchRenderTris
 	int NumTriSlotsFree;
 	FreeList TriFreeSlots;
 
+	// every slot below this index holds a live tri; free slot searches and
+	// compaction start here
+	TriIndex LowestFreeTri;
+
+	// slot at which the next incremental vertex cache reordering window starts
+	TriIndex ReorderCursor;
+
 	bool NormalsPresent;
 	bool ColorsPresent;
 };	
@@ -77,6 +93,43 @@ public: // PUBLIC FUNCTIONS
 	void RemoveVertexRenderDatum(VertexRenderDatum *pVertexRenderDatum);
 	void AddTriRenderDatum(TriIndex iTri, PatchIndex PatchID);
 	void RemoveTriRenderDatum(TriIndex TriRenderDatum, PatchIndex PatchID);
+
+	// moves up to MaxMoves live tris from the end of the patch's tri render data
+	// into free slots below them, so that the range [0, LastActiveTri] submitted
+	// by the render callbacks stays dense; returns the number of tris moved
+	unsigned int CompactTriRenderData(PatchIndex PatchID, unsigned int MaxMoves);
+
+	// if MaxMovesPerPatch is nonzero, each RenderPatch() call first compacts the
+	// patch by up to that many tris; 0 disables compaction
+	void SetTriCompaction(unsigned int MaxMovesPerPatch);
+
+	// reorders live tris, a window of TRI_REORDER_WINDOW at a time, for post-transform
+	// vertex cache reuse; picks up where the previous call left off and stops after
+	// visiting about MaxTris slots; returns the number of tri swaps made
+	unsigned int ReorderTriRenderData(PatchIndex PatchID, unsigned int MaxTris);
+
+	// if MaxTrisPerPatch is nonzero, each RenderPatch() call first reorders up to
+	// that many of the patch's tris; 0 disables reordering
+	void SetTriReordering(unsigned int MaxTrisPerPatch);
+
+	// size of the post-transform vertex cache that reordering and ACMR assume;
+	// clamped to [4, MAX_VERTEX_CACHE_SIZE]
+	void SetVertexCacheSize(unsigned int CacheSize);
+
+	// average cache miss ratio (vertex cache misses per tri) of the patch's tris in the
+	// order they are submitted
+	float GetPatchACMR(PatchIndex PatchID);
+
+	// bytes allocated for this renderer's vertex and tri render data
+	unsigned int GetMemoryAllocated();
+
+	// makes sure the patch has room for NumTris more tris, growing its tri render data if
+	// the memory manager's budget allows; returns false if there isn't room
+	bool ReserveTriRenderData(PatchIndex PatchID, unsigned int NumTris);
+
+	// compacts patches holding much more tri render data than their live tris need, and
+	// shrinks them; returns the number of bytes given back
+	unsigned int TrimTriRenderData();
 	NodeIndex GetVertexRenderDatumIndex(VertexRenderDatum *pVRD);
 	NodeIndex GetVertexCacheBackRef(NodeIndex iVertexCacheIndex, Forest *pForest);
 	inline ProxyIndex GetProxy(TriIndex i, int k) const;
@@ -92,7 +145,11 @@ protected: // PRIVATE FUNCTIONS
 
 	void PopulateVertexSlotsCache();
 	void PopulateTriSlotsCache(VDS::PatchIndex PatchID);
-	VertexRenderDatum *CacheVertex(NodeIndex iVertexArrayLocation, Node *pNode);
+	TriIndex FindTriRenderDatumOwner(PatchIndex PatchID, TriIndex iSlot);
+	void MoveTriRenderDatum(PatchIndex PatchID, TriIndex iFrom, TriIndex iTo);
+	void SwapTriRenderDatums(PatchIndex PatchID, TriIndex iA, TriIndex iB);
+	unsigned int ReorderTriRenderDataWindow(PatchIndex PatchID, TriIndex iStart, TriIndex &iNext);
+	VertexRenderDatum *CacheVertex(NodeIndex iVertexArrayLocation, NodeIndex iNode);
 	void UseSystemMemoryVertexData();
 	void UseFastMemoryVertexData();
 
@@ -125,6 +182,10 @@ public:	// PUBLIC DATA
 
 	TriIndex mNumTris;	// total number of tris in all of this renderer's patches
 
+	unsigned int mMaxTriCompactionMoves; // per patch per RenderPatch() call; 0 if compaction is off
+	unsigned int mMaxTriReorderTris; // per patch per RenderPatch() call; 0 if reordering is off
+	unsigned int mVertexCacheSize;
+
 	unsigned int VertexIndexSizeLimit;
 
 
@@ -160,6 +221,7 @@ public: // MEMORY MANAGEMENT FUNCTIONS AND DATA
 	void SetCopyPerFrame(bool CopyPerFrame);
 
 	Manager *mpMemoryManager; // is set by Manager::AddRenderer() call
+	unsigned int miMemoryBlock; // index of this renderer in mpMemoryManager's arrays
 
 	// memory which is getting sent to the card (i.e. is in the vertex or tri array) but does not contain vertex or tri information
 	unsigned int mSlackBytes; 
@@ -188,10 +250,8 @@ public: // DEBUG DATA
 	float *ACMR;
 	unsigned int *vertex_cache_size;
 
-#ifdef _WIN32
-	LARGE_INTEGER times_30;
-
-#endif
+	// time spent copying vertex data to fast memory (TIMING_LEVEL_1), accumulated until reset
+	TimerTicks mCopyTicks;
 }; // Class Renderer
 
 } //namespace VDS
@@ -30,8 +30,8 @@
 // uncomment for performance outputs
 //#define PERFORMANCE_OUTPUT
 
-// uncomment to generate timing information
-// higher levels delve deeper into the subprocedures
+// uncomment to generate timing information (see timing.h and Simplifier::mStats)
+// higher levels delve deeper into the subprocedures and imply the levels below them
 //#define TIMING_LEVEL_1 // basic time spent updating simplification params and node errors, simplifying, rendering
 //#define TIMING_LEVEL_2 // breakdown of updating node errors - calculating errors and heapify for each queue
 						 // also tracks the average sizes of the nodequeues
@@ -39,13 +39,21 @@
 //#define TIMING_LEVEL_4
 //#define TIMING_LEVEL_5 // finding and adding VertexRenderDatums and TriRenderDatums
 
+#if defined(TIMING_LEVEL_5) && !defined(TIMING_LEVEL_4)
+#define TIMING_LEVEL_4
+#endif
+#if defined(TIMING_LEVEL_4) && !defined(TIMING_LEVEL_3)
+#define TIMING_LEVEL_3
+#endif
+#if defined(TIMING_LEVEL_3) && !defined(TIMING_LEVEL_2)
+#define TIMING_LEVEL_2
+#endif
+#if defined(TIMING_LEVEL_2) && !defined(TIMING_LEVEL_1)
+#define TIMING_LEVEL_1
+#endif
+
 #ifndef WIN32
 #undef PERFORMANCE_OUTPUT
-#undef TIMING_LEVEL_1
-#undef TIMING_LEVEL_2
-#undef TIMING_LEVEL_3
-#undef TIMING_LEVEL_4
-#undef TIMING_LEVEL_5
 #endif
 
 #endif // #ifndef SETTINGS_H
@@ -22,6 +22,9 @@
 #include "simplifier.h"
 #include "forest.h"
 #include "cut.h"
+#include "renderer.h"
+#include "manager.h"
+#include "occlusion.h"
 
 using namespace std;
 using namespace VDS;
@@ -37,6 +40,7 @@ Simplifier::Simplifier()
 	mIsValid = false;
 	mBudgetTolerance = 0;
 	mSimplificationBreakCount = 0;
+	mCullSubtrees = false;
 
 // private data initialization
 	mpCuts = NULL;
@@ -47,20 +51,13 @@ Simplifier::Simplifier()
 	mpFoldQueue->Initialize(48, -FLT_MAX);
 	mpUnfoldQueue = new NodeQueue(this);
 	mpUnfoldQueue->Initialize(48, -FLT_MAX);
+	mpParkedItems = NULL;
+	mNumParked = 0;
+	mMaxParked = 0;
+	mpOcclusionBuffer = NULL;
+	mOcclusionPass = 0;
 
-// profiling data initialization
-#ifdef _WIN32
-	timer_update_budget_errors.LowPart = 0;
-	timer_simplification.LowPart = 0;
-	fold_time.LowPart = 0;
-	unfold_time.LowPart = 0;
-	update_budget_errors_calc.LowPart = 0;
-	update_budget_errors_queue_manip.LowPart = 0;
-#endif
-	tris_introduced = 0;
-	tris_removed = 0;
-	foldqueue_size = 0;
-	unfoldqueue_size = 0;
+	// profiling data (mStats) is zeroed by its constructor
 }
 
 Simplifier::~Simplifier()
@@ -69,6 +66,8 @@ Simplifier::~Simplifier()
 		delete[] mpCuts;
 	delete mpFoldQueue;
 	delete mpUnfoldQueue;
+	if (mpParkedItems != NULL)
+		delete[] mpParkedItems;
 }
 
 void Simplifier::AddCut(Cut *pCut)
@@ -90,12 +89,16 @@ void Simplifier::AddCut(Cut *pCut)
 	RootNode.CutID = mNumCuts-1;
 	RootNode.miNode = Forest::iROOT_NODE;
 	RootNode.miFirstLiveTri = Forest::iNIL_TRI;
-	RootNode.mPosition = pCut->mpForest->mpNodes[RootNode.miNode].mpRenderData->Position;
+	RootNode.mPosition = pCut->mpForest->GetNodeRenderData(RootNode.miNode)->Position;
 //	RootNode.mRadius = pCut->mpForest->mpNodes[RootNode.miNode].mRadius;
 	RootNode.mXBBoxOffset = pCut->mpForest->mpNodes[RootNode.miNode].mXBBoxOffset;
 	RootNode.mYBBoxOffset = pCut->mpForest->mpNodes[RootNode.miNode].mYBBoxOffset;
 	RootNode.mZBBoxOffset = pCut->mpForest->mpNodes[RootNode.miNode].mZBBoxOffset;
 	RootNode.mBBoxCenter = pCut->mpForest->mpNodes[RootNode.miNode].mBBoxCenter;
+	RootNode.mCullStamp = 0;
+	RootNode.mPlaneMask = VDS_ALL_FRUSTUM_PLANES;
+	RootNode.mIsParked = false;
+	RootNode.mOccludedPass = 0;
 	RootNode.mError = -mfErrorFunc(&RootNode, pCut);
 
 	RootNode.pVertexRenderDatum = pCut->mpRenderer->AddVertexRenderDatum(RootNode.miNode);
@@ -116,53 +119,260 @@ void Simplifier::UpdateNodeErrors()
 	int i;
 	int PQsize;
 	BudgetItem *element;
+	unsigned int NumOccluded = 0;
+
+#ifdef TIMING_LEVEL_1
+	ScopedTimer UpdateNodeErrorsTimer(mStats.UpdateNodeErrorsTicks);
+#endif
+	if (mCullSubtrees)
+		CullSubtrees();
+	if (mpOcclusionBuffer != NULL)
+		++mOcclusionPass;
 
 #ifdef TIMING_LEVEL_2
-	LARGE_INTEGER time_1, time_2, time_3, time_4, time_5;
-	QueryPerformanceCounter(&time_1);
+	TimerTicks time_1, time_2, time_3, time_4, time_5;
+	time_1 = GetTimerTicks();
 #endif
 
 	PQsize = mpFoldQueue->Size;
 	for (i = 1; i <= PQsize; ++i)
 	{
 		element = mpFoldQueue->GetElement(i);
-		element->mError = mfErrorFunc(element, mpCuts[element->CutID]);
+		if ((mpOcclusionBuffer != NULL) && NodeOccluded(element))
+		{
+			element->mError = 0;
+			++NumOccluded;
+		}
+		else
+			element->mError = mfErrorFunc(element, mpCuts[element->CutID]);
 	}
 
 #ifdef TIMING_LEVEL_2
-	QueryPerformanceCounter(&time_2);
+	time_2 = GetTimerTicks();
 #endif
 
 	PQsize = mpUnfoldQueue->Size;
 	for (i = 1; i <= PQsize; ++i)
 	{
 		element = mpUnfoldQueue->GetElement(i);
-		element->mError = -mfErrorFunc(element, mpCuts[element->CutID]);
+		if ((mpOcclusionBuffer != NULL) && NodeOccluded(element))
+		{
+			element->mError = 0;
+			++NumOccluded;
+		}
+		else
+			element->mError = -mfErrorFunc(element, mpCuts[element->CutID]);
 	}
 
 #ifdef TIMING_LEVEL_2
-	QueryPerformanceCounter(&time_3);
+	time_3 = GetTimerTicks();
 #endif
 
 	mpFoldQueue->buildheap();
 
 #ifdef TIMING_LEVEL_2
-	QueryPerformanceCounter(&time_4);
+	time_4 = GetTimerTicks();
 #endif
 
 	mpUnfoldQueue->buildheap();
 
 #ifdef TIMING_LEVEL_2
-	QueryPerformanceCounter(&time_5);
-	times_26.LowPart = (time_2.LowPart - time_1.LowPart);
-	times_27.LowPart = (time_3.LowPart - time_2.LowPart);
-	times_28.LowPart = (time_4.LowPart - time_3.LowPart);
-	times_29.LowPart = (time_5.LowPart - time_4.LowPart);
+	time_5 = GetTimerTicks();
+	mStats.FoldErrorCalcTicks += time_2 - time_1;
+	mStats.UnfoldErrorCalcTicks += time_3 - time_2;
+	mStats.FoldHeapifyTicks += time_4 - time_3;
+	mStats.UnfoldHeapifyTicks += time_5 - time_4;
 #endif
+	mStats.FoldQueueSize = mpFoldQueue->Size;
+	mStats.UnfoldQueueSize = mpUnfoldQueue->Size;
+	mStats.NumParked = mNumParked;
+	mStats.NumOccluded = NumOccluded;
+}
+
+bool Simplifier::NodeOccluded(BudgetItem *pItem)
+{
+	Cut *pCut = mpCuts[pItem->CutID];
+	NodeIndex iParent = pCut->mpForest->mpNodes[pItem->miNode].miParent;
+	BudgetItem *pParentItem = (iParent != Forest::iNIL_NODE) ? pCut->mpNodeRefs[iParent] : NULL;
+
+	// the fold queue is updated first, so the parents of unfold queue entries have usually
+	// been tested already
+	if ((pParentItem == NULL) || (pParentItem->mOccludedPass != mOcclusionPass))
+	{
+		if (!mpOcclusionBuffer->BoxOccluded(pCut->mTransformMatrix, pItem->mBBoxCenter,
+				pItem->mXBBoxOffset, pItem->mYBBoxOffset, pItem->mZBBoxOffset))
+			return false;
+	}
+	pItem->mOccludedPass = mOcclusionPass;
+	return true;
+}
+
+void Simplifier::CullSubtrees()
+{
+	Cut *pCut;
+	int iCut, i;
+	bool ViewChanged = false;
+
 #ifdef TIMING_LEVEL_2
-	foldqueue_size = mpFoldQueue->Size;
-	unfoldqueue_size = mpUnfoldQueue->Size;
+	ScopedTimer CullSubtreesTimer(mStats.CullSubtreesTicks);
 #endif
+
+	for (iCut = 0; iCut < mNumCuts; ++iCut)
+	{
+		pCut = mpCuts[iCut];
+		if (pCut->mCulledStamp == pCut->mFrustumStamp)
+			continue;
+		pCut->mCulledStamp = pCut->mFrustumStamp;
+		CullNode(pCut, Forest::iROOT_NODE, VDS_ALL_FRUSTUM_PLANES);
+		ViewChanged = true;
+	}
+	if (!ViewChanged)
+		return;
+
+	// the walks stop at nodes entirely inside the frustum, so a parked node they didn't reach is
+	// below one of those and is inside as well. Unpark() fills slot i from the end of the list,
+	// which has already been visited
+	for (i = mNumParked - 1; i >= 0; --i)
+	{
+		pCut = mpCuts[mpParkedItems[i]->CutID];
+		if (mpParkedItems[i]->mCullStamp != pCut->mFrustumStamp)
+			Unpark(mpParkedItems[i]);
+	}
+}
+
+void Simplifier::CullNode(Cut *pCut, NodeIndex iNode, unsigned char PlaneMask)
+{
+	Node *pNodes = pCut->mpForest->mpNodes;
+	BudgetItem *pItem = pCut->mpNodeRefs[iNode];
+	NodeIndex iChild;
+	unsigned int NumTris = 0, BytesUsed = 0;
+
+	// leaf nodes have nothing below them to fold, so they are never parked
+	if ((pItem == NULL) || (pNodes[iNode].miFirstChild == Forest::iNIL_NODE))
+		return;
+
+	pItem->mCullStamp = pCut->mFrustumStamp;
+	if (pCut->BoxOutsideFrustum(pItem, PlaneMask))
+	{
+		pItem->mPlaneMask = PlaneMask;
+		if (!pItem->mIsParked)
+		{
+			FoldSubtree(pCut, iNode, NumTris, BytesUsed);
+			Park(pCut->mpNodeRefs[iNode]);
+		}
+		return;
+	}
+	pItem->mPlaneMask = PlaneMask;
+
+	// a parked node's children are all folded, so there is nothing below it to visit
+	if (pItem->mIsParked)
+		Unpark(pItem);
+	else if ((PlaneMask != 0) && pCut->NodeIsUnfolded(iNode))
+	{
+		for (iChild = pNodes[iNode].miFirstChild; iChild != Forest::iNIL_NODE; iChild = pNodes[iChild].miRightSibling)
+			CullNode(pCut, iChild, PlaneMask);
+	}
+}
+
+void Simplifier::FoldSubtree(Cut *pCut, NodeIndex iNode, unsigned int &NumTris, unsigned int &BytesUsed)
+{
+	Node *pNodes = pCut->mpForest->mpNodes;
+	NodeIndex iRingNode = iNode, iChild;
+
+	if (!pCut->NodeIsUnfolded(iNode))
+		return;
+
+	// with REVERSE_PRUNING Fold() doesn't fold unfolded children first, and folding iNode folds its
+	// coincident vertices too, so every child of the ring has to be folded before iNode is
+	do
+	{
+		for (iChild = pNodes[iRingNode].miFirstChild; iChild != Forest::iNIL_NODE; iChild = pNodes[iChild].miRightSibling)
+			FoldSubtree(pCut, iChild, NumTris, BytesUsed);
+		iRingNode = pNodes[iRingNode].mCoincidentVertex;
+	}
+	while ((iRingNode != Forest::iNIL_NODE) && (iRingNode != iNode));
+
+	if (pCut->NodeIsUnfolded(iNode))
+		Fold(pCut->mpNodeRefs[iNode], NumTris, BytesUsed);
+}
+
+void Simplifier::Park(BudgetItem *pItem)
+{
+	Cut *pCut = mpCuts[pItem->CutID];
+	NodeIndex iNode = pItem->miNode;
+	BudgetItem *pParkedItem = new BudgetItem;
+
+	memcpy(pParkedItem, pItem, sizeof(BudgetItem));
+	mpUnfoldQueue->Remove(pItem);
+	pCut->mpNodeRefs[iNode] = pParkedItem;
+	AddParkedItem(pParkedItem);
+}
+
+BudgetItem *Simplifier::Unpark(BudgetItem *pItem)
+{
+	Cut *pCut = mpCuts[pItem->CutID];
+	NodeIndex iNode = pItem->miNode;
+
+	RemoveParkedItem(pItem);
+	// the real error is computed by the next UpdateNodeErrors()
+	pItem->mError = VDS_DEFERRED_UNFOLD_ERROR;
+	mpUnfoldQueue->Insert(pItem);
+	delete pItem;
+	return pCut->mpNodeRefs[iNode];
+}
+
+void Simplifier::AddParkedItem(BudgetItem *pItem)
+{
+	if (mNumParked >= mMaxParked)
+	{
+		BudgetItem **pOldItems = mpParkedItems;
+		mMaxParked = (mMaxParked == 0) ? 64 : mMaxParked * 2;
+		mpParkedItems = new BudgetItem* [mMaxParked];
+		if (pOldItems != NULL)
+		{
+			memcpy(mpParkedItems, pOldItems, mNumParked * sizeof(BudgetItem*));
+			delete[] pOldItems;
+		}
+	}
+	pItem->mIsParked = true;
+	pItem->PQindex = mNumParked;
+	mpParkedItems[mNumParked++] = pItem;
+}
+
+void Simplifier::RemoveParkedItem(BudgetItem *pItem)
+{
+	int iSlot = pItem->PQindex;
+
+	mpParkedItems[iSlot] = mpParkedItems[--mNumParked];
+	mpParkedItems[iSlot]->PQindex = iSlot;
+	pItem->mIsParked = false;
+}
+
+void Simplifier::UnparkAll(Cut *pCut)
+{
+	int i;
+
+	for (i = mNumParked - 1; i >= 0; --i)
+	{
+		if ((pCut == NULL) || (mpCuts[mpParkedItems[i]->CutID] == pCut))
+			Unpark(mpParkedItems[i]);
+	}
+}
+
+void Simplifier::SetCullSubtrees(bool CullSubtrees)
+{
+	int i;
+
+	if (CullSubtrees == mCullSubtrees)
+		return;
+	mCullSubtrees = CullSubtrees;
+	if (!CullSubtrees)
+		UnparkAll(NULL);
+	else // cull every cut on the next UpdateNodeErrors()
+	{
+		for (i = 0; i < mNumCuts; ++i)
+			mpCuts[i]->mCulledStamp = mpCuts[i]->mFrustumStamp - 1;
+	}
 }
 
 void Simplifier::FlushQueues()
@@ -188,9 +398,12 @@ void Simplifier::FlushQueues()
 		mpUnfoldQueue->Remove(pItem);
 		pCurrentCut->mpNodeRefs[node] = NULL;
 	}
+	// parked BudgetItems are on the heap, and are deleted with the rest below
+	mNumParked = 0;
 	for (miCurrentCut = 0; miCurrentCut < mNumCuts; ++miCurrentCut)
 	{
 		pCurrentCut = mpCuts[miCurrentCut];
+		pCurrentCut->mCulledStamp = pCurrentCut->mFrustumStamp - 1;
 		for (i = 1; i <= pCurrentCut->mpForest->mNumNodes; ++i)
 		{
 			if (pCurrentCut->mpNodeRefs[i] != NULL)
@@ -210,12 +423,16 @@ void Simplifier::FlushQueues()
 		RootNode.CutID = miCurrentCut;
 		RootNode.miNode = Forest::iROOT_NODE;
 		RootNode.miFirstLiveTri = Forest::iNIL_TRI;
-		RootNode.mPosition = pCurrentCut->mpForest->mpNodes[RootNode.miNode].mpRenderData->Position;
+		RootNode.mPosition = pCurrentCut->mpForest->GetNodeRenderData(RootNode.miNode)->Position;
 //		RootNode.mRadius = pCurrentCut->mpForest->mpNodes[RootNode.miNode].mRadius;
 		RootNode.mXBBoxOffset = pCurrentCut->mpForest->mpNodes[RootNode.miNode].mXBBoxOffset;
 		RootNode.mYBBoxOffset = pCurrentCut->mpForest->mpNodes[RootNode.miNode].mYBBoxOffset;
 		RootNode.mZBBoxOffset = pCurrentCut->mpForest->mpNodes[RootNode.miNode].mZBBoxOffset;
 		RootNode.mBBoxCenter = pCurrentCut->mpForest->mpNodes[RootNode.miNode].mBBoxCenter;
+		RootNode.mCullStamp = 0;
+		RootNode.mPlaneMask = VDS_ALL_FRUSTUM_PLANES;
+		RootNode.mIsParked = false;
+		RootNode.mOccludedPass = 0;
 
 		RootNode.mError = -mfErrorFunc(&RootNode, pCurrentCut);
 
@@ -232,19 +449,12 @@ void Simplifier::FlushQueues()
 void Simplifier::SimplifyBudget(unsigned int Budget, bool UseTriBudget)
 {
 	unsigned int count, curval, NumTris, BytesUsed;
-	tris_introduced = 0;
-	tris_removed = 0;
 
 	if (!mIsValid)
 		return;
 
-#ifdef TIMING_LEVEL_3
-	unfold_time.LowPart = 0;
-	fold_time.LowPart = 0;
-#endif
-#ifdef TIMING_LEVEL_4
-	unfold_queue_manip.LowPart = 0;
-	fold_queue_manip.LowPart = 0;
+#ifdef TIMING_LEVEL_1
+	ScopedTimer SimplifyTimer(mStats.SimplifyTicks);
 #endif
 
 	NumTris = GetTriangleCount();
@@ -270,6 +480,13 @@ void Simplifier::SimplifyBudget(unsigned int Budget, bool UseTriBudget)
 		while ((curval < (Budget-mBudgetTolerance)) && (mpUnfoldQueue->Size >= 1))
 		{
 			UnfoldNode = mpUnfoldQueue->FindMin();
+			if (UnfoldNode->mError == VDS_DEFERRED_UNFOLD_ERROR)
+			{
+				UnfoldNode = NULL;
+				break;
+			}
+			if (DeferUnfold(UnfoldNode))
+				continue;
 			UnfoldNodeIndex = UnfoldNode->miNode;
 			
 			if (mpCurrentForest->NodesAreCoincidentOrEqual(UnfoldNode->miNode, LastUnfold) && (UnfoldNode->CutID == LastCutUnfolded))
@@ -327,20 +544,13 @@ void Simplifier::SimplifyBudget(unsigned int Budget, bool UseTriBudget)
 void Simplifier::SimplifyThreshold(float Threshold)
 {
 	unsigned int count, NumTris, BytesUsed;
-	tris_introduced = 0;
-	tris_removed = 0;
 
 	count = 0;
 	if (!mIsValid)
 		return;
 
-#ifdef TIMING_LEVEL_3
-	unfold_time.LowPart = 0;
-	fold_time.LowPart = 0;
-#endif
-#ifdef TIMING_LEVEL_4
-	unfold_queue_manip.LowPart = 0;
-	fold_queue_manip.LowPart = 0;
+#ifdef TIMING_LEVEL_1
+	ScopedTimer SimplifyTimer(mStats.SimplifyTicks);
 #endif
 
 	BudgetItem *UnfoldNode = NULL;
@@ -380,6 +590,8 @@ void Simplifier::SimplifyThreshold(float Threshold)
 		{
 			break;
 		}
+		if (DeferUnfold(UnfoldNode))
+			continue;
 		Unfold(UnfoldNode, NumTris, BytesUsed);
 		if (mSimplificationBreakCount)
 		{
@@ -393,13 +605,15 @@ void Simplifier::SimplifyThreshold(float Threshold)
 void Simplifier::SimplifyBudgetAndThreshold(unsigned int Budget, bool UseTriBudget, float Threshold)
 {
 	unsigned int count, curval, NumTris, BytesUsed;
-	tris_introduced = 0;
-	tris_removed = 0;
 
 	count = 0;
 	if (!mIsValid)
 		return;
 
+#ifdef TIMING_LEVEL_1
+	ScopedTimer SimplifyTimer(mStats.SimplifyTicks);
+#endif
+
 	NumTris = GetTriangleCount();
 	BytesUsed = GetMemoryUsage();
 	curval = UseTriBudget ? NumTris : BytesUsed;
@@ -425,6 +639,13 @@ void Simplifier::SimplifyBudgetAndThreshold(unsigned int Budget, bool UseTriBudg
 		while ((curval <= Budget-mBudgetTolerance) && (mpUnfoldQueue->Size >= 1))
 		{
 			UnfoldNode = mpUnfoldQueue->FindMin();
+			if (UnfoldNode->mError == VDS_DEFERRED_UNFOLD_ERROR)
+			{
+				UnfoldNode = NULL;
+				break;
+			}
+			if (DeferUnfold(UnfoldNode))
+				continue;
 			UnfoldNodeIndex = UnfoldNode->miNode;
 			
 			float UnfoldNodeErr = UnfoldNode->mError;
@@ -526,7 +747,7 @@ unsigned int Simplifier::GetTriangleCount()
 
 const Point3& Simplifier::GetNodePosition(BudgetItem *pItem) const
 {
-	return mpCuts[pItem->CutID]->mpForest->mpNodes[pItem->miNode].mpRenderData->Position;
+	return mpCuts[pItem->CutID]->mpForest->GetNodeRenderData(pItem->miNode)->Position;
 }
 
 //const Float& Simplifier::GetNodeRadius(BudgetItem *pItem) const
@@ -566,6 +787,54 @@ const Float& Simplifier::GetInvTanFov(BudgetItem *pItem) const
 }
 */
 
+bool Simplifier::DeferUnfold(BudgetItem *pItem)
+{
+	Forest *pForest = mpCuts[pItem->CutID]->mpForest;
+	NodeIndex iNode = pItem->miNode;
+	bool Ready = true;
+
+	// a node unfolds along with the rest of its coincident ring, so all of them have to be there
+	do
+	{
+		Ready = pForest->NodeIsLoaded(iNode) && ((pForest->mpPager == NULL) || pForest->mpPager->NodeIsReady(iNode));
+		iNode = pForest->mpNodes[iNode].mCoincidentVertex;
+	}
+	while (Ready && (iNode != Forest::iNIL_NODE) && (iNode != pItem->miNode));
+	if (Ready && ReserveUnfoldRenderData(pItem))
+		return false;
+	pItem->mError = VDS_DEFERRED_UNFOLD_ERROR;
+	mpUnfoldQueue->heapify(pItem->PQindex);
+	return true;
+}
+
+bool Simplifier::ReserveUnfoldRenderData(BudgetItem *pItem)
+{
+	Cut *pCut = mpCuts[pItem->CutID];
+	Renderer *pRenderer = pCut->mpRenderer;
+	Tri *pTris = pCut->mpForest->mpTris;
+	TriIndex iSubTri, iOther, iFirstSubTri;
+	unsigned int NumTris;
+
+	if ((pRenderer->mpMemoryManager == NULL) || (pRenderer->mpMemoryManager->GetMemoryBudget() == 0))
+		return true;
+
+	// reserve room in each patch for the subtris up to and including this one that are in its
+	// patch; the last reservation for a patch covers all of that patch's subtris
+	iFirstSubTri = pCut->mpForest->mpNodes[pItem->miNode].miFirstSubTri;
+	for (iSubTri = iFirstSubTri; iSubTri != Forest::iNIL_TRI; iSubTri = pTris[iSubTri].miNextSubTri)
+	{
+		NumTris = 0;
+		for (iOther = iFirstSubTri; iOther != pTris[iSubTri].miNextSubTri; iOther = pTris[iOther].miNextSubTri)
+		{
+			if (pTris[iOther].mPatchID == pTris[iSubTri].mPatchID)
+				++NumTris;
+		}
+		if (!pRenderer->ReserveTriRenderData(pTris[iSubTri].mPatchID, NumTris))
+			return false;
+	}
+	return true;
+}
+
 void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &BytesUsed)
 {
 	NodeIndex iChild;
@@ -575,6 +844,8 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 	int k;
 	VertexRenderDatum *newVertexRenderDatum;
 	BudgetItem newBudgetItem;
+	unsigned char ChildPlaneMask;
+	bool CullChildren, Culled;
 
 	if (pItem == NULL)
 	{
@@ -582,9 +853,12 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 		return;
 	}
 
+	// parked nodes are unfolded through a coincident vertex or a snapshot
+	if (pItem->mIsParked)
+		pItem = Unpark(pItem);
+
 #ifdef TIMING_LEVEL_3
-	LARGE_INTEGER time_before_unfold;
-	QueryPerformanceCounter(&time_before_unfold);
+	TimerTicks time_before_unfold = GetTimerTicks();
 #endif
 
 	miCurrentCut = pItem->CutID;
@@ -606,12 +880,29 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 		if (pNodes[iNode].miParent != Forest::iNIL_NODE)
 			pRenderer->SetVertexRenderDatumAboveParentsOfBoundary(pNodeRefs[pNodes[iNode].miParent]->pVertexRenderDatum, true);
 
+#ifdef TIMING_LEVEL_4
+		TimerTicks time_phase = GetTimerTicks(), time_now;
+#endif
+
+		// once a cut has been culled against its current frustum, a node the culling walk didn't
+		// reach is inside the frustum, and so are its children; the others only need testing
+		// against the planes iNode straddles
+		CullChildren = mCullSubtrees && (pCurrentCut->mCulledStamp == pCurrentCut->mFrustumStamp) &&
+			(pItem->mCullStamp == pCurrentCut->mFrustumStamp) && (pItem->mPlaneMask != 0);
+		ChildPlaneMask = pItem->mPlaneMask;
+
 		// for each child of iNode:
 		iChild = pNodes[iNode].miFirstChild;
 		while (iChild != Forest::iNIL_NODE)
 		{
 			// add VertexRenderDatum to renderer
+#ifdef TIMING_LEVEL_5
+			TimerTicks time_before_add = GetTimerTicks();
+#endif
 			newVertexRenderDatum = pRenderer->AddVertexRenderDatum(iChild);
+#ifdef TIMING_LEVEL_5
+			mStats.AddVertexRenderDatumTicks += GetTimerTicks() - time_before_add;
+#endif
 			newVertexRenderDatum->Node = iChild;
 			pCurrentCut->mNumActiveNodes++;
 			NumChildren++;
@@ -621,14 +912,29 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 			newBudgetItem.CutID = miCurrentCut;
 			newBudgetItem.miFirstLiveTri = Forest::iNIL_TRI;
 
-			newBudgetItem.mPosition = pCurrentCut->mpForest->mpNodes[iChild].mpRenderData->Position;
+			newBudgetItem.mPosition = pCurrentCut->mpForest->GetNodeRenderData(iChild)->Position;
 //			newBudgetItem.mRadius = pCurrentCut->mpForest->mpNodes[iChild].mRadius;
 			newBudgetItem.mXBBoxOffset = pCurrentCut->mpForest->mpNodes[iChild].mXBBoxOffset;
 			newBudgetItem.mYBBoxOffset = pCurrentCut->mpForest->mpNodes[iChild].mYBBoxOffset;
 			newBudgetItem.mZBBoxOffset = pCurrentCut->mpForest->mpNodes[iChild].mZBBoxOffset;
 			newBudgetItem.mBBoxCenter = pCurrentCut->mpForest->mpNodes[iChild].mBBoxCenter;
 
-			newBudgetItem.mError = -mfErrorFunc(&newBudgetItem, pCurrentCut);
+			newBudgetItem.mCullStamp = 0;
+			newBudgetItem.mPlaneMask = VDS_ALL_FRUSTUM_PLANES;
+			newBudgetItem.mIsParked = false;
+			newBudgetItem.mOccludedPass = 0;
+			Culled = false;
+			if (CullChildren && (pNodes[iChild].miFirstChild != Forest::iNIL_NODE))
+			{
+				newBudgetItem.mCullStamp = pCurrentCut->mFrustumStamp;
+				newBudgetItem.mPlaneMask = ChildPlaneMask;
+				Culled = pCurrentCut->BoxOutsideFrustum(&newBudgetItem, newBudgetItem.mPlaneMask);
+			}
+
+			if (Culled)
+				newBudgetItem.mError = VDS_DEFERRED_UNFOLD_ERROR;
+			else
+				newBudgetItem.mError = -mfErrorFunc(&newBudgetItem, pCurrentCut);
 
 			// set BudgetItem.RenderData pointer to address of child's RenderData
 			newBudgetItem.pVertexRenderDatum = newVertexRenderDatum;
@@ -640,12 +946,22 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 			if (pNodes[iChild].miFirstChild != Forest::iNIL_NODE)
 			{
 #endif
-				// TODO: find place in queue first instead of making budgetitem and then copying into place in queue
-				// copy BudgetItem data into unfold queue
-				mpUnfoldQueue->Insert(&newBudgetItem);
+				if (Culled)
+				{
+					// child is outside the frustum, so park it rather than queueing it
+					pNodeRefs[iChild] = new BudgetItem;
+					memcpy(pNodeRefs[iChild], &newBudgetItem, sizeof(BudgetItem));
+					AddParkedItem(pNodeRefs[iChild]);
+				}
+				else
+				{
+					// TODO: find place in queue first instead of making budgetitem and then copying into place in queue
+					// copy BudgetItem data into unfold queue
+					mpUnfoldQueue->Insert(&newBudgetItem);
 
-				// this is needed because the location of pItem could have changed if the unfoldqueue was enlarged during the Insert call
-				pItem = pNodeRefs[iNode];
+					// this is needed because the location of pItem could have changed if the unfoldqueue was enlarged during the Insert call
+					pItem = pNodeRefs[iNode];
+				}
 #ifdef PRUNING
 			}
 			else
@@ -664,6 +980,12 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 
 		BytesUsed += NumChildren * pCurrentCut->mBytesPerNode;
 
+#ifdef TIMING_LEVEL_4
+		time_now = GetTimerTicks();
+		mStats.UnfoldActivateChildrenTicks += time_now - time_phase;
+		time_phase = time_now;
+#endif
+
 		// for each livetri of iNode:
 		for (iLiveTri = pNodeRefs[iNode]->miFirstLiveTri; iLiveTri != Forest::iNIL_TRI; iLiveTri = iNextLiveTri)
 		{
@@ -691,20 +1013,39 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 			pTris[iLiveTri].AddToLiveTriList(iLiveTri, k, *mpCurrentForest, pRenderer);
 		}
 
+#ifdef TIMING_LEVEL_4
+		time_now = GetTimerTicks();
+		mStats.UnfoldMoveLiveTrisTicks += time_now - time_phase;
+		time_phase = time_now;
+#endif
+
 		// for each subtri of iNode:
 		for (iSubTri = pNodes[iNode].miFirstSubTri; iSubTri != Forest::iNIL_TRI; iSubTri = pTris[iSubTri].miNextSubTri)
 		{
 			//cout << "\tAdding Tri " << iSubTri << endl;
 			++NumSubTris;
 			// add TriRenderDatum to renderer
+#ifdef TIMING_LEVEL_5
+			TimerTicks time_before_add = GetTimerTicks();
+#endif
 			pRenderer->AddTriRenderDatum(iSubTri, pTris[iSubTri].mPatchID);
+#ifdef TIMING_LEVEL_5
+			mStats.AddTriRenderDatumTicks += GetTimerTicks() - time_before_add;
+#endif
 		}
 
 		// Add number of subtris to Cut.ActiveTris
 		pCurrentCut->mNumActiveTris += NumSubTris;
 		NumTris += NumSubTris;
 		BytesUsed += NumSubTris * pCurrentCut->mBytesPerTri;
-		tris_introduced += NumSubTris;
+		mStats.TrisIntroduced += NumSubTris;
+		++mStats.NumUnfolds;
+
+#ifdef TIMING_LEVEL_4
+		time_now = GetTimerTicks();
+		mStats.UnfoldActivateSubTrisTicks += time_now - time_phase;
+		time_phase = time_now;
+#endif
 		
 		// because of the addition of the children, pItem likely now points to a different
 		// element of the queue than iNode's, so update it to point to iNode's entry again
@@ -764,20 +1105,10 @@ void Simplifier::Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &
 #endif
 		
 #ifdef TIMING_LEVEL_4
-	LARGE_INTEGER time_before_heapify;
-	QueryPerformanceCounter(&time_before_heapify);
+		mStats.UnfoldQueueManipTicks += GetTimerTicks() - time_phase;
 #endif
-#ifdef TIMING_LEVEL_4
-	LARGE_INTEGER time_after_heapify;
-	QueryPerformanceCounter(&time_after_heapify);
-	unfold_queue_manip.LowPart += (time_after_heapify.LowPart - time_before_heapify.LowPart);
-#endif
-
-
 #ifdef TIMING_LEVEL_3
-	LARGE_INTEGER time_after_unfold;
-	QueryPerformanceCounter(&time_after_unfold);
-	unfold_time.LowPart += (time_after_unfold.LowPart - time_before_unfold.LowPart);
+		mStats.UnfoldTicks += GetTimerTicks() - time_before_unfold;
 #endif
 
 		if (pNodes[iNode].mCoincidentVertex)
@@ -802,8 +1133,10 @@ void Simplifier::Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &By
 	}
 
 #ifdef TIMING_LEVEL_3
-	LARGE_INTEGER time_before_fold;
-	QueryPerformanceCounter(&time_before_fold);
+	TimerTicks time_before_fold = GetTimerTicks();
+#endif
+#ifdef TIMING_LEVEL_4
+	TimerTicks time_phase = GetTimerTicks(), time_now;
 #endif
 
 	miCurrentCut = pItem->CutID;
@@ -840,6 +1173,12 @@ void Simplifier::Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &By
 
 //cout << " folding node " << iNode << endl;
 
+#ifdef TIMING_LEVEL_4
+	time_now = GetTimerTicks();
+	mStats.FoldCheckTicks += time_now - time_phase;
+	time_phase = time_now;
+#endif
+
 	if (iParent != Forest::iNIL_NODE)
 		pRenderer->SetVertexRenderDatumAboveParentsOfBoundary(pNodeRefs[iParent]->pVertexRenderDatum, false);
 
@@ -889,8 +1228,14 @@ void Simplifier::Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &By
 		if (pNodes[iChild].miFirstChild != Forest::iNIL_NODE)
 		{
 #endif
-			// remove child from the unfoldqueue
-			mpUnfoldQueue->Remove(mpUnfoldQueue->Find(pNodeRefs[iChild]));
+			// remove child from the unfoldqueue, or from the parked list if subtree culling parked it
+			if (pNodeRefs[iChild]->mIsParked)
+			{
+				RemoveParkedItem(pNodeRefs[iChild]);
+				delete pNodeRefs[iChild];
+			}
+			else
+				mpUnfoldQueue->Remove(mpUnfoldQueue->Find(pNodeRefs[iChild]));
 
 			// set child's NodeRef to NULL, because NodeQueue->Remove() does not
 			pNodeRefs[iChild] = NULL;
@@ -908,6 +1253,12 @@ void Simplifier::Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &By
 
 	BytesUsed -= NumChildren * pCurrentCut->mBytesPerNode;
 
+#ifdef TIMING_LEVEL_4
+	time_now = GetTimerTicks();
+	mStats.FoldRemoveChildrenTicks += time_now - time_phase;
+	time_phase = time_now;
+#endif
+
 	for (iSubTri = pNodes[iNode].miFirstSubTri; iSubTri != Forest::iNIL_TRI; iSubTri = pTris[iSubTri].miNextSubTri)
 	{
 		pTris[iSubTri].RemoveFromLiveTriList(iSubTri, pTriRefs[iSubTri]->backrefs[0], *mpCurrentForest, pRenderer);
@@ -938,7 +1289,14 @@ void Simplifier::Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &By
 	pCurrentCut->mNumActiveTris -= numSubTris;
 	NumTris -= numSubTris;
 	BytesUsed -= numSubTris * pCurrentCut->mBytesPerTri;
-	tris_removed += numSubTris;
+	mStats.TrisRemoved += numSubTris;
+	++mStats.NumFolds;
+
+#ifdef TIMING_LEVEL_4
+	time_now = GetTimerTicks();
+	mStats.FoldRemoveSubTrisTicks += time_now - time_phase;
+	time_phase = time_now;
+#endif
 
 	// because of the removal of the children, pItem possibly points to an
 	// element of the queue other than iNode's, so update it
@@ -993,19 +1351,10 @@ void Simplifier::Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &By
 
 
 #ifdef TIMING_LEVEL_4
-	LARGE_INTEGER time_before_heapify;
-	QueryPerformanceCounter(&time_before_heapify);
+	mStats.FoldQueueManipTicks += GetTimerTicks() - time_phase;
 #endif
-#ifdef TIMING_LEVEL_4
-	LARGE_INTEGER time_after_heapify;
-	QueryPerformanceCounter(&time_after_heapify);
-	fold_queue_manip.LowPart += (time_after_heapify.LowPart - time_before_heapify.LowPart);
-#endif
-
 #ifdef TIMING_LEVEL_3
-	LARGE_INTEGER time_after_fold;
-	QueryPerformanceCounter(&time_after_fold);
-	fold_time.LowPart += (time_after_fold.LowPart - time_before_fold.LowPart);
+	mStats.FoldTicks += GetTimerTicks() - time_before_fold;
 #endif
 
 	if (pNodes[iNode].mCoincidentVertex)
@@ -18,6 +18,11 @@
 #include "nodequeue.h"
 #include "primtypes.h"
 #include "tri.h"
+#include "timing.h"
+
+// error given to unfold queue entries whose data is still being loaded; it sorts them 
+// behind every real candidate until UpdateNodeErrors() recomputes their errors
+#define VDS_DEFERRED_UNFOLD_ERROR 3.402823466e+38F
 
 namespace VDS
 {
@@ -40,6 +45,16 @@ public: // PUBLIC FUNCTIONS
 	// set budget mode error callback
 	void SetErrorFunc(ErrorFunc fError);
 
+	// turns hierarchical frustum culling of the cuts' subtrees on or off; turning it off
+	// returns every parked node to the unfold queue
+	void SetCullSubtrees(bool CullSubtrees);
+
+	// when pBuffer is not NULL, UpdateNodeErrors() gives nodes whose bboxes are entirely behind
+	// the occluders rasterized into it an error of 0, so they are folded first and unfolded last.
+	// The buffer is owned by the caller, who fills it and calls BuildPyramid() before each update
+	void SetOcclusionBuffer(OcclusionBuffer *pBuffer) { mpOcclusionBuffer = pBuffer; }
+	OcclusionBuffer *GetOcclusionBuffer() const { return mpOcclusionBuffer; }
+
 	// get current memory usage by this simplifier's cuts
 	unsigned int GetMemoryUsage();
 
@@ -60,6 +75,33 @@ protected: // PRIVATE FUNCTIONS
 	void Unfold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &BytesUsed);
 	void Fold(BudgetItem *pItem, unsigned int &NumTris, unsigned int &BytesUsed);
 
+	// if the data needed to unfold pItem hasn't been loaded progressively yet, or isn't
+	// resident in a paged forest, moves pItem to the back of the unfold queue and returns true
+	// if the renderer can't make room for the tris unfolding pItem adds within the memory
+	// manager's budget, pItem is deferred the same way
+	bool DeferUnfold(BudgetItem *pItem);
+	bool ReserveUnfoldRenderData(BudgetItem *pItem);
+
+	// subtree culling: called by UpdateNodeErrors() when mCullSubtrees is set. Walks each cut
+	// whose view has changed from the root down, testing only the frustum planes its parent
+	// straddles; subtrees entirely outside the frustum are folded to their root, which is parked
+	// outside the unfold queue until its box is found back inside the frustum
+	void CullSubtrees();
+	void CullNode(Cut *pCut, NodeIndex iNode, unsigned char PlaneMask);
+	// folds the unfolded descendants of iNode (and of its coincident vertices) bottom-up, then iNode
+	void FoldSubtree(Cut *pCut, NodeIndex iNode, unsigned int &NumTris, unsigned int &BytesUsed);
+	// Park() moves a node's BudgetItem from the unfold queue to the parked list; Unpark() puts it
+	// back and returns the queue element it now occupies
+	void Park(BudgetItem *pItem);
+	BudgetItem *Unpark(BudgetItem *pItem);
+	void AddParkedItem(BudgetItem *pItem);
+	void RemoveParkedItem(BudgetItem *pItem);
+	void UnparkAll(Cut *pCut);
+
+	// occlusion test for UpdateNodeErrors(); a node whose parent was found occluded in the
+	// same pass is occluded too, since the parent's bbox encloses it
+	bool NodeOccluded(BudgetItem *pItem);
+
 	// removes all nodes from fold queue and removes all nodes except root node from unfold queue
 	// deletes BudgetItems of all pruned and reverse-pruned nodes
 	void FlushQueues();
@@ -75,6 +117,7 @@ public: // PUBLIC DATA
 //	Float mThreshold;
 //	Float mSin2Threshold;
 	int mBudgetTolerance;
+	bool mCullSubtrees; // set through SetCullSubtrees()
 	unsigned int mSimplificationBreakCount;
 	bool mIsValid;
 	Cut **mpCuts;	// dynamically allocated array of pointers to cuts this simplifier simplifies
@@ -86,38 +129,16 @@ public: // making these public for access by glod VDSCut
 	Forest *mpCurrentForest;
 	NodeQueue *mpFoldQueue;
 	NodeQueue *mpUnfoldQueue;
+	BudgetItem **mpParkedItems;	// heap BudgetItems of nodes parked by subtree culling
+	int mNumParked;
+	int mMaxParked;
+	OcclusionBuffer *mpOcclusionBuffer;
+	unsigned int mOcclusionPass;
 
 public: // profiling information
-#ifdef _WIN32
-	LARGE_INTEGER timer_update_budget_errors;
-	LARGE_INTEGER timer_simplification;
-	LARGE_INTEGER fold_time;
-	LARGE_INTEGER unfold_time;
-	LARGE_INTEGER fold_check;
-	LARGE_INTEGER fold_remove_children;
-	LARGE_INTEGER fold_remove_subtris;
-	LARGE_INTEGER fold_queue_manip;
-	LARGE_INTEGER unfold_activate_children;
-	LARGE_INTEGER unfold_move_livetris;
-	LARGE_INTEGER unfold_activate_subtris;
-	LARGE_INTEGER unfold_queue_manip;
-	LARGE_INTEGER unfold_finding_trirenderdatum_slot;
-	LARGE_INTEGER unfold_adding_trirenderdatum;
-	LARGE_INTEGER unfold_finding_vertexrenderdatum_slot;
-	LARGE_INTEGER unfold_adding_vertexrenderdatum;
-	LARGE_INTEGER update_budget_errors_calc;
-	LARGE_INTEGER update_budget_errors_queue_manip;
-
-	LARGE_INTEGER times_26;
-	LARGE_INTEGER times_27;
-	LARGE_INTEGER times_28;
-	LARGE_INTEGER times_29;
-#endif
-
-	unsigned int tris_introduced;
-	unsigned int tris_removed;
-	unsigned int foldqueue_size;
-	unsigned int unfoldqueue_size;
+	// accumulated across simplification calls until ResetStats() is called
+	SimplifierStats mStats;
+	void ResetStats() { mStats.Reset(); }
 
 //Friends
 	friend class Tree;
@@ -14,16 +14,107 @@
 #pragma warning(disable: 4530)
 #include "threads.h"
 #include <iostream>
+#include <stdio.h>
 
 #ifdef WIN32
 #include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
 #endif
 
 int GetNumSystemProcessors()
 {
 	int n = 0;
 //	ztGetNumAvailableProcessors(&n);
-	return n;
+#ifdef WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	n = (int) info.dwNumberOfProcessors;
+#else
+	n = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (n > 0) ? n : 1;
+}
+
+struct ForkedThreadParams
+{
+	ForkedThreadFunc fThreadFunc;
+	int iThread;
+	int NumThreads;
+	void *pParams;
+};
+
+#ifdef WIN32
+static DWORD WINAPI ForkedThreadMain(LPVOID pArg)
+#else
+static void *ForkedThreadMain(void *pArg)
+#endif
+{
+	ForkedThreadParams *p = (ForkedThreadParams *) pArg;
+	p->fThreadFunc(p->iThread, p->NumThreads, p->pParams);
+	return 0;
+}
+
+void ForkAndJoinThreads(int NumThreads, ForkedThreadFunc fThreadFunc, void *pParams)
+{
+	int i;
+
+	if (NumThreads <= 1)
+	{
+		fThreadFunc(0, 1, pParams);
+		return;
+	}
+
+	ForkedThreadParams *params = new ForkedThreadParams[NumThreads];
+#ifdef WIN32
+	HANDLE *threads = new HANDLE[NumThreads];
+#else
+	pthread_t *threads = new pthread_t[NumThreads];
+#endif
+	bool *started = new bool[NumThreads];
+
+	for (i = 0; i < NumThreads; ++i)
+	{
+		params[i].fThreadFunc = fThreadFunc;
+		params[i].iThread = i;
+		params[i].NumThreads = NumThreads;
+		params[i].pParams = pParams;
+		started[i] = false;
+	}
+	for (i = 1; i < NumThreads; ++i)
+	{
+#ifdef WIN32
+		threads[i] = CreateThread(NULL, 0, ForkedThreadMain, &params[i], 0, NULL);
+		started[i] = (threads[i] != NULL);
+#else
+		started[i] = (pthread_create(&threads[i], NULL, ForkedThreadMain, &params[i]) == 0);
+#endif
+	}
+
+	fThreadFunc(0, NumThreads, pParams);
+
+	for (i = 1; i < NumThreads; ++i)
+	{
+		if (started[i])
+		{
+#ifdef WIN32
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+#else
+			pthread_join(threads[i], NULL);
+#endif
+		}
+		else
+		{
+			// couldn't get a thread for this one, so run it here
+			fThreadFunc(i, NumThreads, pParams);
+		}
+	}
+
+	delete[] started;
+	delete[] threads;
+	delete[] params;
 }
 
 void StartRenderThread(void (*fSimplifyFunc) (void))
@@ -52,3 +143,140 @@ void RenderThreadFunc(void (*fSimplifyFunc) (void))
 			0;// what do we need to include to get linux Sleep()?
 #endif
 }
+
+struct StartedThreadParams
+{
+	ThreadFunc fThreadFunc;
+	void *pParams;
+};
+
+#ifdef WIN32
+static DWORD WINAPI StartedThreadMain(LPVOID pArg)
+#else
+static void *StartedThreadMain(void *pArg)
+#endif
+{
+	StartedThreadParams params = *(StartedThreadParams *) pArg;
+	delete (StartedThreadParams *) pArg;
+	params.fThreadFunc(params.pParams);
+	return 0;
+}
+
+ThreadHandle StartThread(ThreadFunc fThreadFunc, void *pParams)
+{
+	StartedThreadParams *params = new StartedThreadParams;
+	params->fThreadFunc = fThreadFunc;
+	params->pParams = pParams;
+#ifdef WIN32
+	HANDLE thread = CreateThread(NULL, 0, StartedThreadMain, params, 0, NULL);
+	if (thread == NULL)
+	{
+		delete params;
+		return NULL;
+	}
+	return (ThreadHandle) thread;
+#else
+	pthread_t *thread = new pthread_t;
+	if (pthread_create(thread, NULL, StartedThreadMain, params) != 0)
+	{
+		delete thread;
+		delete params;
+		return NULL;
+	}
+	return (ThreadHandle) thread;
+#endif
+}
+
+void JoinThread(ThreadHandle hThread)
+{
+	if (hThread == NULL)
+		return;
+#ifdef WIN32
+	WaitForSingleObject((HANDLE) hThread, INFINITE);
+	CloseHandle((HANDLE) hThread);
+#else
+	pthread_join(*(pthread_t *) hThread, NULL);
+	delete (pthread_t *) hThread;
+#endif
+}
+
+ThreadLock::ThreadLock()
+{
+#ifdef WIN32
+	CRITICAL_SECTION *lock = new CRITICAL_SECTION;
+	InitializeCriticalSection(lock);
+#else
+	pthread_mutex_t *lock = new pthread_mutex_t;
+	pthread_mutex_init(lock, NULL);
+#endif
+	mpLock = lock;
+}
+
+ThreadLock::~ThreadLock()
+{
+#ifdef WIN32
+	DeleteCriticalSection((CRITICAL_SECTION *) mpLock);
+	delete (CRITICAL_SECTION *) mpLock;
+#else
+	pthread_mutex_destroy((pthread_mutex_t *) mpLock);
+	delete (pthread_mutex_t *) mpLock;
+#endif
+}
+
+void ThreadLock::Lock()
+{
+#ifdef WIN32
+	EnterCriticalSection((CRITICAL_SECTION *) mpLock);
+#else
+	pthread_mutex_lock((pthread_mutex_t *) mpLock);
+#endif
+}
+
+void ThreadLock::Unlock()
+{
+#ifdef WIN32
+	LeaveCriticalSection((CRITICAL_SECTION *) mpLock);
+#else
+	pthread_mutex_unlock((pthread_mutex_t *) mpLock);
+#endif
+}
+
+ThreadSignal::ThreadSignal()
+{
+#ifdef WIN32
+	CONDITION_VARIABLE *signal = new CONDITION_VARIABLE;
+	InitializeConditionVariable(signal);
+#else
+	pthread_cond_t *signal = new pthread_cond_t;
+	pthread_cond_init(signal, NULL);
+#endif
+	mpSignal = signal;
+}
+
+ThreadSignal::~ThreadSignal()
+{
+#ifdef WIN32
+	delete (CONDITION_VARIABLE *) mpSignal;
+#else
+	pthread_cond_destroy((pthread_cond_t *) mpSignal);
+	delete (pthread_cond_t *) mpSignal;
+#endif
+}
+
+void ThreadSignal::Wait(ThreadLock &rLock)
+{
+#ifdef WIN32
+	SleepConditionVariableCS((CONDITION_VARIABLE *) mpSignal, (CRITICAL_SECTION *) rLock.mpLock, INFINITE);
+#else
+	pthread_cond_wait((pthread_cond_t *) mpSignal, (pthread_mutex_t *) rLock.mpLock);
+#endif
+}
+
+void ThreadSignal::Broadcast()
+{
+#ifdef WIN32
+	WakeAllConditionVariable((CONDITION_VARIABLE *) mpSignal);
+#else
+	pthread_cond_broadcast((pthread_cond_t *) mpSignal);
+#endif
+}
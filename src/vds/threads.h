@@ -19,7 +19,58 @@
 
 //using namespace ZThreads;
 
+// returns the number of processors available to this process (at least 1)
+int GetNumSystemProcessors();
+
 void StartRenderThread(void (*fSimplifyFunc) (void));
 void RenderThreadFunc(void (*fSimplifyFunc) (void));
 
+// Runs fThreadFunc(iThread, NumThreads, pParams) for iThread = 0..NumThreads-1,
+// each on its own thread (iThread 0 runs on the calling thread), and returns once
+// all of them have returned.  Falls back to running them in turn on the calling
+// thread if threads can't be created.
+typedef void (*ForkedThreadFunc)(int iThread, int NumThreads, void *pParams);
+void ForkAndJoinThreads(int NumThreads, ForkedThreadFunc fThreadFunc, void *pParams);
+
+// Starts fThreadFunc(pParams) on a new thread; returns NULL if it couldn't be created
+typedef void *ThreadHandle;
+typedef void (*ThreadFunc)(void *pParams);
+ThreadHandle StartThread(ThreadFunc fThreadFunc, void *pParams);
+
+// Waits for a thread started by StartThread to return
+void JoinThread(ThreadHandle hThread);
+
+// Mutual exclusion lock
+class ThreadLock
+{
+public:
+	ThreadLock();
+	~ThreadLock();
+	void Lock();
+	void Unlock();
+
+private:
+	ThreadLock(const ThreadLock &); // not implemented
+	ThreadLock &operator =(const ThreadLock &); // not implemented
+	void *mpLock;
+	friend class ThreadSignal;
+};
+
+// Condition that threads can wait on while holding a ThreadLock
+class ThreadSignal
+{
+public:
+	ThreadSignal();
+	~ThreadSignal();
+	// releases rLock, waits until signalled, then reacquires rLock
+	void Wait(ThreadLock &rLock);
+	// wakes all waiting threads
+	void Broadcast();
+
+private:
+	ThreadSignal(const ThreadSignal &); // not implemented
+	ThreadSignal &operator =(const ThreadSignal &); // not implemented
+	void *mpSignal;
+};
+
 #endif
@@ -0,0 +1,118 @@
+/******************************************************************************
+ * Copyright 2004 David Luebke, Brenden Schubert                              *
+ *                University of Virginia                                      *
+ ******************************************************************************
+ * This file is distributed as part of the VDSlib library, and, as such,      *
+ * falls under the terms of the VDSlib public license. VDSlib is distributed  *
+ * without any warranty, implied or otherwise. See the VDSlib license for     *
+ * more details.                                                              *
+ *                                                                            *
+ * You should have recieved a copy of the VDSlib Open-Source License with     *
+ * this copy of VDSlib; if not, please visit the VDSlib web page,             *
+ * http://vdslib.virginia.edu/license for more information.                   *
+ ******************************************************************************/
+#ifndef TIMING_H
+#define TIMING_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <string.h>
+
+#include "settings.h"
+
+namespace VDS
+{
+
+// Portable high resolution timer used by the TIMING_LEVEL_n instrumentation.
+// Ticks come from QueryPerformanceCounter on Windows and from the monotonic
+// clock_gettime() clock elsewhere; convert differences with TimerTicksToSeconds().
+typedef long long TimerTicks;
+
+inline TimerTicks GetTimerTicks()
+{
+#ifdef _WIN32
+	LARGE_INTEGER Ticks;
+	QueryPerformanceCounter(&Ticks);
+	return Ticks.QuadPart;
+#else
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (TimerTicks) Now.tv_sec * 1000000000LL + Now.tv_nsec;
+#endif
+}
+
+inline double TimerTicksToSeconds(TimerTicks Ticks)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER PerfFreq = {0};
+	if (PerfFreq.QuadPart == 0)
+		QueryPerformanceFrequency(&PerfFreq);
+	return (double) Ticks / (double) PerfFreq.QuadPart;
+#else
+	return (double) Ticks * 1.0e-9;
+#endif
+}
+
+// Profiling information gathered by a Simplifier.  The counters are always
+// maintained; the tick totals are only accumulated when the matching
+// TIMING_LEVEL_n is defined in settings.h and are zero otherwise.  Everything
+// accumulates until Reset() is called.
+struct SimplifierStats
+{
+	unsigned int NumFolds;
+	unsigned int NumUnfolds;
+	unsigned int TrisIntroduced;
+	unsigned int TrisRemoved;
+	unsigned int FoldQueueSize;		// queue sizes as of the last UpdateNodeErrors()
+	unsigned int UnfoldQueueSize;
+	unsigned int NumParked;			// nodes parked outside the frustum by subtree culling
+	unsigned int NumOccluded;		// queue entries found behind the occluders
+
+	// TIMING_LEVEL_1
+	TimerTicks UpdateNodeErrorsTicks;
+	TimerTicks SimplifyTicks;
+	// TIMING_LEVEL_2
+	TimerTicks FoldErrorCalcTicks;
+	TimerTicks UnfoldErrorCalcTicks;
+	TimerTicks FoldHeapifyTicks;
+	TimerTicks UnfoldHeapifyTicks;
+	TimerTicks CullSubtreesTicks;
+	// TIMING_LEVEL_3
+	TimerTicks FoldTicks;
+	TimerTicks UnfoldTicks;
+	// TIMING_LEVEL_4
+	TimerTicks FoldCheckTicks;
+	TimerTicks FoldRemoveChildrenTicks;
+	TimerTicks FoldRemoveSubTrisTicks;
+	TimerTicks FoldQueueManipTicks;
+	TimerTicks UnfoldActivateChildrenTicks;
+	TimerTicks UnfoldMoveLiveTrisTicks;
+	TimerTicks UnfoldActivateSubTrisTicks;
+	TimerTicks UnfoldQueueManipTicks;
+	// TIMING_LEVEL_5
+	TimerTicks AddVertexRenderDatumTicks;
+	TimerTicks AddTriRenderDatumTicks;
+
+	SimplifierStats() { Reset(); }
+	void Reset() { memset(this, 0, sizeof(SimplifierStats)); }
+};
+
+// Adds the time between its construction and destruction to a TimerTicks total;
+// for timing functions with several return paths
+class ScopedTimer
+{
+public:
+	ScopedTimer(TimerTicks &rTotal) : mrTotal(rTotal), mStart(GetTimerTicks()) {}
+	~ScopedTimer() { mrTotal += GetTimerTicks() - mStart; }
+
+private:
+	TimerTicks &mrTotal;
+	TimerTicks mStart;
+};
+
+} // namespace VDS
+
+#endif // #ifndef TIMING_H
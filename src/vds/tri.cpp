@@ -65,17 +65,29 @@ void Tri::MoveProxyDown(TriIndex iTri, int iProxy, const Forest &rForest, Render
 	TriProxyBackRef **pTriRefs = pRenderer->mpCut->mpTriRefs;
 	const Node *nodes = rForest.mpNodes;
 	NodeIndex *pProxy = &((*pTriRefs[iTri])[iProxy]);
+	NodeIndex iCorner = miCorners[iProxy];
+
+	// corners in the breadth first coarse levels of a forest laid out for paging are
+	// found by climbing from the corner, which only touches coarse nodes
+	if (iCorner <= rForest.mNumCoarseNodes)
+	{
+		while ((nodes[iCorner].miParent != *pProxy) && (nodes[iCorner].miParent != Forest::iNIL_NODE))
+			iCorner = nodes[iCorner].miParent;
+		*pProxy = iCorner;
+		return;
+	}
+
 	*pProxy = nodes[*pProxy].miFirstChild;
 
 	// need additional termination test that sees if current proxy is an ancestor of or is the proxy needed
 	// terminate if corner is greater than proxy->rightsibling
 
     while ((nodes[*pProxy].miRightSibling != Forest::iNIL_NODE)
-        && (miCorners[iProxy] >= nodes[*pProxy].miRightSibling))
+        && (iCorner >= rForest.GetSubtreeStart(nodes[*pProxy].miRightSibling)))
     {
         *pProxy = rForest.mpNodes[*pProxy].miRightSibling;
     }
-    assert((*pTriRefs[iTri])[iProxy] <= miCorners[iProxy]);
+    assert(rForest.GetSubtreeStart(*pProxy) <= iCorner);
 }
 
 int Tri::GetNodeIndex(TriIndex iTri, NodeIndex iNode, const Forest *pForest, Renderer *pRenderer) const
@@ -21,7 +21,7 @@ class VDS::Tri
 public:
 	Tri();
 	Tri(const Tri &); //not implemented
-	virtual ~Tri();
+	~Tri();
 
 // PRIVATE FUNCTIONS
 private:
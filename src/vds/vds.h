@@ -80,6 +80,15 @@ namespace VDS
 	typedef unsigned long TriIndex;
 	typedef unsigned int ProxyIndex;
 	typedef unsigned short PatchIndex;
+#ifdef _WIN32
+	typedef unsigned __int64 VDSFileOffset;
+#else
+	typedef unsigned long long VDSFileOffset;
+#endif
+
+	// stream callbacks; return the number of bytes actually read or written
+	typedef size_t (*VDSReadFunc)(void *pBuffer, size_t Size, void *pUserData);
+	typedef size_t (*VDSWriteFunc)(const void *pBuffer, size_t Size, void *pUserData);
 
 	typedef void* UserNodeData;
 	typedef void* UserForestData;
@@ -150,6 +159,8 @@ namespace VDS
 	class Renderer;
     class ForestBuilder; // this needs to be def'd to grant it friend access to other classes
 	class Manager;
+	class ForestPager;
+	class OcclusionBuffer;
 
 	typedef void (*RenderFunc)(Renderer &, PatchIndex);
 	typedef Float (*ErrorFunc)(BudgetItem *, const Cut *);
@@ -44,6 +44,14 @@ struct BudgetItem
 	int CutID; // TODO: this doesn't need to be an int - can save space by making into a char or even fewer bits
 
 	TriIndex miFirstLiveTri;
+
+	// subtree culling state (see Simplifier::CullSubtrees()); while a node is parked outside
+	// the view frustum its BudgetItem lives on the heap and PQindex is its slot in the parked list
+	unsigned int mCullStamp;	// frustum stamp of the cut when mPlaneMask was last computed
+	unsigned char mPlaneMask;	// bit i set if the node's bbox straddles frustum plane i
+	bool mIsParked;
+
+	unsigned int mOccludedPass; // Simplifier::mOcclusionPass in which the node was last found occluded
 };
 
 } //namespace VDS
@@ -93,6 +93,14 @@ SOURCE=.\forest.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\forestcompress.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\forestprogressive.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\forestbuilder.cpp
 # End Source File
 # Begin Source File
@@ -113,6 +121,14 @@ SOURCE=.\nodequeue.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\occlusion.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\pager.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\primtypes.cpp
 # End Source File
 # Begin Source File
@@ -169,6 +185,14 @@ SOURCE=.\nodequeue.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\occlusion.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\pager.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\primtypes.h
 # End Source File
 # Begin Source File
@@ -189,6 +213,10 @@ SOURCE=.\threads.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\timing.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\tri.h
 # End Source File
 # Begin Source File
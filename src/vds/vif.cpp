@@ -17,16 +17,30 @@
 
 #include "vif.h"
 #include "vds.h"
+#include "threads.h"
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <set>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 using namespace std;
 using namespace VDS;
 
-char *get_line(ifstream &rIStream);
+char *get_line(istream &rIStream);
 bool is_blank_line(char *pLine);
 bool read_header(istream &rIStream, unsigned int &rMajor, unsigned int &rMinor, unsigned int &rFormat, unsigned int &rNumTextures, unsigned int &rNumVertexPositions, unsigned int &rNumNodes, unsigned int &rNumTris, VDS::PatchIndex &rNumPatches, unsigned int &rNumMerges, unsigned int &rNumErrorParams, int &rErrorParamSize);
 void eat(istream &rIStream);
@@ -396,618 +410,494 @@ bool Vif::WriteVif2_3(const char *Filename)
 	return true;
 }
 
-bool Vif::ReadVif2_2(const char *Filename)
+// VIF 2.x files are read through a read-only memory mapping of the whole file.  After
+// the header, a pass over the lines finds where each section (vertex positions,
+// vertices, tris, error params, merges) starts and cuts the sections into chunks of
+// whole records; the chunks are then parsed by several threads at once, straight into
+// arrays sized from the header counts.  Files that don't have one record per line are
+// parsed front to back on one thread instead.
+
+// records per chunk when a VIF file is parsed by several threads
+#define VIF_RECORDS_PER_CHUNK 16384
+
+#define VIF_SECTION_POSITIONS 0
+#define VIF_SECTION_VERTICES 1
+#define VIF_SECTION_TRIS 2
+#define VIF_SECTION_ERROR_PARAMS 3
+#define VIF_SECTION_MERGES 4
+#define VIF_NUM_SECTIONS 5
+
+static const char VifSectionLetters[VIF_NUM_SECTIONS + 1] = "pvtem";
+
+// read-only view of a whole file
+struct VifFileView
 {
-	char letter;
-	unsigned int i, j;
-    ifstream fin;
-	Point3 pos;
-	Vec3 normal;
-	ByteColorA color;
-    unsigned int major, minor;
-//    bool is_merge_tree;
-//    bool is_node_over;
-    unsigned int format;
-	NodeIndex node, user_index;
-	TriIndex tri;
-	NodeIndex merge, parent, child;
-	NodeIndex children[128];
+	const char *mpData;
+	size_t mSize;
+#ifdef _WIN32
+	HANDLE mhFile;
+	HANDLE mhMapping;
+#endif
 
-	fin.open(Filename);
-	if (!fin.is_open())
+	VifFileView()
 	{
-		fprintf(stderr, "Error opening file \"%s\"\n", Filename);
-		return false;
+		mpData = NULL;
+		mSize = 0;
+#ifdef _WIN32
+		mhFile = INVALID_HANDLE_VALUE;
+		mhMapping = NULL;
+#endif
 	}
 
-    cout << "Reading VIF Header...";
-    if (!read_header(fin, major, minor, format, NumTextures, NumVertexPositions, NumVerts, NumTris, NumPatches, NumMerges, NumErrorParams, ErrorParamSize))
-    {
-		cerr << "Incorrect header in \"" << Filename << "\"" << endl;
-		return false;
-    }
-
-    cout << "finished." << endl;    
-    if ((format & POSITION) == 0)
-    {
-        cerr << "VIF files must contain position" << endl;
-        return false;
-    }
+	~VifFileView()
+	{
+#ifdef _WIN32
+		if (mpData != NULL)
+			UnmapViewOfFile(mpData);
+		if (mhMapping != NULL)
+			CloseHandle(mhMapping);
+		if (mhFile != INVALID_HANDLE_VALUE)
+			CloseHandle(mhFile);
+#else
+		if (mpData != NULL)
+			munmap((void *) mpData, mSize);
+#endif
+	}
 
-	cout << "Reading Vertex Positions...";
+	bool Open(const char *Filename)
+	{
+#ifdef _WIN32
+		mhFile = CreateFile(Filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (mhFile == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER FileSize;
+		if (!GetFileSizeEx(mhFile, &FileSize) || (FileSize.QuadPart == 0))
+			return false;
+		mSize = (size_t) FileSize.QuadPart;
+		mhMapping = CreateFileMapping(mhFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mhMapping == NULL)
+			return false;
+		mpData = (const char *) MapViewOfFile(mhMapping, FILE_MAP_READ, 0, 0, 0);
+		return (mpData != NULL);
+#else
+		int hFile = open(Filename, O_RDONLY);
+		if (hFile < 0)
+			return false;
+		struct stat FileInfo;
+		if ((fstat(hFile, &FileInfo) != 0) || (FileInfo.st_size == 0))
+		{
+			close(hFile);
+			return false;
+		}
+		mSize = (size_t) FileInfo.st_size;
+		void *pMapping = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, hFile, 0);
+		close(hFile);
+		if (pMapping == MAP_FAILED)
+			return false;
+		madvise(pMapping, mSize, MADV_SEQUENTIAL);
+		mpData = (const char *) pMapping;
+		return true;
+#endif
+	}
+};
 
-	VertexPositions = new VertexRenderDatum[NumVertexPositions];
+// lets read_header() parse the header straight out of the mapping
+class VifHeaderBuf : public std::streambuf
+{
+public:
+	VifHeaderBuf(const char *pData, size_t Size)
+	{
+		char *p = const_cast<char *>(pData);
+		setg(p, p, p + Size);
+	}
+	size_t GetOffset() const { return gptr() - eback(); }
+};
 
-	if (format & COLORMASK)
-		ColorsPresent = true;
-	else
-		ColorsPresent = false;
+static const double PowersOfTen[] = 
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-	if (format & NORMAL)
-		NormalsPresent = true;
-	else
-		NormalsPresent = false;
+// Reads whitespace separated tokens out of a range of the mapped file
+struct VifParser
+{
+	const char *p;
+	const char *end;
 
-    if (NumTextures > 0)
-    {
-		TextureCoords = new Point2 *[NumVertexPositions];
-		for (i = 0; i < NumVertexPositions; ++i)
-			TextureCoords[i] = new Point2[NumTextures];
-    }
+	VifParser(const char *pStart, const char *pEnd) : p(pStart), end(pEnd) { }
 
-	for (i = 0; i < NumVertexPositions; ++i)
+	// skips white space and comments, like eat()
+	void Eat()
 	{
-        eat(fin);
-        fin.get(letter);
-        if (letter != 'p')
-        {
-            cerr << "Error on vertex " << i << ", expected vertex" << endl;
-            return false;
-        }
-        if (!isspace(fin.peek()))
-        {
-            fin >> user_index;
-            if (user_index != i)
-            {
-                cerr << "Error, vertex index agreement." << endl;
-                return false;
-            }
-        }
-        fin >> pos;
-
-		if (ColorsPresent)
+		while (p < end)
 		{
-            eat(fin);        
-            fin.get(letter);
-            if (letter != 'c')
-            {
-				cerr << "Error - expected vertex color." << endl;
-			}
-			fin >> color;
-		}
-		if (NormalsPresent)
-		{
-            eat(fin);        
-            fin.get(letter);
-            if (letter != 'n')
-            {
-				cerr << "Error - expected vertex normal." << endl;
-			}
-			fin >> normal;
-			if (normal.LengthSquared() == 0.0)
-				normal = gDefaultNormal;
-			else
-				normal.Normalize();
-		}
-		for (j = 0; j < NumTextures; ++j)
-		{
-            eat(fin);        
-            fin.get(letter);
-            if (letter != 'x')
-            {
-				cerr << "Error - expected texture coordinate " << j << "." << endl;
-			}
-			if (isspace(fin.peek()))
+			if (*p == '#')
 			{
-				cerr << "Error - expected texture coordinate " << j << "'s index." << endl;
+				while ((p < end) && (*p != '\n'))
+					++p;
 			}
-			fin >> user_index;
-			if (user_index != j)
-			{
-				cerr << "Error, texture coordinate " << j << " index agreement." << endl;
-				return false;
-			}
-			fin >> TextureCoords[i][j];
-        }
-
-		VertexPositions[i].Position = pos;
-
-		if (ColorsPresent)
-		{
-			VertexPositions[i].Color = color;
-		}
-		if (NormalsPresent)
-		{
-			VertexPositions[i].Normal = normal;
+			else if (isspace((unsigned char) *p))
+				++p;
+			else
+				break;
 		}
 	}
 
-	cout << "finished." << endl;
-	cout << "Reading Nodes...";
+	void SkipSpace()
+	{
+		while ((p < end) && isspace((unsigned char) *p))
+			++p;
+	}
 
-	Vertices = new VifVertex[NumVerts];
-//	char *line;
-	bool coincidentflag;
-	unsigned int vp, patchid, coincidentvert;
+	int Peek() const { return (p < end) ? (unsigned char) *p : EOF; }
+	int Get() { return (p < end) ? (unsigned char) *p++ : EOF; }
+	bool AtSpace() const { return (p < end) && isspace((unsigned char) *p); }
 
-    for (node = 0; node < NumVerts; node++)
-    {
-        eat(fin);
-        fin.get(letter);
-        if (letter != 'v')
-        {
-            cerr << "Error on vertex " << node << ", expected vertex" << endl;
-            return false;
-        }
-        if (!isspace(fin.peek()))
-        {
-            fin >> user_index;
-            if (user_index != node)
-            {
-                cerr << "Error, vertex index agreement." << endl;
-                return false;
-            }
-        }
+	bool ReadUInt(unsigned int &rValue)
+	{
+		SkipSpace();
+		if ((p < end) && (*p == '+'))
+			++p;
+		if ((p >= end) || (*p < '0') || (*p > '9'))
+			return false;
+		unsigned int value = 0;
+		while ((p < end) && (*p >= '0') && (*p <= '9'))
+			value = value * 10 + (*p++ - '0');
+		rValue = value;
+		return true;
+	}
 
-		fin >> vp >> patchid;
-		eat(fin);
-		char c = fin.peek();
-		if ((c >= '0') && (c <= '9'))
-		{
-			coincidentflag = true;
-			fin >> coincidentvert;
-		}
-		else
-		{
-			coincidentflag = false;
-			coincidentvert = 666666;
-		}
+	bool ReadInt(int &rValue)
+	{
+		unsigned int value;
+		bool negative;
+		SkipSpace();
+		negative = (p < end) && (*p == '-');
+		if (negative)
+			++p;
+		if (!ReadUInt(value))
+			return false;
+		rValue = negative ? -(int) value : (int) value;
+		return true;
+	}
 
-		if (patchid > NumPatches)
+	// decimal floats are converted directly; anything unusual (inf, nan, hex) goes through strtod
+	bool ReadFloat(float &rValue)
+	{
+		unsigned long long mantissa = 0;
+		int exponent = 0, digits = 0;
+		bool negative = false, any = false;
+		const char *start;
+
+		SkipSpace();
+		start = p;
+		if ((p < end) && ((*p == '-') || (*p == '+')))
+			negative = (*p++ == '-');
+		for (; (p < end) && (*p >= '0') && (*p <= '9'); ++p, any = true)
 		{
-			cerr << "Invalid patch ID specified in vertex " << node << endl;
-			return false;
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0)
+					++digits;
+			}
+			else
+				++exponent;
 		}
-		Vertices[node].VertexPosition = vp;
-		Vertices[node].PatchID = patchid;
-		Vertices[node].CoincidentVertexFlag = coincidentflag;
-		Vertices[node].CoincidentVertex = coincidentvert;
-    }
-
-    for (node = 0; node < NumVerts; node++)
-    {
-		if (Vertices[node].CoincidentVertexFlag)
+		if ((p < end) && (*p == '.'))
 		{
-			i = node;
-			if (Vertices[i].CoincidentVertex == i)
+			for (++p; (p < end) && (*p >= '0') && (*p <= '9'); ++p, any = true)
 			{
-				cerr << "Error - Coincident vertex points to self." << endl;
-				return false;
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0)
+						++digits;
+					--exponent;
+				}
 			}
-			while (Vertices[i].CoincidentVertex != node)
+		}
+		if (!any)
+			return ReadFloatSlowly(start, rValue);
+		if ((p < end) && ((*p == 'e') || (*p == 'E')))
+		{
+			const char *mark = p;
+			int sign = 1, e = 0;
+			++p;
+			if ((p < end) && ((*p == '-') || (*p == '+')))
+				sign = (*p++ == '-') ? -1 : 1;
+			if ((p < end) && (*p >= '0') && (*p <= '9'))
 			{
-				if (!Vertices[i].CoincidentVertexFlag)
+				while ((p < end) && (*p >= '0') && (*p <= '9'))
 				{
-					cerr << "Error - Coincident vertex doesn't have coincident vertex flag set." << endl;
-					return false;
+					if (e < 10000)
+						e = e * 10 + (*p - '0');
+					++p;
 				}
-				i = Vertices[i].CoincidentVertex;
+				exponent += sign * e;
 			}
+			else
+				p = mark;
 		}
+		if ((p < end) && !isspace((unsigned char) *p) && (*p != '#'))
+			return ReadFloatSlowly(start, rValue);
+
+		double value = (double) mantissa;
+		if (mantissa == 0)
+			value = 0.0;
+		else if ((exponent >= -22) && (exponent <= 22))
+			value = (exponent >= 0) ? value * PowersOfTen[exponent] : value / PowersOfTen[-exponent];
+		else
+			value *= pow(10.0, (double) exponent);
+		rValue = (float) (negative ? -value : value);
+		return true;
 	}
 
-	cout << "finished." << endl;
-
-    cout << "Reading Tris..." << flush;
-
-	Triangles = new VifTri[NumTris];
-	unsigned int v0, v1, v2;
-
-	for (tri = 0; tri < NumTris; ++tri)
+	bool ReadFloatSlowly(const char *start, float &rValue)
 	{
-        eat(fin);
-        if (fin.get() != 't')
-        {
-            cerr << "Error, expecting tri." << endl;
-            return false;
-        }
-
-		fin >> v0 >> v1 >> v2 >> patchid;
-
-        if ((v0 >= NumVerts) || (v1 >= NumVerts) || (v2 >= NumVerts))
-        {
-            cerr << "Invalid vertex specified in tri number " << tri << endl;
-            return false;
-        }
-		if (patchid > NumPatches)
-		{
-			cerr << "Invalid patch ID specified in tri number " << tri << endl;
+		char token[64];
+		size_t length = 0;
+		char *pTokenEnd;
+
+		p = start;
+		while ((p < end) && !isspace((unsigned char) *p) && (length < sizeof(token) - 1))
+			token[length++] = *p++;
+		token[length] = '\0';
+		rValue = (float) strtod(token, &pTokenEnd);
+		if ((length == 0) || (pTokenEnd == token))
 			return false;
-		}
-		if ((patchid != Vertices[v0].PatchID) || (patchid != Vertices[v1].PatchID) || (patchid != Vertices[v2].PatchID))
-		{
-			cerr << "Error - tri number " << tri << " has patch ID different than one of its corner vertices' patch ID." << endl;
-			return false;
-		}
-		Triangles[tri].Corners[0] = v0;
-		Triangles[tri].Corners[1] = v1;
-		Triangles[tri].Corners[2] = v2;
-		Triangles[tri].PatchID = patchid;
+		p = start + (pTokenEnd - token);
+		return true;
 	}
-	cout << "finished." << endl;
+};
 
-	cout << "Reading Merges..." << flush;
-	Merges = new VifMerge[NumMerges];
-	
-	for (merge = 0; merge < NumMerges; ++merge)
+static bool ParseVifVertexPositions(VifParser &rIn, Vif &rVif, unsigned int iFirst, unsigned int Count)
+{
+	unsigned int i, j, user_index, r, g, b, a;
+	VertexRenderDatum *pDatum;
+	Vec3 normal;
+
+	for (i = iFirst; i < iFirst + Count; ++i)
 	{
-		eat(fin);
-		if (fin.get() != 'm')
+		pDatum = &rVif.VertexPositions[i];
+		rIn.Eat();
+		if (rIn.Get() != 'p')
 		{
-			cerr << "Error, expecting merge." << endl;
-			return false;
-		}
-		fin >> parent;
-		if (parent >= NumVerts)
-		{
-			cerr << "Attempt to merge invalid vertex in VIF." << endl;
+			cerr << "Error on vertex " << i << ", expected vertex" << endl;
 			return false;
 		}
-		Merges[merge].ParentNode = parent;
-		i = 0;
-		eat(fin);
-		while (fin.peek() != 'm' && !fin.eof())
+		if (!rIn.AtSpace())
 		{
-			fin >> child;
-			if (child >= NumVerts)
+			if (!rIn.ReadUInt(user_index) || (user_index != i))
 			{
-				cerr << "Attempt to merge invalid node." << endl;
+				cerr << "Error, vertex index agreement." << endl;
 				return false;
 			}
-			children[i] = child;
-			++i;
-			eat(fin);
 		}
-		Merges[merge].NumNodesInMerge = i;
-		Merges[merge].NodesBeingMerged = new unsigned int[Merges[merge].NumNodesInMerge];
-		for (i = 0; i < Merges[merge].NumNodesInMerge; ++i)
-			Merges[merge].NodesBeingMerged[i] = children[i];
-	}
-	cout << "finished." << endl;
-	return true;
-}
-
-bool Vif::ReadVif2_3(const char *Filename)
-{
-	char letter;
-	unsigned int i, j;
-    int k;
-	int errorparamindex;
-    ifstream fin;
-	Point3 pos;
-	Vec3 normal;
-	ByteColorA color;
-    unsigned int major, minor;
-//    bool is_merge_tree, is_node_over;
-    unsigned int format;
-	NodeIndex node, user_index;
-	TriIndex tri;
-	NodeIndex merge, parent, child;
-	NodeIndex children[128];
-
-	fin.open(Filename);
-	if (!fin.is_open())
-	{
-		fprintf(stderr, "Error opening file \"%s\"\n", Filename);
-		return false;
-	}
-
-    cout << "Reading VIF Header...";
-    if (!read_header(fin, major, minor, format, NumTextures, NumVertexPositions, NumVerts, NumTris, NumPatches, NumMerges, NumErrorParams, ErrorParamSize))
-    {
-		cerr << "Incorrect header in \"" << Filename << "\"" << endl;
-		return false;
-    }
-
-    cout << "finished." << endl;    
-    if ((format & POSITION) == 0)
-    {
-        cerr << "VIF files must contain position" << endl;
-        return false;
-    }
-
-	cout << "Reading Vertex Positions...";
-
-	VertexPositions = new VertexRenderDatum[NumVertexPositions];
-
-	if (format & COLORMASK)
-		ColorsPresent = true;
-	else
-		ColorsPresent = false;
-
-	if (format & NORMAL)
-		NormalsPresent = true;
-	else
-		NormalsPresent = false;
-
-    if (NumTextures > 0)
-    {
-		TextureCoords = new Point2 *[NumVertexPositions];
-		for (i = 0; i < NumVertexPositions; ++i)
-			TextureCoords[i] = new Point2[NumTextures];
-    }
-
-	for (i = 0; i < NumVertexPositions; ++i)
-	{
-        eat(fin);
-        fin.get(letter);
-        if (letter != 'p')
-        {
-            cerr << "Error on vertex " << i << ", expected vertex" << endl;
-            return false;
-        }
-        if (!isspace(fin.peek()))
-        {
-            fin >> user_index;
-            if (user_index != i)
-            {
-                cerr << "Error, vertex index agreement." << endl;
-                return false;
-            }
-        }
-        fin >> pos;
-
-		if (ColorsPresent)
+		if (!rIn.ReadFloat(pDatum->Position.X) || !rIn.ReadFloat(pDatum->Position.Y) || !rIn.ReadFloat(pDatum->Position.Z))
 		{
-            eat(fin);        
-            fin.get(letter);
-            if (letter != 'c')
-            {
+			cerr << "Error reading position of vertex " << i << endl;
+			return false;
+		}
+		if (rVif.ColorsPresent)
+		{
+			rIn.Eat();
+			if ((rIn.Get() != 'c') || !rIn.ReadUInt(r) || !rIn.ReadUInt(g) || !rIn.ReadUInt(b) || !rIn.ReadUInt(a))
+			{
 				cerr << "Error - expected vertex color." << endl;
+				return false;
 			}
-			fin >> color;
+			pDatum->Color.R = r;
+			pDatum->Color.G = g;
+			pDatum->Color.B = b;
+			pDatum->Color.A = a;
 		}
-		if (NormalsPresent)
+		if (rVif.NormalsPresent)
 		{
-            eat(fin);        
-            fin.get(letter);
-            if (letter != 'n')
-            {
+			rIn.Eat();
+			if ((rIn.Get() != 'n') || !rIn.ReadFloat(normal.X) || !rIn.ReadFloat(normal.Y) || !rIn.ReadFloat(normal.Z))
+			{
 				cerr << "Error - expected vertex normal." << endl;
+				return false;
 			}
-			fin >> normal;
 			if (normal.LengthSquared() == 0.0)
 				normal = gDefaultNormal;
 			else
 				normal.Normalize();
+			pDatum->Normal = normal;
 		}
-		for (j = 0; j < NumTextures; ++j)
+		for (j = 0; j < rVif.NumTextures; ++j)
 		{
-            eat(fin);        
-            fin.get(letter);
-            if (letter != 'x')
-            {
+			rIn.Eat();
+			if ((rIn.Get() != 'x') || rIn.AtSpace())
+			{
 				cerr << "Error - expected texture coordinate " << j << "." << endl;
+				return false;
 			}
-			if (isspace(fin.peek()))
+			if (!rIn.ReadUInt(user_index) || (user_index != j))
 			{
-				cerr << "Error - expected texture coordinate " << j << "'s index." << endl;
+				cerr << "Error, texture coordinate " << j << " index agreement." << endl;
+				return false;
 			}
-			fin >> user_index;
-			if (user_index != j)
+			if (!rIn.ReadFloat(rVif.TextureCoords[i][j].X) || !rIn.ReadFloat(rVif.TextureCoords[i][j].Y))
 			{
-				cerr << "Error, texture coordinate " << j << " index agreement." << endl;
+				cerr << "Error - expected texture coordinate " << j << "." << endl;
 				return false;
 			}
-			fin >> TextureCoords[i][j];
-        }
+		}
+	}
+	return true;
+}
 
-		VertexPositions[i].Position = pos;
+static bool ParseVifVertices(VifParser &rIn, Vif &rVif, unsigned int iFirst, unsigned int Count)
+{
+	unsigned int node, user_index, vp, patchid, coincidentvert;
+	int c;
 
-		if (ColorsPresent)
+	for (node = iFirst; node < iFirst + Count; ++node)
+	{
+		rIn.Eat();
+		if (rIn.Get() != 'v')
 		{
-			VertexPositions[i].Color = color;
+			cerr << "Error on vertex " << node << ", expected vertex" << endl;
+			return false;
 		}
-		if (NormalsPresent)
+		if (!rIn.AtSpace())
 		{
-			VertexPositions[i].Normal = normal;
+			if (!rIn.ReadUInt(user_index) || (user_index != node))
+			{
+				cerr << "Error, vertex index agreement." << endl;
+				return false;
+			}
 		}
-	}
-
-	cout << "finished." << endl;
-	cout << "Reading Nodes...";
-
-	Vertices = new VifVertex[NumVerts];
-//	char *line;
-	bool coincidentflag;
-	unsigned int vp, patchid, coincidentvert;
-
-    for (node = 0; node < NumVerts; node++)
-    {
-        eat(fin);
-        fin.get(letter);
-        if (letter != 'v')
-        {
-            cerr << "Error on vertex " << node << ", expected vertex" << endl;
-            return false;
-        }
-        if (!isspace(fin.peek()))
-        {
-            fin >> user_index;
-            if (user_index != node)
-            {
-                cerr << "Error, vertex index agreement." << endl;
-                return false;
-            }
-        }
-
-		fin >> vp >> patchid;
-		eat(fin);
-		char c = fin.peek();
+		if (!rIn.ReadUInt(vp) || !rIn.ReadUInt(patchid))
+		{
+			cerr << "Error reading vertex " << node << endl;
+			return false;
+		}
+		rIn.Eat();
+		c = rIn.Peek();
+		VifVertex &rVertex = rVif.Vertices[node];
 		if ((c >= '0') && (c <= '9'))
 		{
-			coincidentflag = true;
-			fin >> coincidentvert;
+			rIn.ReadUInt(coincidentvert);
+			rVertex.CoincidentVertexFlag = true;
+			rVertex.CoincidentVertex = coincidentvert;
 		}
 		else
 		{
-			coincidentflag = false;
-			coincidentvert = 666666;
+			rVertex.CoincidentVertexFlag = false;
+			rVertex.CoincidentVertex = 666666;
 		}
-
-		if (patchid > NumPatches)
+		if (patchid > rVif.NumPatches)
 		{
 			cerr << "Invalid patch ID specified in vertex " << node << endl;
 			return false;
 		}
-		Vertices[node].VertexPosition = vp;
-		Vertices[node].PatchID = patchid;
-		Vertices[node].CoincidentVertexFlag = coincidentflag;
-		Vertices[node].CoincidentVertex = coincidentvert;
-    }
-
-    for (node = 0; node < NumVerts; node++)
-    {
-		if (Vertices[node].CoincidentVertexFlag)
-		{
-			i = node;
-			if (Vertices[i].CoincidentVertex == i)
-			{
-				cerr << "Error - Coincident vertex points to self." << endl;
-				return false;
-			}
-			while (Vertices[i].CoincidentVertex != node)
-			{
-				if (!Vertices[i].CoincidentVertexFlag)
-				{
-					cerr << "Error - Coincident vertex doesn't have coincident vertex flag set." << endl;
-					return false;
-				}
-				i = Vertices[i].CoincidentVertex;
-			}
-		}
+		rVertex.VertexPosition = vp;
+		rVertex.PatchID = patchid;
 	}
+	return true;
+}
 
-	cout << "finished." << endl;
-
-    cout << "Reading Tris..." << flush;
-
-	Triangles = new VifTri[NumTris];
-	unsigned int v0, v1, v2;
+// patch IDs are checked against the corners once all the vertices have been read
+static bool ParseVifTris(VifParser &rIn, Vif &rVif, unsigned int iFirst, unsigned int Count)
+{
+	unsigned int tri, v0, v1, v2, patchid;
 
-	for (tri = 0; tri < NumTris; ++tri)
+	for (tri = iFirst; tri < iFirst + Count; ++tri)
 	{
-        eat(fin);
-        if (fin.get() != 't')
-        {
-            cerr << "Error, expecting tri." << endl;
-            return false;
-        }
-
-		fin >> v0 >> v1 >> v2 >> patchid;
-
-        if ((v0 >= NumVerts) || (v1 >= NumVerts) || (v2 >= NumVerts))
-        {
-            cerr << "Invalid vertex specified in tri number " << tri << endl;
-            return false;
-        }
-		if (patchid > NumPatches)
+		rIn.Eat();
+		if (rIn.Get() != 't')
 		{
-			cerr << "Invalid patch ID specified in tri number " << tri << endl;
+			cerr << "Error, expecting tri." << endl;
 			return false;
 		}
-		if ((patchid != Vertices[v0].PatchID) || (patchid != Vertices[v1].PatchID) || (patchid != Vertices[v2].PatchID))
+		if (!rIn.ReadUInt(v0) || !rIn.ReadUInt(v1) || !rIn.ReadUInt(v2) || !rIn.ReadUInt(patchid))
 		{
-			cerr << "Error - tri number " << tri << " has patch ID different than one of its corner vertices' patch ID." << endl;
+			cerr << "Error reading tri number " << tri << endl;
+			return false;
+		}
+		if ((v0 >= rVif.NumVerts) || (v1 >= rVif.NumVerts) || (v2 >= rVif.NumVerts))
+		{
+			cerr << "Invalid vertex specified in tri number " << tri << endl;
+			return false;
+		}
+		if (patchid > rVif.NumPatches)
+		{
+			cerr << "Invalid patch ID specified in tri number " << tri << endl;
 			return false;
 		}
-		Triangles[tri].Corners[0] = v0;
-		Triangles[tri].Corners[1] = v1;
-		Triangles[tri].Corners[2] = v2;
-		Triangles[tri].PatchID = patchid;
+		rVif.Triangles[tri].Corners[0] = v0;
+		rVif.Triangles[tri].Corners[1] = v1;
+		rVif.Triangles[tri].Corners[2] = v2;
+		rVif.Triangles[tri].PatchID = patchid;
 	}
-	cout << "finished." << endl;
+	return true;
+}
 
-	if (NumErrorParams)
-	{
-		cout << "Reading Errors..." << flush;
+static bool ParseVifErrorParams(VifParser &rIn, Vif &rVif, unsigned int iFirst, unsigned int Count)
+{
+	unsigned int i, user_index;
+	int k, c;
+	float *pParam;
 
-		if (ErrorParamSize < 1)
+	for (i = iFirst; i < iFirst + Count; ++i)
+	{
+		rIn.Eat();
+		if (rIn.Get() != 'e')
 		{
-			cerr << "Error - ErrorParamSize (" << ErrorParamSize << ") expected to be a positive integer." << endl;
+			cerr << "Error on error param " << i << ", expected error param" << endl;
 			return false;
 		}
-
-		ErrorParams = new float[NumErrorParams * ErrorParamSize];
-		errorparamindex = 0;
-		for (i = 0; i < NumErrorParams; ++i)
+		if (!rIn.ReadUInt(user_index) || (user_index != i))
 		{
-			eat(fin);
-			fin.get(letter);
-			if (letter != 'e')
-			{
-				cerr << "Error on error param " << i << ", expected error param" << endl;
-				return false;
-			}
-			fin >> user_index;
-			if (user_index != i)
+			cerr << "Error in error param index agreement." << endl;
+			return false;
+		}
+		pParam = &rVif.ErrorParams[i * rVif.ErrorParamSize];
+		for (k = 0; k < rVif.ErrorParamSize; ++k)
+		{
+			rIn.Eat();
+			c = rIn.Peek();
+			if ((c == 'e') || (c == 'm') || (c == EOF) || !rIn.ReadFloat(pParam[k]))
 			{
-				cerr << "Error in error param index agreement." << endl;
+				cerr << "Error in expected number of floats in error param." << endl;
 				return false;
 			}
-			for (k = 0; k < ErrorParamSize; ++k)
-			{
-				eat(fin);
-				if (fin.peek() == 'e' || fin.peek() == 'm' || fin.eof())
-				{
-					cerr << "Error in expected number of floats in error param." << endl;
-					return false;
-				}
-				fin >> ErrorParams[errorparamindex];
-				++errorparamindex;
-			}
 		}
-		cout << "finished." << endl;
 	}
+	return true;
+}
 
-	cout << "Reading Merges..." << flush;
-	Merges = new VifMerge[NumMerges];
-	
-	for (merge = 0; merge < NumMerges; ++merge)
+static bool ParseVifMerges(VifParser &rIn, Vif &rVif, unsigned int iFirst, unsigned int Count, vector<unsigned int> &rChildren)
+{
+	unsigned int merge, parent, child;
+	int errorparamindex;
+
+	for (merge = iFirst; merge < iFirst + Count; ++merge)
 	{
-		eat(fin);
-		if (fin.get() != 'm')
+		rIn.Eat();
+		if ((rIn.Get() != 'm') || !rIn.ReadUInt(parent))
 		{
 			cerr << "Error, expecting merge." << endl;
 			return false;
 		}
-		fin >> parent;
-		if (parent >= NumVerts)
+		if (parent >= rVif.NumVerts)
 		{
 			cerr << "Attempt to merge invalid vertex in VIF." << endl;
 			return false;
 		}
-		Merges[merge].ParentNode = parent;
-
-		if (NumErrorParams > 0)
+		errorparamindex = 0;
+		if (rVif.NumErrorParams > 0)
 		{
-			eat(fin);
-			if (fin.get() != 'e')
+			rIn.Eat();
+			if ((rIn.Get() != 'e') || !rIn.ReadInt(errorparamindex))
 			{
 				cerr << "Error - expected error param index in merge " << merge << endl;
 				return false;
 			}
-			fin >> errorparamindex;
 			if (errorparamindex < 1)
 			{
 				cerr << "Error - error param index of merge " << merge << " is less than 1." << endl;
@@ -1015,30 +905,272 @@ bool Vif::ReadVif2_3(const char *Filename)
 			}
 		}
 
-		i = 0;
-		eat(fin);
-		while (fin.peek() != 'm' && !fin.eof())
+		rChildren.clear();
+		rIn.Eat();
+		while ((rIn.Peek() != 'm') && (rIn.Peek() != EOF))
 		{
-			fin >> child;
-			if (child >= NumVerts)
+			if (!rIn.ReadUInt(child) || (child >= rVif.NumVerts))
 			{
 				cerr << "Attempt to merge invalid node." << endl;
 				return false;
 			}
-			children[i] = child;
-			++i;
-			eat(fin);
+			rChildren.push_back(child);
+			rIn.Eat();
+		}
+		VifMerge &rMerge = rVif.Merges[merge];
+		rMerge.ParentNode = parent;
+		rMerge.ErrorParamIndex = errorparamindex;
+		rMerge.NumNodesInMerge = (unsigned int) rChildren.size();
+		rMerge.NodesBeingMerged = new unsigned int[rMerge.NumNodesInMerge];
+		if (rMerge.NumNodesInMerge > 0)
+			memcpy(rMerge.NodesBeingMerged, &rChildren[0], rMerge.NumNodesInMerge * sizeof(unsigned int));
+	}
+	return true;
+}
+
+struct VifChunk
+{
+	int Section;
+	const char *pStart;
+	const char *pEnd;	// start of the next chunk (merges run until the next 'm')
+	unsigned int iFirst;
+	unsigned int Count;
+};
+
+static bool ParseVifChunk(const VifChunk &rChunk, Vif &rVif, vector<unsigned int> &rChildren)
+{
+	VifParser in(rChunk.pStart, rChunk.pEnd);
+	switch (rChunk.Section)
+	{
+	case VIF_SECTION_POSITIONS:
+		return ParseVifVertexPositions(in, rVif, rChunk.iFirst, rChunk.Count);
+	case VIF_SECTION_VERTICES:
+		return ParseVifVertices(in, rVif, rChunk.iFirst, rChunk.Count);
+	case VIF_SECTION_TRIS:
+		return ParseVifTris(in, rVif, rChunk.iFirst, rChunk.Count);
+	case VIF_SECTION_ERROR_PARAMS:
+		return ParseVifErrorParams(in, rVif, rChunk.iFirst, rChunk.Count);
+	default:
+		return ParseVifMerges(in, rVif, rChunk.iFirst, rChunk.Count, rChildren);
+	}
+}
+
+// Splits the body of a VIF file into chunks of whole records, assuming every record
+// starts on its own line.  Returns false if the file doesn't look like that (or the
+// record counts don't match the header), in which case it must be parsed sequentially.
+static bool FindVifChunks(const char *pBody, const char *pEnd, const unsigned int *pExpectedCounts, vector<VifChunk> &rChunks)
+{
+	unsigned int counts[VIF_NUM_SECTIONS] = { 0, 0, 0, 0, 0 };
+	const char *line, *next, *q;
+	const char *pLetter;
+	int section = -1, s;
+	VifChunk chunk;
+
+	rChunks.clear();
+	for (line = pBody; line < pEnd; line = next)
+	{
+		next = (const char *) memchr(line, '\n', pEnd - line);
+		next = (next == NULL) ? pEnd : next + 1;
+		for (q = line; (q < next) && isspace((unsigned char) *q); ++q)
+			;
+		if ((q == next) || (*q == '#'))
+			continue;
+		pLetter = strchr(VifSectionLetters, *q);
+		if ((pLetter == NULL) || (*q == '\0'))
+		{
+			// vertex position attribute lines and merge continuations
+			if ((section == VIF_SECTION_POSITIONS) && ((*q == 'c') || (*q == 'n') || (*q == 'x')))
+				continue;
+			if ((section == VIF_SECTION_MERGES) && (*q >= '0') && (*q <= '9'))
+				continue;
+			return false;
+		}
+		s = (int) (pLetter - VifSectionLetters);
+		if (s < section)
+			return false;
+		if ((s != section) || (counts[s] % VIF_RECORDS_PER_CHUNK == 0))
+		{
+			if (!rChunks.empty())
+				rChunks.back().pEnd = q;
+			chunk.Section = s;
+			chunk.pStart = q;
+			chunk.pEnd = pEnd;
+			chunk.iFirst = counts[s];
+			chunk.Count = 0;
+			rChunks.push_back(chunk);
+			section = s;
+		}
+		++counts[s];
+		++rChunks.back().Count;
+	}
+	for (s = 0; s < VIF_NUM_SECTIONS; ++s)
+	{
+		if (counts[s] != pExpectedCounts[s])
+			return false;
+	}
+	return true;
+}
+
+struct VifParseJob
+{
+	Vif *pVif;
+	const vector<VifChunk> *pChunks;
+	bool *pThreadFailed;
+};
+
+static void ParseVifChunksThread(int iThread, int NumThreads, void *pParams)
+{
+	VifParseJob *pJob = (VifParseJob *) pParams;
+	vector<unsigned int> children;
+	size_t i;
+
+	for (i = iThread; i < pJob->pChunks->size(); i += NumThreads)
+	{
+		if (!ParseVifChunk((*pJob->pChunks)[i], *pJob->pVif, children))
+		{
+			pJob->pThreadFailed[iThread] = true;
+			return;
+		}
+	}
+}
+
+bool Vif::ReadVif(const char *Filename, int NumThreads)
+{
+	unsigned int i, major, minor, format;
+	NodeIndex node;
+	TriIndex tri;
+	VifFileView view;
+
+	if (!view.Open(Filename))
+	{
+		fprintf(stderr, "Error opening file \"%s\"\n", Filename);
+		return false;
+	}
+
+	cout << "Reading VIF Header...";
+	VifHeaderBuf headerbuf(view.mpData, view.mSize);
+	istream header(&headerbuf);
+	if (!read_header(header, major, minor, format, NumTextures, NumVertexPositions, NumVerts, NumTris, NumPatches, NumMerges, NumErrorParams, ErrorParamSize))
+	{
+		cerr << "Incorrect header in \"" << Filename << "\"" << endl;
+		return false;
+	}
+	cout << "finished." << endl;
+	if ((format & POSITION) == 0)
+	{
+		cerr << "VIF files must contain position" << endl;
+		return false;
+	}
+	if ((NumErrorParams > 0) && (ErrorParamSize < 1))
+	{
+		cerr << "Error - ErrorParamSize (" << ErrorParamSize << ") expected to be a positive integer." << endl;
+		return false;
+	}
+	ColorsPresent = ((format & COLORMASK) != 0);
+	NormalsPresent = ((format & NORMAL) != 0);
+
+	// everything is sized from the header up front
+	VertexPositions = new VertexRenderDatum[NumVertexPositions];
+	if (NumTextures > 0)
+	{
+		TextureCoords = new Point2 *[NumVertexPositions];
+		for (i = 0; i < NumVertexPositions; ++i)
+			TextureCoords[i] = new Point2[NumTextures];
+	}
+	Vertices = new VifVertex[NumVerts];
+	Triangles = new VifTri[NumTris];
+	if (NumErrorParams > 0)
+		ErrorParams = new float[NumErrorParams * ErrorParamSize];
+	Merges = new VifMerge[NumMerges];
+	for (i = 0; i < NumMerges; ++i)
+	{
+		Merges[i].NumNodesInMerge = 0;
+		Merges[i].NodesBeingMerged = NULL;
+	}
+
+	cout << "Reading VIF Data..." << flush;
+	const char *pBody = view.mpData + headerbuf.GetOffset();
+	const char *pEnd = view.mpData + view.mSize;
+	unsigned int ExpectedCounts[VIF_NUM_SECTIONS] = { NumVertexPositions, NumVerts, NumTris, NumErrorParams, NumMerges };
+	vector<VifChunk> chunks;
+	bool ok = true;
+
+	if (NumThreads <= 0)
+		NumThreads = GetNumSystemProcessors();
+	if ((NumThreads > 1) && FindVifChunks(pBody, pEnd, ExpectedCounts, chunks) && (chunks.size() > 1))
+	{
+		if ((size_t) NumThreads > chunks.size())
+			NumThreads = (int) chunks.size();
+		bool *pThreadFailed = new bool[NumThreads];
+		for (int iThread = 0; iThread < NumThreads; ++iThread)
+			pThreadFailed[iThread] = false;
+		VifParseJob job;
+		job.pVif = this;
+		job.pChunks = &chunks;
+		job.pThreadFailed = pThreadFailed;
+		ForkAndJoinThreads(NumThreads, ParseVifChunksThread, &job);
+		for (int iThread = 0; iThread < NumThreads; ++iThread)
+			ok = ok && !pThreadFailed[iThread];
+		delete[] pThreadFailed;
+	}
+	else
+	{
+		VifParser in(pBody, pEnd);
+		vector<unsigned int> children;
+		ok = ParseVifVertexPositions(in, *this, 0, NumVertexPositions) &&
+			ParseVifVertices(in, *this, 0, NumVerts) &&
+			ParseVifTris(in, *this, 0, NumTris) &&
+			ParseVifErrorParams(in, *this, 0, NumErrorParams) &&
+			ParseVifMerges(in, *this, 0, NumMerges, children);
+	}
+	if (!ok)
+		return false;
+
+	for (node = 0; node < NumVerts; node++)
+	{
+		if (Vertices[node].CoincidentVertexFlag)
+		{
+			i = node;
+			if (Vertices[i].CoincidentVertex == i)
+			{
+				cerr << "Error - Coincident vertex points to self." << endl;
+				return false;
+			}
+			while (Vertices[i].CoincidentVertex != node)
+			{
+				if (!Vertices[i].CoincidentVertexFlag || (Vertices[i].CoincidentVertex >= NumVerts))
+				{
+					cerr << "Error - Coincident vertex doesn't have coincident vertex flag set." << endl;
+					return false;
+				}
+				i = Vertices[i].CoincidentVertex;
+			}
+		}
+	}
+	for (tri = 0; tri < NumTris; ++tri)
+	{
+		PatchIndex patchid = Triangles[tri].PatchID;
+		if ((patchid != Vertices[Triangles[tri].Corners[0]].PatchID) || (patchid != Vertices[Triangles[tri].Corners[1]].PatchID) || 
+			(patchid != Vertices[Triangles[tri].Corners[2]].PatchID))
+		{
+			cerr << "Error - tri number " << tri << " has patch ID different than one of its corner vertices' patch ID." << endl;
+			return false;
 		}
-		Merges[merge].NumNodesInMerge = i;
-		Merges[merge].NodesBeingMerged = new unsigned int[Merges[merge].NumNodesInMerge];
-		for (i = 0; i < Merges[merge].NumNodesInMerge; ++i)
-			Merges[merge].NodesBeingMerged[i] = children[i];
-		Merges[merge].ErrorParamIndex = errorparamindex;
 	}
 	cout << "finished." << endl;
 	return true;
 }
 
+bool Vif::ReadVif2_2(const char *Filename)
+{
+	return ReadVif(Filename);
+}
+
+bool Vif::ReadVif2_3(const char *Filename)
+{
+	return ReadVif(Filename);
+}
+
 //return the next non-blank, non-comment line
 char *get_line(istream &rIStream)
 {
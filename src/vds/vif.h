@@ -100,6 +100,11 @@ public:
 	// Returns true if write was successful, false if error occurred
 	bool WriteVif2_3(const char *Filename);
 
+	// Reads Vif from a VIF2.2 or VIF2.3 format file, memory mapping it and parsing its
+	// sections with NumThreads threads (0 means one per processor)
+	// return true if read was successful, false if error occurred
+	bool ReadVif(const char *Filename, int NumThreads = 0);
+
 	// Reads Vif from a VIF2.2 format file
 	// return true if read was successful, false if error occurred
 	bool ReadVif2_2(const char *Filename);
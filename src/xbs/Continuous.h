@@ -15,6 +15,8 @@
 
 #include "xbs.h"
 #include "Hierarchy.h"
+#include <forestbuilder.h>
+#include <vector>
 
 class VDSHierarchy : public Hierarchy
 {
@@ -22,18 +24,67 @@ class VDSHierarchy : public Hierarchy
         int *danglingVerts;
         int numDanglingVerts;
         int maxDanglingVerts;
+
+        // The hierarchy as it is built, numbered from 0 like a VIF file;
+        // finalize() hands it to VDS::ForestBuilder::BuildForest()
+        char colorsPresent, normalsPresent;
+        int numTextures;
+        int numPatches;
+        std::vector<VDS::VertexRenderDatum> renderData;
+        std::vector<VDS::NodeIndex> nodeRenderData;
+        std::vector<VDS::PatchIndex> nodePatches;
+        std::vector<VDS::NodeIndex> coincidentNodes;
+        std::vector<VDS::NodeIndex> triCorners;
+        std::vector<VDS::PatchIndex> triPatches;
+        std::vector<VDS::NodeIndex> mergeParents;
+        std::vector<unsigned int> mergeSizes;
+        std::vector<VDS::NodeIndex> mergeChildren;
+
+        // while the forest is being read progressively, the stream it
+        // comes from; see beginProgressiveStream()
+        GLOD_StreamReader *progressiveIn;
+
+        int addRenderDatum(xbsVertex *vert);
+        int addNode(int renderDatum, VDS::PatchIndex patch)
+        {
+            nodeRenderData.push_back(renderDatum);
+            nodePatches.push_back(patch);
+            coincidentNodes.push_back(nodeRenderData.size() - 1);
+            return (int)nodeRenderData.size() - 1;
+        }
+        void beginMerge(int parent)
+        {
+            mergeParents.push_back(parent);
+            mergeSizes.push_back(0);
+        }
+        void addMergeChild(int child)
+        {
+            mergeChildren.push_back(child);
+            mergeSizes.back()++;
+        }
+        void freeBuildData()
+        {
+            // swap with empties to actually release the memory
+            std::vector<VDS::VertexRenderDatum>().swap(renderData);
+            std::vector<VDS::NodeIndex>().swap(nodeRenderData);
+            std::vector<VDS::PatchIndex>().swap(nodePatches);
+            std::vector<VDS::NodeIndex>().swap(coincidentNodes);
+            std::vector<VDS::NodeIndex>().swap(triCorners);
+            std::vector<VDS::PatchIndex>().swap(triPatches);
+            std::vector<VDS::NodeIndex>().swap(mergeParents);
+            std::vector<unsigned int>().swap(mergeSizes);
+            std::vector<VDS::NodeIndex>().swap(mergeChildren);
+        }
     
     public:
             GLfloat quadricMultiplier;    
-        
-        Vif *vif; // used for building VDS  
     
         Forest *mpForest;  
     
         VDSHierarchy()  : Hierarchy(VDS_Hierarchy)
         {
-            vif = NULL;
             mpForest = NULL;
+            progressiveIn = NULL;
             numDanglingVerts = 0;
             danglingVerts = new int();
             maxDanglingVerts = 1;
@@ -43,8 +94,7 @@ class VDSHierarchy : public Hierarchy
                 delete mpForest;
             if(danglingVerts != NULL)
                 delete [] danglingVerts;
-            if(vif != NULL)
-                delete vif;
+            delete progressiveIn;
         };
         void InitForLoad() { 
             delete [] danglingVerts;
@@ -83,6 +133,12 @@ class VDSHierarchy : public Hierarchy
         virtual int  getReadbackSize();
         virtual void readback(void* dst);
         virtual int load(void* src);
+        virtual int writeStream(GLOD_StreamWriter* out);
+        virtual int readStream(GLOD_StreamReader* in);
+        virtual int writeProgressiveStream(GLOD_StreamWriter* out);
+        virtual int beginProgressiveStream(GLOD_StreamReader* in);
+        virtual int continueProgressiveStream(unsigned int max_records);
+        virtual unsigned int getProgressiveRecordsLeft();
 
         virtual int GetPatchCount() {
             return mpForest->mNumPatches;
@@ -128,6 +184,11 @@ class VDSCut : public GLOD_Cut
 
         virtual void getReadbackSizes(int patch, GLuint* nindices, GLuint* nverts);
         virtual void readback(int npatch, GLOD_RawPatch* patch);
+        virtual int fill(int npatch, GLOD_FillTarget* target);
+
+        virtual int getSnapshotSize();
+        virtual void saveSnapshot(void* data);
+        virtual int loadSnapshot(const void* data);
 
         void initVBO();
 };
@@ -206,9 +206,19 @@ class DiscreteHierarchy : public Hierarchy
         virtual int  getReadbackSize();
         virtual void readback(void* dst);
         virtual int load(void* src); // returns 0 on fail
+        virtual int writeStream(GLOD_StreamWriter* out);
+        virtual int readStream(GLOD_StreamReader* in);
         virtual void changeQuadricMultiplier(GLfloat multiplier);
+        // levels need not have the same patches (GLOD_DISCRETE_MANUAL levels
+        // are whatever the application inserted, and loaded levels whatever
+        // was saved), so this covers every level's; a cut treats the
+        // patches its level lacks as empty
         virtual int GetPatchCount() {
-            return LODs[current]->numPatches;
+            int count = 0;
+            for (int i=0; i<numLODs; i++)
+                if (LODs[i]->numPatches > count)
+                    count = LODs[i]->numPatches;
+            return count;
         }
 };
 
@@ -220,9 +230,17 @@ class DiscreteCut : public GLOD_Cut
             currentNumTris = hierarchy->LODs[LODNumber]->numTris;
             refineTris = (LODNumber == 0) ? MAXINT :
                 hierarchy->LODs[LODNumber-1]->numTris;
-            hierarchy->current=LODNumber;
+            // the hierarchy's current level is left alone: instances share
+            // it and may adapt on different threads
         }
         void computeBoundingSphere();
+        // the cut's level's patch, or NULL if the level has no such patch
+        DiscretePatch *getPatch(int npatch)
+        {
+            DiscreteLevel *level = hierarchy->LODs[LODNumber];
+            return ((npatch >= 0) && (npatch < level->numPatches)) ?
+                &level->patches[npatch] : NULL;
+        }
     
     public:
         DiscreteHierarchy *hierarchy;
@@ -275,6 +293,7 @@ class DiscreteCut : public GLOD_Cut
 #ifdef GLOD
         virtual void getReadbackSizes(int patch, GLuint* nindices, GLuint* nverts);
         virtual void readback(int npatch, GLOD_RawPatch* patch);
+        virtual int fill(int npatch, GLOD_FillTarget* target);
 #endif
 
         void initVBO();
@@ -18,12 +18,12 @@
 #include "vds_callbacks.h"
 #include "manager.h"
 
-extern VDS::Manager s_VDSMemoryManager;
-
 // predefs
 class EdgeCollapse;
 class Model;
 class Operation;
+class GLOD_StreamWriter;
+class GLOD_StreamReader;
 
 #include "View.h"
 
@@ -68,8 +68,18 @@ class GLOD_Cut
 #ifdef GLOD
         virtual void getReadbackSizes(int patch, GLuint* nindices, GLuint* nverts) = 0;
         virtual void readback(int npatch, GLOD_RawPatch* patch) = 0;
+
+        // writes a patch straight into the caller's arrays; returns 0 if
+        // this cut can't, and readback() is used instead
+        virtual int fill(int npatch, GLOD_FillTarget* target) { return 0; };
 #endif
 
+        // snapshots of the cut's current state; cuts that don't support
+        // them report a size of 0
+        virtual int getSnapshotSize() { return 0; };
+        virtual void saveSnapshot(void* data) {};
+        virtual int loadSnapshot(const void* data) { return 0; };
+
     
         // VBO rendering stuff
         GLuint VBO_id;
@@ -103,6 +113,20 @@ class Hierarchy
         virtual int  getReadbackSize() = 0;
         virtual void readback(void* dst) = 0;
 
+        // object streams (glod_stream.h); return 0 on fail. An in place
+        // reader's memory may be kept and used by the loaded hierarchy.
+        virtual int writeStream(GLOD_StreamWriter* out) { return 0; };
+        virtual int readStream(GLOD_StreamReader* in) { return 0; };
+
+        // progressive object streams: beginProgressiveStream() reads only
+        // enough to use the hierarchy, and takes over the reader, which
+        // continueProgressiveStream() reads up to max_records more records
+        // from; it returns 0 once there are none left. 0 if unsupported.
+        virtual int writeProgressiveStream(GLOD_StreamWriter* out) { return 0; };
+        virtual int beginProgressiveStream(GLOD_StreamReader* in) { return 0; };
+        virtual int continueProgressiveStream(unsigned int max_records) { return 0; };
+        virtual unsigned int getProgressiveRecordsLeft() { return 0; };
+
         virtual void changeQuadricMultiplier(GLfloat multiplier) = 0;
         
         virtual int GetPatchCount() = 0;
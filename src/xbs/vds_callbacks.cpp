@@ -138,10 +138,6 @@ void VBOFastRenderCallback(VDS::Renderer &rRenderer, VDS::PatchIndex PatchID)
 
     glDrawElements(GL_TRIANGLES, (NumTris) * 3, GL_UNSIGNED_INT, rRenderer.mpPatchTriData[PatchID].TriProxiesArray);
 //      glDrawRangeElements(GL_TRIANGLES, 0, rRenderer.mNumVertices, (NumTris) * 3, GL_UNSIGNED_INT, rRenderer.mpPatchTriData[PatchID].TriProxiesArray);
-
-#ifdef TIMING_LEVEL_2
-    rRenderer.times_30.LowPart = (time_after_copy.LowPart - time_before_copy.LowPart);
-#endif
 }
 
 // NODE ERROR CALLBACKS ******************************************
@@ -348,12 +348,17 @@ class XBSSimplifier
     
   public:
     
+    // if progress is given, the fraction of the model's vertices removed
+    // so far is written to it as simplification goes (for async builds)
     XBSSimplifier(Model *mdl, OperationType opType = Half_Edge_Collapse,
-	       QueueMode qm = Lazy, Hierarchy* h = NULL, int bordLck=0)
+	       QueueMode qm = Lazy, Hierarchy* h = NULL, int bordLck=0,
+	       volatile float *progress = NULL)
     {
 	model = mdl;
 	output = h;
 	borderLock = bordLck;
+	int numOps = 0;
+	int numVerts = model->getNumVerts();
 	
 	output->initialize(model);
 
@@ -423,6 +428,9 @@ class XBSSimplifier
 
 		//remove the op when we done it.
 		delete op;
+
+	    if ((progress != NULL) && (++numOps < numVerts))
+		*progress = (float) numOps / (float) numVerts;
             
             // debug
             model->testVertOps();